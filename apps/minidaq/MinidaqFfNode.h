@@ -39,6 +39,7 @@ class MinidaqFfNode : public MinidaqNode {
     bool _Accept();
     int _PickSubdetector();
     int _PickNFragments();
+    void _AcquireOffloadCredit();
 
     int _baseId = 0;
     int _nSubdetectors = 0;
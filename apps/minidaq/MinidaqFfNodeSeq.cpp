@@ -83,37 +83,30 @@ void MinidaqFfNodeSeq::_Task(Key &&key, std::atomic<std::uint64_t> &cnt,
         }
 #endif /* WITH_INTEGRITY_CHECK */
         if (accept) {
-            while (1) {
-                try {
-                    _kvs->UpdateAsync(
-                        key, UpdateOptions(LONG_TERM),
-                        [&cnt, &cntErr](DaqDB::KVStoreBase *kvs,
-                                        DaqDB::Status status, const char *key,
-                                        const size_t keySize, const char *value,
-                                        const size_t valueSize) {
-                            if (!status.ok()) {
-                                cntErr++;
-                            } else {
-                                cnt++;
-                            }
-                        });
-                    _kvs->Free(key, std::move(value));
-                    /** @todo c++ does not allow it in lambda,
-                     *        this is not thread-safe
-                     */
-                } catch (QueueFullException &e) {
-                    // Keep retrying
-                    if (_delay_us) {
-                        std::this_thread::sleep_for(
-                            std::chrono::microseconds(_delay_us));
-                    }
-                    continue;
-                } catch (...) {
-                    _kvs->Free(key, std::move(value));
-                    _kvs->Free(std::move(key));
-                    throw;
-                }
-                break;
+            UpdateOptions updateOptions(LONG_TERM);
+            updateOptions.useCredit(true);
+            try {
+                _AcquireOffloadCredit();
+                _kvs->UpdateAsync(
+                    key, updateOptions,
+                    [&cnt, &cntErr](DaqDB::KVStoreBase *kvs,
+                                    DaqDB::Status status, const char *key,
+                                    const size_t keySize, const char *value,
+                                    const size_t valueSize) {
+                        if (!status.ok()) {
+                            cntErr++;
+                        } else {
+                            cnt++;
+                        }
+                    });
+                _kvs->Free(key, std::move(value));
+                /** @todo c++ does not allow it in lambda,
+                 *        this is not thread-safe
+                 */
+            } catch (...) {
+                _kvs->Free(key, std::move(value));
+                _kvs->Free(std::move(key));
+                throw;
             }
         } else {
             _kvs->Remove(key);
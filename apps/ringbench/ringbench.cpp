@@ -0,0 +1,182 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Throughput comparison of the portable LockFreeRing and spdk_ring in the
+ * configuration used by the pollers (N producers, single consumer, bursts
+ * of pointers).
+ */
+
+#include <atomic>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "spdk/env.h"
+
+#include <LockFreeRing.h>
+
+using namespace std;
+namespace po = boost::program_options;
+
+struct RingBenchParams {
+    unsigned int producers;
+    size_t ringSize;
+    size_t burst;
+    uint64_t opsPerProducer;
+};
+
+class SpdkRingAdapter {
+  public:
+    explicit SpdkRingAdapter(size_t count) {
+        _ring = spdk_ring_create(SPDK_RING_TYPE_MP_SC, count,
+                                 SPDK_ENV_SOCKET_ID_ANY);
+    }
+    ~SpdkRingAdapter() { spdk_ring_free(_ring); }
+    bool valid() const { return _ring != nullptr; }
+    size_t enqueueBurst(void **objs, size_t n) {
+        return spdk_ring_enqueue(_ring, objs, n, nullptr);
+    }
+    size_t dequeueBurst(void **objs, size_t n) {
+        return spdk_ring_dequeue(_ring, objs, n);
+    }
+
+  private:
+    struct spdk_ring *_ring;
+};
+
+class PortableRingAdapter {
+  public:
+    explicit PortableRingAdapter(size_t count)
+        : _ring(count, DaqDB::RingType::MP_SC) {}
+    bool valid() const { return true; }
+    size_t enqueueBurst(void **objs, size_t n) {
+        return _ring.enqueueBurst(objs, n);
+    }
+    size_t dequeueBurst(void **objs, size_t n) {
+        return _ring.dequeueBurst(objs, n);
+    }
+
+  private:
+    DaqDB::LockFreeRing<void *> _ring;
+};
+
+template <class Ring>
+double runBench(Ring &ring, const RingBenchParams &params) {
+    std::atomic<bool> start{false};
+    std::vector<std::thread> producers;
+
+    for (unsigned int p = 0; p < params.producers; p++) {
+        producers.emplace_back([&ring, &params, &start]() {
+            std::vector<void *> objs(params.burst,
+                                     reinterpret_cast<void *>(0x1));
+            while (!start.load(std::memory_order_acquire))
+                ;
+            uint64_t sent = 0;
+            while (sent < params.opsPerProducer) {
+                size_t n = std::min<uint64_t>(params.burst,
+                                              params.opsPerProducer - sent);
+                sent += ring.enqueueBurst(objs.data(), n);
+            }
+        });
+    }
+
+    std::vector<void *> objs(params.burst);
+    const uint64_t total = params.opsPerProducer * params.producers;
+    uint64_t received = 0;
+
+    auto begin = chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    while (received < total)
+        received += ring.dequeueBurst(objs.data(), params.burst);
+    auto end = chrono::steady_clock::now();
+
+    for (auto &t : producers)
+        t.join();
+
+    chrono::duration<double> elapsed = end - begin;
+    return total / elapsed.count() / 1000000;
+}
+
+int main(int argc, char **argv) {
+    RingBenchParams params;
+    bool skipSpdk = false;
+
+    po::options_description argumentsDescription{"Options"};
+    argumentsDescription.add_options()("help,h", "Print help messages")(
+        "producers,p",
+        po::value<unsigned int>(&params.producers)->default_value(4),
+        "Number of producer threads")(
+        "ring-size,r",
+        po::value<size_t>(&params.ringSize)->default_value(4096 * 4),
+        "Ring size")("burst,b",
+                     po::value<size_t>(&params.burst)->default_value(32),
+                     "Enqueue/dequeue burst size")(
+        "ops,n",
+        po::value<uint64_t>(&params.opsPerProducer)->default_value(10000000),
+        "Operations per producer")(
+        "no-spdk", po::bool_switch(&skipSpdk),
+        "Skip spdk_ring (no SPDK environment/hugepages available)");
+
+    po::variables_map parsedArguments;
+    try {
+        po::store(po::parse_command_line(argc, argv, argumentsDescription),
+                  parsedArguments);
+
+        if (parsedArguments.count("help")) {
+            std::cout << argumentsDescription << endl;
+            return 0;
+        }
+        po::notify(parsedArguments);
+    } catch (po::error &parserError) {
+        cerr << "Invalid arguments: " << parserError.what() << endl << endl;
+        cerr << argumentsDescription << endl;
+        return -1;
+    }
+
+    cout << "producers=" << params.producers
+         << " ring-size=" << params.ringSize << " burst=" << params.burst
+         << " ops/producer=" << params.opsPerProducer << endl;
+
+    PortableRingAdapter portableRing(params.ringSize);
+    cout << "LockFreeRing: " << fixed << setprecision(2)
+         << runBench(portableRing, params) << " Mops/s" << endl;
+
+    if (skipSpdk)
+        return 0;
+
+    struct spdk_env_opts opts;
+    spdk_env_opts_init(&opts);
+    opts.name = "ringbench";
+    opts.shm_id = -1;
+    if (spdk_env_init(&opts) < 0) {
+        cerr << "Cannot initialize SPDK environment" << endl;
+        return -1;
+    }
+
+    SpdkRingAdapter spdkRing(params.ringSize);
+    if (!spdkRing.valid()) {
+        cerr << "Cannot create spdk_ring" << endl;
+        return -1;
+    }
+    cout << "spdk_ring:    " << fixed << setprecision(2)
+         << runBench(spdkRing, params) << " Mops/s" << endl;
+
+    return 0;
+}
@@ -0,0 +1,524 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/*
+ * Optional coroutine layer over PutAsync/GetAsync/UpdateAsync. DAQDB itself
+ * is built as C++14, this header is usable only from C++20 translation units
+ * and is empty otherwise.
+ *
+ *   DaqDB::coro::Task<> readOne(DaqDB::coro::Store &store, Key key) {
+ *       auto res = co_await store.Get(key);
+ *       ...
+ *   }
+ *
+ *   DaqDB::coro::Executor exec(*kvs);
+ *   DaqDB::coro::Store store(*kvs);
+ *   for (auto &key : keys)
+ *       exec.spawn(readOne(store, key));
+ *   exec.run();
+ *
+ * Pass state to tasks as parameters, captures of a coroutine lambda do not
+ * outlive the lambda object.
+ */
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#define DAQDB_COROUTINES 1
+
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <daqdb/KVStoreBase.h>
+#include <daqdb/Types.h>
+
+namespace DaqDB {
+namespace coro {
+
+/**
+ * Per-thread cache of coroutine frames in power of two size classes.
+ * Frames are taken from the cache of the thread that destroys the coroutine
+ * and returned to it, so steady state resumption does not touch the heap.
+ * Each class keeps at most MAX_CACHED_FRAMES frames, frames freed above
+ * that go back to the heap so a burst of coroutines is not pinned to the
+ * thread.
+ */
+class FramePool {
+  public:
+    static void *alloc(size_t size) {
+        size_t cls = _sizeClass(size);
+        if (cls >= SIZE_CLASSES)
+            return ::operator new(size);
+        auto &cache = _cache();
+        FreeFrame *frame = cache.heads[cls];
+        if (frame) {
+            cache.heads[cls] = frame->next;
+            cache.counts[cls]--;
+            return frame;
+        }
+        return ::operator new(MIN_FRAME_SIZE << cls);
+    }
+
+    static void free(void *ptr, size_t size) noexcept {
+        size_t cls = _sizeClass(size);
+        if (cls >= SIZE_CLASSES)
+            return ::operator delete(ptr);
+        auto &cache = _cache();
+        if (cache.counts[cls] >= MAX_CACHED_FRAMES)
+            return ::operator delete(ptr);
+        auto *frame = static_cast<FreeFrame *>(ptr);
+        frame->next = cache.heads[cls];
+        cache.heads[cls] = frame;
+        cache.counts[cls]++;
+    }
+
+    /** Number of frames of given size cached by the calling thread. */
+    static size_t cached(size_t size) {
+        size_t cls = _sizeClass(size);
+        return (cls < SIZE_CLASSES) ? _cache().counts[cls] : 0;
+    }
+
+    static constexpr size_t MAX_CACHED_FRAMES = 256;
+
+  private:
+    static const size_t MIN_FRAME_SIZE = 64;
+    static const size_t SIZE_CLASSES = 10; // up to 32KB frames
+
+    struct FreeFrame {
+        FreeFrame *next;
+    };
+
+    struct Cache {
+        FreeFrame *heads[SIZE_CLASSES] = {};
+        size_t counts[SIZE_CLASSES] = {};
+        ~Cache() {
+            for (auto head : heads) {
+                while (head) {
+                    auto next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+    };
+
+    static size_t _sizeClass(size_t size) {
+        size_t cls = 0;
+        while ((MIN_FRAME_SIZE << cls) < size)
+            cls++;
+        return cls;
+    }
+
+    static Cache &_cache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+};
+
+template <class T = void> class Task;
+
+namespace detail {
+
+struct PooledFrame {
+    static void *operator new(size_t size) { return FramePool::alloc(size); }
+    static void operator delete(void *ptr, size_t size) noexcept {
+        FramePool::free(ptr, size);
+    }
+};
+
+struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <class P>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<P> h) noexcept {
+        auto cont = h.promise().continuation;
+        return cont ? cont : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase : PooledFrame {
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+};
+
+template <class T> struct Promise : PromiseBase {
+    Task<T> get_return_object();
+    template <class U> void return_value(U &&value) {
+        result = std::forward<U>(value);
+    }
+    T take() {
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(result);
+    }
+    T result{};
+};
+
+template <> struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void take() {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+} // namespace detail
+
+/**
+ * Lazily started coroutine returning T. Starts when awaited or when handed
+ * to Executor::spawn().
+ */
+template <class T> class Task {
+  public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle h) : _h(h) {}
+    Task(Task &&t) noexcept : _h(std::exchange(t._h, nullptr)) {}
+    Task &operator=(Task &&t) noexcept {
+        if (this != &t) {
+            if (_h)
+                _h.destroy();
+            _h = std::exchange(t._h, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() {
+        if (_h)
+            _h.destroy();
+    }
+
+    bool await_ready() const noexcept { return !_h || _h.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) {
+        _h.promise().continuation = cont;
+        return _h;
+    }
+    T await_resume() { return _h.promise().take(); }
+
+  private:
+    Handle _h = nullptr;
+};
+
+namespace detail {
+template <class T> Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+} // namespace detail
+
+/**
+ * Single threaded scheduler driving many in-flight operations. Switches the
+ * constructing thread to a completion queue, so completions are delivered
+ * from run() on this thread and no cross-thread handoff is needed to resume
+ * a coroutine. Must be constructed, run and destroyed on the same thread.
+ */
+class Executor {
+  public:
+    explicit Executor(KVStoreBase &kvs, size_t queueDepth = 4096)
+        : _kvs(kvs) {
+        _kvs.EnableCompletionQueue(queueDepth);
+        _ready.reserve(queueDepth);
+        _running.reserve(queueDepth);
+    }
+    ~Executor() { _kvs.DisableCompletionQueue(); }
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    /**
+     * Start a task. Ownership is taken by the executor, the task is
+     * destroyed when it completes.
+     */
+    void spawn(Task<> task) {
+        auto d = _drive(*this, std::move(task));
+        _active++;
+        schedule(d.h);
+    }
+
+    /**
+     * Run until all spawned tasks complete.
+     *
+     * @throw first exception which escaped a spawned task
+     */
+    void run() {
+        while (_active) {
+            if (!_runReady() && !_kvs.PollCompletions(COMPLETION_BURST))
+                std::this_thread::yield();
+        }
+        if (_error)
+            std::rethrow_exception(std::exchange(_error, nullptr));
+    }
+
+    /**
+     * Queue a suspended coroutine for resumption. Not thread safe, callers
+     * are expected to run on the executor thread.
+     */
+    void schedule(std::coroutine_handle<> h) { _ready.push_back(h); }
+
+    size_t active() const { return _active; }
+    KVStoreBase &kvs() { return _kvs; }
+
+    static Executor *current() { return _current(); }
+
+  private:
+    static const size_t COMPLETION_BURST = 64;
+
+    struct Detached {
+        struct promise_type : detail::PooledFrame {
+            promise_type(Executor &exec, Task<> &) : exec(exec) {}
+            Detached get_return_object() {
+                return {std::coroutine_handle<promise_type>::from_promise(
+                    *this)};
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept {
+                exec._active--;
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() {
+                if (!exec._error)
+                    exec._error = std::current_exception();
+            }
+            Executor &exec;
+        };
+        std::coroutine_handle<> h;
+    };
+
+    /* exec is consumed by the promise constructor */
+    static Detached _drive([[maybe_unused]] Executor &exec, Task<> task) {
+        co_await task;
+    }
+
+    bool _runReady() {
+        if (_ready.empty())
+            return false;
+        std::swap(_ready, _running);
+        Executor *prev = std::exchange(_current(), this);
+        for (auto h : _running)
+            h.resume();
+        _current() = prev;
+        _running.clear();
+        return true;
+    }
+
+    static Executor *&_current() {
+        static thread_local Executor *exec = nullptr;
+        return exec;
+    }
+
+    KVStoreBase &_kvs;
+    std::vector<std::coroutine_handle<>> _ready;
+    std::vector<std::coroutine_handle<>> _running;
+    size_t _active = 0;
+    std::exception_ptr _error;
+};
+
+struct GetResult {
+    Status status;
+    Value value; // NOT_BUFFERED, release with KVStoreBase::Free(key, value)
+};
+
+namespace detail {
+
+/*
+ * Awaiter shared by all operations. The callback runs on the executor thread
+ * (completion queue or synchronous error path), it only records the result
+ * and queues the coroutine, resumption always happens from Executor::run().
+ */
+class OpAwaiter {
+  public:
+    explicit OpAwaiter(KVStoreBase &kvs) : _kvs(kvs) {}
+    OpAwaiter(const OpAwaiter &) = delete;
+    OpAwaiter &operator=(const OpAwaiter &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+  protected:
+    void _suspend(std::coroutine_handle<> h) {
+        _h = h;
+        _exec = Executor::current();
+        if (!_exec)
+            throw OperationFailedException(Status(NOT_SUPPORTED),
+                                           "co_await outside of executor");
+    }
+
+    void _complete(Status status) {
+        _status = status;
+        _exec->schedule(_h);
+    }
+
+    KVStoreBase &_kvs;
+    Status _status;
+    std::coroutine_handle<> _h;
+    Executor *_exec = nullptr;
+};
+
+class PutAwaiter : public OpAwaiter {
+  public:
+    PutAwaiter(KVStoreBase &kvs, Key &&key, Value &&value,
+               const PutOptions &options)
+        : OpAwaiter(kvs), _key(std::move(key)), _value(std::move(value)),
+          _options(options) {}
+
+    void await_suspend(std::coroutine_handle<> h) {
+        _suspend(h);
+        _kvs.PutAsync(std::move(_key), std::move(_value),
+                      [this](KVStoreBase *, Status status, const char *,
+                             const size_t, const char *,
+                             const size_t) { _complete(status); },
+                      _options);
+    }
+    Status await_resume() { return _status; }
+
+  private:
+    Key _key;
+    Value _value;
+    PutOptions _options;
+};
+
+class GetAwaiter : public OpAwaiter {
+  public:
+    GetAwaiter(KVStoreBase &kvs, const Key &key, const GetOptions &options)
+        : OpAwaiter(kvs), _key(key), _options(options) {}
+
+    void await_suspend(std::coroutine_handle<> h) {
+        _suspend(h);
+        _kvs.GetAsync(_key,
+                      [this](KVStoreBase *, Status status, const char *,
+                             const size_t, const char *value,
+                             const size_t valueSize) {
+                          if (status.ok() && value && valueSize)
+                              _copy(value, valueSize);
+                          _complete(status);
+                      },
+                      _options);
+    }
+    GetResult await_resume() { return {_status, _value}; }
+
+  private:
+    void _copy(const char *value, size_t valueSize) {
+        _value = _kvs.Alloc(_key, valueSize,
+                            AllocOptions(KeyValAttribute::NOT_BUFFERED));
+        std::memcpy(_value.data(), value, valueSize);
+    }
+
+    const Key &_key;
+    GetOptions _options;
+    Value _value;
+};
+
+class UpdateAwaiter : public OpAwaiter {
+  public:
+    UpdateAwaiter(KVStoreBase &kvs, const Key &key, Value &&value,
+                  const UpdateOptions &options)
+        : OpAwaiter(kvs), _key(key), _value(std::move(value)),
+          _options(options), _withValue(true) {}
+    UpdateAwaiter(KVStoreBase &kvs, const Key &key,
+                  const UpdateOptions &options)
+        : OpAwaiter(kvs), _key(key), _options(options), _withValue(false) {}
+
+    void await_suspend(std::coroutine_handle<> h) {
+        _suspend(h);
+        auto cb = [this](KVStoreBase *, Status status, const char *,
+                         const size_t, const char *,
+                         const size_t) { _complete(status); };
+        if (_withValue)
+            _kvs.UpdateAsync(_key, std::move(_value), cb, _options);
+        else
+            _kvs.UpdateAsync(_key, _options, cb);
+    }
+    Status await_resume() { return _status; }
+
+  private:
+    const Key &_key;
+    Value _value;
+    UpdateOptions _options;
+    bool _withValue;
+};
+
+} // namespace detail
+
+/**
+ * Awaitable view of a KVStoreBase. Keys passed by reference must stay valid
+ * until the operation is resumed, which holds for keys living in the
+ * awaiting coroutine. Operations have to be awaited from a task running on
+ * an Executor.
+ */
+class Store {
+  public:
+    explicit Store(KVStoreBase &kvs) : _kvs(kvs) {}
+
+    /**
+     * @return Status of PutAsync
+     */
+    detail::PutAwaiter Put(Key &&key, Value &&value,
+                           const PutOptions &options = PutOptions()) {
+        return {_kvs, std::move(key), std::move(value), options};
+    }
+
+    /**
+     * @return Status and a copy of the value, release it with
+     * KVStoreBase::Free()
+     */
+    detail::GetAwaiter Get(const Key &key,
+                           const GetOptions &options = GetOptions()) {
+        return {_kvs, key, options};
+    }
+
+    /**
+     * @return Status of UpdateAsync
+     */
+    detail::UpdateAwaiter
+    Update(const Key &key, Value &&value,
+           const UpdateOptions &options = UpdateOptions()) {
+        return {_kvs, key, std::move(value), options};
+    }
+
+    /**
+     * @return Status of UpdateAsync
+     */
+    detail::UpdateAwaiter Update(const Key &key,
+                                 const UpdateOptions &options) {
+        return {_kvs, key, options};
+    }
+
+    KVStoreBase &kvs() { return _kvs; }
+
+  private:
+    KVStoreBase &_kvs;
+};
+
+} // namespace coro
+} // namespace DaqDB
+
+#endif
@@ -138,7 +138,8 @@ class KVStoreBase {
      * Synchronously get a value for a given key.
      *
      * @return On success returns allocated buffer with value. The caller is
-     * responsible of releasing the buffer.
+     * responsible of releasing the buffer with Free. Offloaded values are
+     * returned in the DMA buffer they were read to, without a copy.
      *
      * @param[in] key Reference to a key structure.
      * @param[in] options Get operation options.
@@ -405,6 +406,18 @@ class KVStoreBase {
      */
     virtual bool IsOffloaded(Key &key) = 0;
 
+    /**
+     * Hints that offloaded values of given keys are read soon. Values are
+     * read in the background, when offload is otherwise idle, into a DRAM
+     * cache serving subsequent Get and GetAsync calls.
+     *
+     * @note Keys not offloaded or not local are ignored, hints are dropped
+     * if too many are pending or offload read cache is disabled.
+     *
+     * @param[in] keys Keys to be read, buffers can be freed on return.
+     */
+    virtual void Prefetch(const std::vector<Key> &keys) = 0;
+
     /**
      * If offload is enabled, quiesce it. Abort if default timeout exceeded.
      *
@@ -415,6 +428,78 @@ class KVStoreBase {
      */
     virtual bool QuiesceOffload(bool ForceAbort = false) = 0;
 
+    /**
+     * Reserve submission queue slots (credits) for asynchronous operations.
+     * Operations spend a credit when submitted with useCredit option set,
+     * also when the submission fails.
+     * Requests using credits are sent to the poller given in options,
+     * round robin is ignored. An offload credit reserves a slot on every
+     * offload queue, since the queue is chosen by key.
+     *
+     * @return true if all n slots were reserved, false if there is not enough
+     * free room in the queue. No slots are reserved in the latter case.
+     *
+     * @param[in] n Number of slots.
+     * @param[in] queue Queue to take slots from.
+     */
+    virtual bool ReserveCredits(size_t n,
+                                const QueueOptions &queue = QueueOptions()) = 0;
+
+    /**
+     * Return unused credits.
+     *
+     * @param[in] n Number of slots.
+     * @param[in] queue Queue the slots were taken from.
+     */
+    virtual void ReleaseCredits(size_t n,
+                                const QueueOptions &queue = QueueOptions()) = 0;
+
+    /**
+     * Return number of free, unreserved slots in a submission queue.
+     *
+     * @param[in] queue Queue to check.
+     */
+    virtual size_t
+    GetFreeQueueDepth(const QueueOptions &queue = QueueOptions()) = 0;
+
+    /**
+     * Register a one-shot callback called once at least n slots can be
+     * queued. The callback is called from the poller thread, or immediately
+     * if there is enough room already, and must not block.
+     *
+     * @param[in] n Number of slots.
+     * @param[in] cb Callback function.
+     * @param[in] queue Queue to watch.
+     */
+    virtual void NotifyOnSpace(size_t n, std::function<void()> cb,
+                               const QueueOptions &queue = QueueOptions()) = 0;
+
+    /**
+     * Deliver completions of PutAsync, GetAsync and UpdateAsync operations
+     * submitted by the calling thread through its completion queue. Callbacks
+     * are then called from PollCompletions() on this thread instead of
+     * internal poller threads.
+     *
+     * @param[in] depth Number of completions held without falling back to
+     * slower overflow list.
+     */
+    virtual void EnableCompletionQueue(size_t depth = 4096) = 0;
+
+    /**
+     * Switch the calling thread back to callbacks called from internal
+     * threads. Completions still queued are dropped.
+     */
+    virtual void DisableCompletionQueue() = 0;
+
+    /**
+     * Call callbacks of completed operations submitted by the calling thread.
+     *
+     * @return Number of completions delivered.
+     *
+     * @param[in] max Maximum number of completions to deliver.
+     */
+    virtual size_t PollCompletions(size_t max) = 0;
+
     virtual uint64_t GetTreeSize() = 0;
     virtual uint64_t GetLeafCount() = 0;
     virtual uint8_t GetTreeDepth() = 0;
@@ -26,9 +26,9 @@ class Key {
   public:
     Key() : attr(KeyValAttribute::NOT_BUFFERED), _data(nullptr), _size(0) {}
     Key(char *data, size_t size)
-        : _data(data), _size(size), attr(KeyValAttribute::NOT_BUFFERED) {}
+        : attr(KeyValAttribute::NOT_BUFFERED), _data(data), _size(size) {}
     Key(char *data, size_t size, KeyValAttribute attr)
-        : _data(data), _size(size), attr(attr) {}
+        : attr(attr), _data(data), _size(size) {}
     char *data() { return _data; }
 
     /**
@@ -38,6 +38,13 @@ class Key {
         return (attr & KeyValAttribute::KVS_BUFFERED);
     };
 
+    /**
+     * @return true if allocated from hugepage arena
+     */
+    inline bool isHugePageBacked() const {
+        return (attr & KeyValAttribute::HUGE_PAGE);
+    };
+
     inline const char *data() const { return _data; }
     inline size_t size() const { return _size; }
 
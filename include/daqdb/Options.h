@@ -26,6 +26,8 @@ namespace DaqDB {
 enum KeyValAttribute : std::int8_t {
     NOT_BUFFERED = 0,
     KVS_BUFFERED = (1 << 0),
+    HUGE_PAGE = (1 << 1), // NOT_BUFFERED buffer taken from hugepage arena
+    DMA_BUFFER = (1 << 2), // NOT_BUFFERED buffer offloaded value was read to
 };
 
 enum PrimaryKeyAttribute : std::int8_t {
@@ -59,7 +61,12 @@ struct UpdateOptions {
     UpdateOptions() : attr(PrimaryKeyAttribute::EMPTY) {}
     UpdateOptions(PrimaryKeyAttribute attr) : attr(attr) {}
 
+    void useCredit(bool credit) { _useCredit = credit; }
+
+    bool useCredit() const { return _useCredit; }
+
     PrimaryKeyAttribute attr;
+    bool _useCredit = false;
 };
 
 struct PutOptions {
@@ -74,9 +81,14 @@ struct PutOptions {
 
     bool roundRobin() const { return _roundRobin; }
 
+    void useCredit(bool credit) { _useCredit = credit; }
+
+    bool useCredit() const { return _useCredit; }
+
     PrimaryKeyAttribute attr = PrimaryKeyAttribute::EMPTY;
     unsigned short _pollerId = 0;
     bool _roundRobin = true;
+    bool _useCredit = false;
 };
 
 struct GetOptions {
@@ -94,11 +106,42 @@ struct GetOptions {
 
     bool roundRobin() const { return _roundRobin; }
 
+    void useCredit(bool credit) { _useCredit = credit; }
+
+    bool useCredit() const { return _useCredit; }
+
+    /*
+     * Offloaded value is returned in the DMA buffer it was read to, without
+     * a copy. Such value is marked KeyValAttribute::DMA_BUFFER and has to be
+     * released with Free().
+     */
+    void handOver(bool handOver) { _handOver = handOver; }
+
+    bool handOver() const { return _handOver; }
+
     PrimaryKeyAttribute attr = PrimaryKeyAttribute::EMPTY;
     PrimaryKeyAttribute newAttr = PrimaryKeyAttribute::EMPTY;
 
     unsigned short _pollerId = 0;
     bool _roundRobin = true;
+    bool _useCredit = false;
+    bool _handOver = false;
+};
+
+enum class QueueType : std::int8_t { PMEM = 0, OFFLOAD };
+
+/*
+ * Submission queue addressed by flow control calls. PMEM queues serve
+ * PutAsync/GetAsync (one per poller), OFFLOAD queue serves LONG_TERM
+ * operations.
+ */
+struct QueueOptions {
+    QueueOptions() {}
+    explicit QueueOptions(QueueType type, unsigned short pollerId = 0)
+        : type(type), pollerId(pollerId) {}
+
+    QueueType type = QueueType::PMEM;
+    unsigned short pollerId = 0;
 };
 
 struct KeyFieldDescriptor {
@@ -137,7 +180,26 @@ struct KeyDescriptor {
     std::vector<KeyFieldDescriptor> _fields;
 };
 
-enum OffloadDevType : std::int8_t { BDEV = 0, JBOD = 1, RAID0 = 2 };
+enum OffloadDevType : std::int8_t {
+    BDEV = 0,
+    JBOD = 1,
+    RAID0 = 2,
+    URING = 3,
+    NULLDEV = 4,
+    RAMDISK = 5
+};
+
+/*
+ * Selects JBOD member written next: in turn, with the fewest queued and
+ * outstanding IOs or with the most free blocks.
+ */
+enum OffloadPlacement : std::int8_t {
+    ROUND_ROBIN = 0,
+    QUEUE_DEPTH = 1,
+    FREE_SPACE = 2
+};
+
+enum class LogLevel : std::int8_t { LEVEL_DEBUG = 0, LEVEL_INFO, LEVEL_CRITICAL };
 
 struct OffloadDevDescriptor {
     OffloadDevDescriptor() = default;
@@ -152,7 +214,20 @@ struct OffloadOptions {
     std::string name; // Unique name
     size_t allocUnitSize =
         16 * 1024; // Allocation unit size shared across the drives in a set
-    size_t raid0StripeSize = 128; // Stripe size, applicable to RAIDx only
+    size_t raid0StripeSize = 128; // Stripe size in KB, applicable to RAID0
+    size_t segmentSize = 256 * 1024; // Log segment size, 0 disables packing
+    unsigned int gcLivePercent = 50; // Segments below are compacted
+    size_t gcRate = 64; // Compaction read rate in MB/s, 0 disables compaction
+    OffloadPlacement placement = QUEUE_DEPTH; // JBOD write placement
+    unsigned int queues = 1; // Offload pollers, each with own device queue
+    size_t readAhead = 0; // Sequential read readahead in KB, 0 disables it
+    size_t readCacheSize = 64; // DRAM cache of offloaded values in MB
+    unsigned int pmemHighWatermark = 0; // PMEM usage % starting offload, 0 off
+    unsigned int pmemLowWatermark = 0;  // PMEM usage % stopping offload
+    size_t uringFileSize = 0; // Uring device file size in MB, 0 keeps it
+    bool uringSqPoll = true;  // Uring submissions polled by kernel thread
+    size_t nullSize = 1024;   // Null or RAM device size in MB
+    size_t nullLatency = 0;   // Null or RAM device IO latency in us
     std::vector<OffloadDevDescriptor>
         _devs; // List of individual drives comprising the set
 };
@@ -163,6 +238,13 @@ struct RuntimeOptions {
     unsigned short baseCoreId = 0;
     unsigned short numOfPollers = 1;
     size_t maxReadyKeys = 0;
+    size_t hugePageSize = 2 * 1024 * 1024; // 2MB or 1GB
+#ifdef DEBUG
+    LogLevel logLevel = LogLevel::LEVEL_DEBUG;
+#else
+    LogLevel logLevel = LogLevel::LEVEL_INFO;
+#endif
+    bool latencyTracing = false; // per-stage request latency histograms
 };
 
 struct DhtKeyRange {
@@ -184,6 +266,7 @@ struct DhtOptions {
     unsigned int maskLength = 0;
     unsigned int maskOffset = 0;
     std::vector<DhtNeighbor *> neighbors;
+    bool hugePageStaging = false; // stage responses in hugepage arena
 };
 
 struct PMEMOptions {
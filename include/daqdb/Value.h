@@ -26,13 +26,20 @@ class Value {
     Value(char *data, size_t size)
         : attr(KeyValAttribute::NOT_BUFFERED), _data(data), _size(size) {}
     Value(char *data, size_t size, KeyValAttribute attr)
-        : _data(data), _size(size), attr(attr) {}
+        : attr(attr), _data(data), _size(size) {}
+    Value(const Value &r) = default;
     char *data() { return _data; }
     inline const char *data() const { return _data; }
     inline size_t size() const { return _size; }
     inline bool isKvsBuffered() const {
         return (attr & KeyValAttribute::KVS_BUFFERED);
     };
+    inline bool isHugePageBacked() const {
+        return (attr & KeyValAttribute::HUGE_PAGE);
+    };
+    inline bool isDmaBuffer() const {
+        return (attr & KeyValAttribute::DMA_BUFFER);
+    };
     inline Value &operator=(const Value &r) {
         if (&r == this)
             return *this;
@@ -16,70 +16,76 @@
 
 #pragma once
 
-#include <boost/circular_buffer.hpp>
+#include <assert.h>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
 
+#include "LockFreeRing.h"
+
 namespace DaqDB {
 
 const uint32_t dequeueBufferLimit = 1024;
 const uint32_t dequeueBufferQuant = 1024;
-
+const unsigned int boundedBufferSpinCount = 64;
+
+/*
+ * Bounded MPMC queue on top of LockFreeRing. Fast path never takes a lock.
+ * Threads that find the queue full (empty) spin briefly and then park on a
+ * condition variable; the opposite side only takes the mutex and notifies
+ * when it sees parked waiters, so an uncontended push/pop is a couple of
+ * atomic operations.
+ */
 template <class T> class BoundedBuffer {
   public:
-    typedef boost::circular_buffer<T> ContainerType;
-
     explicit BoundedBuffer(size_t capacity, unsigned int timeout = 10)
-        : _unread(0), _qContainer(capacity), _timeout(timeout) {}
+        : _ring(capacity, RingType::MP_MC), _timeout(timeout),
+          _parkedProducers(0), _parkedConsumers(0) {}
 
     bool pushFront(T item) {
-        std::unique_lock<std::mutex> lock(_cvMutex);
-        const std::chrono::milliseconds timeout(_timeout);
-        if (_cvNotFull.wait_for(lock, timeout, [this] {
-                return BoundedBuffer<T>::isNotFull();
-            }) == false) {
-            lock.unlock();
-            return false;
+        if (_ring.enqueue(item) == false) {
+            if (_park(_parkedProducers, _cvNotFull, [this] {
+                    return _ring.freeCount() > 0;
+                }) == false)
+                return false;
+            if (_ring.enqueue(item) == false)
+                return false;
         }
-        _qContainer.push_front(item);
-        _unread++;
-        lock.unlock();
-        _cvNotEmpty.notify_all();
+        _unpark(_parkedConsumers, _cvNotEmpty);
         return true;
     }
 
-    bool popBack(T pItem) {
-        std::unique_lock<std::mutex> lock(_cvMutex);
-        const std::chrono::milliseconds timeout(_timeout);
-        if (_cvNotEmpty.wait_for(lock, timeout, [this] {
-                return BoundedBuffer<T>::isNotEmpty();
-            }) == false) {
-            lock.unlock();
-            return false;
+    bool popBack(T *pItem) {
+        if (_ring.dequeue(*pItem) == false) {
+            if (_park(_parkedConsumers, _cvNotEmpty,
+                      [this] { return _ring.empty() == false; }) == false)
+                return false;
+            if (_ring.dequeue(*pItem) == false)
+                return false;
         }
-        *pItem = _qContainer[--_unread];
-        lock.unlock();
-        _cvNotFull.notify_all();
+        _unpark(_parkedProducers, _cvNotFull);
         return true;
     }
 
+    /*
+     * Bulk dequeue of up to dequeueBufferQuant elements in a single ring
+     * operation.
+     */
     bool popBackVector(T pItem[], unsigned short *size) {
-        std::unique_lock<std::mutex> lock(_cvMutex);
-        const std::chrono::milliseconds timeout(_timeout);
-        if (_cvNotEmpty.wait_for(lock, timeout, [this] {
-                return BoundedBuffer<T>::isNotEmpty();
-            }) == false) {
-            lock.unlock();
-            return false;
-        }
-        unsigned short i = 0;
-        for (; _unread > 0 && i < dequeueBufferQuant;) {
-            pItem[i++] = _qContainer[--_unread];
+        size_t count = _ring.dequeueBurst(pItem, dequeueBufferQuant);
+        if (count == 0) {
+            if (_park(_parkedConsumers, _cvNotEmpty,
+                      [this] { return _ring.empty() == false; }) == false) {
+                *size = 0;
+                return false;
+            }
+            count = _ring.dequeueBurst(pItem, dequeueBufferQuant);
         }
-        *size = i;
-        lock.unlock();
-        _cvNotFull.notify_all();
+        *size = static_cast<unsigned short>(count);
+        if (count == 0)
+            return false;
+        _unpark(_parkedProducers, _cvNotFull, count > 1);
         return true;
     }
 
@@ -87,15 +93,53 @@ template <class T> class BoundedBuffer {
     BoundedBuffer(const BoundedBuffer &) = delete;
     BoundedBuffer &operator=(const BoundedBuffer &) = delete;
 
-    bool isNotEmpty() const { return _unread > 0; }
-    bool isNotFull() const { return _unread < _qContainer.capacity(); }
+    /*
+     * Spin for a while and then sleep until ready() or timeout. Waiter is
+     * registered before ready() is re-checked under the mutex, so a notifier
+     * that missed the registration must have made ready() true already.
+     */
+    template <class Pred>
+    bool _park(std::atomic<unsigned int> &parked,
+               std::condition_variable &cv, Pred ready) {
+        for (unsigned int i = 0; i < boundedBufferSpinCount; i++) {
+            if (ready())
+                return true;
+            cpuRelax();
+        }
+
+        std::unique_lock<std::mutex> lock(_parkMutex);
+        parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::chrono::milliseconds timeout(_timeout);
+        bool ret = cv.wait_for(lock, timeout, ready);
+        parked.fetch_sub(1);
+        return ret;
+    }
 
-    size_t _unread;
-    ContainerType _qContainer;
-    std::mutex _cvMutex;
+    void _unpark(std::atomic<unsigned int> &parked,
+                 std::condition_variable &cv, bool all = false) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(_parkMutex);
+        }
+        if (all)
+            cv.notify_all();
+        else
+            cv.notify_one();
+    }
+
+    LockFreeRing<T> _ring;
+    unsigned int _timeout;
+
+    /* padded apart, see LockFreeRing::HeadTail */
+    std::atomic<unsigned int> _parkedProducers;
+    char _padParked[DAQDB_CACHE_LINE_SIZE];
+    std::atomic<unsigned int> _parkedConsumers;
+    std::mutex _parkMutex;
     std::condition_variable _cvNotEmpty;
     std::condition_variable _cvNotFull;
-    unsigned int _timeout;
 };
 
 template <class T> class BlockingPoller {
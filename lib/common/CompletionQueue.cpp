@@ -0,0 +1,132 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "CompletionQueue.h"
+#include "MemMgr.h"
+
+namespace DaqDB {
+
+DaqDB::GeneralPool<Completion, DaqDB::ClassAlloc<Completion>>
+    Completion::pool(100, "completionPool");
+
+CompletionQueue::CompletionQueue(size_t depth)
+    : _ring(depth, RingType::MP_SC), _overflowCnt(0) {}
+
+CompletionQueue::~CompletionQueue() {
+    /* undelivered completions are dropped */
+    Completion *completion;
+    while (_ring.dequeue(completion))
+        _overflow.push_back(completion);
+    for (auto completion : _overflow)
+        _release(completion);
+}
+
+void CompletionQueue::push(const KVStoreBase::KVStoreBaseCallback &clb,
+                           Status status, const char *key, size_t keySize,
+                           const char *value, size_t valueSize,
+                           bool copyValue) {
+    Completion *completion = Completion::pool.get();
+    completion->clb = clb;
+    completion->status = status;
+    completion->keySize = key ? keySize : 0;
+    if (completion->keySize > COMPLETION_KEY_SIZE)
+        completion->longKey = new char[completion->keySize];
+    if (completion->keySize)
+        std::memcpy(const_cast<char *>(completion->keyData()), key,
+                    completion->keySize);
+    completion->valueSize = valueSize;
+    completion->valueOwned = copyValue && value && valueSize;
+    if (completion->valueOwned) {
+        char *copy = MemMgr::allocValue(valueSize);
+        std::memcpy(copy, value, valueSize);
+        completion->value = copy;
+    } else {
+        completion->value = value;
+    }
+
+    if (_ring.enqueue(completion))
+        return;
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    _overflow.push_back(completion);
+    _overflowCnt++;
+}
+
+void CompletionQueue::_deliver(KVStoreBase *kvs, Completion *completion) {
+    if (completion->clb)
+        completion->clb(kvs, completion->status, completion->keyData(),
+                        completion->keySize, completion->value,
+                        completion->valueSize);
+    _release(completion);
+}
+
+void CompletionQueue::_release(Completion *completion) {
+    if (completion->valueOwned)
+        MemMgr::freeValue(const_cast<char *>(completion->value),
+                          completion->valueSize);
+    delete[] completion->longKey;
+    completion->longKey = nullptr;
+    /* release objects captured by user callback */
+    completion->clb = nullptr;
+    Completion::pool.put(completion);
+}
+
+size_t CompletionQueue::poll(KVStoreBase *kvs, size_t max) {
+    const size_t burst = 32;
+    Completion *completions[burst];
+    size_t delivered = 0;
+
+    while (delivered < max) {
+        size_t cnt =
+            _ring.dequeueBurst(completions, std::min(burst, max - delivered));
+        if (!cnt)
+            break;
+        for (size_t i = 0; i < cnt; i++)
+            _deliver(kvs, completions[i]);
+        delivered += cnt;
+    }
+
+    while (delivered < max && _overflowCnt.load(std::memory_order_relaxed)) {
+        Completion *completion;
+        {
+            std::lock_guard<std::mutex> lock(_overflowMutex);
+            if (_overflow.empty())
+                break;
+            completion = _overflow.front();
+            _overflow.pop_front();
+            _overflowCnt--;
+        }
+        _deliver(kvs, completion);
+        delivered++;
+    }
+
+    return delivered;
+}
+
+KVStoreBase::KVStoreBaseCallback
+CompletionQueue::wrap(const std::shared_ptr<CompletionQueue> &cq,
+                      const KVStoreBase::KVStoreBaseCallback &clb,
+                      bool copyValue) {
+    return [cq, clb, copyValue](KVStoreBase *kvs, Status status,
+                                const char *key, size_t keySize,
+                                const char *value, size_t valueSize) {
+        cq->push(clb, status, key, keySize, value, valueSize, copyValue);
+    };
+}
+
+} // namespace DaqDB
@@ -0,0 +1,98 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "ClassAlloc.h"
+#include "GeneralPool.h"
+#include "LockFreeRing.h"
+#include <daqdb/KVStoreBase.h>
+
+namespace DaqDB {
+
+const size_t COMPLETION_KEY_SIZE = 64;
+const size_t DEFAULT_COMPLETION_QUEUE_DEPTH = 4096;
+
+/*
+ * Result of an asynchronous operation waiting to be delivered. Key is
+ * always copied, keys longer than COMPLETION_KEY_SIZE go to a heap buffer.
+ * Value is copied only when it points to a buffer owned by the pipeline
+ * (GET).
+ */
+struct Completion {
+    KVStoreBase::KVStoreBaseCallback clb;
+    Status status;
+    char key[COMPLETION_KEY_SIZE];
+    char *longKey = nullptr;
+    size_t keySize = 0;
+    const char *value = nullptr;
+    size_t valueSize = 0;
+    bool valueOwned = false;
+
+    inline const char *keyData() const { return longKey ? longKey : key; }
+
+    static DaqDB::GeneralPool<Completion, DaqDB::ClassAlloc<Completion>> pool;
+};
+
+/*
+ * Per-client completion queue. Pollers push completions from their own
+ * threads, the client thread drains them and runs the callbacks.
+ * Completions that do not fit into the ring go to an overflow list, so
+ * pollers never wait for the client.
+ */
+class CompletionQueue {
+  public:
+    explicit CompletionQueue(size_t depth = DEFAULT_COMPLETION_QUEUE_DEPTH);
+    ~CompletionQueue();
+
+    void push(const KVStoreBase::KVStoreBaseCallback &clb, Status status,
+              const char *key, size_t keySize, const char *value,
+              size_t valueSize, bool copyValue);
+
+    /**
+     * Runs callbacks of up to max completions on the calling thread.
+     *
+     * @return number of completions delivered
+     */
+    size_t poll(KVStoreBase *kvs, size_t max);
+
+    /**
+     * Wraps callback so that its invocation is queued here.
+     *
+     * @param copyValue value passed to callback has to be copied, it is not
+     * valid after the callback returns
+     */
+    static KVStoreBase::KVStoreBaseCallback
+    wrap(const std::shared_ptr<CompletionQueue> &cq,
+         const KVStoreBase::KVStoreBaseCallback &clb, bool copyValue);
+
+  private:
+    void _deliver(KVStoreBase *kvs, Completion *completion);
+    void _release(Completion *completion);
+
+    LockFreeRing<Completion *> _ring;
+    std::mutex _overflowMutex;
+    std::deque<Completion *> _overflow;
+    std::atomic<size_t> _overflowCnt;
+};
+
+} // namespace DaqDB
@@ -77,11 +77,86 @@ bool readConfiguration(const std::string &configFile, DaqDB::Options &options,
     unsigned int baseCoreId;
     if (cfg.lookupValue("runtime_base_core_id", baseCoreId))
         options.runtime.baseCoreId = baseCoreId;
+    long long hugePageSize;
+    if (cfg.lookupValue("runtime_huge_page_size", hugePageSize))
+        options.runtime.hugePageSize = hugePageSize;
+    bool latencyTracing;
+    if (cfg.lookupValue("runtime_latency_tracing", latencyTracing))
+        options.runtime.latencyTracing = latencyTracing;
+    std::string logLevel;
+    if (cfg.lookupValue("runtime_log_level", logLevel)) {
+        if (logLevel == "debug")
+            options.runtime.logLevel = LogLevel::LEVEL_DEBUG;
+        else if (logLevel == "info")
+            options.runtime.logLevel = LogLevel::LEVEL_INFO;
+        else if (logLevel == "critical")
+            options.runtime.logLevel = LogLevel::LEVEL_CRITICAL;
+        else {
+            ss << "Unknown runtime_log_level [" << logLevel << "]";
+            return false;
+        }
+    }
 
     int offloadAllocUnitSize;
     bool noOffload = false;
     if (cfg.lookupValue("offload_unit_alloc_size", offloadAllocUnitSize))
         options.offload.allocUnitSize = offloadAllocUnitSize;
+    int offloadSegmentSize;
+    if (cfg.lookupValue("offload_segment_size", offloadSegmentSize)) {
+        if (offloadSegmentSize < 0) {
+            ss << "Invalid offload_segment_size [" << offloadSegmentSize
+               << "]";
+            return false;
+        }
+        options.offload.segmentSize = offloadSegmentSize;
+    }
+    int offloadGcLivePercent;
+    if (cfg.lookupValue("offload_gc_live_percent", offloadGcLivePercent))
+        options.offload.gcLivePercent = offloadGcLivePercent;
+    int offloadGcRate;
+    if (cfg.lookupValue("offload_gc_rate", offloadGcRate))
+        options.offload.gcRate = offloadGcRate;
+    int offloadQueues;
+    if (cfg.lookupValue("offload_queues", offloadQueues)) {
+        if (offloadQueues < 1) {
+            ss << "Invalid offload_queues [" << offloadQueues << "]";
+            return false;
+        }
+        options.offload.queues = offloadQueues;
+    }
+    int offloadReadAhead;
+    if (cfg.lookupValue("offload_readahead", offloadReadAhead))
+        options.offload.readAhead = offloadReadAhead;
+    int offloadReadCacheSize;
+    if (cfg.lookupValue("offload_read_cache_size", offloadReadCacheSize))
+        options.offload.readCacheSize = offloadReadCacheSize;
+    int pmemHighWatermark;
+    if (cfg.lookupValue("offload_pmem_high_watermark", pmemHighWatermark))
+        options.offload.pmemHighWatermark = pmemHighWatermark;
+    int pmemLowWatermark;
+    if (cfg.lookupValue("offload_pmem_low_watermark", pmemLowWatermark))
+        options.offload.pmemLowWatermark = pmemLowWatermark;
+    if (options.offload.pmemHighWatermark > 100 ||
+        options.offload.pmemLowWatermark >
+            options.offload.pmemHighWatermark) {
+        ss << "Invalid offload PMEM watermarks ["
+           << options.offload.pmemLowWatermark << ", "
+           << options.offload.pmemHighWatermark << "]";
+        return false;
+    }
+    std::string placement;
+    if (cfg.lookupValue("offload_jbod_placement", placement)) {
+        if (placement == "rr")
+            options.offload.placement = OffloadPlacement::ROUND_ROBIN;
+        else if (placement == "queue")
+            options.offload.placement = OffloadPlacement::QUEUE_DEPTH;
+        else if (placement == "space")
+            options.offload.placement = OffloadPlacement::FREE_SPACE;
+        else {
+            ss << "Unknown offload_jbod_placement [" << placement << "]";
+            return false;
+        }
+    }
     std::string dev_type;
     cfg.lookupValue("offload_dev_type", dev_type);
     if (options.mode == OperationalMode::STORAGE) {
@@ -91,6 +166,12 @@ bool readConfiguration(const std::string &configFile, DaqDB::Options &options,
             options.offload.devType = OffloadDevType::JBOD;
         else if (dev_type == "raid0")
             options.offload.devType = OffloadDevType::RAID0;
+        else if (dev_type == "uring")
+            options.offload.devType = OffloadDevType::URING;
+        else if (dev_type == "null")
+            options.offload.devType = OffloadDevType::NULLDEV;
+        else if (dev_type == "ram")
+            options.offload.devType = OffloadDevType::RAMDISK;
         else {
             ss << "No offload dev found ... continuing " << std::endl;
             noOffload = true;
@@ -144,6 +225,30 @@ bool readConfiguration(const std::string &configFile, DaqDB::Options &options,
                             static_cast<size_t>(stripeSize);
                 }
             } break;
+            case OffloadDevType::URING: {
+                if (!cfg.lookupValue("offload_uring_path",
+                                     offload_desc.devName)) {
+                    ss << "No offload_uring_path found for uring in offload";
+                    return false;
+                }
+                options.offload._devs.push_back(offload_desc);
+                int uringFileSize;
+                if (cfg.lookupValue("offload_uring_file_size", uringFileSize))
+                    options.offload.uringFileSize = uringFileSize;
+                bool uringSqPoll;
+                if (cfg.lookupValue("offload_uring_sqpoll", uringSqPoll))
+                    options.offload.uringSqPoll = uringSqPoll;
+            } break;
+            case OffloadDevType::NULLDEV:
+            case OffloadDevType::RAMDISK: {
+                options.offload._devs.push_back(offload_desc);
+                int nullSize;
+                if (cfg.lookupValue("offload_null_size", nullSize))
+                    options.offload.nullSize = nullSize;
+                int nullLatency;
+                if (cfg.lookupValue("offload_null_latency", nullLatency))
+                    options.offload.nullLatency = nullLatency;
+            } break;
             default:
                 break;
             }
@@ -162,6 +267,9 @@ bool readConfiguration(const std::string &configFile, DaqDB::Options &options,
         options.dht.numOfDhtThreads = numOfDhtThreads;
     if (cfg.lookupValue("runtime_base_dht_id", baseDhtId))
         options.dht.baseDhtId = baseDhtId;
+    bool hugePageStaging;
+    if (cfg.lookupValue("dht_huge_page_staging", hugePageStaging))
+        options.dht.hugePageStaging = hugePageStaging;
 
     try {
         const libconfig::Setting &neighbors = cfg.lookup("neighbors");
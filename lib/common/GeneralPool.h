@@ -17,6 +17,7 @@
 #pragma once
 
 #include <assert.h>
+#include <atomic>
 #include <mutex>
 
 #include "ClassAlloc.h"
@@ -24,6 +25,7 @@
 #include "DefaultAllocStrategy.h"
 #include "GeneralPoolBase.h"
 #include "GeneralPoolBucket.h"
+#include "GeneralPoolMagazine.h"
 #include "GlobalMemoryAlloc.h"
 
 #include "PoolManager.h"
@@ -34,7 +36,7 @@ namespace DaqDB {
 const unsigned int MAX_POOL_BUCKETS = 64;
 
 template <class T, class Alloc = DaqDB::ClassAlloc<T>>
-class GeneralPool : public GeneralPoolBase {
+class GeneralPool : public GeneralPoolBase, private MagazineDepot {
   public:
     friend class MemMgr;
 
@@ -59,10 +61,12 @@ class GeneralPool : public GeneralPoolBase {
     GeneralPool(const GeneralPool<T, Alloc> &right);
     GeneralPool<T, Alloc> &operator=(const GeneralPool<T, Alloc> &right);
 
+    void releaseObject(void *obj_) final;
+
   private:
     Lock mutex;
     AllocStrategy *strategy;
-    unsigned int counter;
+    std::atomic<unsigned int> counter;
     unsigned int objSize;
     GeneralPoolBucket<T, Alloc> buckets[MAX_POOL_BUCKETS];
 };
@@ -194,6 +198,7 @@ inline GeneralPool<T, Alloc>::GeneralPool(const char *name_,
 }
 
 template <class T, class Alloc> inline GeneralPool<T, Alloc>::~GeneralPool() {
+    detachMagazines();
     delete strategy;
 
     // unregister w/PoolManager
@@ -220,12 +225,16 @@ template <class T, class Alloc> inline void GeneralPool<T, Alloc>::manage() {
 }
 
 template <class T, class Alloc> inline T *GeneralPool<T, Alloc>::get() {
-    // this has to be done in two steps to guarantee the right result in
-    // multi-threaded environment
-    unsigned int local_counter = counter++;
+    // try the per-thread magazines first
+    T *tmp_obj = static_cast<T *>(magazineGet());
 
-    // get the object from one of the buckets
-    T *tmp_obj = buckets[local_counter % MAX_POOL_BUCKETS].get();
+    if (!tmp_obj) {
+        unsigned int local_counter =
+            counter.fetch_add(1, std::memory_order_relaxed);
+
+        // get the object from one of the buckets
+        tmp_obj = buckets[local_counter % MAX_POOL_BUCKETS].get();
+    }
 
 #ifdef _MM_DEBUG_
 
@@ -367,12 +376,29 @@ inline void GeneralPool<T, Alloc>::put(T *obj_) {
         abort();
     }
 
-    // return it to the pool
+    // cache it in the per-thread magazines or return it to the pool
+    if (magazinePut(obj_))
+        return;
     buckets[bucket_number].put(obj_);
 
     return;
 }
 
+/*
+ * Invoked by the magazine layer to return cached objects to their buckets.
+ */
+template <class T, class Alloc>
+inline void GeneralPool<T, Alloc>::releaseObject(void *obj_) {
+#ifndef _MM_GMP_ON_
+    unsigned int stamp = *(unsigned int *)((char *)obj_ + objSize);
+#else
+    unsigned int stamp = *(unsigned int *)((char *)obj_ - OBJ_PADDING);
+#endif
+    unsigned int bucket_number =
+        (stamp >> BUCKET_NUMBER_SHIFT) & BUCKET_NUMBER_MASK;
+    buckets[bucket_number].put(static_cast<T *>(obj_));
+}
+
 template <class T, class Alloc>
 inline void GeneralPool<T, Alloc>::put(T *obj_, unsigned int pool_) {
     assert(pool_ < MAX_POOL_BUCKETS);
@@ -0,0 +1,123 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "GeneralPoolMagazine.h"
+#include "Logger.h"
+
+namespace DaqDB {
+
+/*
+ * Slots of destroyed pools are reused. Each owner gets a new generation,
+ * so magazines a thread still holds for the previous owner are never
+ * flushed into the new pool. Pools created while all slots are taken work
+ * without magazines.
+ */
+static std::mutex depotRegistryMutex;
+static MagazineDepot *depotRegistry[MAX_MAGAZINE_POOLS];
+static unsigned int depotRegistryGen[MAX_MAGAZINE_POOLS];
+static std::vector<unsigned int> depotRegistryFree;
+static unsigned int depotRegistryNext = 0;
+
+MagazineDepot::MagazineDepot()
+    : _slot(MAX_MAGAZINE_POOLS), _gen(0),
+      _full(MAGAZINE_DEPOT_SIZE, RingType::MP_MC),
+      _empty(MAGAZINE_DEPOT_SIZE, RingType::MP_MC) {
+    std::lock_guard<std::mutex> lock(depotRegistryMutex);
+    if (!depotRegistryFree.empty()) {
+        _slot = depotRegistryFree.back();
+        depotRegistryFree.pop_back();
+    } else if (depotRegistryNext < MAX_MAGAZINE_POOLS) {
+        _slot = depotRegistryNext++;
+    } else {
+        DAQ_INFO("All " + std::to_string(MAX_MAGAZINE_POOLS) +
+                 " magazine slots taken, pool runs without magazines");
+        return;
+    }
+    /* generation 0 marks unused thread entries */
+    if (++depotRegistryGen[_slot] == 0)
+        ++depotRegistryGen[_slot];
+    _gen = depotRegistryGen[_slot];
+    depotRegistry[_slot] = this;
+}
+
+MagazineDepot::~MagazineDepot() {
+    detachMagazines();
+
+    Magazine *mag;
+    while (_full.dequeue(mag))
+        delete mag;
+    while (_empty.dequeue(mag))
+        delete mag;
+}
+
+void MagazineDepot::detachMagazines() {
+    std::lock_guard<std::mutex> lock(depotRegistryMutex);
+    if (_slot < MAX_MAGAZINE_POOLS) {
+        depotRegistry[_slot] = nullptr;
+        depotRegistryFree.push_back(_slot);
+        _slot = MAX_MAGAZINE_POOLS;
+    }
+}
+
+Magazine *MagazineDepot::_getEmpty() {
+    Magazine *mag;
+    if (_empty.dequeue(mag))
+        return mag;
+    return new (std::nothrow) Magazine();
+}
+
+void MagazineDepot::_putEmpty(Magazine *mag) {
+    if (_empty.enqueue(mag) == false)
+        delete mag;
+}
+
+void MagazineDepot::_release(Magazine *mag) {
+    while (!mag->isEmpty())
+        releaseObject(mag->objs[--mag->count]);
+}
+
+/*
+ * Objects cached for a destroyed pool are gone with its buckets, only the
+ * magazines are freed.
+ */
+void ThreadMagazines::_reset(Entry &e, unsigned int gen) {
+    delete e.loaded;
+    delete e.previous;
+    e.loaded = e.previous = nullptr;
+    e.gen = gen;
+}
+
+ThreadMagazines::~ThreadMagazines() {
+    std::lock_guard<std::mutex> lock(depotRegistryMutex);
+    for (unsigned int slot = 0; slot < MAX_MAGAZINE_POOLS; slot++) {
+        Entry &e = _entries[slot];
+        MagazineDepot *depot = depotRegistry[slot];
+        if (depot && depot->_gen == e.gen) {
+            for (Magazine *mag : {e.loaded, e.previous}) {
+                if (mag)
+                    depot->_release(mag);
+            }
+        }
+        _reset(e, 0);
+    }
+}
+
+} // namespace DaqDB
@@ -0,0 +1,175 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utility>
+
+#include "LockFreeRing.h"
+
+namespace DaqDB {
+
+const unsigned int MAGAZINE_SIZE = 32;
+const unsigned int MAGAZINE_DEPOT_SIZE = 64;
+const unsigned int MAX_MAGAZINE_POOLS = 512;
+
+struct Magazine {
+    unsigned int count = 0;
+    void *objs[MAGAZINE_SIZE];
+
+    bool isFull() const { return count == MAGAZINE_SIZE; }
+    bool isEmpty() const { return count == 0; }
+};
+
+/*
+ * Per-thread object cache placed in front of GeneralPool buckets.
+ *
+ * Every thread keeps two magazines (loaded and previous) per pool and
+ * serves get/put from them without any shared writes. Full and empty
+ * magazines are exchanged with the pool through lock-free depot rings, so
+ * buckets (and their mutex) are only touched when the whole depot is
+ * exhausted or overflowing. Objects cached by a thread are returned to the
+ * buckets when the thread exits.
+ */
+class MagazineDepot {
+  public:
+    MagazineDepot();
+    virtual ~MagazineDepot();
+
+    /*
+     * @return cached object or nullptr if caller has to use the buckets
+     */
+    inline void *magazineGet();
+    /*
+     * @return false if object was not cached and has to go to the buckets
+     */
+    inline bool magazinePut(void *obj);
+
+  protected:
+    /*
+     * Returns object to its home bucket.
+     */
+    virtual void releaseObject(void *obj) = 0;
+    /*
+     * Must be called by derived class destructor before buckets go away.
+     */
+    void detachMagazines();
+
+  private:
+    MagazineDepot(const MagazineDepot &) = delete;
+    MagazineDepot &operator=(const MagazineDepot &) = delete;
+
+    friend class ThreadMagazines;
+
+    Magazine *_getEmpty();
+    void _putEmpty(Magazine *mag);
+    void _release(Magazine *mag);
+
+    unsigned int _slot;
+    unsigned int _gen;
+    LockFreeRing<Magazine *> _full;
+    LockFreeRing<Magazine *> _empty;
+};
+
+class ThreadMagazines {
+  public:
+    struct Entry {
+        Magazine *loaded = nullptr;
+        Magazine *previous = nullptr;
+        /* generation of the slot owner the magazines were filled for */
+        unsigned int gen = 0;
+    };
+
+    ThreadMagazines() = default;
+    ~ThreadMagazines();
+
+    /*
+     * Magazines left behind by a destroyed pool that used the slot before
+     * are dropped on first access.
+     */
+    static inline Entry &entry(unsigned int slot, unsigned int gen) {
+        static thread_local ThreadMagazines magazines;
+        Entry &e = magazines._entries[slot];
+        if (e.gen != gen)
+            _reset(e, gen);
+        return e;
+    }
+
+  private:
+    static void _reset(Entry &e, unsigned int gen);
+
+    Entry _entries[MAX_MAGAZINE_POOLS];
+};
+
+inline void *MagazineDepot::magazineGet() {
+    if (_slot == MAX_MAGAZINE_POOLS)
+        return nullptr;
+    ThreadMagazines::Entry &e = ThreadMagazines::entry(_slot, _gen);
+
+    if (e.loaded && !e.loaded->isEmpty())
+        return e.loaded->objs[--e.loaded->count];
+
+    if (e.previous && !e.previous->isEmpty()) {
+        std::swap(e.loaded, e.previous);
+        return e.loaded->objs[--e.loaded->count];
+    }
+
+    Magazine *full;
+    if (_full.dequeue(full) == false)
+        return nullptr;
+    if (e.previous)
+        _putEmpty(e.previous);
+    e.previous = e.loaded;
+    e.loaded = full;
+    return e.loaded->objs[--e.loaded->count];
+}
+
+inline bool MagazineDepot::magazinePut(void *obj) {
+    if (_slot == MAX_MAGAZINE_POOLS)
+        return false;
+    ThreadMagazines::Entry &e = ThreadMagazines::entry(_slot, _gen);
+
+    if (e.loaded && !e.loaded->isFull()) {
+        e.loaded->objs[e.loaded->count++] = obj;
+        return true;
+    }
+
+    if (e.previous == nullptr) {
+        e.previous = _getEmpty();
+        if (e.previous == nullptr)
+            return false;
+    }
+
+    if (e.previous->isFull()) {
+        /*
+         * Both magazines are full, hand previous over to the depot. If the
+         * depot is full as well, its objects go back to the buckets.
+         */
+        if (_full.enqueue(e.previous)) {
+            e.previous = _getEmpty();
+            if (e.previous == nullptr)
+                return false;
+        } else {
+            _release(e.previous);
+        }
+    }
+
+    std::swap(e.loaded, e.previous);
+    e.loaded->objs[e.loaded->count++] = obj;
+    return true;
+}
+
+} // namespace DaqDB
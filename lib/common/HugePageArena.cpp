@@ -0,0 +1,142 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <sys/mman.h>
+
+#include <daqdb/Types.h>
+
+#include "HugePageArena.h"
+#include "Logger.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+namespace DaqDB {
+
+HugePageArena &HugePageArena::getInstance() {
+    static HugePageArena arena;
+    return arena;
+}
+
+HugePageArena::HugePageArena() : _mapped(false), _fallback(false) {}
+
+HugePageArena::~HugePageArena() {
+    for (auto &chunk : _chunks)
+        munmap(chunk.first, chunk.second);
+}
+
+void HugePageArena::setPageSize(size_t pageSize) {
+    if (pageSize != HUGE_PAGE_SIZE_2MB && pageSize != HUGE_PAGE_SIZE_1GB)
+        throw OperationFailedException(EINVAL,
+                                       "Unsupported hugepage size " +
+                                           std::to_string(pageSize));
+    std::lock_guard<std::mutex> lock(_chunkMutex);
+    if (pageSize == _pageSize)
+        return;
+    /* sizes of existing dedicated mappings are derived from the page size */
+    if (_mapped)
+        throw OperationFailedException(EBUSY,
+                                       "Hugepage size cannot change after "
+                                       "memory is mapped");
+    _pageSize = pageSize;
+}
+
+size_t HugePageArena::mappedSize(size_t size) const {
+    if (size > (1UL << HUGE_PAGE_ARENA_MAX_SHIFT))
+        return _roundToPage(size, _largePageSize(size));
+    return 1UL << (_sizeClass(size) + HUGE_PAGE_ARENA_MIN_SHIFT);
+}
+
+void *HugePageArena::_map(size_t size, size_t pageSize) {
+    _mapped = true;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    int pageShift = __builtin_ctzl(pageSize);
+    void *addr =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE,
+             flags | MAP_HUGETLB | (pageShift << MAP_HUGE_SHIFT), -1, 0);
+    if (addr != MAP_FAILED)
+        return addr;
+
+    if (_fallback.exchange(true) == false)
+        DAQ_INFO("Hugepages of " + std::to_string(pageSize) +
+                 " bytes not available, falling back to regular pages");
+    addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (addr == MAP_FAILED)
+        throw OperationFailedException(ENOMEM);
+    madvise(addr, size, MADV_HUGEPAGE);
+    return addr;
+}
+
+unsigned int HugePageArena::_sizeClass(size_t size) const {
+    unsigned int shift = HUGE_PAGE_ARENA_MIN_SHIFT;
+    while ((1UL << shift) < size)
+        shift++;
+    return shift - HUGE_PAGE_ARENA_MIN_SHIFT;
+}
+
+void *HugePageArena::_carve(size_t size) {
+    std::lock_guard<std::mutex> lock(_chunkMutex);
+    if (_chunkLeft < size) {
+        /*
+         * Leftover of the current chunk is abandoned, the smallest classes
+         * waste at most one size class worth of memory per chunk.
+         */
+        size_t chunkSize = std::max(HUGE_PAGE_ARENA_CHUNK_SIZE, _pageSize);
+        _chunkCur = static_cast<char *>(_map(chunkSize, _pageSize));
+        _chunkLeft = chunkSize;
+        _chunks.emplace_back(_chunkCur, chunkSize);
+    }
+    void *ptr = _chunkCur;
+    _chunkCur += size;
+    _chunkLeft -= size;
+    return ptr;
+}
+
+void *HugePageArena::alloc(size_t size) {
+    if (size > (1UL << HUGE_PAGE_ARENA_MAX_SHIFT))
+        return _map(mappedSize(size), _largePageSize(size));
+
+    unsigned int sizeClass = _sizeClass(size);
+    FreeList &freeList = _freeLists[sizeClass];
+    {
+        std::lock_guard<std::mutex> lock(freeList.mutex);
+        if (!freeList.objs.empty()) {
+            void *ptr = freeList.objs.back();
+            freeList.objs.pop_back();
+            return ptr;
+        }
+    }
+    return _carve(1UL << (sizeClass + HUGE_PAGE_ARENA_MIN_SHIFT));
+}
+
+void HugePageArena::free(void *ptr, size_t size) {
+    if (!ptr)
+        return;
+    if (size > (1UL << HUGE_PAGE_ARENA_MAX_SHIFT)) {
+        munmap(ptr, mappedSize(size));
+        return;
+    }
+
+    FreeList &freeList = _freeLists[_sizeClass(size)];
+    std::lock_guard<std::mutex> lock(freeList.mutex);
+    freeList.objs.push_back(ptr);
+}
+
+} // namespace DaqDB
@@ -0,0 +1,105 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace DaqDB {
+
+const size_t HUGE_PAGE_SIZE_2MB = 2UL * 1024 * 1024;
+const size_t HUGE_PAGE_SIZE_1GB = 1024UL * 1024 * 1024;
+const size_t HUGE_PAGE_ARENA_CHUNK_SIZE = 32UL * 1024 * 1024;
+const unsigned int HUGE_PAGE_ARENA_MIN_SHIFT = 6;  // 64B
+const unsigned int HUGE_PAGE_ARENA_MAX_SHIFT = 21; // 2MB
+const unsigned int HUGE_PAGE_ARENA_CLASSES =
+    HUGE_PAGE_ARENA_MAX_SHIFT - HUGE_PAGE_ARENA_MIN_SHIFT + 1;
+
+/*
+ * Process wide arena for staging buffers backed by 2MB or 1GB hugepages.
+ *
+ * Memory is mapped in chunks with MAP_HUGETLB and carved into power of two
+ * size classes kept on free lists; chunks are never returned to the system.
+ * Buffers above the biggest class get their own mapping, made of 2MB pages
+ * unless they span a whole 1GB page. When hugepages are not reserved the
+ * arena falls back to regular anonymous mappings with transparent hugepages
+ * requested through madvise.
+ */
+class HugePageArena {
+  public:
+    static HugePageArena &getInstance();
+
+    /**
+     * Selects hugepage size (2MB or 1GB) before the first allocation.
+     *
+     * @throw OperationFailedException if the size is not supported or
+     * memory was mapped with another page size already
+     */
+    void setPageSize(size_t pageSize);
+    size_t getPageSize() const { return _pageSize; }
+
+    /**
+     * @return bytes taken from the system by a buffer of given size
+     */
+    size_t mappedSize(size_t size) const;
+
+    /**
+     * @throw OperationFailedException if memory cannot be mapped
+     */
+    void *alloc(size_t size);
+    void free(void *ptr, size_t size);
+
+    /**
+     * @return true if all mappings so far are backed by hugepages
+     */
+    bool isHugePageBacked() const { return !_fallback; }
+
+  private:
+    HugePageArena();
+    ~HugePageArena();
+    HugePageArena(const HugePageArena &) = delete;
+    HugePageArena &operator=(const HugePageArena &) = delete;
+
+    void *_map(size_t size, size_t pageSize);
+    void *_carve(size_t size);
+    unsigned int _sizeClass(size_t size) const;
+    /* page size of a dedicated mapping, fixed once memory is mapped */
+    size_t _largePageSize(size_t size) const {
+        return size >= _pageSize ? _pageSize : HUGE_PAGE_SIZE_2MB;
+    }
+    static size_t _roundToPage(size_t size, size_t pageSize) {
+        return (size + pageSize - 1) & ~(pageSize - 1);
+    }
+
+    struct FreeList {
+        std::mutex mutex;
+        std::vector<void *> objs;
+    };
+
+    std::mutex _chunkMutex;
+    std::vector<std::pair<void *, size_t>> _chunks;
+    char *_chunkCur = nullptr;
+    size_t _chunkLeft = 0;
+    FreeList _freeLists[HUGE_PAGE_ARENA_CLASSES];
+    size_t _pageSize = HUGE_PAGE_SIZE_2MB;
+    std::atomic<bool> _mapped;
+    std::atomic<bool> _fallback;
+};
+
+} // namespace DaqDB
@@ -0,0 +1,111 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+
+#include "hdr_histogram.h"
+
+#include "LatencyTracer.h"
+#include <daqdb/Types.h>
+
+namespace DaqDB {
+
+static const char *traceStageNames[TRACE_POINTS] = {
+    "total",  "poller_queue",   "io_engine_queue", "io_submit",
+    "device", "finalize_queue", "callback"};
+
+LatencyTracer &LatencyTracer::getInstance() {
+    static LatencyTracer instance;
+    return instance;
+}
+
+LatencyTracer::LatencyTracer() : _enabled(false) {
+    for (auto &histogram : _histograms)
+        histogram = nullptr;
+}
+
+LatencyTracer::~LatencyTracer() {
+    _enabled = false;
+    for (auto histogram : _histograms) {
+        if (histogram)
+            hdr_close(histogram);
+    }
+}
+
+void LatencyTracer::enable(bool en) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (en && !_histograms[0]) {
+        /* histograms are never freed, requests in flight may record */
+        for (auto &histogram : _histograms) {
+            int err = hdr_init(1, TRACE_MAX_LATENCY_NS,
+                               TRACE_SIGNIFICANT_FIGURES, &histogram);
+            if (err)
+                throw OperationFailedException(err,
+                                               "Cannot create histogram");
+        }
+    }
+    _enabled.store(en, std::memory_order_release);
+}
+
+void LatencyTracer::reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto histogram : _histograms) {
+        if (histogram)
+            hdr_reset(histogram);
+    }
+}
+
+void LatencyTracer::_record(const RqstTrace &trace) {
+    uint64_t prev = trace.ts[TRACE_SUBMIT];
+    for (unsigned int point = TRACE_SUBMIT + 1; point < TRACE_POINTS;
+         point++) {
+        /* stages the request did not go through are skipped */
+        if (!trace.ts[point])
+            continue;
+        hdr_record_value_atomic(_histograms[point], trace.ts[point] - prev);
+        prev = trace.ts[point];
+    }
+    hdr_record_value_atomic(_histograms[TRACE_SUBMIT],
+                            trace.ts[TRACE_DONE] - trace.ts[TRACE_SUBMIT]);
+}
+
+void LatencyTracer::_printStage(std::string &out, unsigned int idx) {
+    struct hdr_histogram *histogram = _histograms[idx];
+    std::stringstream result;
+    result << traceStageNames[idx] << ": count=" << histogram->total_count
+           << " min=" << hdr_min(histogram)
+           << " mean=" << static_cast<uint64_t>(hdr_mean(histogram))
+           << " p50=" << hdr_value_at_percentile(histogram, 50.0)
+           << " p99=" << hdr_value_at_percentile(histogram, 99.0)
+           << " p99.9=" << hdr_value_at_percentile(histogram, 99.9)
+           << " max=" << hdr_max(histogram) << " [ns]" << std::endl;
+    out += result.str();
+}
+
+std::string LatencyTracer::print(const std::string &stage) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::string out;
+    if (!_histograms[0])
+        return out;
+
+    for (unsigned int idx = 0; idx < TRACE_POINTS; idx++) {
+        if (stage.empty() || stage == traceStageNames[idx])
+            _printStage(out, idx);
+    }
+    return out;
+}
+
+} // namespace DaqDB
@@ -0,0 +1,119 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+struct hdr_histogram;
+
+namespace DaqDB {
+
+/*
+ * Points at which a request changes hands. The time spent between two
+ * consecutive points the request went through is accounted to the stage
+ * named after the later point, SUBMIT slot holds end-to-end latency.
+ */
+enum TracePoint : std::uint8_t {
+    TRACE_SUBMIT = 0,  // KVStore enqueued the request
+    TRACE_POLLER,      // dequeued by PmemPoller/OffloadPoller
+    TRACE_IO_ENGINE,   // dequeued by SpdkIoEngine
+    TRACE_IO_SUBMIT,   // IO submitted to SPDK
+    TRACE_IO_COMPLETE, // SPDK completion callback
+    TRACE_FINALIZE,    // dequeued by FinalizePoller
+    TRACE_DONE,        // user callback returned
+    TRACE_POINTS
+};
+
+const uint64_t TRACE_MAX_LATENCY_NS = 10ULL * 1000 * 1000 * 1000;
+const int TRACE_SIGNIFICANT_FIGURES = 3;
+
+struct RqstTrace {
+    uint64_t ts[TRACE_POINTS] = {0};
+};
+
+/*
+ * Optional per-stage request latency tracing. Timestamps are stamped into
+ * the request at each hand-off and aggregated into HDR histograms when the
+ * request completes. Requests submitted while tracing is disabled carry no
+ * timestamps and are not accounted.
+ */
+class LatencyTracer {
+  public:
+    static LatencyTracer &getInstance();
+
+    void enable(bool en);
+    inline bool isEnabled() const {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    inline void start(RqstTrace &trace) {
+        if (isEnabled()) {
+            trace = RqstTrace();
+            trace.ts[TRACE_SUBMIT] = now();
+        } else {
+            trace.ts[TRACE_SUBMIT] = 0;
+        }
+    }
+    inline void stamp(RqstTrace &trace, TracePoint point) {
+        if (trace.ts[TRACE_SUBMIT])
+            trace.ts[point] = now();
+    }
+    /**
+     * Stamps TRACE_DONE and records the request into histograms.
+     */
+    inline void finish(RqstTrace &trace) {
+        if (trace.ts[TRACE_SUBMIT]) {
+            trace.ts[TRACE_DONE] = now();
+            _record(trace);
+            trace.ts[TRACE_SUBMIT] = 0;
+        }
+    }
+
+    void reset();
+
+    /**
+     * @param stage stage name, empty string for all stages
+     * @return latency summary in nanoseconds, empty if stage is unknown or
+     * tracing was never enabled
+     */
+    std::string print(const std::string &stage = "");
+
+    static inline uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+  private:
+    LatencyTracer();
+    ~LatencyTracer();
+    LatencyTracer(const LatencyTracer &) = delete;
+    LatencyTracer &operator=(const LatencyTracer &) = delete;
+
+    void _record(const RqstTrace &trace);
+    void _printStage(std::string &out, unsigned int idx);
+
+    std::atomic<bool> _enabled;
+    std::mutex _mutex;
+    struct hdr_histogram *_histograms[TRACE_POINTS];
+};
+
+} // namespace DaqDB
@@ -0,0 +1,221 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define DAQDB_CACHE_LINE_SIZE 64
+
+namespace DaqDB {
+
+enum class RingType : std::uint8_t { SP_SC = 0, MP_SC, SP_MC, MP_MC };
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/*
+ * Bounded lock-free ring of trivially copyable elements (pointers in
+ * practice), following the rte_ring head/tail scheme. Producers and
+ * consumers each reserve a range by moving their head, copy the elements and
+ * then publish the range by moving their tail. Single producer/consumer sides
+ * skip the compare-and-swap. Capacity is rounded up to a power of two.
+ */
+template <class T> class LockFreeRing {
+  public:
+    explicit LockFreeRing(size_t count, RingType type = RingType::MP_SC);
+    ~LockFreeRing();
+
+    /*
+     * Enqueue all n elements or none of them.
+     *
+     * @return number of enqueued elements (0 or n)
+     */
+    size_t enqueueBulk(const T *objs, size_t n) {
+        return _enqueue(objs, n, true);
+    }
+    /*
+     * Enqueue as many of n elements as there is room for.
+     *
+     * @return number of enqueued elements
+     */
+    size_t enqueueBurst(const T *objs, size_t n) {
+        return _enqueue(objs, n, false);
+    }
+    bool enqueue(const T &obj) { return _enqueue(&obj, 1, true) == 1; }
+
+    /*
+     * Dequeue exactly n elements or none of them.
+     */
+    size_t dequeueBulk(T *objs, size_t n) { return _dequeue(objs, n, true); }
+    /*
+     * Dequeue up to n elements.
+     */
+    size_t dequeueBurst(T *objs, size_t n) { return _dequeue(objs, n, false); }
+    bool dequeue(T &obj) { return _dequeue(&obj, 1, true) == 1; }
+
+    /*
+     * Consumer tail is loaded first, it never passes the producer tail
+     * loaded after it, so the difference does not wrap. Both sides may move
+     * in between, the count is clamped to capacity as in rte_ring.
+     */
+    size_t count() const {
+        uint32_t consTail = _cons.tail.load(std::memory_order_acquire);
+        uint32_t prodTail = _prod.tail.load(std::memory_order_acquire);
+        uint32_t cnt = prodTail - consTail;
+        return (cnt > _capacity) ? _capacity : cnt;
+    }
+    size_t freeCount() const { return _capacity - count(); }
+    size_t capacity() const { return _capacity; }
+    bool empty() const { return count() == 0; }
+    RingType type() const { return _type; }
+
+  private:
+    LockFreeRing(const LockFreeRing &) = delete;
+    LockFreeRing &operator=(const LockFreeRing &) = delete;
+
+    /*
+     * Padded rather than aligned to a cache line, so rings can be allocated
+     * with plain new (C++14 does not honour over-aligned types there) while
+     * producer and consumer sides still never share a line.
+     */
+    struct HeadTail {
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+        char pad[DAQDB_CACHE_LINE_SIZE - 2 * sizeof(std::atomic<uint32_t>)];
+    };
+
+    inline bool _multiProd() const {
+        return _type == RingType::MP_SC || _type == RingType::MP_MC;
+    }
+    inline bool _multiCons() const {
+        return _type == RingType::SP_MC || _type == RingType::MP_MC;
+    }
+
+    uint32_t _moveHead(HeadTail &ht, const HeadTail &other, bool multi,
+                       uint32_t n, bool fixed, uint32_t capacity,
+                       uint32_t &oldHead);
+    inline void _publishTail(HeadTail &ht, bool multi, uint32_t oldHead,
+                             uint32_t newHead);
+
+    size_t _enqueue(const T *objs, size_t n, bool fixed);
+    size_t _dequeue(T *objs, size_t n, bool fixed);
+
+    char _padHead[DAQDB_CACHE_LINE_SIZE];
+    HeadTail _prod;
+    HeadTail _cons;
+    uint32_t _capacity;
+    uint32_t _mask;
+    RingType _type;
+    T *_slots;
+};
+
+template <class T>
+LockFreeRing<T>::LockFreeRing(size_t count, RingType type)
+    : _capacity(1), _type(type), _slots(nullptr) {
+    while (_capacity < count)
+        _capacity <<= 1;
+    _mask = _capacity - 1;
+    _slots = new T[_capacity];
+}
+
+template <class T> LockFreeRing<T>::~LockFreeRing() { delete[] _slots; }
+
+/*
+ * Reserve up to n slots by moving the head of the given side.
+ * For producers the available room is capacity - (head - consumer tail),
+ * for consumers it is producer tail - head (capacity passed as 0).
+ */
+template <class T>
+uint32_t LockFreeRing<T>::_moveHead(HeadTail &ht, const HeadTail &other,
+                                    bool multi, uint32_t n, bool fixed,
+                                    uint32_t capacity, uint32_t &oldHead) {
+    uint32_t cnt;
+    oldHead = ht.head.load(std::memory_order_relaxed);
+    for (;;) {
+        uint32_t avail =
+            capacity + other.tail.load(std::memory_order_acquire) - oldHead;
+        cnt = (n > avail) ? (fixed ? 0 : avail) : n;
+        if (!cnt)
+            return 0;
+        if (!multi) {
+            ht.head.store(oldHead + cnt, std::memory_order_relaxed);
+            return cnt;
+        }
+        if (ht.head.compare_exchange_weak(oldHead, oldHead + cnt,
+                                          std::memory_order_relaxed,
+                                          std::memory_order_relaxed))
+            return cnt;
+    }
+}
+
+template <class T>
+inline void LockFreeRing<T>::_publishTail(HeadTail &ht, bool multi,
+                                          uint32_t oldHead, uint32_t newHead) {
+    /*
+     * With many producers (consumers) the ranges must be published in the
+     * order they were reserved.
+     */
+    if (multi) {
+        while (ht.tail.load(std::memory_order_relaxed) != oldHead)
+            cpuRelax();
+    }
+    ht.tail.store(newHead, std::memory_order_release);
+}
+
+template <class T>
+size_t LockFreeRing<T>::_enqueue(const T *objs, size_t n, bool fixed) {
+    uint32_t head;
+    uint32_t cnt = _moveHead(_prod, _cons, _multiProd(),
+                             static_cast<uint32_t>(n), fixed, _capacity, head);
+    if (!cnt)
+        return 0;
+
+    for (uint32_t i = 0; i < cnt; i++)
+        _slots[(head + i) & _mask] = objs[i];
+
+    _publishTail(_prod, _multiProd(), head, head + cnt);
+    return cnt;
+}
+
+template <class T>
+size_t LockFreeRing<T>::_dequeue(T *objs, size_t n, bool fixed) {
+    uint32_t head;
+    uint32_t cnt = _moveHead(_cons, _prod, _multiCons(),
+                             static_cast<uint32_t>(n), fixed, 0, head);
+    if (!cnt)
+        return 0;
+
+    for (uint32_t i = 0; i < cnt; i++)
+        objs[i] = _slots[(head + i) & _mask];
+
+    _publishTail(_cons, _multiCons(), head, head + cnt);
+    return cnt;
+}
+
+} // namespace DaqDB
@@ -11,27 +11,227 @@
  * distributed under the License is distributed on an "AS IS" BASIS,
  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
  * See the License for the specific language governing permissions and
- * limitations under the License. 
+ * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#include <pthread.h>
+
 #include "Logger.h"
 
 namespace DaqDB {
 
 DaqDB::Logger gLog;
 
-Logger::Logger() {}
+static const int8_t LOG_DISABLED = INT8_MAX;
+
+/* flush() from the sink must not wait for itself */
+static thread_local bool logFlusherThread = false;
+
+/*
+ * Every thread registers its ring on first log call. Ring outlives the
+ * thread until the flusher drains it.
+ */
+struct LogRingHolder {
+    ~LogRingHolder() {
+        if (ring && ring->refs.fetch_sub(1) == 1)
+            delete ring;
+    }
+    LogRing *ring = nullptr;
+};
+
+static inline uint64_t logTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Logger::Logger()
+    : _threshold(LOG_DISABLED),
+#ifdef DEBUG
+      _level(LogLevel::LEVEL_DEBUG),
+#else
+      _level(LogLevel::LEVEL_INFO),
+#endif
+      _flusherRunning(false) {
+}
+
+Logger::~Logger() {
+    _threshold = LOG_DISABLED;
+    _stopFlusher();
 
-Logger::~Logger() {}
+    std::lock_guard<std::mutex> lock(_ringsMutex);
+    for (auto ring : _rings) {
+        if (ring->refs.fetch_sub(1) == 1)
+            delete ring;
+    }
+    _rings.clear();
+}
 
 void Logger::setLogFunc(const std::function<void(std::string)> &fn) {
+    _stopFlusher();
     _logFunc = fn;
+    if (!_logFunc) {
+        _threshold = LOG_DISABLED;
+        return;
+    }
+
+    _threshold = static_cast<int8_t>(_level);
+    std::lock_guard<std::mutex> lock(_flushMutex);
+    _flusherRunning = true;
+    _flusher = new std::thread(&Logger::_flusherLoop, this);
+}
+
+void Logger::setLevel(LogLevel level) {
+    _level = level;
+    if (_logFunc)
+        _threshold = static_cast<int8_t>(_level);
+}
+
+void Logger::log(LogLevel level, const std::string &msg) {
+    LogRecord rec;
+    rec.level = level;
+    rec.fmt = nullptr;
+    rec.format = &Logger::_formatString;
+    const size_t maxLen = LogRecord::PAYLOAD_SIZE - 1;
+    if (msg.size() > maxLen) {
+        std::string cut(msg, 0, maxLen);
+        _markTruncated(cut, maxLen);
+        std::memcpy(rec.payload, cut.c_str(), cut.size() + 1);
+    } else {
+        std::memcpy(rec.payload, msg.c_str(), msg.size() + 1);
+    }
+    _push(rec);
+
+    if (level == LogLevel::LEVEL_CRITICAL)
+        flush();
+}
+
+void Logger::_formatString(const LogRecord &rec, std::string &out) {
+    out = rec.payload;
+}
+
+void Logger::_markTruncated(std::string &out, size_t maxLen) {
+    const size_t markLen = sizeof(LOG_TRUNCATED_MARK) - 1;
+    out.resize(maxLen - markLen);
+    out += LOG_TRUNCATED_MARK;
+}
+
+LogRing *Logger::_threadRing() {
+    static thread_local LogRingHolder holder;
+    if (!holder.ring) {
+        holder.ring = new LogRing();
+        std::lock_guard<std::mutex> lock(_ringsMutex);
+        _rings.push_back(holder.ring);
+    }
+    return holder.ring;
+}
+
+void Logger::_push(LogRecord &rec) {
+    rec.timestamp = logTimestamp();
+    LogRing *ring = _threadRing();
+    if (!ring->ring.enqueue(rec))
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
 }
 
-void Logger::log(std::string msg) {
-    if (_logFunc) {
+size_t Logger::_drain() {
+    uint64_t dropped = 0;
+    _batch.clear();
+    {
+        std::lock_guard<std::mutex> lock(_ringsMutex);
+        for (auto it = _rings.begin(); it != _rings.end();) {
+            LogRing *ring = *it;
+            LogRecord rec;
+            while (ring->ring.dequeue(rec))
+                _batch.push_back(rec);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+            /* owning thread exited and ring is drained */
+            if (ring->refs.load() == 1 && ring->ring.empty()) {
+                delete ring;
+                it = _rings.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    /* keep global order across threads */
+    std::stable_sort(_batch.begin(), _batch.end(),
+                     [](const LogRecord &a, const LogRecord &b) {
+                         return a.timestamp < b.timestamp;
+                     });
+
+    std::string msg;
+    for (auto &rec : _batch) {
+        rec.format(rec, msg);
         _logFunc(msg);
     }
+    if (dropped)
+        _logFunc("Logger: " + std::to_string(dropped) +
+                 " record(s) dropped, ring full");
+
+    return _batch.size();
+}
+
+void Logger::_flusherLoop() {
+    pthread_setname_np(pthread_self(), "Logger");
+    logFlusherThread = true;
+
+    while (_flusherRunning) {
+        uint64_t requested;
+        {
+            std::lock_guard<std::mutex> lock(_flushMutex);
+            requested = _flushRequested;
+        }
+
+        _drain();
+
+        std::unique_lock<std::mutex> lock(_flushMutex);
+        _flushDone = requested;
+        _flushDoneCv.notify_all();
+        _flushCv.wait_for(
+            lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS), [this] {
+                return !_flusherRunning || _flushRequested > _flushDone;
+            });
+    }
+}
+
+void Logger::flush() {
+    if (logFlusherThread)
+        return;
+
+    /* flusher is started and stopped with the mutex held */
+    std::unique_lock<std::mutex> lock(_flushMutex);
+    if (!_flusherRunning)
+        return;
+    uint64_t request = ++_flushRequested;
+    _flushCv.notify_one();
+    _flushDoneCv.wait(lock, [this, request] {
+        return _flushDone >= request || !_flusherRunning;
+    });
+}
+
+void Logger::_stopFlusher() {
+    if (!_flusher)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(_flushMutex);
+        _flusherRunning = false;
+        _flushCv.notify_all();
+        _flushDoneCv.notify_all();
+    }
+    _flusher->join();
+    delete _flusher;
+    _flusher = nullptr;
+
+    /* pass remaining records to the sink */
+    if (_logFunc)
+        _drain();
 }
 
 } // namespace DaqDB
@@ -11,34 +11,174 @@
  * distributed under the License is distributed on an "AS IS" BASIS,
  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
  * See the License for the specific language governing permissions and
- * limitations under the License. 
+ * limitations under the License.
  */
 
 #pragma once
 
-/** @todo implement logging categories */
-#define DAQ_INFO(msg) gLog.log(msg)
-#define DAQ_CRITICAL(msg) gLog.log(msg)
-#ifdef DEBUG
-#define DAQ_DEBUG(msg) gLog.log(msg)
-#else
-#define DAQ_DEBUG(msg)
-#endif
+/*
+ * Log macros check the level before evaluating the message, so disabled
+ * levels cost a single relaxed load. DAQ_*F variants take a string literal
+ * printf format and trivially copyable arguments; arguments are stored in
+ * binary form and formatted by the background flusher.
+ */
+#define DAQ_LOG(level, msg)                                                    \
+    do {                                                                       \
+        if (gLog.isEnabled(level))                                             \
+            gLog.log(level, msg);                                              \
+    } while (0)
+#define DAQ_LOGF(level, fmt, ...)                                              \
+    do {                                                                       \
+        if (gLog.isEnabled(level))                                             \
+            gLog.logf(level, fmt, ##__VA_ARGS__);                              \
+    } while (0)
+
+#define DAQ_INFO(msg) DAQ_LOG(DaqDB::LogLevel::LEVEL_INFO, msg)
+#define DAQ_CRITICAL(msg) DAQ_LOG(DaqDB::LogLevel::LEVEL_CRITICAL, msg)
+#define DAQ_DEBUG(msg) DAQ_LOG(DaqDB::LogLevel::LEVEL_DEBUG, msg)
+#define DAQ_INFOF(fmt, ...)                                                    \
+    DAQ_LOGF(DaqDB::LogLevel::LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define DAQ_DEBUGF(fmt, ...)                                                   \
+    DAQ_LOGF(DaqDB::LogLevel::LEVEL_DEBUG, fmt, ##__VA_ARGS__)
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <functional>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <daqdb/Options.h>
+
+#include "LockFreeRing.h"
 
 namespace DaqDB {
 
+const size_t LOG_RECORD_SIZE = 256;
+const size_t LOG_RING_SIZE = 1024;
+const unsigned int LOG_FLUSH_INTERVAL_MS = 10;
+/* appended to messages cut to fit a record */
+const char LOG_TRUNCATED_MARK[] = " [truncated]";
+
+struct LogRecord;
+typedef void (*LogFormatFunc)(const LogRecord &rec, std::string &out);
+
+struct LogRecord {
+    uint64_t timestamp;
+    LogFormatFunc format;
+    const char *fmt;
+    LogLevel level;
+    static const size_t PAYLOAD_SIZE = LOG_RECORD_SIZE - 4 * sizeof(uint64_t);
+    alignas(uint64_t) char payload[PAYLOAD_SIZE];
+};
+
+/*
+ * Per-thread single producer ring. Shared by the owning thread and the
+ * flusher, whoever releases the last reference frees it.
+ */
+struct LogRing {
+    LogRing() : ring(LOG_RING_SIZE, RingType::SP_SC), refs(2), dropped(0) {}
+    LockFreeRing<LogRecord> ring;
+    std::atomic<int> refs;
+    std::atomic<uint64_t> dropped;
+};
+
+template <class... T> struct LogArgsTrivial : std::true_type {};
+template <class T, class... R>
+struct LogArgsTrivial<T, R...>
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+                                       LogArgsTrivial<R...>::value> {};
+
 class Logger {
   public:
     Logger();
     virtual ~Logger();
 
+    /*
+     * Sets the sink and starts background flusher. Sink is invoked from
+     * the flusher thread only.
+     */
     void setLogFunc(const std::function<void(std::string)> &fn);
-    void log(std::string);
+    void setLevel(LogLevel level);
+
+    inline bool isEnabled(LogLevel level) const {
+        return static_cast<int8_t>(level) >=
+               _threshold.load(std::memory_order_relaxed);
+    }
+
+    void log(LogLevel level, const std::string &msg);
+
+    template <class... Args>
+    void logf(LogLevel level, const char *fmt, Args... args) {
+        typedef std::tuple<Args...> ArgsTuple;
+        static_assert(sizeof(ArgsTuple) <= LogRecord::PAYLOAD_SIZE,
+                      "Too many log arguments");
+        static_assert(LogArgsTrivial<Args...>::value,
+                      "Log arguments must be trivially copyable");
+
+        LogRecord rec;
+        rec.level = level;
+        rec.fmt = fmt;
+        rec.format = &Logger::_formatArgs<Args...>;
+        new (rec.payload) ArgsTuple(args...);
+        _push(rec);
+    }
+
+    /*
+     * Waits until records logged so far are passed to the sink.
+     */
+    void flush();
 
   private:
+    template <class... Args, size_t... I>
+    static void _snprintf(std::string &out, const char *fmt,
+                          const std::tuple<Args...> &args,
+                          std::index_sequence<I...>) {
+        char buf[LOG_RECORD_SIZE * 2];
+        int len = snprintf(buf, sizeof(buf), fmt, std::get<I>(args)...);
+        out = buf;
+        if (len >= static_cast<int>(sizeof(buf)))
+            _markTruncated(out, sizeof(buf) - 1);
+    }
+
+    static void _markTruncated(std::string &out, size_t maxLen);
+
+    template <class... Args>
+    static void _formatArgs(const LogRecord &rec, std::string &out) {
+        auto &args = *reinterpret_cast<const std::tuple<Args...> *>(rec.payload);
+        _snprintf(out, rec.fmt, args, std::index_sequence_for<Args...>{});
+    }
+
+    static void _formatString(const LogRecord &rec, std::string &out);
+
+    void _push(LogRecord &rec);
+    LogRing *_threadRing();
+    size_t _drain();
+    void _flusherLoop();
+    void _stopFlusher();
+
     std::function<void(std::string)> _logFunc = nullptr;
+    std::atomic<int8_t> _threshold;
+    LogLevel _level;
+
+    std::mutex _ringsMutex;
+    std::vector<LogRing *> _rings;
+    std::vector<LogRecord> _batch;
+
+    std::thread *_flusher = nullptr;
+    std::atomic<bool> _flusherRunning;
+    std::mutex _flushMutex;
+    std::condition_variable _flushCv;
+    std::condition_variable _flushDoneCv;
+    uint64_t _flushRequested = 0;
+    uint64_t _flushDone = 0;
 };
 
 extern DaqDB::Logger gLog;
@@ -249,6 +249,111 @@ void MemMgr::putMem(void *ptr) {
     }
 }
 
+void MemMgr::putMem(void *ptr, size_t size_) {
+#ifdef _GMP_DEBUG_
+    fprintf(stderr, "released ptr: %x size: %d\n", ptr, size_);
+#endif
+
+    if (size_ <= 4) {
+        GMPpool4.put(ptr);
+        return;
+    }
+    if (size_ <= 8) {
+        GMPpool8.put(ptr);
+        return;
+    }
+    if (size_ <= 16) {
+        GMPpool16.put(ptr);
+        return;
+    }
+    if (size_ <= 32) {
+        GMPpool32.put(ptr);
+        return;
+    }
+    if (size_ <= 64) {
+        GMPpool64.put(ptr);
+        return;
+    }
+    if (size_ <= 128) {
+        GMPpool128.put(ptr);
+        return;
+    }
+    if (size_ <= 256) {
+        GMPpool256.put(ptr);
+        return;
+    }
+    if (size_ <= 512) {
+        GMPpool512.put(ptr);
+        return;
+    }
+    if (size_ <= 1024) {
+        GMPpool1024.put(ptr);
+        return;
+    }
+    if (size_ <= 2048) {
+        GMPpool2048.put(ptr);
+        return;
+    }
+    if (size_ <= 4096) {
+        GMPpool4096.put(ptr);
+        return;
+    }
+    if (size_ <= 8192) {
+        GMPpool8192.put(ptr);
+        return;
+    }
+    if (size_ <= 16384) {
+        GMPpool16K.put(ptr);
+        return;
+    }
+    if (size_ <= 32768) {
+        GMPpool32K.put(ptr);
+        return;
+    }
+    if (size_ <= 65536) {
+        GMPpool64K.put(ptr);
+        return;
+    }
+    if (size_ <= 131072) {
+        GMPpool128K.put(ptr);
+        return;
+    }
+    if (size_ <= 262144) {
+        GMPpool256K.put(ptr);
+        return;
+    }
+    if (size_ <= 524288) {
+        GMPpool512K.put(ptr);
+        return;
+    }
+    if (size_ <= 1048576) {
+        GMPpool1M.put(ptr);
+        return;
+    }
+
+    free(ptr);
+}
+
+static MemMgr &valueMemMgr() {
+    static MemMgr memMgr;
+    return memMgr;
+}
+
+char *MemMgr::allocValue(size_t size_) {
+    if (size_ > MAX_POOLED_SIZE)
+        return new char[size_];
+    return static_cast<char *>(valueMemMgr().getMem(size_));
+}
+
+void MemMgr::freeValue(char *ptr, size_t size_) {
+    if (!ptr)
+        return;
+    if (size_ > MAX_POOLED_SIZE)
+        delete[] ptr;
+    else
+        valueMemMgr().putMem(ptr, size_);
+}
+
 void MemMgr::engage() { started = true; }
 
 void MemMgr::dump() {}
@@ -85,6 +85,22 @@ class MemMgr {
     virtual ~MemMgr();
     void *getMem(size_t size_);
     void putMem(void *ptr);
+    /*
+     * Returns chunk of known size to its size class pool. Unlike putMem(ptr)
+     * it does not depend on the front stamp, so it can be used with
+     * _MM_GMP_ON_ disabled.
+     */
+    void putMem(void *ptr, size_t size_);
+
+    /*
+     * Size class allocator for NOT_BUFFERED values. Values up to
+     * MAX_POOLED_SIZE are served from size class pools fronted by per-thread
+     * magazines, bigger ones come from the heap. The same size has to be
+     * passed to freeValue.
+     */
+    static char *allocValue(size_t size_);
+    static void freeValue(char *ptr, size_t size_);
+    static const size_t MAX_POOLED_SIZE = 1048576;
     static void engage();
     void dump();
     static bool started;
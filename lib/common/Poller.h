@@ -16,61 +16,233 @@
 
 #pragma once
 
+#include <assert.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
 #include "spdk/io_channel.h"
 #include "spdk/queue.h"
 
+#include "LockFreeRing.h"
+
 #define DEQUEUE_RING_LIMIT 1024
+#define POLLER_RING_SIZE (4096 * 4)
 
 namespace DaqDB {
 
+/*
+ * Request ring implementation used by a poller. SPDK_RING requires the
+ * SPDK/DPDK environment (hugepages) to be initialized, PORTABLE_RING is
+ * allocated from regular heap memory.
+ */
+enum class PollerRingBackend : std::uint8_t { SPDK_RING = 0, PORTABLE_RING };
+
+inline RingType toRingType(spdk_ring_type type) {
+    switch (type) {
+    case SPDK_RING_TYPE_SP_SC:
+        return RingType::SP_SC;
+    case SPDK_RING_TYPE_MP_SC:
+        return RingType::MP_SC;
+    default:
+        return RingType::MP_MC;
+    }
+}
+
 template <class T> class Poller {
   public:
     Poller(bool _createBuf = true,
-           spdk_ring_type _rsqRingType = SPDK_RING_TYPE_MP_SC)
-        : rqstRing(0), requests(new T *[DEQUEUE_RING_LIMIT]),
-          createBuf(_createBuf), rsqRingType(_rsqRingType) {
+           spdk_ring_type _rsqRingType = SPDK_RING_TYPE_MP_SC,
+           PollerRingBackend _ringBackend = PollerRingBackend::SPDK_RING)
+        : rqstRing(0), rqstPortableRing(0),
+          requests(new T *[DEQUEUE_RING_LIMIT]), rsqRingType(_rsqRingType),
+          createBuf(_createBuf), ringBackend(_ringBackend) {
         if (createBuf == true) {
-            rqstRing =
-                spdk_ring_create(rsqRingType, 4096 * 4, SPDK_ENV_SOCKET_ID_ANY);
+            createRing();
         }
     }
     virtual ~Poller() {
-        spdk_ring_free(rqstRing);
+        if (rqstRing)
+            spdk_ring_free(rqstRing);
+        delete rqstPortableRing;
         delete[] requests;
     }
     bool init() {
         if (createBuf == false) {
-            rqstRing =
-                spdk_ring_create(rsqRingType, 4096 * 4, SPDK_ENV_SOCKET_ID_ANY);
-            return rqstRing ? true : false;
+            return createRing();
         }
         return true;
     }
+    /*
+     * Slots reserved by other producers are not available here. Without
+     * credits in use the request goes straight to the ring, a reserve()
+     * racing with it may then find its slot taken by enqueueReserved().
+     */
     virtual bool enqueue(T *rqst) {
-        size_t count = spdk_ring_enqueue(rqstRing, (void **)&rqst, 1, 0);
-        return (count == 1);
+        if (!_reserved.load(std::memory_order_relaxed))
+            return _enqueue(rqst);
+        if (!reserve(1))
+            return false;
+        if (enqueueReserved(rqst))
+            return true;
+        release(1);
+        return false;
+    }
+    /*
+     * Enqueue using a slot reserved earlier with reserve().
+     */
+    bool enqueueReserved(T *rqst) {
+        if (!_enqueue(rqst))
+            return false;
+        _reserved.fetch_sub(1, std::memory_order_relaxed);
+        return true;
     }
     virtual void dequeue(uint32_t cnt = DEQUEUE_RING_LIMIT) {
-        requestCount = spdk_ring_dequeue(
-            rqstRing, (void **)&requests[0],
-            cnt >= DEQUEUE_RING_LIMIT ? DEQUEUE_RING_LIMIT : cnt);
-        assert(requestCount <=
-               (cnt >= DEQUEUE_RING_LIMIT ? DEQUEUE_RING_LIMIT : cnt));
+        uint32_t limit = cnt >= DEQUEUE_RING_LIMIT ? DEQUEUE_RING_LIMIT : cnt;
+        if (rqstPortableRing)
+            requestCount =
+                rqstPortableRing->dequeueBurst(&requests[0], limit);
+        else
+            requestCount =
+                spdk_ring_dequeue(rqstRing, (void **)&requests[0], limit);
+        assert(requestCount <= limit);
+        if (requestCount)
+            _checkSpaceWaiters();
+    }
+    size_t count() {
+        if (rqstPortableRing)
+            return rqstPortableRing->count();
+        return rqstRing ? spdk_ring_count(rqstRing) : 0;
+    }
+    size_t freeCount() {
+        if (rqstPortableRing)
+            return rqstPortableRing->freeCount();
+        /* rte_ring keeps one slot empty */
+        return rqstRing ? POLLER_RING_SIZE - 1 - spdk_ring_count(rqstRing)
+                        : 0;
+    }
+
+    /*
+     * Credit based flow control. Producer reserves n slots upfront and
+     * spends them with enqueueReserved(), unused credits are returned with
+     * release().
+     *
+     * @return true if all n slots were reserved
+     */
+    bool reserve(size_t n) {
+        size_t reserved = _reserved.load(std::memory_order_relaxed);
+        do {
+            if (freeCount() < reserved + n)
+                return false;
+        } while (!_reserved.compare_exchange_weak(reserved, reserved + n,
+                                                  std::memory_order_relaxed));
+        return true;
+    }
+    void release(size_t n) {
+        _reserved.fetch_sub(n, std::memory_order_relaxed);
+        _checkSpaceWaiters();
+    }
+
+    /*
+     * Registers one-shot callback invoked when at least n slots can be
+     * queued. Callback is called from the poller thread (or immediately if
+     * there is enough room already) and should not block.
+     */
+    void notifyOnSpace(size_t n, std::function<void()> clb) {
+        {
+            std::lock_guard<std::mutex> lock(_spaceWaitersMutex);
+            /*
+             * Waiter is counted before the room is checked, pairs with the
+             * fence in _checkSpaceWaiters(): either the check sees the slots
+             * freed by the consumer or the consumer sees the waiter.
+             */
+            _spaceWaitersCnt.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (canQueue() < n) {
+                _spaceWaiters.push_back({n, clb});
+                return;
+            }
+            _spaceWaitersCnt.fetch_sub(1);
+        }
+        clb();
     }
-    size_t count() { return rqstRing ? spdk_ring_count(rqstRing) : 0; }
 
     virtual void process() = 0;
 
     virtual void setRunning(int rn) {}
     virtual bool isOffloadRunning() { return false; }
     virtual void initFreeList() {}
-    virtual uint32_t canQueue() { return 0; }
+    /*
+     * Starts own thread for pollers not driven by the SPDK app thread
+     */
+    virtual void startThread() {}
+    /*
+     * @return number of unreserved free slots
+     */
+    virtual uint32_t canQueue() {
+        size_t free = freeCount();
+        size_t reserved = _reserved.load(std::memory_order_relaxed);
+        return free > reserved ? free - reserved : 0;
+    }
 
     struct spdk_ring *rqstRing;
+    LockFreeRing<T *> *rqstPortableRing;
     unsigned short requestCount = 0;
     T **requests;
     spdk_ring_type rsqRingType;
     bool createBuf;
+    PollerRingBackend ringBackend;
+
+  protected:
+    bool _enqueue(T *rqst) {
+        if (rqstPortableRing)
+            return rqstPortableRing->enqueue(rqst);
+        size_t count = spdk_ring_enqueue(rqstRing, (void **)&rqst, 1, 0);
+        return (count == 1);
+    }
+
+    inline void _checkSpaceWaiters() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_spaceWaitersCnt.load(std::memory_order_relaxed))
+            _notifySpaceWaiters();
+    }
+
+    void _notifySpaceWaiters() {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(_spaceWaitersMutex);
+            size_t avail = canQueue();
+            for (auto it = _spaceWaiters.begin(); it != _spaceWaiters.end();) {
+                if (it->first <= avail) {
+                    ready.push_back(it->second);
+                    it = _spaceWaiters.erase(it);
+                    _spaceWaitersCnt--;
+                } else {
+                    it++;
+                }
+            }
+        }
+        for (auto &clb : ready)
+            clb();
+    }
+
+    bool createRing() {
+        if (ringBackend == PollerRingBackend::PORTABLE_RING) {
+            rqstPortableRing = new LockFreeRing<T *>(POLLER_RING_SIZE,
+                                                     toRingType(rsqRingType));
+            return true;
+        }
+        rqstRing = spdk_ring_create(rsqRingType, POLLER_RING_SIZE,
+                                    SPDK_ENV_SOCKET_ID_ANY);
+        return rqstRing ? true : false;
+    }
+
+    std::atomic<size_t> _reserved{0};
+    std::mutex _spaceWaitersMutex;
+    std::vector<std::pair<size_t, std::function<void()>>> _spaceWaiters;
+    std::atomic<unsigned int> _spaceWaitersCnt{0};
 };
 
 } // namespace DaqDB
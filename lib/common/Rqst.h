@@ -21,6 +21,7 @@
 
 #include "ClassAlloc.h"
 #include "GeneralPool.h"
+#include "LatencyTracer.h"
 #include <daqdb/KVStoreBase.h>
 
 namespace DaqDB {
@@ -46,6 +47,7 @@ class Rqst {
         : op(op), key(key), keySize(keySize), value(value),
           valueSize(valueSize), clb(clb), loc(loc) {
         memcpy(keyBuffer, key, keySize);
+        LatencyTracer::getInstance().start(trace);
     }
     Rqst()
         : op(T::GET), key(keyBuffer), keySize(0), value(0), valueSize(0),
@@ -64,16 +66,28 @@ class Rqst {
         valueSize = _valueSize;
         clb = _clb;
         loc = _loc;
+        LatencyTracer::getInstance().start(trace);
     }
     void finalizeGet(const char *_key, const size_t _keySize,
                      const char *_value, size_t _valueSize,
-                     KVStoreBase::KVStoreBaseCallback _clb) {
+                     KVStoreBase::KVStoreBaseCallback _clb,
+                     bool _handOver = false) {
         op = T::GET;
         key = _key;
         keySize = _keySize;
         value = _value;
         valueSize = _valueSize;
         clb = _clb;
+        handOver = _handOver;
+        prefetch = false;
+        located = false;
+        LatencyTracer::getInstance().start(trace);
+    }
+    void finalizePrefetch(const char *_key, const size_t _keySize) {
+        finalizeGet(_key, _keySize, nullptr, 0, nullptr);
+        memcpy(keyBuffer, key, keySize);
+        key = keyBuffer;
+        prefetch = true;
     }
     void finalizeRemove(const char *_key, const size_t _keySize,
                         const char *_value, size_t _valueSize,
@@ -84,6 +98,7 @@ class Rqst {
         value = _value;
         valueSize = _valueSize;
         clb = _clb;
+        LatencyTracer::getInstance().start(trace);
     }
 
     T op;
@@ -97,8 +112,15 @@ class Rqst {
     // performance
     KVStoreBase::KVStoreBaseCallback clb;
     uint8_t loc;
-    unsigned char taskBuffer[256];
-    uint64_t devAddrBuf[2];
+    /* read buffer is passed to the callback, which has to free it */
+    bool handOver = false;
+    /* value is read into the read cache, nobody waits for it */
+    bool prefetch = false;
+    /* devAddrBuf and valueSize hold the value looked up by the submitter */
+    bool located = false;
+    unsigned char taskBuffer[280];
+    uint64_t devAddrBuf[3];
+    RqstTrace trace;
 
     static DaqDB::GeneralPool<Rqst, DaqDB::ClassAlloc<Rqst>> updatePool;
     static DaqDB::GeneralPool<Rqst, DaqDB::ClassAlloc<Rqst>> getPool;
@@ -16,25 +16,46 @@
 
 #include "KVStore.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/filesystem.hpp>
 #include <cerrno>
 #include <chrono>
 #include <condition_variable>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
+#include <CompletionQueue.h>
 #include <DhtServer.h>
 #include <DhtUtils.h>
+#include <HugePageArena.h>
+#include <LatencyTracer.h>
 #include <Logger.h>
+#include <MemMgr.h>
 #include <daqdb/Types.h>
 #include <libpmem.h>
 
+#include "spdk/env.h"
+
 using namespace std::chrono_literals;
 namespace bf = boost::filesystem;
 
 namespace DaqDB {
 
+/*
+ * Completion queues of the calling thread, one per store it enabled them on,
+ * see EnableCompletionQueue. Stores are keyed by an id never reused, so a
+ * store opened at the address of a closed one does not get its queue.
+ */
+static thread_local std::unordered_map<uint64_t,
+                                       std::shared_ptr<CompletionQueue>>
+    threadCompletionQueues;
+static std::atomic<uint64_t> nextStoreId{0};
+
 const size_t DEFAULT_KEY_SIZE = 16;
+/* reads of a value moved on the device while it was read */
+const unsigned int KVS_GET_MOVED_RETRIES = 3;
 
 KVStoreBase *KVStore::Open(const DaqDB::Options &options) {
     KVStore *kvs = new KVStore(options);
@@ -43,7 +64,7 @@ KVStoreBase *KVStore::Open(const DaqDB::Options &options) {
 }
 
 KVStore::KVStore(const DaqDB::Options &options)
-    : _options(options), _spOffloadPoller(nullptr), _keySize(0) {}
+    : _options(options), _keySize(0), _storeId(nextStoreId++) {}
 
 KVStore::~KVStore() {
     DAQ_INFO("Closing DAQDB KVStore.");
@@ -55,11 +76,15 @@ KVStore::~KVStore() {
     for (auto index = 0; index < _rqstPollers.size(); index++) {
         delete _rqstPollers.at(index);
     }
-    _spOffloadPoller.reset();
+    /* pollers with own threads are stopped before the first one */
+    for (auto index = _offloadPollers.size(); index-- > 0;) {
+        delete _offloadPollers.at(index);
+    }
+    _offloadPollers.clear();
 }
 
 bool KVStore::QuiesceOffload(bool forceAbort) {
-    if ( _spSpdk->isBdevFound() == true && _spOffloadPoller.get() ) {
+    if ( _spSpdk->isBdevFound() == true && !_offloadPollers.empty() ) {
         _spSpdk->getBdev()->IOQuiesce();
 
         int num_tries = 0;
@@ -83,11 +108,16 @@ void KVStore::init() {
     auto baseCoreId = getOptions().runtime.baseCoreId;
     auto coresUsed = 0;
 
+    gLog.setLevel(getOptions().runtime.logLevel);
     if (getOptions().runtime.logFunc)
         gLog.setLogFunc(getOptions().runtime.logFunc);
 
     DAQ_INFO("Starting DAQDB KVStore.");
 
+    HugePageArena::getInstance().setPageSize(
+        getOptions().runtime.hugePageSize);
+    LatencyTracer::getInstance().enable(getOptions().runtime.latencyTracing);
+
     DAQ_INFO("Key structure:");
     for (size_t i = 0; i < getOptions().key.nfields(); i++) {
         DAQ_INFO("  Field[" + std::to_string(i) + "]: " +
@@ -135,13 +165,45 @@ void KVStore::init() {
     }
 
     if ( _spSpdk->isBdevFound() == true ) {
-        _spOffloadPoller.reset(new DaqDB::OffloadPoller(pmem(), getSpdkCore()));
+        /* first poller runs in SPDK app thread on its own core */
+        unsigned int queues = std::min(
+            std::max(getOptions().offload.queues, 1u), SPDK_MAX_IO_QUEUES);
+        _offloadPollers.push_back(
+            new DaqDB::OffloadPoller(pmem(), getSpdkCore()));
         coresUsed++;
+        for (unsigned int queue = 1; queue < queues; queue++) {
+            _offloadPollers.push_back(new DaqDB::OffloadPoller(
+                pmem(), getSpdkCore(), queue, baseCoreId + coresUsed));
+            coresUsed++;
+        }
     }
 
-    if (_spOffloadPoller.get()) {
+    if (!_offloadPollers.empty()) {
         auto *spdkCore = getSpdkCore();
-        spdkCore->setPoller(_spOffloadPoller.get());
+        size_t cacheSize = getOptions().offload.readCacheSize * 1024 * 1024;
+        if (cacheSize) {
+            _readCache.reset(new OffloadReadCache(cacheSize));
+            OffloadReadCache *cache = _readCache.get();
+            spdkCore->getBdev()->setReleaseHandler(
+                [cache](const PciAddr &dev, uint64_t lba, uint64_t blocks) {
+                    cache->invalidate(dev, lba, blocks);
+                });
+        }
+        const OffloadOptions &offload = getOptions().offload;
+        if (offload.pmemHighWatermark) {
+            _tiering.reset(new OffloadTiering(pmem(), _offloadPollers,
+                                              offload.pmemHighWatermark,
+                                              offload.pmemLowWatermark));
+            _offloadPollers.front()->tiering = _tiering.get();
+        }
+        for (auto offloadPoller : _offloadPollers) {
+            offloadPoller->readCache = _readCache.get();
+            spdkCore->addPoller(offloadPoller);
+        }
+        void *poolAddr;
+        size_t poolSize;
+        if (pmem()->GetPoolRange(&poolAddr, &poolSize))
+            spdkCore->setPmemRegion(poolAddr, poolSize);
         if (spdkCore->isSpdkReady() == true) {
             spdkCore->startSpdk();
             spdkCore->waitReady(); // synchronize until SpdkCore is done
@@ -149,10 +211,19 @@ void KVStore::init() {
         }
     }
 
+    /*
+     * PMEM-only deployments do not need SPDK rings, requests are passed
+     * through portable lock-free rings allocated from regular memory.
+     */
+    auto ringBackend = (_spSpdk->isBdevFound() == true)
+                           ? PollerRingBackend::SPDK_RING
+                           : PollerRingBackend::PORTABLE_RING;
     for (auto index = coresUsed; index < pollerCount + coresUsed; index++) {
-        auto rqstPoller = new DaqDB::PmemPoller(pmem(), baseCoreId + index);
+        auto rqstPoller =
+            new DaqDB::PmemPoller(pmem(), baseCoreId + index, ringBackend);
         if (_spSpdk->isBdevFound() == true )
-            rqstPoller->offloadPoller = _spOffloadPoller.get();
+            rqstPoller->offloadPollers = _offloadPollers;
+        rqstPoller->tiering = _tiering.get();
         _rqstPollers.push_back(rqstPoller);
     }
 
@@ -184,6 +255,8 @@ void KVStore::Put(const char *key, size_t keySize, char *value,
         pmem()->Remove(key);
         throw;
     }
+    if (_tiering)
+        _tiering->track(key, keySize);
 }
 
 void KVStore::_getOffloaded(const char *key, size_t keySize, char *value,
@@ -207,7 +280,7 @@ void KVStore::_getOffloaded(const char *key, size_t keySize, char *value,
                              cv.notify_all();
                          });
 
-    if (!_spOffloadPoller->enqueue(getRqst)) {
+    if (!_offloadQueue(key, keySize)->enqueue(getRqst)) {
         OffloadRqst::getPool.put(getRqst);
         throw QueueFullException();
     }
@@ -220,28 +293,48 @@ void KVStore::_getOffloaded(const char *key, size_t keySize, char *value,
         throw OperationFailedException(Status(TIME_OUT));
 }
 
+/*
+ * With handOver the DMA read buffer itself is returned, it has to be released
+ * with spdk_dma_free. Device location already looked up by the caller is
+ * passed in valCtx and is not looked up again by the offload poller.
+ */
 void KVStore::_getOffloaded(const char *key, size_t keySize, char **value,
-                            size_t *valueSize) {
+                            size_t *valueSize, bool handOver,
+                            const ValCtx *valCtx) {
     if (!isOffloadEnabled())
         throw OperationFailedException(Status(OFFLOAD_DISABLED_ERROR));
     std::mutex mtx;
     std::condition_variable cv;
     bool ready = false;
+    Status rc;
     OffloadRqst *getRqst = OffloadRqst::getPool.get();
-    getRqst->finalizeGet(key, keySize, nullptr, 0,
-                         [&mtx, &cv, &ready, &value, &valueSize](
-                             KVStoreBase *kvs, Status status, const char *key,
-                             size_t keySize, const char *valueOff,
-                             size_t valueOffSize) {
-                             *value = new char[valueOffSize];
-                             std::unique_lock<std::mutex> lck(mtx);
-                             std::memcpy(*value, valueOff, valueOffSize);
-                             *valueSize = valueOffSize;
-                             ready = true;
-                             cv.notify_all();
-                         });
+    getRqst->finalizeGet(
+        key, keySize, nullptr, 0,
+        [&mtx, &cv, &ready, &rc, &value, &valueSize, handOver](
+            KVStoreBase *kvs, Status status, const char *key, size_t keySize,
+            const char *valueOff, size_t valueOffSize) {
+            std::unique_lock<std::mutex> lck(mtx);
+            rc = status;
+            if (!status.ok()) {
+                *value = nullptr;
+            } else if (handOver) {
+                *value = const_cast<char *>(valueOff);
+            } else {
+                *value = MemMgr::allocValue(valueOffSize);
+                std::memcpy(*value, valueOff, valueOffSize);
+            }
+            *valueSize = valueOffSize;
+            ready = true;
+            cv.notify_all();
+        },
+        handOver);
+    if (valCtx) {
+        memcpy(getRqst->devAddrBuf, valCtx->val, sizeof(DeviceAddr));
+        getRqst->valueSize = valCtx->size;
+        getRqst->located = true;
+    }
 
-    if (!_spOffloadPoller->enqueue(getRqst)) {
+    if (!_offloadQueue(key, keySize)->enqueue(getRqst)) {
         OffloadRqst::getPool.put(getRqst);
         throw QueueFullException();
     }
@@ -252,6 +345,8 @@ void KVStore::_getOffloaded(const char *key, size_t keySize, char **value,
     }
     if (!ready)
         throw OperationFailedException(Status(TIME_OUT));
+    if (!rc.ok())
+        throw OperationFailedException(rc);
 }
 
 void KVStore::Get(const char *key, size_t keySize, char *value,
@@ -260,21 +355,28 @@ void KVStore::Get(const char *key, size_t keySize, char *value,
     char *pVal;
     uint8_t location;
 
-    pmem()->Get(key, reinterpret_cast<void **>(&pVal), &pValSize, &location);
-    if (!value) {
-        DAQ_DEBUG("Error on get: value buffer is null");
-        throw OperationFailedException(PMEM_ALLOCATION_ERROR);
-    }
-    if (location == PMEM) {
-        if (*valueSize < pValSize) {
-            DAQ_DEBUG("Error on get: buffer size " +
-                      std::to_string(*valueSize) + " < value size " +
-                      std::to_string(pValSize));
-            throw OperationFailedException(EINVAL);
+    {
+        /* value is not moved out of PMEM while being copied */
+        RTreeValuePin pin(pmem());
+        pmem()->Get(key, reinterpret_cast<void **>(&pVal), &pValSize,
+                    &location);
+        if (!value) {
+            DAQ_DEBUG("Error on get: value buffer is null");
+            throw OperationFailedException(PMEM_ALLOCATION_ERROR);
+        }
+        if (location == PMEM) {
+            if (*valueSize < pValSize) {
+                DAQ_DEBUG("Error on get: buffer size " +
+                          std::to_string(*valueSize) + " < value size " +
+                          std::to_string(pValSize));
+                throw OperationFailedException(EINVAL);
+            }
+            pmem_memcpy_nodrain(value, pVal, pValSize);
+            *valueSize = pValSize;
+            return;
         }
-        pmem_memcpy_nodrain(value, pVal, pValSize);
-        *valueSize = pValSize;
-    } else if (location == DISK) {
+    }
+    if (location == DISK) {
         _getOffloaded(key, keySize, value, valueSize);
     } else {
         throw OperationFailedException(EINVAL);
@@ -287,16 +389,22 @@ void KVStore::Get(const char *key, size_t keySize, char **value,
     char *pVal;
     uint8_t location;
 
-    pmem()->Get(key, reinterpret_cast<void **>(&pVal), &pValSize, &location);
-    if (!value)
-        throw OperationFailedException(PMEM_ALLOCATION_ERROR);
-    if (location == PMEM) {
-        *value = new char[pValSize];
+    {
+        RTreeValuePin pin(pmem());
+        pmem()->Get(key, reinterpret_cast<void **>(&pVal), &pValSize,
+                    &location);
         if (!value)
-            throw OperationFailedException(ENOMEM);
-        pmem_memcpy_nodrain(*value, pVal, pValSize);
-        *valueSize = pValSize;
-    } else if (location == DISK) {
+            throw OperationFailedException(PMEM_ALLOCATION_ERROR);
+        if (location == PMEM) {
+            *value = MemMgr::allocValue(pValSize);
+            if (!*value)
+                throw OperationFailedException(ENOMEM);
+            pmem_memcpy_nodrain(*value, pVal, pValSize);
+            *valueSize = pValSize;
+            return;
+        }
+    }
+    if (location == DISK) {
         _getOffloaded(key, keySize, value, valueSize);
     } else {
         throw OperationFailedException(EINVAL);
@@ -338,7 +446,7 @@ void KVStore::Remove(const char *key, size_t keySize) {
                 cv.notify_all();
             });
 
-        if (!_spOffloadPoller->enqueue(removeRqst)) {
+        if (!_offloadQueue(key, keySize)->enqueue(removeRqst)) {
             OffloadRqst::removePool.put(removeRqst);
             throw QueueFullException();
         }
@@ -383,19 +491,22 @@ void KVStore::PutAsync(Key &&key, Value &&value, KVStoreBaseCallback cb,
 
     thread_local int pollerId = 0;
 
-    pollerId = (options.roundRobin()) ? ((pollerId + 1) % _rqstPollers.size())
-                                      : options.pollerId();
+    pollerId = (options.roundRobin() && !options.useCredit())
+                   ? ((pollerId + 1) % _rqstPollers.size())
+                   : options.pollerId();
+    /* failures are reported through the completion queue as well */
+    KVStoreBaseCallback clb = _completionClb(cb, false);
     try {
         // todo memleak - key and value are not freed
         PmemRqst *msg = new PmemRqst(RqstOperation::PUT, key.data(), key.size(),
-                                     value.data(), value.size(), cb);
-        if (!_rqstPollers.at(pollerId)->enqueue(msg)) {
+                                     value.data(), value.size(), clb);
+        if (!_enqueue(_rqstPollers.at(pollerId), msg, options.useCredit())) {
             delete msg;
             throw QueueFullException();
         }
     } catch (OperationFailedException &e) {
-        cb(this, e.status(), key.data(), key.size(), value.data(),
-           value.size());
+        clb(this, e.status(), key.data(), key.size(), value.data(),
+            value.size());
     } catch (...) {
         throw;
     }
@@ -404,36 +515,102 @@ void KVStore::PutAsync(Key &&key, Value &&value, KVStoreBaseCallback cb,
 Value KVStore::Get(const Key &key, const GetOptions &options) {
     if (!getDhtCore()->isLocalKey(key))
         return dhtClient()->get(key);
-    char *data;
-    size_t size;
-    Get(key.data(), key.size(), &data, &size, options);
-    return Value(data, size);
+    bool handOver = options.handOver();
+    DeviceAddr addr;
+    for (unsigned int retry = 0;; retry++) {
+        ValCtx valCtx;
+        char *data;
+        size_t size;
+        if (_getLocated(key, valCtx, addr, &data))
+            return Value(data, valCtx.size);
+        /* device address is passed as read, not as stored in the tree */
+        valCtx.val = &addr;
+        _getOffloaded(key.data(), key.size(), &data, &size, handOver,
+                      &valCtx);
+
+        /*
+         * Extent was not pinned during the read, the value is returned
+         * only if the key still points to it. Otherwise the compactor or
+         * an update may have freed it in the meantime.
+         */
+        ValCtx curCtx;
+        DeviceAddr curAddr;
+        char *curData = nullptr;
+        bool moved = true;
+        try {
+            moved = _getLocated(key, curCtx, curAddr, &curData) ||
+                    curCtx.size != valCtx.size ||
+                    memcmp(&curAddr, &addr, sizeof(addr));
+        } catch (...) {
+            _freeRead(data, size, handOver);
+            throw;
+        }
+        if (!moved)
+            return handOver ? Value(data, size, KeyValAttribute::DMA_BUFFER)
+                            : Value(data, size);
+        _freeRead(data, size, handOver);
+        if (curData)
+            return Value(curData, curCtx.size);
+        if (retry == KVS_GET_MOVED_RETRIES)
+            throw OperationFailedException(Status(TIME_OUT));
+    }
+}
+
+/*
+ * Looks value up, a PMEM value is copied to data while the tree is pinned,
+ * address of an offloaded one to addr.
+ *
+ * @return true if the value was in PMEM
+ */
+bool KVStore::_getLocated(const Key &key, ValCtx &valCtx, DeviceAddr &addr,
+                          char **data) {
+    RTreeValuePin pin(pmem());
+    pmem()->Get(key.data(), &valCtx.val, &valCtx.size, &valCtx.location);
+    if (valCtx.location == PMEM) {
+        *data = MemMgr::allocValue(valCtx.size);
+        if (!*data)
+            throw OperationFailedException(ENOMEM);
+        pmem_memcpy_nodrain(*data, valCtx.val, valCtx.size);
+        return true;
+    }
+    if (valCtx.location != DISK)
+        throw OperationFailedException(EINVAL);
+    memcpy(&addr, valCtx.val, sizeof(addr));
+    return false;
+}
+
+void KVStore::_freeRead(char *data, size_t size, bool handOver) {
+    if (handOver)
+        spdk_dma_free(data);
+    else
+        MemMgr::freeValue(data, size);
 }
 
 void KVStore::GetAsync(const Key &key, KVStoreBaseCallback cb,
                        const GetOptions &options) {
     if (!getDhtCore()->isLocalKey(key))
         throw FUNC_NOT_IMPLEMENTED;
+    KVStoreBaseCallback clb = _completionClb(cb, true);
     if (options.attr & PrimaryKeyAttribute::LONG_TERM) {
         if (!isOffloadEnabled())
             throw OperationFailedException(Status(OFFLOAD_DISABLED_ERROR));
 
         OffloadRqst *getRqst = OffloadRqst::getPool.get();
         try {
-            getRqst->finalizeGet(key.data(), key.size(), nullptr, 0, cb);
-            if (!_spOffloadPoller->enqueue(getRqst)) {
+            getRqst->finalizeGet(key.data(), key.size(), nullptr, 0, clb);
+            if (!_enqueueOffload(getRqst, options.useCredit())) {
                 OffloadRqst::getPool.put(getRqst);
                 throw QueueFullException();
             }
         } catch (OperationFailedException &e) {
             Value val;
-            cb(this, e.status(), key.data(), key.size(), val.data(),
-               val.size());
+            clb(this, e.status(), key.data(), key.size(), val.data(),
+                val.size());
         }
     } else {
         thread_local int pollerId = 0;
 
-        pollerId = (options.roundRobin())
+        pollerId = (options.roundRobin() && !options.useCredit())
                        ? ((pollerId + 1) % _rqstPollers.size())
                        : options.pollerId();
 
@@ -441,15 +618,16 @@ void KVStore::GetAsync(const Key &key, KVStoreBaseCallback cb,
             throw OperationFailedException(EINVAL);
         }
         try {
-            if (!_rqstPollers.at(pollerId)->enqueue(
-                    new PmemRqst(RqstOperation::GET, key.data(), key.size(),
-                                 nullptr, 0, cb))) {
+            if (!_enqueue(_rqstPollers.at(pollerId),
+                          new PmemRqst(RqstOperation::GET, key.data(),
+                                       key.size(), nullptr, 0, clb),
+                          options.useCredit())) {
                 throw QueueFullException();
             }
         } catch (OperationFailedException &e) {
             Value val;
-            cb(this, e.status(), key.data(), key.size(), val.data(),
-               val.size());
+            clb(this, e.status(), key.data(), key.size(), val.data(),
+                val.size());
         }
     }
 }
@@ -510,7 +688,7 @@ void KVStore::Update(const Key &key, Value &&val,
             },
             location);
 
-        if (!_spOffloadPoller->enqueue(updateRqst)) {
+        if (!_offloadQueue(key.data(), key.size())->enqueue(updateRqst)) {
             OffloadRqst::updatePool.put(updateRqst);
             throw QueueFullException();
         }
@@ -539,6 +717,7 @@ void KVStore::UpdateAsync(const Key &key, Value &&value, KVStoreBaseCallback cb,
         if (!isOffloadEnabled())
             throw OperationFailedException(Status(OFFLOAD_DISABLED_ERROR));
 
+        KVStoreBaseCallback clb = _completionClb(cb, false);
         uint8_t location;
         try {
             void *newValData;
@@ -547,23 +726,23 @@ void KVStore::UpdateAsync(const Key &key, Value &&value, KVStoreBaseCallback cb,
                           &location);
             value = Value(static_cast<char *>(newValData), newValSize);
         } catch (...) {
-            Value val;
-            cb(this, KEY_NOT_FOUND, key.data(), key.size(), value.data(),
-               value.size());
+            clb(this, KEY_NOT_FOUND, key.data(), key.size(), value.data(),
+                value.size());
+            return;
         }
         OffloadRqst *updateRqst = OffloadRqst::updatePool.get();
         try {
             updateRqst->finalizeUpdate(key.data(), key.size(), value.data(),
-                                       value.size(), cb, location);
+                                       value.size(), clb, location);
 
-            if (!_spOffloadPoller->enqueue(updateRqst)) {
+            if (!_enqueueOffload(updateRqst, options.useCredit())) {
                 OffloadRqst::updatePool.put(updateRqst);
                 throw QueueFullException();
             }
         } catch (OperationFailedException &e) {
             Value val;
-            cb(this, e.status(), key.data(), key.size(), val.data(),
-               val.size());
+            clb(this, e.status(), key.data(), key.size(), val.data(),
+                val.size());
         }
     } else {
         // @TODO other attributes not supported by rtree currently
@@ -600,10 +779,19 @@ void KVStore::RemoveRange(const Key &beg, const Key &end) {
 
 void KVStore::Alloc(const char *key, size_t keySize, char **value, size_t size,
                     const AllocOptions &options) {
-    if (options.attr & KeyValAttribute::KVS_BUFFERED)
-        pmem()->AllocValueForKey(key, size, value);
+    if (options.attr & KeyValAttribute::KVS_BUFFERED) {
+        try {
+            pmem()->AllocValueForKey(key, size, value);
+        } catch (OperationFailedException &e) {
+            /* values are moved out of PMEM without waiting for next check */
+            if (_tiering && e.status().getStatusCode() == PMEM_ALLOCATION_ERROR)
+                _tiering->allocFailed();
+            throw;
+        }
+    } else if (options.attr & KeyValAttribute::HUGE_PAGE)
+        *value = static_cast<char *>(HugePageArena::getInstance().alloc(size));
     else
-        *value = new char[size];
+        *value = MemMgr::allocValue(size);
 }
 
 Value KVStore::Alloc(const Key &key, size_t size, const AllocOptions &options) {
@@ -612,6 +800,8 @@ Value KVStore::Alloc(const Key &key, size_t size, const AllocOptions &options) {
         valAttr = KeyValAttribute::KVS_BUFFERED;
         if (!getDhtCore()->isLocalKey(key))
             return dhtClient()->alloc(key, size);
+    } else if (options.attr & KeyValAttribute::HUGE_PAGE) {
+        valAttr = KeyValAttribute::HUGE_PAGE;
     }
     char *value;
     Alloc(key.data(), key.size(), &value, size, options);
@@ -623,8 +813,12 @@ void KVStore::Free(const Key &key, Value &&value) {
         if (!getDhtCore()->isLocalKey(key))
             return dhtClient()->free(key, std::move(value));
         // todo add pmem free method (free only if not in use)
+    } else if (value.isHugePageBacked()) {
+        HugePageArena::getInstance().free(value.data(), value.size());
+    } else if (value.isDmaBuffer()) {
+        spdk_dma_free(value.data());
     } else {
-        delete[] value.data();
+        MemMgr::freeValue(value.data(), value.size());
     }
 }
 
@@ -642,6 +836,10 @@ void KVStore::ChangeOptions(Value &value, const AllocOptions &options) {
 Key KVStore::AllocKey(const AllocOptions &options) {
     if (options.attr & KeyValAttribute::KVS_BUFFERED) {
         return dhtClient()->allocKey(KeySize());
+    } else if (options.attr & KeyValAttribute::HUGE_PAGE) {
+        return Key(static_cast<char *>(
+                       HugePageArena::getInstance().alloc(KeySize())),
+                   KeySize(), KeyValAttribute::HUGE_PAGE);
     } else {
         return Key(new char[KeySize()], KeySize());
     }
@@ -650,6 +848,8 @@ Key KVStore::AllocKey(const AllocOptions &options) {
 void KVStore::Free(Key &&key) {
     if (key.isKvsBuffered()) {
         dhtClient()->free(std::move(key));
+    } else if (key.isHugePageBacked()) {
+        HugePageArena::getInstance().free(key.data(), key.size());
     } else {
         delete[] key.data();
     }
@@ -673,6 +873,20 @@ bool KVStore::IsOffloaded(Key &key) {
     }
     return result;
 }
+void KVStore::Prefetch(const std::vector<Key> &keys) {
+    if (!_readCache || !isOffloadEnabled())
+        return;
+    for (auto &key : keys) {
+        if (key.size() > sizeof(OffloadRqst::keyBuffer) ||
+            !getDhtCore()->isLocalKey(key))
+            continue;
+        OffloadRqst *rqst = OffloadRqst::getPool.get();
+        rqst->finalizePrefetch(key.data(), key.size());
+        if (!_offloadQueue(key.data(), key.size())->enqueuePrefetch(rqst))
+            OffloadRqst::getPool.put(rqst);
+    }
+}
+
 std::string KVStore::getProperty(const std::string &name) {
     std::unique_lock<std::mutex> l(_lock);
 
@@ -695,10 +909,140 @@ std::string KVStore::getProperty(const std::string &name) {
         return std::to_string(getOptions().pmem.totalSize);
     if (name == "daqdb.pmem.alloc_unit_size")
         return std::to_string(getOptions().pmem.allocUnitSize);
+    if (name == "daqdb.offload.read_cache.size")
+        return std::to_string(_readCache ? _readCache->getSize() : 0);
+    if (name == "daqdb.offload.read_cache.count")
+        return std::to_string(_readCache ? _readCache->getCount() : 0);
+    if (name == "daqdb.offload.read_cache.hits")
+        return std::to_string(_readCache ? _readCache->getHits() : 0);
+    if (name == "daqdb.offload.read_cache.misses")
+        return std::to_string(_readCache ? _readCache->getMisses() : 0);
+    if (name == "daqdb.offload.read_cache.coalesced")
+        return std::to_string(_readCache ? _readCache->getCoalesced() : 0);
+    if (name == "daqdb.offload.read_cache.evictions")
+        return std::to_string(_readCache ? _readCache->getEvictions() : 0);
+    if (name == "daqdb.offload.read_cache.hit_rate" && _readCache) {
+        /* coalesced reads waited for the device, they count as misses */
+        uint64_t hits = _readCache->getHits();
+        uint64_t lookups =
+            hits + _readCache->getMisses() + _readCache->getCoalesced();
+        return std::to_string(lookups ? 100 * hits / lookups : 0) + "%";
+    }
+    if (name == "daqdb.offload.tiering.moved_bytes")
+        return std::to_string(_tiering ? _tiering->getMovedBytes() : 0);
+    if (name == "daqdb.offload.tiering.moved_count")
+        return std::to_string(_tiering ? _tiering->getMovedCount() : 0);
+    if (name == "daqdb.offload.tiering.tracked")
+        return std::to_string(_tiering ? _tiering->getTrackedCount() : 0);
+    if (name == "daqdb.latency")
+        return LatencyTracer::getInstance().print();
+    if (name.compare(0, 14, "daqdb.latency.") == 0)
+        return LatencyTracer::getInstance().print(name.substr(14));
 
     return "";
 }
 
+KVStoreBase::KVStoreBaseCallback
+KVStore::_completionClb(const KVStoreBaseCallback &cb, bool copyValue) {
+    if (threadCompletionQueues.empty() || !cb)
+        return cb;
+    auto it = threadCompletionQueues.find(_storeId);
+    if (it == threadCompletionQueues.end())
+        return cb;
+    return CompletionQueue::wrap(it->second, cb, copyValue);
+}
+
+void KVStore::EnableCompletionQueue(size_t depth) {
+    threadCompletionQueues[_storeId].reset(new CompletionQueue(depth));
+}
+
+void KVStore::DisableCompletionQueue() {
+    threadCompletionQueues.erase(_storeId);
+}
+
+size_t KVStore::PollCompletions(size_t max) {
+    auto it = threadCompletionQueues.find(_storeId);
+    if (it == threadCompletionQueues.end())
+        return 0;
+    return it->second->poll(this, max);
+}
+
+std::vector<OffloadPoller *> &KVStore::_offloadQueues() {
+    if (!isOffloadEnabled())
+        throw OperationFailedException(Status(OFFLOAD_DISABLED_ERROR));
+    return _offloadPollers;
+}
+
+OffloadPoller *KVStore::_offloadQueue(const char *key, size_t keySize) {
+    return _offloadPollers.at(
+        OffloadPoller::queueOf(key, keySize, _offloadPollers.size()));
+}
+
+/*
+ * Offload credit is a slot reserved on every offload queue, it is spent on
+ * the queue of the key and given back on the others.
+ */
+bool KVStore::_enqueueOffload(OffloadRqst *rqst, bool useCredit) {
+    OffloadPoller *poller = _offloadQueue(rqst->key, rqst->keySize);
+    if (useCredit) {
+        for (auto other : _offloadPollers) {
+            if (other != poller)
+                other->release(1);
+        }
+    }
+    return _enqueue(poller, rqst, useCredit);
+}
+
+bool KVStore::ReserveCredits(size_t n, const QueueOptions &queue) {
+    if (queue.type == QueueType::OFFLOAD) {
+        auto &pollers = _offloadQueues();
+        for (size_t index = 0; index < pollers.size(); index++) {
+            if (!pollers[index]->reserve(n)) {
+                while (index-- > 0)
+                    pollers[index]->release(n);
+                return false;
+            }
+        }
+        return true;
+    }
+    return _rqstPollers.at(queue.pollerId)->reserve(n);
+}
+
+void KVStore::ReleaseCredits(size_t n, const QueueOptions &queue) {
+    if (queue.type == QueueType::OFFLOAD) {
+        for (auto poller : _offloadQueues())
+            poller->release(n);
+    } else {
+        _rqstPollers.at(queue.pollerId)->release(n);
+    }
+}
+
+/*
+ * Offload queue depth is limited by the fullest offload poller.
+ */
+OffloadPoller *KVStore::_fullestOffloadQueue() {
+    OffloadPoller *fullest = nullptr;
+    for (auto poller : _offloadQueues()) {
+        if (!fullest || poller->canQueue() < fullest->canQueue())
+            fullest = poller;
+    }
+    return fullest;
+}
+
+size_t KVStore::GetFreeQueueDepth(const QueueOptions &queue) {
+    if (queue.type == QueueType::OFFLOAD)
+        return _fullestOffloadQueue()->canQueue();
+    return _rqstPollers.at(queue.pollerId)->canQueue();
+}
+
+void KVStore::NotifyOnSpace(size_t n, std::function<void()> cb,
+                            const QueueOptions &queue) {
+    if (queue.type == QueueType::OFFLOAD)
+        _fullestOffloadQueue()->notifyOnSpace(n, cb);
+    else
+        _rqstPollers.at(queue.pollerId)->notifyOnSpace(n, cb);
+}
+
 uint64_t KVStore::GetTreeSize() { return pmem()->GetTreeSize(); }
 
 uint8_t KVStore::GetTreeDepth() { return pmem()->GetTreeDepth(); }
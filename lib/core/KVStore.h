@@ -96,8 +96,21 @@ class KVStore : public KVStoreBase {
     void Remove(const char *key, size_t keySize);
 
     virtual bool IsOffloaded(Key &key);
+    virtual void Prefetch(const std::vector<Key> &keys);
     virtual bool QuiesceOffload(bool forceAbort = false);
 
+    virtual bool ReserveCredits(size_t n,
+                                const QueueOptions &queue = QueueOptions());
+    virtual void ReleaseCredits(size_t n,
+                                const QueueOptions &queue = QueueOptions());
+    virtual size_t GetFreeQueueDepth(const QueueOptions &queue = QueueOptions());
+    virtual void NotifyOnSpace(size_t n, std::function<void()> cb,
+                               const QueueOptions &queue = QueueOptions());
+
+    virtual void EnableCompletionQueue(size_t depth = 4096);
+    virtual void DisableCompletionQueue();
+    virtual size_t PollCompletions(size_t max);
+
     uint64_t GetTreeSize();
     uint64_t GetLeafCount();
     uint8_t GetTreeDepth();
@@ -117,18 +130,45 @@ class KVStore : public KVStoreBase {
   private:
     explicit KVStore(const DaqDB::Options &options);
     inline bool isOffloadEnabled() { return getSpdkCore()->isOffloadEnabled(); }
+    std::vector<OffloadPoller *> &_offloadQueues();
+    OffloadPoller *_offloadQueue(const char *key, size_t keySize);
+    OffloadPoller *_fullestOffloadQueue();
+    bool _enqueueOffload(OffloadRqst *rqst, bool useCredit);
+    KVStoreBaseCallback _completionClb(const KVStoreBaseCallback &cb,
+                                       bool copyValue);
+
+    /*
+     * Credit is consumed by the call either way: it becomes the slot of the
+     * queued request, or goes back to the poller if the request could not
+     * be queued. Caller must not release it again.
+     */
+    template <class P, class R>
+    static inline bool _enqueue(P *poller, R *rqst, bool useCredit) {
+        if (!useCredit)
+            return poller->enqueue(rqst);
+        if (poller->enqueueReserved(rqst))
+            return true;
+        poller->release(1);
+        return false;
+    }
 
     void _getOffloaded(const char *key, size_t keySize, char *value,
                        size_t *valueSize);
     void _getOffloaded(const char *key, size_t keySize, char **value,
-                       size_t *valueSize);
+                       size_t *valueSize, bool handOver = false,
+                       const ValCtx *valCtx = nullptr);
+    bool _getLocated(const Key &key, ValCtx &valCtx, DeviceAddr &addr,
+                     char **data);
+    void _freeRead(char *data, size_t size, bool handOver);
 
     size_t _keySize;
     Options _options;
 
     std::unique_ptr<DhtServer> _spDhtServer;
     std::unique_ptr<RTreeEngine> _spRtree;
-    std::unique_ptr<OffloadPoller> _spOffloadPoller;
+    std::vector<OffloadPoller *> _offloadPollers;
+    std::unique_ptr<OffloadReadCache> _readCache;
+    std::unique_ptr<OffloadTiering> _tiering;
     std::unique_ptr<PrimaryKeyEngine> _spPKey;
     std::vector<PmemPoller *> _rqstPollers;
 
@@ -136,6 +176,8 @@ class KVStore : public KVStoreBase {
     std::unique_ptr<SpdkCore> _spSpdk;
 
     std::mutex _lock;
+    /* keys completion queues of this store in threads using them */
+    const uint64_t _storeId;
 };
 
 } // namespace DaqDB
@@ -22,7 +22,9 @@
 #include "DhtClient.h"
 #include "DhtCore.h"
 
+#include <HugePageArena.h>
 #include <Logger.h>
+#include <MemMgr.h>
 #include <sslot.h>
 
 using namespace std;
@@ -47,7 +49,14 @@ static void clbGet(void *ctxClient, void *ioCtx) {
     reqCtx->status = resultMsg->status;
     if (resultMsg->status == StatusCode::OK) {
         auto responseSize = resultMsg->msgSize;
-        reqCtx->value = new Value(new char[responseSize], responseSize);
+        if (client->isHugePageStaging())
+            reqCtx->value = new Value(
+                static_cast<char *>(
+                    HugePageArena::getInstance().alloc(responseSize)),
+                responseSize, KeyValAttribute::HUGE_PAGE);
+        else
+            reqCtx->value =
+                new Value(MemMgr::allocValue(responseSize), responseSize);
         memcpy(reqCtx->value->data(), resultMsg->msg, responseSize);
     }
 
@@ -66,7 +75,13 @@ static void clbGetAny(void *ctxClient, void *ioCtx) {
     reqCtx->status = resultMsg->status;
     if (resultMsg->status == StatusCode::OK) {
         auto keySize = resultMsg->msgSize;
-        reqCtx->key = new Key(new char[keySize], keySize);
+        if (client->isHugePageStaging())
+            reqCtx->key =
+                new Key(static_cast<char *>(
+                            HugePageArena::getInstance().alloc(keySize)),
+                        keySize, KeyValAttribute::HUGE_PAGE);
+        else
+            reqCtx->key = new Key(new char[keySize], keySize);
         memcpy(reqCtx->key->data(), resultMsg->msg, keySize);
     }
 
@@ -139,6 +154,7 @@ void DhtClient::initialize(DhtCore *dhtCore) {
 
     _dhtCore = dhtCore;
     _nexus = _dhtCore->getNexus();
+    _hugePageStaging = _dhtCore->options.hugePageStaging;
     erpc::Rpc<erpc::CTransport> *rpc;
 
     int i = _dhtCore->numberOfClientThreads++;
@@ -114,6 +114,11 @@ class DhtClient {
 
     erpc::MsgBuffer *getRespMsgBuf();
 
+    /**
+     * @return true if received keys and values are staged in hugepage arena
+     */
+    inline bool isHugePageStaging() const { return _hugePageStaging; }
+
     bool ping(DhtNode &node);
 
     /**
@@ -198,6 +203,7 @@ class DhtClient {
     std::unique_ptr<erpc::MsgBuffer> _respMsgBuf;
     bool _reqMsgBufInUse = false;
     bool _reqMsgBufValInUse = false;
+    bool _hugePageStaging = false;
     uint8_t _remoteRpcId = 0;
 };
 } // namespace DaqDB
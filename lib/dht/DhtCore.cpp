@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <cinttypes>
+
 #include <boost/filesystem.hpp>
 
 #include <rpc.h>
@@ -166,12 +168,11 @@ DhtNode *DhtCore::getHostAny() {
 }
 
 DhtNode *DhtCore::getHostForKey(Key key) {
-    DAQ_DEBUG("maskLen:" + std::to_string(_maskLength) + " maskOffset:" +
-              std::to_string(_maskOffset));
+    DAQ_DEBUGF("maskLen:%u maskOffset:%u", _maskLength, _maskOffset);
     if (_maskLength <= 0)
         throw OperationFailedException(Status(KEY_NOT_FOUND));
     auto keyHash = _genHash(key.data());
-    DAQ_DEBUG("keyHash:" + std::to_string(keyHash));
+    DAQ_DEBUGF("keyHash:%" PRIu64, keyHash);
     for (auto rangeAndHost : _rangeToHost) {
         auto range = rangeAndHost.first;
         DAQ_DEBUG("Node " + rangeAndHost.second->getUri() + " serving " +
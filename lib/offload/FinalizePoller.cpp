@@ -16,6 +16,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <mutex>
 #include <sstream>
@@ -33,6 +34,8 @@
 #include "spdk/thread.h"
 
 #include "FinalizePoller.h"
+#include "OffloadCompactor.h"
+#include "OffloadSegment.h"
 
 namespace DaqDB {
 
@@ -50,11 +53,26 @@ void FinalizePoller::process() {
             if (_state != FinalizePoller::State::FP_READY)
                 dropIt = true;
 
+            if (task->segment && task->op == OffloadOperation::GET) {
+                _processSegmentRead(task);
+                continue;
+            } else if (task->segment) {
+                _processSegment(task, dropIt);
+                continue;
+            }
+
+            /* request goes back to its pool before the loop ends */
+            RqstTrace trace = task->rqst->trace;
+            LatencyTracer::getInstance().stamp(trace, TRACE_FINALIZE);
+
             switch (task->op) {
             case OffloadOperation::GET:
-                if (dropIt == true)
+                if (dropIt == true) {
+                    /* hand over buffer has no owner yet */
+                    if (task->dmaBuf)
+                        spdk_dma_free(task->dmaBuf);
                     OffloadRqst::getPool.put(task->rqst);
-                else
+                } else
                     _processGet(task);
                 break;
             case OffloadOperation::UPDATE:
@@ -72,6 +90,8 @@ void FinalizePoller::process() {
             default:
                 break;
             }
+            if (!dropIt)
+                LatencyTracer::getInstance().finish(trace);
         }
         requestCount = 0;
     } else {
@@ -80,20 +100,35 @@ void FinalizePoller::process() {
     }
 }
 
+/*
+ * Read buffer of a hand over request is passed to the callback with the value
+ * moved to its start, otherwise it goes back to the pool.
+ */
 void FinalizePoller::_processGet(DeviceTask *task) {
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
 
-    if (task->result) {
-        if (task->clb)
-            task->clb(nullptr, StatusCode::OK, task->key, task->keySize,
-                      task->buff->getSpdkDmaBuf(), task->rqst->valueSize);
-    } else {
-        if (task->clb)
-            task->clb(nullptr, StatusCode::UNKNOWN_ERROR, task->key,
-                      task->keySize, nullptr, 0);
+    if (task->result && task->clb) {
+        char *value;
+        if (task->dmaBuf) {
+            value = task->dmaBuf;
+            if (task->bufOffset)
+                memmove(value, value + task->bufOffset,
+                        task->rqst->valueSize);
+            task->dmaBuf = nullptr;
+        } else {
+            value = task->buff->getSpdkDmaBuf() + task->bufOffset;
+        }
+        task->clb(nullptr, StatusCode::OK, task->key, task->keySize, value,
+                  task->rqst->valueSize);
+    } else if (task->clb) {
+        task->clb(nullptr, StatusCode::UNKNOWN_ERROR, task->key,
+                  task->keySize, nullptr, 0);
     }
 
-    bdev->ioPoolMgr->putIoReadBuf(task->buff);
+    if (task->dmaBuf)
+        spdk_dma_free(task->dmaBuf);
+    else if (task->buff)
+        bdev->ioPoolMgr->putIoReadBuf(task->buff);
     bdev->ioBufsInUse--;
     OffloadRqst::getPool.put(task->rqst);
 }
@@ -103,6 +138,7 @@ void FinalizePoller::_processUpdate(DeviceTask *task) {
     DeviceAddr devAddr;
     devAddr.busAddr.pciAddr = bdev->spBdevCtx.pci_addr;
     devAddr.lba = task->freeLba;
+    devAddr.segAddr.segAddr = 0;
 
     if (task->result) {
         if (task->updatePmemIOV) {
@@ -129,11 +165,108 @@ void FinalizePoller::_processUpdate(DeviceTask *task) {
     OffloadRqst::updatePool.put(task->rqst);
 }
 
+void FinalizePoller::_processSegmentRead(DeviceTask *task) {
+    SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
+    bdev->ioBufsInUse--;
+    task->segment->compactor->readComplete(task->result);
+}
+
+/*
+ * Updates pmem location of every value packed into a written log segment.
+ * Live bytes are committed before any location points into the segment.
+ * Values relocated by the compactor are switched only if the index still
+ * points to their old location, checked under the index lock. The key might
+ * have been removed or updated in the meantime.
+ */
+void FinalizePoller::_processSegment(DeviceTask *task, bool dropIt) {
+    SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
+    OffloadSegment *seg = task->segment;
+
+    if (dropIt || !task->result) {
+        bdev->commitSegment(task->freeLba, 0);
+        seg->writer->fail(seg, StatusCode::UNKNOWN_ERROR, !dropIt);
+        return;
+    }
+
+    DeviceAddr devAddr;
+    devAddr.busAddr.busAddr = 0;
+    devAddr.busAddr.pciAddr = bdev->spBdevCtx.pci_addr;
+    devAddr.lba = task->freeLba;
+    bdev->commitSegment(task->freeLba, seg->valueBytes);
+
+    for (size_t idx = 0; idx < seg->rqsts.size(); idx++) {
+        OffloadRqst *rqst = seg->rqsts[idx];
+        RqstTrace trace = rqst->trace;
+        seg->copyIoTrace(trace);
+        LatencyTracer::getInstance().stamp(trace, TRACE_FINALIZE);
+
+        devAddr.segAddr.seg.offset = seg->offsets[idx];
+        devAddr.segAddr.seg.size = rqst->valueSize;
+        StatusCode status = StatusCode::OK;
+        try {
+            if (rqst->loc != LOCATIONS::DISK)
+                task->rtree->AllocateAndUpdateValueWrapper(
+                    rqst->key, sizeof(DeviceAddr), &devAddr);
+            else if (!task->rtree->RelocateValueWrapper(
+                         rqst->key, sizeof(DeviceAddr),
+                         reinterpret_cast<DeviceAddr *>(rqst->devAddrBuf),
+                         &devAddr))
+                status = StatusCode::KEY_NOT_FOUND;
+        } catch (...) {
+            status = StatusCode::UNKNOWN_ERROR;
+        }
+        if (status != StatusCode::OK)
+            bdev->putFreeLba(&devAddr, 0);
+        if (rqst->clb)
+            rqst->clb(nullptr, status, rqst->key, rqst->keySize, nullptr, 0);
+        OffloadRqst::updatePool.put(rqst);
+        LatencyTracer::getInstance().finish(trace);
+    }
+
+    seg->writer->release(seg);
+}
+
+/*
+ * Looks up the device location of the value being removed. The index is
+ * consulted again as the value could have been relocated by the compactor
+ * since the remove was submitted.
+ */
+bool FinalizePoller::_getRemovedValue(DeviceTask *task, DeviceAddr &devAddr,
+                                      size_t &size) {
+    SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
+    void *val;
+    uint8_t location;
+    try {
+        task->rtree->Get(task->rqst->key, task->rqst->keySize, &val, &size,
+                         &location);
+    } catch (...) {
+        return false;
+    }
+    if (location != LOCATIONS::DISK)
+        return false;
+    devAddr = *static_cast<DeviceAddr *>(val);
+    return devAddr.busAddr.pciAddr == bdev->spBdevCtx.pci_addr;
+}
+
 void FinalizePoller::_processRemove(DeviceTask *task) {
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
 
     if (task->result) {
-        task->rtree->Remove(task->rqst->key);
+        DeviceAddr devAddr;
+        size_t size = 0;
+        bool onDevice = _getRemovedValue(task, devAddr, size);
+        try {
+            task->rtree->Remove(task->rqst->key);
+        } catch (...) {
+            if (task->clb)
+                task->clb(nullptr, StatusCode::KEY_NOT_FOUND, task->key,
+                          task->keySize, nullptr, 0);
+            OffloadRqst::removePool.put(task->rqst);
+            return;
+        }
+        /* extent goes back to the allocator through a batched unmap */
+        if (onDevice)
+            bdev->putFreeLba(&devAddr, bdev->getAlignedSize(size));
         if (task->clb)
             task->clb(nullptr, StatusCode::OK, task->key, task->keySize,
                       nullptr, 0);
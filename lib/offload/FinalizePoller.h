@@ -59,6 +59,10 @@ class FinalizePoller : public FinPoller {
     void _processGet(DeviceTask *task);
     void _processUpdate(DeviceTask *task);
     void _processRemove(DeviceTask *task);
+    void _processSegment(DeviceTask *task, bool dropIt);
+    void _processSegmentRead(DeviceTask *task);
+    bool _getRemovedValue(DeviceTask *task, DeviceAddr &devAddr,
+                          size_t &size);
 
   private:
     std::atomic<State> _state;
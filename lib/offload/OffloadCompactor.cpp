@@ -0,0 +1,181 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "spdk/env.h"
+
+#include "OffloadCompactor.h"
+#include <Logger.h>
+#include <daqdb/Types.h>
+
+namespace DaqDB {
+
+bool isOffloadValueAt(RTreeEngine *rtree, const char *key, size_t keySize,
+                      const DeviceAddr &devAddr) {
+    void *val;
+    size_t size;
+    uint8_t location;
+    try {
+        rtree->Get(key, keySize, &val, &size, &location);
+    } catch (...) {
+        return false;
+    }
+    return location == LOCATIONS::DISK &&
+           !memcmp(val, &devAddr, sizeof(devAddr));
+}
+
+OffloadCompactor::OffloadCompactor(RTreeEngine *rtree, SpdkDevice *dev,
+                                   OffloadSegmentWriter *writer,
+                                   unsigned int livePercent, size_t rate)
+    : _rtree(rtree), _dev(dev), _writer(writer),
+      _maxLiveBytes(writer->getSegmentSize() * livePercent / 100),
+      _rate(static_cast<uint64_t>(rate) * 1024 * 1024), _state(CP_IDLE),
+      _cursor(nullptr, 0) {
+    _victim.compactor = this;
+    _victim.buf = reinterpret_cast<char *>(spdk_dma_zmalloc(
+        writer->getSegmentSize(), writer->getBufAlign(), NULL));
+    if (!_victim.buf)
+        throw OperationFailedException(ENOMEM,
+                                       "Cannot allocate compaction buffer");
+}
+
+OffloadCompactor::~OffloadCompactor() { spdk_dma_free(_victim.buf); }
+
+void OffloadCompactor::process(uint64_t now, bool idle) {
+    _refill(now);
+
+    switch (_state.load(std::memory_order_acquire)) {
+    case CP_IDLE:
+        if (idle && _tokens >= _writer->getSegmentSize() && _startRead())
+            _tokens -= _writer->getSegmentSize();
+        break;
+    case CP_READ_DONE:
+        if (!_readResult) {
+            DAQ_CRITICAL("Compaction read of segment [" +
+                         std::to_string(_victimAddr.lba) + "] failed");
+            _state = CP_IDLE;
+            break;
+        }
+        _cursor = OffloadSegmentCursor(_victim.buf, _writer->getSegmentSize());
+        _pending = false;
+        _liveFound = false;
+        _state = CP_RELOCATING;
+        _relocate();
+        break;
+    case CP_RELOCATING:
+        _relocate();
+        break;
+    default:
+        break;
+    }
+}
+
+void OffloadCompactor::_refill(uint64_t now) {
+    if (_lastRefill && now > _lastRefill) {
+        uint64_t elapsed = std::min(now - _lastRefill, OFFLOAD_GC_NS_PER_SEC);
+        uint64_t burst = 2 * _writer->getSegmentSize();
+        _tokens = std::min(_tokens + elapsed * _rate / OFFLOAD_GC_NS_PER_SEC,
+                           burst);
+    }
+    _lastRefill = now;
+}
+
+bool OffloadCompactor::_startRead() {
+    uint64_t lba;
+    SpdkDevice *dev =
+        _dev->getCompactionVictim(_maxLiveBytes, OFFLOAD_GC_FREE_PERCENT, lba);
+    if (!dev)
+        return false;
+
+    _victimDev = dev;
+    _victimAddr.lba = lba;
+    _victimAddr.busAddr.busAddr = 0;
+    _victimAddr.busAddr.pciAddr = dev->getBdevCtx()->pci_addr;
+    _victimAddr.segAddr.segAddr = 0;
+
+    size_t segSize = _writer->getSegmentSize();
+    _victim.task = DeviceTask{0,
+                              segSize,
+                              static_cast<uint32_t>(
+                                  segSize / _writer->getBlockSize()),
+                              0,
+                              nullptr,
+                              false,
+                              _rtree,
+                              nullptr,
+                              dev,
+                              nullptr,
+                              OffloadOperation::GET};
+    _victim.task.segment = &_victim;
+    _victim.task.freeLba = lba;
+
+    _state = CP_READING;
+    if (dev->read(&_victim.task) != true) {
+        _state = CP_IDLE;
+        return false;
+    }
+    _victimCount++;
+    return true;
+}
+
+/*
+ * Packs values of the victim still referenced by the index, stops when the
+ * writer has no free segment and continues on the next call.
+ */
+void OffloadCompactor::_relocate() {
+    while (_pending || _cursor.next()) {
+        _pending = false;
+
+        DeviceAddr addr = _victimAddr;
+        addr.segAddr.seg.offset = _cursor.valueOffset();
+        addr.segAddr.seg.size = _cursor.valueSize();
+        if (!isOffloadValueAt(_rtree, _cursor.key(), _cursor.keySize(), addr))
+            continue;
+        _liveFound = true;
+
+        SpdkDevice *victimDev = _victimDev;
+        OffloadRqst *rqst = OffloadRqst::updatePool.get();
+        rqst->finalizeUpdate(
+            _cursor.key(), _cursor.keySize(), _cursor.value(),
+            _cursor.valueSize(),
+            [victimDev, addr](KVStoreBase *kvs, Status status,
+                              const char *key, size_t keySize,
+                              const char *value, size_t valueSize) {
+                if (status.ok())
+                    victimDev->putFreeLba(&addr, 0);
+            },
+            LOCATIONS::DISK);
+        /* relocations are kept out of latency statistics */
+        rqst->trace.ts[TRACE_SUBMIT] = 0;
+        memcpy(rqst->devAddrBuf, &addr, sizeof(addr));
+
+        if (!_writer->append(rqst)) {
+            OffloadRqst::updatePool.put(rqst);
+            _pending = true;
+            return;
+        }
+        _relocatedBytes += _cursor.valueSize();
+    }
+
+    /* live bytes accounted to the segment belong to no value */
+    if (!_liveFound)
+        _victimDev->commitSegment(_victimAddr.lba, 0);
+    _state = CP_IDLE;
+}
+
+} // namespace DaqDB
@@ -0,0 +1,104 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "OffloadSegment.h"
+#include <RTreeEngine.h>
+#include <SpdkDevice.h>
+
+namespace DaqDB {
+
+const unsigned int OFFLOAD_GC_FREE_PERCENT = 25;
+const uint64_t OFFLOAD_GC_NS_PER_SEC = 1000ULL * 1000 * 1000;
+
+/**
+ * Checks if the index still points key to given device address.
+ */
+bool isOffloadValueAt(RTreeEngine *rtree, const char *key, size_t keySize,
+                      const DeviceAddr &devAddr);
+
+/*
+ * Reclaims log segments occupied mostly by removed or overwritten values.
+ * Once free segments run low, a segment with little live data is read back,
+ * values still referenced by the index are packed again through the segment
+ * writer and their locations are switched by FinalizePoller. The old segment
+ * becomes free once all relocated values are released from it.
+ *
+ * Runs in OffloadPoller thread. Victim reads are limited by a token bucket
+ * and new victims are not picked while foreground updates wait for a free
+ * segment.
+ */
+class OffloadCompactor {
+  public:
+    /**
+     * @param livePercent segments with less live data are compacted
+     * @param rate victim read rate in MB/s
+     */
+    OffloadCompactor(RTreeEngine *rtree, SpdkDevice *dev,
+                     OffloadSegmentWriter *writer, unsigned int livePercent,
+                     size_t rate);
+    ~OffloadCompactor();
+
+    /**
+     * @param idle false if foreground updates wait for a free segment
+     */
+    void process(uint64_t now, bool idle);
+
+    /**
+     * Called by FinalizePoller once the victim read completes.
+     */
+    void readComplete(bool result) {
+        _readResult = result;
+        _state.store(CP_READ_DONE, std::memory_order_release);
+    }
+
+    uint64_t getRelocatedBytes() const { return _relocatedBytes; }
+    uint64_t getVictimCount() const { return _victimCount; }
+
+  private:
+    enum State { CP_IDLE = 0, CP_READING, CP_READ_DONE, CP_RELOCATING };
+
+    void _refill(uint64_t now);
+    bool _startRead();
+    void _relocate();
+
+    RTreeEngine *_rtree;
+    SpdkDevice *_dev;
+    OffloadSegmentWriter *_writer;
+    uint32_t _maxLiveBytes;
+    uint64_t _rate; // bytes per second
+
+    std::atomic<State> _state;
+    bool _readResult = false;
+    OffloadSegment _victim;
+    SpdkDevice *_victimDev = nullptr;
+    DeviceAddr _victimAddr;
+    OffloadSegmentCursor _cursor;
+    bool _pending = false;   // cursor entry waits for a free segment
+    bool _liveFound = false; // victim holds at least one live value
+
+    uint64_t _tokens = 0;
+    uint64_t _lastRefill = 0;
+
+    uint64_t _relocatedBytes = 0;
+    uint64_t _victimCount = 0;
+};
+
+} // namespace DaqDB
@@ -14,96 +14,340 @@
  * limitations under the License.
  */
 
-#include <iostream>
-#include <string>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include <libpmemobj.h>
 
-#include "OffloadFreeList.h"
 #include "OffloadLbaAlloc.h"
+#include <Logger.h>
+#include <daqdb/Types.h>
 
 namespace DaqDB {
 
-OffloadLbaAlloc::OffloadLbaAlloc(bool create, std::string filename,
-                                 uint64_t blockCnt, uint64_t avgBlkPerLba) {
-    bool initNeeded = false;
+using pmem::obj::make_persistent;
+using pmem::obj::p;
+using pmem::obj::pool;
+using pmem::obj::transaction;
+
+const uint64_t LBA_WORD_BITS = 64;
+const uint64_t LBA_WORD_FULL = ~0ULL;
 
-    if (create == false) {
-        _offloadFreeList =
-            pool<OffloadFreeList>::open(filename.c_str(), poolLayout);
+OffloadLbaAlloc::OffloadLbaAlloc(const std::string &filename,
+                                 uint64_t blockCnt, uint64_t unitBlocks)
+    : _unitBlocks(unitBlocks), _unitCount(blockCnt / unitBlocks),
+      _wordCount((_unitCount + LBA_WORD_BITS - 1) / LBA_WORD_BITS) {
+    if (boost::filesystem::exists(filename)) {
+        _pool = pool<Bitmap>::open(filename, _poolLayout);
+        _bitmap = _pool.get_root().get();
+        if (_bitmap->unitBlocks != _unitBlocks ||
+            _bitmap->unitCount != _unitCount) {
+            _pool.close();
+            throw OperationFailedException(
+                EINVAL, "Offload allocation unit changed, recreate " +
+                            filename);
+        }
     } else {
-        _offloadFreeList = pool<OffloadFreeList>::create(
-            filename.c_str(), poolLayout, poolFreelistSize, pollMode);
-        initNeeded = true;
-    }
-    freeLbaList = _offloadFreeList.get_root().get();
-    freeLbaList->maxLba = blockCnt / avgBlkPerLba;
-    if (initNeeded) {
-        freeLbaList->push(_offloadFreeList, -1);
-        for (uint32_t slot = 0; slot < numSlots; slot++) {
-            freeLbaList->pushBlock(_offloadFreeList, -1, slot);
+        size_t poolSize = _wordCount * sizeof(uint64_t) + PMEMOBJ_MIN_POOL;
+        _pool = pool<Bitmap>::create(filename, _poolLayout, poolSize,
+                                     S_IWUSR | S_IRUSR);
+        _bitmap = _pool.get_root().get();
+        transaction::exec_tx(_pool, [&] {
+            _bitmap->unitCount = _unitCount;
+            _bitmap->unitBlocks = _unitBlocks;
+            _bitmap->words = make_persistent<p<uint64_t>[]>(_wordCount);
+        });
+        pmemobj_memset_persist(_pool.get_handle(), _bitmap->words.get(), 0,
+                               _wordCount * sizeof(uint64_t));
+        /* units past the end of the device are never free */
+        uint64_t tail = _unitCount % LBA_WORD_BITS;
+        if (tail) {
+            _bitmap->words[_wordCount - 1] = LBA_WORD_FULL << tail;
+            _persistWords(_wordCount - 1, _wordCount - 1);
         }
     }
 
-    for (uint32_t i = 0; i < _maxBuckets; i++) {
-        buckets[i].level = 0;
-        buckets[i].sizeBracket = i + 1; // 4kB, 8kB, 12kB, ...
+    _rebuild();
+    DAQ_DEBUG("Offload allocation units [" + std::to_string(_unitCount) +
+              "] free [" + std::to_string(_freeUnits) + "]");
+}
+
+OffloadLbaAlloc::~OffloadLbaAlloc() {
+    persist();
+    _pool.close();
+}
+
+int64_t OffloadLbaAlloc::getLba(uint64_t blocks) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t len = _units(blocks);
+    int64_t start = _alloc(len);
+    if (start < 0)
+        return -1;
+
+    uint64_t unit = static_cast<uint64_t>(start);
+    _persistWords(unit / LBA_WORD_BITS, (unit + len - 1) / LBA_WORD_BITS);
+    return static_cast<int64_t>(unit * _unitBlocks);
+}
+
+size_t OffloadLbaAlloc::getLbas(uint64_t blocks, size_t cnt,
+                                std::vector<uint64_t> &lbas) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t len = _units(blocks);
+    size_t got = 0;
+    for (; got < cnt; got++) {
+        int64_t start = _alloc(len);
+        if (start < 0)
+            break;
+        uint64_t unit = static_cast<uint64_t>(start);
+        for (uint64_t idx = unit / LBA_WORD_BITS;
+             idx <= (unit + len - 1) / LBA_WORD_BITS; idx++)
+            pmemobj_flush(_pool.get_handle(), &_bitmap->words[idx],
+                          sizeof(uint64_t));
+        lbas.push_back(unit * _unitBlocks);
+    }
+    if (got)
+        pmemobj_drain(_pool.get_handle());
+    return got;
+}
+
+void OffloadLbaAlloc::putLba(uint64_t lba, uint64_t blocks) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t unit = lba / _unitBlocks;
+    uint64_t len = _units(blocks);
+    if (lba % _unitBlocks || unit + len > _unitCount || !_isMarked(unit, len, true)) {
+        DAQ_CRITICAL("Free of invalid extent [" + std::to_string(lba) +
+                     "] blocks [" + std::to_string(blocks) + "]");
+        return;
     }
+
+    _mark(unit, len, false);
+    for (uint64_t idx = unit / LBA_WORD_BITS;
+         idx <= (unit + len - 1) / LBA_WORD_BITS; idx++)
+        _dirty.push_back(idx);
+    _putExtent(unit, len);
+    _freeUnits += len;
+    if (_dirty.size() >= OFFLOAD_LBA_PERSIST_BATCH)
+        _persistDirty();
 }
 
-int64_t OffloadLbaAlloc::getLba(size_t ioSize) {
-    uint32_t bucketNum = ioSize / 4096;
-    if (bucketNum >= _maxBuckets) {
+void OffloadLbaAlloc::persist() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _persistDirty();
+}
+
+uint64_t OffloadLbaAlloc::getFreeUnits() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _freeUnits;
+}
+
+int64_t OffloadLbaAlloc::_alloc(uint64_t len) {
+    if (len > _freeUnits)
+        return -1;
+
+    int64_t start = _take(len);
+    if (start < 0)
+        start = _scan(len);
+    if (start < 0)
         return -1;
+    _mark(static_cast<uint64_t>(start), len, true);
+    _freeUnits -= len;
+    return start;
+}
+
+/*
+ * Exact fit first, then the shortest longer extent is split, long extents
+ * are carved last so the device is filled sequentially. Extents partly
+ * taken by a bitmap scan are replaced by their free parts.
+ */
+int64_t OffloadLbaAlloc::_take(uint64_t len) {
+    uint64_t start;
+    for (uint64_t cls = len; cls < OFFLOAD_LBA_MAX_EXTENT; cls++) {
+        if (_free[cls].empty())
+            continue;
+        start = _free[cls].back();
+        _free[cls].pop_back();
+        if (!_isMarked(start, cls, false)) {
+            _putFreeRuns(start, cls);
+            /* free parts may fit a shorter class already passed */
+            cls = len - 1;
+            continue;
+        }
+        if (cls > len)
+            _putExtent(start + len, cls - len);
+        return static_cast<int64_t>(start);
     }
-    if (!buckets[bucketNum].level) {
-        int64_t ret = getBlock(buckets[bucketNum], bucketNum);
-        if (ret < 0) {
-            return ret;
+
+    for (size_t idx = _large.size(); idx-- > 0;) {
+        Extent &ext = _large[idx];
+        if (ext.len < len)
+            continue;
+        if (!_isMarked(ext.start, len, false)) {
+            Extent stale = ext;
+            ext = _large.back();
+            _large.pop_back();
+            _putFreeRuns(stale.start, stale.len);
+            return _take(len);
+        }
+        start = ext.start;
+        ext.start += len;
+        ext.len -= len;
+        if (ext.len < OFFLOAD_LBA_MAX_EXTENT) {
+            if (ext.len)
+                _free[ext.len].push_back(ext.start);
+            ext = _large.back();
+            _large.pop_back();
         }
+        return static_cast<int64_t>(start);
     }
-    return buckets[bucketNum].get();
+    return -1;
 }
 
-int64_t OffloadLbaAlloc::getBlock(LbaBucket &bucket, size_t ioSize) {
-    int64_t ret = freeLbaList->getBlock(_offloadFreeList, bucket.lbas,
-                                        bucket.lbasSize, ioSize);
-    if (ret < 0) {
-        return ret;
+void OffloadLbaAlloc::_putExtent(uint64_t start, uint64_t len) {
+    if (len < OFFLOAD_LBA_MAX_EXTENT)
+        _free[len].push_back(start);
+    else
+        _large.push_back({start, len});
+}
+
+void OffloadLbaAlloc::_putFreeRuns(uint64_t start, uint64_t len) {
+    uint64_t run = 0;
+    for (uint64_t unit = start; unit < start + len; unit++) {
+        if (_isMarked(unit, 1, false)) {
+            run++;
+            continue;
+        }
+        if (run)
+            _putExtent(unit - run, run);
+        run = 0;
     }
-    bucket.level = static_cast<uint32_t>(ret);
-    return ret;
+    if (run)
+        _putExtent(start + len - run, run);
 }
 
-void OffloadLbaAlloc::putLba(int64_t lba, size_t ioSize) {
-    uint32_t bucketNum = ioSize / 4096;
-    if (bucketNum >= _maxBuckets) {
-        return;
+/*
+ * Looks up a run of free units in the bitmap, starting where the previous
+ * scan stopped. Gives up after OFFLOAD_LBA_SCAN_WORDS words unless a run is
+ * being counted, that one is followed until it ends or is long enough.
+ */
+int64_t OffloadLbaAlloc::_scan(uint64_t len) {
+    uint64_t runStart = 0;
+    uint64_t run = 0;
+    for (uint64_t cnt = 0; cnt < _wordCount; cnt++) {
+        if (cnt >= OFFLOAD_LBA_SCAN_WORDS && !run)
+            break;
+        uint64_t idx = _scanWord;
+        _scanWord = (idx + 1) % _wordCount;
+        /* runs do not wrap around the end of the device */
+        if (!idx)
+            run = 0;
+
+        uint64_t word = _bitmap->words[idx].get_ro();
+        if (word == LBA_WORD_FULL) {
+            run = 0;
+            continue;
+        }
+        for (uint64_t bit = 0; bit < LBA_WORD_BITS; bit++) {
+            if (word & (1ULL << bit)) {
+                run = 0;
+                continue;
+            }
+            if (!run)
+                runStart = idx * LBA_WORD_BITS + bit;
+            if (++run == len) {
+                /* rest of the word may still be free */
+                _scanWord = idx;
+                return static_cast<int64_t>(runStart);
+            }
+        }
     }
-    if (buckets[bucketNum].level >= buckets[bucketNum].lbasSize) {
-        putBlock(buckets[bucketNum], bucketNum);
+    return -1;
+}
+
+void OffloadLbaAlloc::_mark(uint64_t start, uint64_t len, bool used) {
+    uint64_t idx = start / LBA_WORD_BITS;
+    uint64_t bit = start % LBA_WORD_BITS;
+    while (len) {
+        uint64_t cnt = std::min(LBA_WORD_BITS - bit, len);
+        uint64_t mask = (cnt == LBA_WORD_BITS) ? LBA_WORD_FULL
+                                               : ((1ULL << cnt) - 1) << bit;
+        p<uint64_t> &word = _bitmap->words[idx];
+        word = used ? (word.get_ro() | mask) : (word.get_ro() & ~mask);
+        len -= cnt;
+        bit = 0;
+        idx++;
     }
-    buckets[bucketNum].put(lba);
 }
 
-void OffloadLbaAlloc::putBlock(LbaBucket &bucket, size_t ioSize) {
-    freeLbaList->putBlock(_offloadFreeList, bucket.lbas, bucket.lbasSize,
-                          ioSize);
-    bucket.level = 0;
+bool OffloadLbaAlloc::_isMarked(uint64_t start, uint64_t len, bool used) {
+    uint64_t idx = start / LBA_WORD_BITS;
+    uint64_t bit = start % LBA_WORD_BITS;
+    while (len) {
+        uint64_t cnt = std::min(LBA_WORD_BITS - bit, len);
+        uint64_t mask = (cnt == LBA_WORD_BITS) ? LBA_WORD_FULL
+                                               : ((1ULL << cnt) - 1) << bit;
+        if ((_bitmap->words[idx].get_ro() & mask) != (used ? mask : 0))
+            return false;
+        len -= cnt;
+        bit = 0;
+        idx++;
+    }
+    return true;
 }
 
-int64_t OffloadLbaAlloc::LbaBucket::get() {
-    if (!level)
-        return -1;
-    int64_t lba = lbas[level - 1];
-    level--;
-    return lba;
+void OffloadLbaAlloc::_persistWords(uint64_t first, uint64_t last) {
+    pmemobj_persist(_pool.get_handle(), &_bitmap->words[first],
+                    (last - first + 1) * sizeof(uint64_t));
 }
 
-void OffloadLbaAlloc::LbaBucket::put(int64_t lba) {
-    if (level >= lbasSize)
+void OffloadLbaAlloc::_persistDirty() {
+    if (_dirty.empty())
         return;
-    level++;
-    lbas[level] = lba;
-    return;
+    for (auto idx : _dirty)
+        pmemobj_flush(_pool.get_handle(), &_bitmap->words[idx],
+                      sizeof(uint64_t));
+    pmemobj_drain(_pool.get_handle());
+    _dirty.clear();
+}
+
+/*
+ * Collects runs of free units into the free extent lists.
+ */
+void OffloadLbaAlloc::_rebuild() {
+    for (auto &list : _free)
+        list.clear();
+    _large.clear();
+    _freeUnits = 0;
+
+    uint64_t runStart = 0;
+    uint64_t run = 0;
+    for (uint64_t idx = 0; idx < _wordCount; idx++) {
+        uint64_t word = _bitmap->words[idx].get_ro();
+        if (word == LBA_WORD_FULL) {
+            if (run)
+                _putExtent(runStart, run);
+            _freeUnits += run;
+            run = 0;
+            continue;
+        }
+        for (uint64_t bit = 0; bit < LBA_WORD_BITS; bit++) {
+            if (word & (1ULL << bit)) {
+                if (run)
+                    _putExtent(runStart, run);
+                _freeUnits += run;
+                run = 0;
+            } else {
+                if (!run)
+                    runStart = idx * LBA_WORD_BITS + bit;
+                run++;
+            }
+        }
+    }
+    if (run)
+        _putExtent(runStart, run);
+    _freeUnits += run;
 }
 
 } // namespace DaqDB
@@ -16,43 +16,125 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
 namespace DaqDB {
 
+/* free extents of this many units or more are kept in a single list */
+const uint64_t OFFLOAD_LBA_MAX_EXTENT = 64;
+/* number of bitmap words freed before they are flushed together */
+const size_t OFFLOAD_LBA_PERSIST_BATCH = 64;
+/* bitmap words searched per allocation no free extent list could serve */
+const uint64_t OFFLOAD_LBA_SCAN_WORDS = 1024;
+
+/*
+ * Allocates extents of allocation units of a single device. A persistent
+ * bitmap keeps one bit per unit, free extents are cached in DRAM lists
+ * indexed by their length and rebuilt from the bitmap on open.
+ *
+ * Freed extents are not merged with their neighbours. Requests no listed
+ * extent fits are looked up in the bitmap, a bounded number of words per
+ * call, so a fragmented device may fail a request before all of it was
+ * searched. Listed extents overlapping such an allocation are checked
+ * against the bitmap when taken and only their free parts are kept.
+ *
+ * Allocated bits are persisted before the extent is returned, freed bits are
+ * flushed in batches. Frees lost in a crash leave the units allocated, they
+ * are never handed out twice.
+ */
 class OffloadLbaAlloc {
   public:
-    OffloadLbaAlloc(bool create, std::string filename, uint64_t blockCnt,
-                    uint64_t avgBlkPerLba);
-    ~OffloadLbaAlloc() = default;
+    OffloadLbaAlloc(const std::string &filename, uint64_t blockCnt,
+                    uint64_t unitBlocks);
+    ~OffloadLbaAlloc();
 
-    struct LbaBucket {
-        LbaBucket() : level(0) {}
-        ~LbaBucket() = default;
+    /**
+     * @return first block of a free extent covering given number of blocks,
+     * -1 if the device is full
+     */
+    int64_t getLba(uint64_t blocks);
 
-        static const uint32_t lbasSize = 1024;
-        uint32_t sizeBracket;
-        int64_t lbas[lbasSize];
-        uint32_t level;
+    /**
+     * Allocates up to cnt extents of given number of blocks with a single
+     * drain of the bitmap, used to refill per queue caches.
+     *
+     * @return number of extents appended to lbas
+     */
+    size_t getLbas(uint64_t blocks, size_t cnt, std::vector<uint64_t> &lbas);
 
-        int64_t get();
-        void put(int64_t lba);
-    };
+    /**
+     * Frees extent returned by getLba for the same number of blocks.
+     */
+    void putLba(uint64_t lba, uint64_t blocks);
+
+    /**
+     * Flushes bitmap words of batched frees.
+     */
+    void persist();
 
-    int64_t getLba(size_t ioSize);
-    void putLba(int64_t lba, size_t ioSize);
+    /**
+     * @return number of blocks covered by extent allocated for given blocks
+     */
+    uint64_t getExtentBlocks(uint64_t blocks) const {
+        return _units(blocks) * _unitBlocks;
+    }
 
-  protected:
-    int64_t getBlock(LbaBucket &bucket, size_t ioSize);
-    void putBlock(LbaBucket &bucket, size_t ioSize);
+    uint64_t getUnitBlocks() const { return _unitBlocks; }
+    uint64_t getUnitCount() const { return _unitCount; }
+    uint64_t getFreeUnits();
 
   private:
-    static const uint32_t _maxBuckets = 8;
-    LbaBucket buckets[_maxBuckets];
-
-    const char *poolLayout = "queue";
-    const unsigned int poolFreelistSize = 1ULL * 1024 * 1024 * 1024;
-    const int pollMode = (S_IWUSR | S_IRUSR);
-    pool<DaqDB::OffloadFreeList> _offloadFreeList;
-    OffloadFreeList *freeLbaList = nullptr;
+    struct Bitmap {
+        pmem::obj::p<uint64_t> unitCount;
+        pmem::obj::p<uint64_t> unitBlocks;
+        pmem::obj::persistent_ptr<pmem::obj::p<uint64_t>[]> words;
+    };
+
+    struct Extent {
+        uint64_t start;
+        uint64_t len;
+    };
+
+    uint64_t _units(uint64_t blocks) const {
+        uint64_t units = (blocks + _unitBlocks - 1) / _unitBlocks;
+        return units ? units : 1;
+    }
+
+    int64_t _alloc(uint64_t len);
+    int64_t _take(uint64_t len);
+    void _putExtent(uint64_t start, uint64_t len);
+    void _putFreeRuns(uint64_t start, uint64_t len);
+    int64_t _scan(uint64_t len);
+    void _mark(uint64_t start, uint64_t len, bool used);
+    bool _isMarked(uint64_t start, uint64_t len, bool used);
+    void _persistWords(uint64_t first, uint64_t last);
+    void _persistDirty();
+    void _rebuild();
+
+    pmem::obj::pool<Bitmap> _pool;
+    Bitmap *_bitmap = nullptr;
+    uint64_t _unitBlocks;
+    uint64_t _unitCount;
+    uint64_t _wordCount;
+    uint64_t _freeUnits = 0;
+    /* bitmap word the next scan starts at */
+    uint64_t _scanWord = 0;
+
+    std::vector<uint64_t> _free[OFFLOAD_LBA_MAX_EXTENT];
+    std::vector<Extent> _large;
+    std::vector<uint64_t> _dirty;
+    std::mutex _mutex;
+
+    const char *_poolLayout = "lba_bitmap";
 };
 
 } // namespace DaqDB
@@ -17,13 +17,13 @@
 #include <stdio.h>
 #include <time.h>
 
+#include <algorithm>
 #include <iostream>
 #include <pthread.h>
 
 #include <thread>
 
 #include <boost/asio.hpp>
-#include <boost/filesystem.hpp>
 
 #include "spdk/stdinc.h"
 #include "spdk/cpuset.h"
@@ -41,41 +41,86 @@
 #include <daqdb/Status.h>
 
 
-#define POOL_FREELIST_SIZE 1ULL * 1024 * 1024 * 1024
-#define LAYOUT "queue"
-#define CREATE_MODE_RW (S_IWUSR | S_IRUSR)
-
 namespace DaqDB {
 
-const char *OffloadPoller::pmemFreeListFilename = "/mnt/pmem/offload_free.pm";
-
-OffloadPoller::OffloadPoller(RTreeEngine *rtree, SpdkCore *_spdkCore)
-    : Poller<OffloadRqst>(false), rtree(rtree), spdkCore(_spdkCore) {}
+OffloadPoller::OffloadPoller(RTreeEngine *rtree, SpdkCore *_spdkCore,
+                             unsigned int queue, size_t cpuCore)
+    : Poller<OffloadRqst>(false), rtree(rtree), spdkCore(_spdkCore),
+      _queue(queue), _cpuCore(cpuCore) {}
 
 OffloadPoller::~OffloadPoller() {
     isRunning = 0;
+    if (_thread != nullptr) {
+        _thread->join();
+        delete _thread;
+    }
+    if (_compactor)
+        delete _compactor;
+    if (_segWriter)
+        delete _segWriter;
+    for (auto rqst : _prefetches)
+        OffloadRqst::getPool.put(rqst);
 }
 
-void OffloadPoller::initFreeList() {
-    auto initNeeded = false;
-    if (getBdevCtx()) {
-        if (boost::filesystem::exists(OffloadPoller::pmemFreeListFilename)) {
-            _offloadFreeList =
-                pool<OffloadFreeList>::open(OffloadPoller::pmemFreeListFilename, LAYOUT);
-        } else {
-            _offloadFreeList = pool<OffloadFreeList>::create(
-                    OffloadPoller::pmemFreeListFilename, LAYOUT, POOL_FREELIST_SIZE,
-                CREATE_MODE_RW);
-            initNeeded = true;
-        }
-        freeLbaList = _offloadFreeList.get_root().get();
-        freeLbaList->maxLba = getBdevCtx()->blk_num / getBdev()->blkNumForLba;
-        if (initNeeded) {
-            freeLbaList->push(_offloadFreeList, -1);
-        }
+void OffloadPoller::startThread() {
+    _thread = new std::thread(&OffloadPoller::_threadMain, this);
+    if (!_cpuCore)
+        return;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(_cpuCore, &cpuset);
+    const int set_result = pthread_setaffinity_np(
+        _thread->native_handle(), sizeof(cpu_set_t), &cpuset);
+    if (set_result == 0) {
+        DAQ_DEBUG("Started OffloadPoller [" + std::to_string(_queue) +
+                  "] on CPU core [" + std::to_string(_cpuCore) + "]");
+    } else {
+        DAQ_DEBUG("Cannot set affinity on CPU core [" +
+                  std::to_string(_cpuCore) + "] for OffloadPoller");
     }
 }
 
+void OffloadPoller::_threadMain() {
+    std::string threadName = "offload" + std::to_string(_queue);
+    pthread_setname_np(pthread_self(), threadName.c_str());
+    while (isRunning) {
+        dequeue();
+        process();
+    }
+}
+
+size_t OffloadPoller::queueOf(const char *key, size_t keySize,
+                              size_t queues) {
+    if (queues < 2)
+        return 0;
+    /* FNV-1a */
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t idx = 0; idx < keySize; idx++) {
+        hash ^= static_cast<unsigned char>(key[idx]);
+        hash *= 1099511628211ULL;
+    }
+    return hash % queues;
+}
+
+/*
+ * Free extents are tracked by the device allocator, pollers only set up
+ * their log segment writer.
+ */
+void OffloadPoller::initFreeList() {
+    if (!getBdevCtx() || !getBdev()->segmentBlocks)
+        return;
+    auto blkSize = getBdevCtx()->blk_size;
+    _segWriter = new OffloadSegmentWriter(getBdev()->segmentBlocks * blkSize,
+                                          blkSize, getBdevCtx()->buf_align);
+    /* single compactor, victims are shared by all queues */
+    const OffloadOptions &options = spdkCore->offloadOptions;
+    if (!_queue && options.gcRate && options.gcLivePercent)
+        _compactor = new OffloadCompactor(rtree, getBdev(), _segWriter,
+                                          options.gcLivePercent,
+                                          options.gcRate);
+}
+
 StatusCode OffloadPoller::_getValCtx(const OffloadRqst *rqst,
                                      ValCtx &valCtx) const {
     try {
@@ -91,7 +136,14 @@ StatusCode OffloadPoller::_getValCtx(const OffloadRqst *rqst,
 void OffloadPoller::_processGet(OffloadRqst *rqst) {
     ValCtx valCtx;
 
-    auto rc = _getValCtx(rqst, valCtx);
+    auto rc = StatusCode::OK;
+    if (rqst->located) {
+        valCtx.location = LOCATIONS::DISK;
+        valCtx.size = rqst->valueSize;
+        valCtx.val = rqst->devAddrBuf;
+    } else {
+        rc = _getValCtx(rqst, valCtx);
+    }
     if (rc != StatusCode::OK) {
         _rqstClb(rqst, rc);
         OffloadRqst::getPool.put(rqst);
@@ -104,6 +156,12 @@ void OffloadPoller::_processGet(OffloadRqst *rqst) {
         return;
     }
 
+    const DeviceAddr *addr = static_cast<DeviceAddr *>(valCtx.val);
+    if (readCache && _readCached(rqst, *addr)) {
+        OffloadRqst::getPool.put(rqst);
+        return;
+    }
+
     SpdkDevice *spdkDev = getBdev();
 
     rqst->valueSize = valCtx.size;
@@ -120,6 +178,7 @@ void OffloadPoller::_processGet(OffloadRqst *rqst) {
                                           rqst,
                                           OffloadOperation::GET};
     memcpy(ioTask->key, rqst->key, rqst->keySize);
+    ioTask->queue = _queue;
 
     if (spdkDev->read(ioTask) != true) {
         _rqstClb(rqst, StatusCode::UNKNOWN_ERROR);
@@ -127,6 +186,103 @@ void OffloadPoller::_processGet(OffloadRqst *rqst) {
     }
 }
 
+/*
+ * Serves value from the read cache or joins a pending read of the same
+ * address. On a miss the request reads the value, its callback caches it and
+ * passes it to the joined requests.
+ */
+bool OffloadPoller::_readCached(OffloadRqst *rqst, const DeviceAddr &addr) {
+    OffloadReadCache::Waiter waiter;
+    if (!rqst->prefetch)
+        waiter = _cacheWaiter(rqst);
+
+    OffloadReadCache::Buffer buf;
+    OffloadReadCache::ReadHandle read;
+    switch (readCache->lookup(addr, buf, waiter, read)) {
+    case OffloadReadCache::Lookup::HIT:
+        if (waiter)
+            waiter(StatusCode::OK, buf);
+        return true;
+    case OffloadReadCache::Lookup::JOINED:
+        return true;
+    default:
+        break;
+    }
+
+    OffloadReadCache *cache = readCache;
+    KVStoreBase::KVStoreBaseCallback clb;
+    if (!rqst->prefetch)
+        clb = rqst->clb;
+    rqst->clb = [cache, read, clb](KVStoreBase *kvs, Status status,
+                                   const char *key, size_t keySize,
+                                   const char *value, size_t valueSize) {
+        cache->complete(read, status.getStatusCode(), value, valueSize);
+        if (clb)
+            clb(kvs, status, key, keySize, value, valueSize);
+    };
+    return false;
+}
+
+/*
+ * Passes cached value to the request callback, a hand over request gets a
+ * DMA buffer as if the value was read from the device.
+ */
+OffloadReadCache::Waiter OffloadPoller::_cacheWaiter(const OffloadRqst *rqst) {
+    if (!rqst->clb)
+        return nullptr;
+
+    KVStoreBase::KVStoreBaseCallback clb = rqst->clb;
+    std::string key(rqst->key, rqst->keySize);
+    bool handOver = rqst->handOver;
+    size_t align = getBdevCtx()->buf_align;
+    return [clb, key, handOver, align](StatusCode status,
+                                       const OffloadReadCache::Buffer &buf) {
+        if (!buf) {
+            clb(nullptr, status, key.data(), key.size(), nullptr, 0);
+            return;
+        }
+        const char *value = buf->data();
+        if (handOver) {
+            char *dmaBuf = reinterpret_cast<char *>(
+                spdk_dma_malloc(buf->size() ? buf->size() : 1, align, NULL));
+            if (!dmaBuf) {
+                clb(nullptr, StatusCode::UNKNOWN_ERROR, key.data(), key.size(),
+                    nullptr, 0);
+                return;
+            }
+            memcpy(dmaBuf, buf->data(), buf->size());
+            value = dmaBuf;
+        }
+        clb(nullptr, StatusCode::OK, key.data(), key.size(), value,
+            buf->size());
+    };
+}
+
+bool OffloadPoller::enqueuePrefetch(OffloadRqst *rqst) {
+    std::lock_guard<std::mutex> lock(_prefetchMutex);
+    if (_prefetches.size() >= OFFLOAD_PREFETCH_DEPTH)
+        return false;
+    _prefetches.push_back(rqst);
+    return true;
+}
+
+void OffloadPoller::_processPrefetches() {
+    SpdkDevice *spdkDev = getBdev();
+    for (size_t cnt = 0; cnt < OFFLOAD_PREFETCH_BATCH; cnt++) {
+        if (spdkDev->canQueue() <= OFFLOAD_PREFETCH_BATCH)
+            return;
+        OffloadRqst *rqst;
+        {
+            std::lock_guard<std::mutex> lock(_prefetchMutex);
+            if (_prefetches.empty())
+                return;
+            rqst = _prefetches.front();
+            _prefetches.pop_front();
+        }
+        _processGet(rqst);
+    }
+}
+
 void OffloadPoller::_processUpdate(OffloadRqst *rqst) {
     DeviceTask *ioTask = nullptr;
 
@@ -135,6 +291,21 @@ void OffloadPoller::_processUpdate(OffloadRqst *rqst) {
         return;
     }
 
+    if (_segWriter && rqst->loc == LOCATIONS::PMEM) {
+        if (!_segWriter->fits(rqst)) {
+            _rqstClb(rqst, StatusCode::UNKNOWN_ERROR);
+            OffloadRqst::updatePool.put(rqst);
+        } else if (!_segmentBacklog.empty() || !_segWriter->append(rqst)) {
+            _segmentBacklog.push_back(rqst);
+        }
+        return;
+    } else if (_segWriter && rqst->loc == LOCATIONS::DISK) {
+        /* value already lives in a log segment */
+        _rqstClb(rqst, StatusCode::OK);
+        OffloadRqst::updatePool.put(rqst);
+        return;
+    }
+
     SpdkDevice *spdkDev = getBdev();
     auto valSizeAlign = spdkDev->getAlignedSize(rqst->valueSize);
     if (rqst->loc == LOCATIONS::PMEM) {
@@ -178,6 +349,7 @@ void OffloadPoller::_processUpdate(OffloadRqst *rqst) {
         return;
     }
 
+    ioTask->queue = _queue;
     if (spdkDev->write(ioTask) != true) {
         _rqstClb(rqst, StatusCode::UNKNOWN_ERROR);
         OffloadRqst::updatePool.put(rqst);
@@ -205,12 +377,10 @@ void OffloadPoller::_processRemove(OffloadRqst *rqst) {
         return;
     }
 
-    uint64_t lba = *(static_cast<uint64_t *>(valCtx.val));
-
     SpdkDevice *spdkDev = getBdev();
     DeviceTask *ioTask = new (rqst->taskBuffer)
         DeviceTask{0,
-                   spdkDev->getOptimalSize(rqst->valueSize),
+                   spdkDev->getOptimalSize(valCtx.size),
                    0,
                    rqst->keySize,
                    static_cast<DeviceAddr *>(valCtx.val),
@@ -220,6 +390,7 @@ void OffloadPoller::_processRemove(OffloadRqst *rqst) {
                    spdkDev,
                    rqst,
                    OffloadOperation::REMOVE};
+    ioTask->queue = _queue;
 
     if (spdkDev->remove(ioTask) != true) {
         _rqstClb(rqst, StatusCode::UNKNOWN_ERROR);
@@ -227,10 +398,65 @@ void OffloadPoller::_processRemove(OffloadRqst *rqst) {
     }
 }
 
+/*
+ * Packs updates waiting for a free segment and values relocated by the
+ * compactor, seals the open segment once its oldest value waits longer than
+ * flush interval and submits sealed segments.
+ */
+void OffloadPoller::_processSegments() {
+    while (!_segmentBacklog.empty() &&
+           _segWriter->append(_segmentBacklog.front()))
+        _segmentBacklog.pop_front();
+
+    uint64_t now = LatencyTracer::now();
+    if (_compactor)
+        _compactor->process(now, _segmentBacklog.empty());
+    _segWriter->tick(now);
+
+    SpdkDevice *spdkDev = getBdev();
+    OffloadSegment *seg;
+    while ((seg = _segWriter->sealed()) != nullptr) {
+        _segWriter->popSealed();
+        LatencyTracer::getInstance().stamp(seg->trace, TRACE_POLLER);
+        seg->task = DeviceTask{0,
+                               _segWriter->getWriteSize(seg),
+                               _segWriter->getWriteBlocks(seg),
+                               0,
+                               nullptr,
+                               true,
+                               rtree,
+                               nullptr,
+                               spdkDev,
+                               nullptr,
+                               OffloadOperation::UPDATE};
+        seg->task.segment = seg;
+        seg->task.queue = _queue;
+        if (spdkDev->write(&seg->task) != true)
+            _segWriter->fail(seg, StatusCode::UNKNOWN_ERROR);
+    }
+}
+
+/*
+ * Requests are left in the ring while the segment backlog is full, so
+ * producers run out of queue credits instead of growing the backlog.
+ */
+void OffloadPoller::dequeue(uint32_t cnt) {
+    if (_segmentBacklog.size() >= OFFLOAD_SEGMENT_BACKLOG_LIMIT) {
+        requestCount = 0;
+        return;
+    }
+    Poller<OffloadRqst>::dequeue(std::min<size_t>(
+        cnt, OFFLOAD_SEGMENT_BACKLOG_LIMIT - _segmentBacklog.size()));
+}
+
 void OffloadPoller::process() {
+    /* prefetches wait for an iteration with no other requests */
+    if (!requestCount && readCache)
+        _processPrefetches();
     if (requestCount > 0) {
         for (unsigned short RqstIdx = 0; RqstIdx < requestCount; RqstIdx++) {
             OffloadRqst *rqst = requests[RqstIdx];
+            LatencyTracer::getInstance().stamp(rqst->trace, TRACE_POLLER);
             switch (rqst->op) {
             case OffloadOperation::GET:
                 _processGet(rqst);
@@ -249,10 +475,10 @@ void OffloadPoller::process() {
         }
         requestCount = 0;
     }
-}
-
-int64_t OffloadPoller::getFreeLba() {
-    return freeLbaList->get(_offloadFreeList);
+    if (_segWriter)
+        _processSegments();
+    if (tiering)
+        tiering->process(LatencyTracer::now());
 }
 
 } // namespace DaqDB
@@ -25,13 +25,17 @@
 #include <mutex>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 
 #include "spdk/bdev.h"
 #include "spdk/env.h"
 #include "spdk/io_channel.h"
 #include "spdk/queue.h"
 
-#include "OffloadFreeList.h"
+#include "OffloadCompactor.h"
+#include "OffloadReadCache.h"
+#include "OffloadSegment.h"
+#include "OffloadTiering.h"
 #include <Poller.h>
 #include <RTreeEngine.h>
 #include <Rqst.h>
@@ -41,16 +45,47 @@
 
 namespace DaqDB {
 
+/* prefetch hints queued per poller, further ones are dropped */
+const size_t OFFLOAD_PREFETCH_DEPTH = 1024;
+/* prefetch reads submitted per idle poller iteration */
+const size_t OFFLOAD_PREFETCH_BATCH = 8;
+/* updates waiting for a free log segment before requests stay queued */
+const size_t OFFLOAD_SEGMENT_BACKLOG_LIMIT = DEQUEUE_RING_LIMIT;
+
+/*
+ * Offload requests are spread over offload pollers by key, each poller
+ * submits to its own device IO queue. The first poller runs in SPDK app
+ * thread, others in their own threads started with startThread().
+ */
 class OffloadPoller : public Poller<OffloadRqst> {
   public:
-    OffloadPoller(RTreeEngine *rtree, SpdkCore *_spdkCore);
+    OffloadPoller(RTreeEngine *rtree, SpdkCore *_spdkCore,
+                  unsigned int queue = 0, size_t cpuCore = 0);
     virtual ~OffloadPoller();
 
+    void dequeue(uint32_t cnt = DEQUEUE_RING_LIMIT) final;
     void process() final;
-    virtual int64_t getFreeLba();
+    void startThread() final;
+
+    /**
+     * All requests of a key are handled by the same poller, so they are
+     * processed in submission order.
+     *
+     * @return index of the poller for given key
+     */
+    static size_t queueOf(const char *key, size_t keySize, size_t queues);
 
     void initFreeList();
 
+    /**
+     * Queues read of a value into the read cache. Prefetches are submitted
+     * only when the poller got no other requests and the device has spare
+     * queue depth.
+     *
+     * @return false if too many prefetches are queued
+     */
+    bool enqueuePrefetch(OffloadRqst *rqst);
+
     virtual SpdkDevice *getBdev() { return spdkCore->spBdev; }
     virtual SpdkBdevCtx *getBdevCtx() { return spdkCore->spBdev->getBdevCtx(); }
     virtual spdk_bdev_desc *getBdevDesc() {
@@ -63,7 +98,9 @@ class OffloadPoller : public Poller<OffloadRqst> {
     RTreeEngine *rtree;
     SpdkCore *spdkCore;
 
-    OffloadFreeList *freeLbaList = nullptr;
+    OffloadReadCache *readCache = nullptr;
+    /* set for the poller moving values out of PMEM */
+    OffloadTiering *tiering = nullptr;
 
     std::atomic<int> isRunning;
 
@@ -74,10 +111,15 @@ class OffloadPoller : public Poller<OffloadRqst> {
     virtual bool isOffloadRunning() { return isRunning; }
 
   private:
+    void _threadMain(void);
 
     void _processGet(OffloadRqst *rqst);
     void _processUpdate(OffloadRqst *rqst);
     void _processRemove(OffloadRqst *rqst);
+    void _processSegments();
+    void _processPrefetches();
+    bool _readCached(OffloadRqst *rqst, const DeviceAddr &addr);
+    OffloadReadCache::Waiter _cacheWaiter(const OffloadRqst *rqst);
 
     StatusCode _getValCtx(const OffloadRqst *rqst, ValCtx &valCtx) const;
 
@@ -86,9 +128,18 @@ class OffloadPoller : public Poller<OffloadRqst> {
             rqst->clb(nullptr, status, rqst->key, rqst->keySize, nullptr, 0);
     }
 
-    pool<DaqDB::OffloadFreeList> _offloadFreeList;
+    /* values are packed into log segments if set */
+    OffloadSegmentWriter *_segWriter = nullptr;
+    /* updates waiting for a free log segment */
+    std::deque<OffloadRqst *> _segmentBacklog;
+    OffloadCompactor *_compactor = nullptr;
+
+    std::deque<OffloadRqst *> _prefetches;
+    std::mutex _prefetchMutex;
 
-    const static char *pmemFreeListFilename;
+    unsigned int _queue;
+    size_t _cpuCore;
+    std::thread *_thread = nullptr;
 };
 
 } // namespace DaqDB
@@ -0,0 +1,222 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OffloadReadCache.h"
+
+namespace DaqDB {
+
+OffloadReadCache::OffloadReadCache(size_t capacity, size_t shards)
+    : _shardCapacity(capacity / (shards ? shards : 1)),
+      _shardCnt(shards ? shards : 1), _shards(new Shard[_shardCnt]) {}
+
+OffloadReadCache::Shard &OffloadReadCache::_shardOf(const CacheKey &key) {
+    uint64_t hash = key.dev ^ key.lba * 0x9e3779b97f4a7c15ULL ^
+                    key.seg * 0xc2b2ae3d27d4eb4fULL;
+    return _shards[(hash ^ (hash >> 32)) % _shardCnt];
+}
+
+OffloadReadCache::Buffer OffloadReadCache::get(const DeviceAddr &addr) {
+    CacheKey key = _key(addr);
+    Shard &shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end())
+        return nullptr;
+    it->second.referenced = true;
+    return it->second.buf;
+}
+
+OffloadReadCache::Lookup OffloadReadCache::lookup(const DeviceAddr &addr,
+                                                  Buffer &buf,
+                                                  const Waiter &waiter,
+                                                  ReadHandle &read) {
+    CacheKey key = _key(addr);
+    Shard &shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        it->second.referenced = true;
+        buf = it->second.buf;
+        if (waiter)
+            _hits++;
+        return Lookup::HIT;
+    }
+
+    auto pending = shard.pending.find(key);
+    if (pending != shard.pending.end()) {
+        if (waiter) {
+            pending->second->waiters.push_back(waiter);
+            _coalesced++;
+        }
+        return Lookup::JOINED;
+    }
+
+    if (waiter)
+        _misses++;
+    read = std::make_shared<PendingRead>();
+    read->key = key;
+    shard.pending[key] = read;
+    return Lookup::MISS;
+}
+
+/*
+ * Invalidation drops pending reads of the extent, a read no longer pending
+ * may have read a freed extent.
+ */
+void OffloadReadCache::complete(const ReadHandle &read, StatusCode status,
+                                const char *value, size_t size) {
+    Buffer buf;
+    if (status == StatusCode::OK)
+        buf = std::make_shared<const std::vector<char>>(value, value + size);
+
+    std::vector<Waiter> waiters;
+    Shard &shard = _shardOf(read->key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.pending.find(read->key);
+        bool valid = it != shard.pending.end() && it->second == read;
+        if (valid)
+            shard.pending.erase(it);
+        waiters.swap(read->waiters);
+        if (buf && valid)
+            _insert(shard, read->key, buf);
+    }
+    for (auto &waiter : waiters)
+        waiter(status, buf);
+}
+
+bool OffloadReadCache::put(const DeviceAddr &addr, uint64_t gen,
+                           const char *value, size_t size) {
+    if (size > _shardCapacity)
+        return false;
+    Buffer buf = std::make_shared<const std::vector<char>>(value, value + size);
+
+    CacheKey key = _key(addr);
+    Shard &shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    /* checked under the shard lock, later invalidation drops the entry */
+    if (_freedSince(key, gen))
+        return false;
+    return _insert(shard, key, buf);
+}
+
+bool OffloadReadCache::_freedSince(const CacheKey &key, uint64_t gen) {
+    std::lock_guard<std::mutex> lock(_freedMutex);
+    if (_gen == gen)
+        return false;
+    /* extents freed right after gen are not remembered anymore */
+    if (_freed.empty() || _freed.front().gen > gen + 1)
+        return true;
+    for (auto it = _freed.rbegin(); it != _freed.rend() && it->gen > gen;
+         ++it) {
+        if (it->dev == key.dev && key.lba >= it->lba &&
+            key.lba < it->lba + it->blocks)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * New entry goes right behind the hand, so it is the last one examined by
+ * the next eviction round.
+ */
+bool OffloadReadCache::_insert(Shard &shard, const CacheKey &key,
+                               const Buffer &buf) {
+    if (buf->size() > _shardCapacity)
+        return false;
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end())
+        _erase(shard, it);
+
+    while (shard.size + buf->size() > _shardCapacity)
+        _evict(shard);
+    RingPos pos = shard.ring.insert(shard.hand, key);
+    shard.entries[key] = {buf, pos, false};
+    shard.size += buf->size();
+    return true;
+}
+
+void OffloadReadCache::_evict(Shard &shard) {
+    for (;;) {
+        if (shard.hand == shard.ring.end())
+            shard.hand = shard.ring.begin();
+        auto it = shard.entries.find(*shard.hand);
+        if (!it->second.referenced) {
+            _erase(shard, it);
+            _evictions++;
+            return;
+        }
+        it->second.referenced = false;
+        ++shard.hand;
+    }
+}
+
+void OffloadReadCache::_erase(Shard &shard, EntryPos it) {
+    if (shard.hand == it->second.pos)
+        shard.hand = shard.ring.erase(it->second.pos);
+    else
+        shard.ring.erase(it->second.pos);
+    shard.size -= it->second.buf->size();
+    shard.entries.erase(it);
+}
+
+/*
+ * Values are spread over all shards, every shard drops its own entries of
+ * the extent.
+ */
+void OffloadReadCache::invalidate(const PciAddr &dev, uint64_t lba,
+                                  uint64_t blocks) {
+    uint64_t devKey = _devKey(dev);
+    {
+        std::lock_guard<std::mutex> lock(_freedMutex);
+        _freed.push_back({devKey, lba, blocks, ++_gen});
+        if (_freed.size() > OFFLOAD_READ_CACHE_FREED)
+            _freed.pop_front();
+    }
+    for (size_t idx = 0; idx < _shardCnt; idx++) {
+        Shard &shard = _shards[idx];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.lower_bound({devKey, lba, 0});
+        while (it != shard.entries.end() && it->first.dev == devKey &&
+               it->first.lba < lba + blocks)
+            _erase(shard, it++);
+        auto pending = shard.pending.lower_bound({devKey, lba, 0});
+        while (pending != shard.pending.end() &&
+               pending->first.dev == devKey &&
+               pending->first.lba < lba + blocks)
+            shard.pending.erase(pending++);
+    }
+}
+
+size_t OffloadReadCache::getSize() {
+    size_t size = 0;
+    for (size_t idx = 0; idx < _shardCnt; idx++) {
+        std::lock_guard<std::mutex> lock(_shards[idx].mutex);
+        size += _shards[idx].size;
+    }
+    return size;
+}
+
+size_t OffloadReadCache::getCount() {
+    size_t cnt = 0;
+    for (size_t idx = 0; idx < _shardCnt; idx++) {
+        std::lock_guard<std::mutex> lock(_shards[idx].mutex);
+        cnt += _shards[idx].entries.size();
+    }
+    return cnt;
+}
+
+} // namespace DaqDB
@@ -0,0 +1,190 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <RTreeEngine.h>
+#include <daqdb/Status.h>
+
+namespace DaqDB {
+
+/* read cache is split into shards with their own locks */
+const size_t OFFLOAD_READ_CACHE_SHARDS = 16;
+/* freed extents remembered to check values read before they were freed */
+const size_t OFFLOAD_READ_CACHE_FREED = 64;
+
+/*
+ * DRAM copies of offloaded values keyed by their device address. Entries of
+ * a device extent are dropped once the extent is freed, so a value written
+ * later to the same address is never served from a stale copy.
+ *
+ * Each shard evicts with CLOCK: entries get a second chance if they were hit
+ * since the hand passed them last, new entries start unreferenced so values
+ * read only once are evicted first. Concurrent misses of the same address
+ * wait for the read of the first one.
+ */
+class OffloadReadCache {
+  public:
+    typedef std::shared_ptr<const std::vector<char>> Buffer;
+    /* gets value of a coalesced read, nullptr if the read failed */
+    typedef std::function<void(StatusCode status, const Buffer &buf)> Waiter;
+    struct PendingRead;
+    typedef std::shared_ptr<PendingRead> ReadHandle;
+
+    enum class Lookup : std::uint8_t { HIT, JOINED, MISS };
+
+    explicit OffloadReadCache(size_t capacity,
+                              size_t shards = OFFLOAD_READ_CACHE_SHARDS);
+
+    /**
+     * @return copy of the value, nullptr if not cached
+     */
+    Buffer get(const DeviceAddr &addr);
+
+    /**
+     * Looks value up, on a miss the caller becomes owner of the read unless
+     * the address is already being read. Lookups without a waiter are hints,
+     * they do not join pending reads and are not counted in statistics.
+     *
+     * @param buf cached value on HIT
+     * @param waiter called once a pending read completes on JOINED
+     * @param read read to complete on MISS
+     */
+    Lookup lookup(const DeviceAddr &addr, Buffer &buf, const Waiter &waiter,
+                  ReadHandle &read);
+
+    /**
+     * Caches value of a read got on MISS and passes it to the joined
+     * waiters. Value is not cached if its extent was invalidated since the
+     * lookup.
+     */
+    void complete(const ReadHandle &read, StatusCode status,
+                  const char *value, size_t size);
+
+    /**
+     * Generation changes on every invalidation, reads started before it may
+     * have read a freed extent.
+     */
+    uint64_t generation() { return _gen; }
+
+    /**
+     * Caches value read at given address unless its extent was invalidated
+     * since gen was taken. Once more extents than OFFLOAD_READ_CACHE_FREED
+     * were freed since then, the value is not cached either.
+     *
+     * @return true if the value was cached
+     */
+    bool put(const DeviceAddr &addr, uint64_t gen, const char *value,
+             size_t size);
+
+    /**
+     * Drops entries of values inside given extent of a device. Reads pending
+     * inside the extent are not joined anymore.
+     */
+    void invalidate(const PciAddr &dev, uint64_t lba, uint64_t blocks);
+
+    size_t getSize();
+    size_t getCount();
+
+    uint64_t getHits() const { return _hits; }
+    uint64_t getMisses() const { return _misses; }
+    uint64_t getCoalesced() const { return _coalesced; }
+    uint64_t getEvictions() const { return _evictions; }
+
+  private:
+    struct CacheKey {
+        uint64_t dev;
+        uint64_t lba;
+        uint64_t seg;
+        bool operator<(const CacheKey &r) const {
+            if (dev != r.dev)
+                return dev < r.dev;
+            if (lba != r.lba)
+                return lba < r.lba;
+            return seg < r.seg;
+        }
+    };
+    typedef std::list<CacheKey>::iterator RingPos;
+    struct Entry {
+        Buffer buf;
+        RingPos pos;
+        bool referenced;
+    };
+    typedef std::map<CacheKey, Entry>::iterator EntryPos;
+    struct Shard {
+        std::mutex mutex;
+        std::map<CacheKey, Entry> entries;
+        std::map<CacheKey, ReadHandle> pending;
+        /* CLOCK ring, hand points at the next eviction candidate */
+        std::list<CacheKey> ring;
+        RingPos hand = ring.end();
+        size_t size = 0;
+    };
+
+    struct FreedExtent {
+        uint64_t dev;
+        uint64_t lba;
+        uint64_t blocks;
+        uint64_t gen;
+    };
+
+  public:
+    struct PendingRead {
+        CacheKey key;
+        std::vector<Waiter> waiters;
+    };
+
+  private:
+    static uint64_t _devKey(const PciAddr &dev) {
+        return (static_cast<uint64_t>(dev.domain) << 24) |
+               (static_cast<uint64_t>(dev.bus) << 16) |
+               (static_cast<uint64_t>(dev.dev) << 8) | dev.func;
+    }
+    static CacheKey _key(const DeviceAddr &addr) {
+        return {_devKey(addr.busAddr.pciAddr), addr.lba,
+                addr.segAddr.segAddr};
+    }
+    Shard &_shardOf(const CacheKey &key);
+    bool _freedSince(const CacheKey &key, uint64_t gen);
+    bool _insert(Shard &shard, const CacheKey &key, const Buffer &buf);
+    void _evict(Shard &shard);
+    void _erase(Shard &shard, EntryPos it);
+
+    size_t _shardCapacity;
+    size_t _shardCnt;
+    std::unique_ptr<Shard[]> _shards;
+    std::atomic<uint64_t> _gen{0};
+    std::mutex _freedMutex;
+    /* last invalidated extents, oldest first */
+    std::deque<FreedExtent> _freed;
+
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+    std::atomic<uint64_t> _coalesced{0};
+    std::atomic<uint64_t> _evictions{0};
+};
+
+} // namespace DaqDB
@@ -0,0 +1,48 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "OffloadReadMerge.h"
+
+namespace DaqDB {
+
+void mergeReadExtents(std::vector<OffloadReadExtent> &extents,
+                      uint64_t maxBlocks,
+                      std::vector<OffloadReadRange> &ranges) {
+    ranges.clear();
+    std::stable_sort(extents.begin(), extents.end(),
+                     [](const OffloadReadExtent &a,
+                        const OffloadReadExtent &b) { return a.lba < b.lba; });
+
+    for (size_t idx = 0; idx < extents.size(); idx++) {
+        const OffloadReadExtent &extent = extents[idx];
+        if (!ranges.empty()) {
+            OffloadReadRange &range = ranges.back();
+            uint64_t end = std::max(range.lba + range.blocks,
+                                    extent.lba + extent.blocks);
+            if (extent.lba <= range.lba + range.blocks &&
+                end - range.lba <= maxBlocks) {
+                range.blocks = end - range.lba;
+                range.cnt++;
+                continue;
+            }
+        }
+        ranges.push_back({extent.lba, extent.blocks, idx, 1});
+    }
+}
+
+} // namespace DaqDB
@@ -0,0 +1,47 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DaqDB {
+
+struct OffloadReadExtent {
+    uint64_t lba;
+    uint64_t blocks;
+    size_t idx; // position of the read in the caller's batch
+};
+
+struct OffloadReadRange {
+    uint64_t lba;
+    uint64_t blocks;
+    size_t first; // first extent of the range in the sorted extents
+    size_t cnt;
+};
+
+/**
+ * Sorts extents of a read batch by LBA and groups adjacent or overlapping
+ * ones into ranges read with a single IO. A range never grows above
+ * maxBlocks, longer extents get a range of their own.
+ */
+void mergeReadExtents(std::vector<OffloadReadExtent> &extents,
+                      uint64_t maxBlocks,
+                      std::vector<OffloadReadRange> &ranges);
+
+} // namespace DaqDB
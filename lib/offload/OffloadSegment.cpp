@@ -0,0 +1,159 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+
+#include "spdk/env.h"
+
+#include "OffloadSegment.h"
+
+namespace DaqDB {
+
+OffloadSegmentWriter::OffloadSegmentWriter(size_t segmentSize,
+                                           uint32_t blockSize,
+                                           uint32_t bufAlign,
+                                           size_t segmentCnt)
+    : _segmentSize((segmentSize + blockSize - 1) / blockSize * blockSize),
+      _blockSize(blockSize), _bufAlign(bufAlign),
+      _free(segmentCnt, RingType::MP_SC) {
+    for (size_t i = 0; i < segmentCnt; i++) {
+        OffloadSegment *seg = new OffloadSegment();
+        seg->writer = this;
+        seg->rqsts.reserve(_segmentSize / OFFLOAD_SEGMENT_VALUE_ALIGN);
+        seg->offsets.reserve(_segmentSize / OFFLOAD_SEGMENT_VALUE_ALIGN);
+        _segments.push_back(seg);
+        _free.enqueue(seg);
+    }
+}
+
+OffloadSegmentWriter::~OffloadSegmentWriter() {
+    for (auto seg : _segments) {
+        if (seg->buf)
+            spdk_dma_free(seg->buf);
+        delete seg;
+    }
+}
+
+bool OffloadSegmentWriter::_open() {
+    OffloadSegment *seg;
+    if (!_free.dequeue(seg))
+        return false;
+    if (!seg->buf) {
+        seg->buf = reinterpret_cast<char *>(
+            spdk_dma_zmalloc(_segmentSize, _bufAlign, NULL));
+        if (!seg->buf) {
+            _free.enqueue(seg);
+            return false;
+        }
+    }
+    seg->used = sizeof(OffloadSegmentHeader);
+    _current = seg;
+    return true;
+}
+
+void OffloadSegmentWriter::_seal() {
+    OffloadSegmentHeader *header =
+        reinterpret_cast<OffloadSegmentHeader *>(_current->buf);
+    header->magic = OFFLOAD_SEGMENT_MAGIC;
+    header->used = static_cast<uint32_t>(_current->used);
+    header->reserved = 0;
+    LatencyTracer::getInstance().start(_current->trace);
+    _sealed.push_back(_current);
+    _current = nullptr;
+}
+
+bool OffloadSegmentWriter::append(OffloadRqst *rqst) {
+    size_t size = offloadSegmentEntrySize(rqst->keySize, rqst->valueSize);
+    if (_current && _current->used + size > _segmentSize)
+        _seal();
+    if (!_current && !_open())
+        return false;
+
+    OffloadSegment *seg = _current;
+    if (seg->rqsts.empty())
+        seg->openedAt = LatencyTracer::now();
+    OffloadSegmentEntry *entry =
+        reinterpret_cast<OffloadSegmentEntry *>(seg->buf + seg->used);
+    entry->valueSize = static_cast<uint32_t>(rqst->valueSize);
+    entry->keySize = static_cast<uint16_t>(rqst->keySize);
+    entry->reserved = 0;
+    memcpy(entry + 1, rqst->key, rqst->keySize);
+    size_t valOffset = seg->used + offloadSegmentAlign(sizeof(*entry) +
+                                                       rqst->keySize);
+    memcpy(seg->buf + valOffset, rqst->value, rqst->valueSize);
+
+    seg->rqsts.push_back(rqst);
+    seg->offsets.push_back(static_cast<uint32_t>(valOffset));
+    seg->valueBytes += rqst->valueSize;
+    seg->used += size;
+    if (seg->used + offloadSegmentEntrySize(0, 1) > _segmentSize)
+        _seal();
+    return true;
+}
+
+void OffloadSegmentWriter::tick(uint64_t now) {
+    if (_current && !_current->rqsts.empty() &&
+        now - _current->openedAt >= OFFLOAD_SEGMENT_FLUSH_NS)
+        _seal();
+}
+
+void OffloadSegmentWriter::flush() {
+    if (_current && !_current->rqsts.empty())
+        _seal();
+}
+
+void OffloadSegmentWriter::fail(OffloadSegment *seg, StatusCode status,
+                                bool notify) {
+    for (auto rqst : seg->rqsts) {
+        if (notify && rqst->clb)
+            rqst->clb(nullptr, status, rqst->key, rqst->keySize, nullptr, 0);
+        OffloadRqst::updatePool.put(rqst);
+    }
+    release(seg);
+}
+
+void OffloadSegmentWriter::release(OffloadSegment *seg) {
+    seg->used = 0;
+    seg->valueBytes = 0;
+    seg->rqsts.clear();
+    seg->offsets.clear();
+    seg->task.segment = nullptr;
+    _free.enqueue(seg);
+}
+
+OffloadSegmentCursor::OffloadSegmentCursor(const char *buf, size_t size)
+    : _buf(buf) {
+    const OffloadSegmentHeader *header =
+        reinterpret_cast<const OffloadSegmentHeader *>(buf);
+    if (size >= sizeof(*header) && header->magic == OFFLOAD_SEGMENT_MAGIC &&
+        header->used <= size)
+        _used = header->used;
+}
+
+bool OffloadSegmentCursor::next() {
+    if (_pos + sizeof(OffloadSegmentEntry) > _used)
+        return false;
+    const OffloadSegmentEntry *entry =
+        reinterpret_cast<const OffloadSegmentEntry *>(_buf + _pos);
+    size_t size = offloadSegmentEntrySize(entry->keySize, entry->valueSize);
+    if (!entry->valueSize || _pos + size > _used)
+        return false;
+    _entry = _pos;
+    _pos += size;
+    return true;
+}
+
+} // namespace DaqDB
@@ -0,0 +1,222 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <LatencyTracer.h>
+#include <LockFreeRing.h>
+#include <Rqst.h>
+#include <SpdkConf.h>
+#include <SpdkDevice.h>
+#include <daqdb/Status.h>
+
+namespace DaqDB {
+
+const size_t OFFLOAD_SEGMENTS_IN_FLIGHT = 8;
+const uint64_t OFFLOAD_SEGMENT_FLUSH_NS = 200 * 1000;
+const size_t OFFLOAD_SEGMENT_VALUE_ALIGN = 8;
+const uint32_t OFFLOAD_SEGMENT_MAGIC = 0x474c5144;
+
+class OffloadCompactor;
+class OffloadSegmentWriter;
+
+/*
+ * On-device segment layout: header followed by packed entries, each entry
+ * is the entry header, the key and the value, key and value are aligned to
+ * OFFLOAD_SEGMENT_VALUE_ALIGN. Keys let the compactor find owners of
+ * values without scanning the index.
+ */
+struct OffloadSegmentHeader {
+    uint32_t magic;
+    uint32_t used; // bytes of the segment filled with entries
+    uint64_t reserved;
+};
+
+struct OffloadSegmentEntry {
+    uint32_t valueSize;
+    uint16_t keySize;
+    uint16_t reserved;
+};
+
+inline size_t offloadSegmentAlign(size_t size) {
+    return (size + OFFLOAD_SEGMENT_VALUE_ALIGN - 1) &
+           ~(OFFLOAD_SEGMENT_VALUE_ALIGN - 1);
+}
+
+inline size_t offloadSegmentEntrySize(size_t keySize, size_t valueSize) {
+    return offloadSegmentAlign(sizeof(OffloadSegmentEntry) + keySize) +
+           offloadSegmentAlign(valueSize);
+}
+
+/*
+ * Log segment values are packed into by OffloadPoller. The whole segment is
+ * written with a single IO and values packed into it are finalized together
+ * once the write completes.
+ */
+struct OffloadSegment {
+    char *buf = nullptr;
+    size_t used = 0;        // bytes packed so far, including alignment
+    size_t valueBytes = 0;  // bytes of packed values
+    uint64_t openedAt = 0;  // time the first value was packed
+    std::vector<OffloadRqst *> rqsts;
+    std::vector<uint32_t> offsets;
+    RqstTrace trace;        // IO stages shared by all packed values
+    DeviceTask task;
+    OffloadSegmentWriter *writer = nullptr;
+    OffloadCompactor *compactor = nullptr; // set for compaction reads
+
+    /*
+     * Copies IO stage timestamps of the segment write into a value trace.
+     */
+    void copyIoTrace(RqstTrace &valTrace) const {
+        if (!valTrace.ts[TRACE_SUBMIT] || !trace.ts[TRACE_SUBMIT])
+            return;
+        for (int point = TRACE_IO_ENGINE; point <= TRACE_IO_COMPLETE; point++)
+            valTrace.ts[point] = trace.ts[point];
+    }
+};
+
+/*
+ * Trace of a device task, segment writes carry their own.
+ */
+inline RqstTrace &taskTrace(DeviceTask *task) {
+    return task->segment ? task->segment->trace : task->rqst->trace;
+}
+
+/*
+ * Packs values of offload UPDATE requests into log segments. Append and
+ * seal are called from OffloadPoller thread only, segments are given back
+ * with release() from the finalizer or IO threads.
+ */
+class OffloadSegmentWriter {
+  public:
+    OffloadSegmentWriter(size_t segmentSize, uint32_t blockSize,
+                         uint32_t bufAlign,
+                         size_t segmentCnt = OFFLOAD_SEGMENTS_IN_FLIGHT);
+    ~OffloadSegmentWriter();
+
+    inline bool fits(const OffloadRqst *rqst) const {
+        return rqst->valueSize &&
+               offloadSegmentEntrySize(rqst->keySize, rqst->valueSize) <=
+                   _segmentSize - sizeof(OffloadSegmentHeader);
+    }
+
+    /**
+     * Copies value of the request into the open segment, sealing it first
+     * if there is no room left.
+     *
+     * @return false if all segments are in flight, request is not taken
+     */
+    bool append(OffloadRqst *rqst);
+
+    /**
+     * Seals the open segment if its oldest value waits longer than flush
+     * interval.
+     */
+    void tick(uint64_t now);
+
+    /**
+     * Seals the open segment if not empty.
+     */
+    void flush();
+
+    /**
+     * @return oldest sealed segment waiting for submission or nullptr
+     */
+    OffloadSegment *sealed() {
+        return _sealed.empty() ? nullptr : _sealed.front();
+    }
+    void popSealed() { _sealed.pop_front(); }
+
+    /**
+     * Size of the IO writing the segment, packed bytes rounded up to blocks.
+     */
+    inline size_t getWriteSize(const OffloadSegment *seg) const {
+        return (seg->used + _blockSize - 1) / _blockSize * _blockSize;
+    }
+    inline uint32_t getWriteBlocks(const OffloadSegment *seg) const {
+        return getWriteSize(seg) / _blockSize;
+    }
+
+    /**
+     * Completes all values of the segment with given status and releases
+     * it. Values are dropped without calling callbacks if notify is false.
+     */
+    void fail(OffloadSegment *seg, StatusCode status, bool notify = true);
+
+    /**
+     * Returns written or failed segment for reuse.
+     */
+    void release(OffloadSegment *seg);
+
+    size_t getSegmentSize() const { return _segmentSize; }
+    uint32_t getBlockSize() const { return _blockSize; }
+    uint32_t getBufAlign() const { return _bufAlign; }
+
+  protected:
+    bool _open();
+    void _seal();
+
+    size_t _segmentSize;
+    uint32_t _blockSize;
+    uint32_t _bufAlign;
+    std::vector<OffloadSegment *> _segments;
+    LockFreeRing<OffloadSegment *> _free;
+    std::deque<OffloadSegment *> _sealed;
+    OffloadSegment *_current = nullptr;
+};
+
+/*
+ * Walks entries of a segment read back from the device.
+ */
+class OffloadSegmentCursor {
+  public:
+    OffloadSegmentCursor(const char *buf, size_t size);
+
+    /**
+     * Moves to the next entry.
+     *
+     * @return false at the end of the segment or if it is malformed
+     */
+    bool next();
+
+    inline const char *key() const {
+        return _buf + _entry + sizeof(OffloadSegmentEntry);
+    }
+    inline uint16_t keySize() const { return _header()->keySize; }
+    inline const char *value() const { return _buf + valueOffset(); }
+    inline uint32_t valueSize() const { return _header()->valueSize; }
+    inline uint32_t valueOffset() const {
+        return _entry + offloadSegmentAlign(sizeof(OffloadSegmentEntry) +
+                                            keySize());
+    }
+
+  private:
+    inline const OffloadSegmentEntry *_header() const {
+        return reinterpret_cast<const OffloadSegmentEntry *>(_buf + _entry);
+    }
+
+    const char *_buf;
+    size_t _used = 0;
+    size_t _pos = sizeof(OffloadSegmentHeader);
+    size_t _entry = 0;
+};
+
+} // namespace DaqDB
@@ -0,0 +1,146 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include <boost/filesystem.hpp>
+
+#include <libpmemobj.h>
+
+#include "OffloadSegmentAlloc.h"
+#include <Logger.h>
+#include <daqdb/Types.h>
+
+namespace DaqDB {
+
+using pmem::obj::make_persistent;
+using pmem::obj::p;
+using pmem::obj::pool;
+using pmem::obj::transaction;
+
+OffloadSegmentAlloc::OffloadSegmentAlloc(const std::string &filename,
+                                         uint64_t blockCnt,
+                                         uint64_t segmentBlocks)
+    : _segmentBlocks(segmentBlocks), _segmentCount(blockCnt / segmentBlocks),
+      _open(_segmentCount, false) {
+    if (boost::filesystem::exists(filename)) {
+        _pool = pool<SegmentTable>::open(filename, _poolLayout);
+        _table = _pool.get_root().get();
+        if (_table->segmentBlocks != _segmentBlocks ||
+            _table->segmentCount != _segmentCount) {
+            _pool.close();
+            throw OperationFailedException(
+                EINVAL, "Offload segment size changed, recreate " + filename);
+        }
+    } else {
+        size_t poolSize = _segmentCount * sizeof(uint32_t) + PMEMOBJ_MIN_POOL;
+        _pool = pool<SegmentTable>::create(filename, _poolLayout, poolSize,
+                                           S_IWUSR | S_IRUSR);
+        _table = _pool.get_root().get();
+        transaction::exec_tx(_pool, [&] {
+            _table->head = 0;
+            _table->segmentCount = _segmentCount;
+            _table->segmentBlocks = _segmentBlocks;
+            _table->live = make_persistent<p<uint32_t>[]>(_segmentCount);
+        });
+        pmemobj_memset_persist(_pool.get_handle(), _table->live.get(), 0,
+                               _segmentCount * sizeof(uint32_t));
+    }
+
+    for (uint64_t idx = 0; idx < _table->head; idx++) {
+        if (!_table->live[idx])
+            _free.push_back(idx);
+    }
+    DAQ_DEBUG("Offload log segments [" + std::to_string(_segmentCount) +
+              "] free [" + std::to_string(getFreeCount()) + "]");
+}
+
+OffloadSegmentAlloc::~OffloadSegmentAlloc() { _pool.close(); }
+
+int64_t OffloadSegmentAlloc::get() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t idx;
+    if (!_free.empty()) {
+        idx = _free.back();
+        _free.pop_back();
+    } else if (_table->head < _segmentCount) {
+        idx = _table->head;
+        _table->head = idx + 1;
+        _pool.persist(_table->head);
+    } else {
+        return -1;
+    }
+    _open[idx] = true;
+    return static_cast<int64_t>(idx * _segmentBlocks);
+}
+
+bool OffloadSegmentAlloc::commit(uint64_t lba, uint32_t liveBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t idx = lba / _segmentBlocks;
+    /* segment emptied by releases is already on its way back */
+    bool owned = _open[idx] || _table->live[idx];
+    _open[idx] = false;
+    _setLive(idx, liveBytes);
+    return owned && !liveBytes;
+}
+
+bool OffloadSegmentAlloc::release(uint64_t lba, uint32_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t idx = lba / _segmentBlocks;
+    uint32_t live = _table->live[idx];
+    if (!live)
+        return false;
+    live = (live > bytes) ? live - bytes : 0;
+    _setLive(idx, live);
+    return !live;
+}
+
+void OffloadSegmentAlloc::put(uint64_t lba) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _free.push_back(lba / _segmentBlocks);
+}
+
+int64_t OffloadSegmentAlloc::findVictim(uint32_t maxLiveBytes,
+                                        uint64_t scanLimit) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t head = _table->head;
+    if (!head)
+        return -1;
+    for (uint64_t cnt = 0; cnt < scanLimit && cnt < head; cnt++) {
+        uint64_t idx = _victimCursor++ % head;
+        uint32_t live = _table->live[idx];
+        if (live && live <= maxLiveBytes)
+            return static_cast<int64_t>(idx * _segmentBlocks);
+    }
+    return -1;
+}
+
+uint32_t OffloadSegmentAlloc::getLiveBytes(uint64_t lba) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _table->live[lba / _segmentBlocks];
+}
+
+uint64_t OffloadSegmentAlloc::getFreeCount() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _free.size() + _segmentCount - _table->head;
+}
+
+void OffloadSegmentAlloc::_setLive(uint64_t idx, uint32_t liveBytes) {
+    _table->live[idx] = liveBytes;
+    _pool.persist(_table->live[idx]);
+}
+
+} // namespace DaqDB
@@ -0,0 +1,105 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+namespace DaqDB {
+
+/*
+ * Allocates fixed size log segments of a single device. Live bytes of every
+ * segment are kept in pmem, a segment is reused once all values packed into
+ * it are removed and it is put back. Segments allocated but not committed
+ * before a crash have no live bytes and are reclaimed on the next open.
+ */
+class OffloadSegmentAlloc {
+  public:
+    OffloadSegmentAlloc(const std::string &filename, uint64_t blockCnt,
+                        uint64_t segmentBlocks);
+    ~OffloadSegmentAlloc();
+
+    /**
+     * @return first block of a free segment, -1 if the device is full
+     */
+    int64_t get();
+
+    /**
+     * Sets live bytes of a freshly written segment.
+     *
+     * @return true if the segment holds no live bytes and may be reused
+     * after put
+     */
+    bool commit(uint64_t lba, uint32_t liveBytes);
+
+    /**
+     * Accounts removal of a value packed into the segment.
+     *
+     * @return true if the last live bytes of the segment were released
+     */
+    bool release(uint64_t lba, uint32_t bytes);
+
+    /**
+     * Returns segment without live bytes to the free ones.
+     */
+    void put(uint64_t lba);
+
+    /**
+     * Looks for a written segment with at most maxLiveBytes live bytes.
+     * Scans up to scanLimit segments, continuing where the previous call
+     * stopped.
+     *
+     * @return first block of the segment, -1 if none found
+     */
+    int64_t findVictim(uint32_t maxLiveBytes, uint64_t scanLimit);
+
+    uint32_t getLiveBytes(uint64_t lba);
+    uint64_t getSegmentBlocks() const { return _segmentBlocks; }
+    uint64_t getSegmentCount() const { return _segmentCount; }
+    uint64_t getFreeCount();
+
+  private:
+    struct SegmentTable {
+        pmem::obj::p<uint64_t> head; // first never used segment
+        pmem::obj::p<uint64_t> segmentCount;
+        pmem::obj::p<uint64_t> segmentBlocks;
+        pmem::obj::persistent_ptr<pmem::obj::p<uint32_t>[]> live;
+    };
+
+    void _setLive(uint64_t idx, uint32_t liveBytes);
+
+    pmem::obj::pool<SegmentTable> _pool;
+    SegmentTable *_table = nullptr;
+    uint64_t _segmentBlocks;
+    uint64_t _segmentCount;
+    std::vector<uint64_t> _free;
+    std::vector<bool> _open; // handed out by get, not committed yet
+    uint64_t _victimCursor = 0;
+    std::mutex _mutex;
+
+    const char *_poolLayout = "segments";
+};
+
+} // namespace DaqDB
@@ -0,0 +1,177 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "OffloadPoller.h"
+#include "OffloadTiering.h"
+
+namespace DaqDB {
+
+OffloadTiering::OffloadTiering(RTreeEngine *rtree,
+                               const std::vector<OffloadPoller *> &pollers,
+                               unsigned int highPercent,
+                               unsigned int lowPercent)
+    : _rtree(rtree), _pollers(pollers),
+      _highPercent(std::min(highPercent, 100u)),
+      _lowPercent(std::min(lowPercent, _highPercent)) {}
+
+void OffloadTiering::track(const char *key, size_t keySize) {
+    std::lock_guard<std::mutex> lock(_keysMutex);
+    _keys.emplace_back(key, keySize);
+}
+
+size_t OffloadTiering::getTrackedCount() {
+    std::lock_guard<std::mutex> lock(_keysMutex);
+    return _keys.size();
+}
+
+/*
+ * Values being moved take PMEM until their update completes, they are
+ * counted as moved already so the low watermark is not overshot. After an
+ * allocation failure a full batch is moved even below the low watermark.
+ */
+void OffloadTiering::process(uint64_t now) {
+    if (!_wakeup && now - _lastCheck < OFFLOAD_TIERING_CHECK_NS)
+        return;
+    _lastCheck = now;
+    _wakeup = false;
+    bool forced = _forced.exchange(false);
+
+    size_t used, size;
+    if (!_rtree->GetPoolUsage(&used, &size))
+        return;
+    size_t low = size * _lowPercent / 100;
+    if (forced || used >= size * _highPercent / 100)
+        _draining = true;
+    else if (used <= low)
+        _draining = false;
+    if (!_draining) {
+        _prune();
+        return;
+    }
+
+    size_t moving = _inFlightBytes;
+    while ((forced || used > low + moving) &&
+           _inFlight < OFFLOAD_TIERING_DEPTH) {
+        std::string key;
+        {
+            std::lock_guard<std::mutex> lock(_keysMutex);
+            if (_keys.empty())
+                return;
+            key = std::move(_keys.front());
+            _keys.pop_front();
+        }
+        size_t valSize = 0;
+        if (!_move(key, valSize)) {
+            /* offload queue is full, key is retried on next check */
+            std::lock_guard<std::mutex> lock(_keysMutex);
+            _keys.push_front(std::move(key));
+            return;
+        }
+        moving += valSize;
+    }
+}
+
+bool OffloadTiering::_inPmem(const std::string &key, void **val,
+                             size_t *size) {
+    uint8_t location;
+    try {
+        _rtree->Get(key.data(), key.size(), val, size, &location);
+    } catch (...) {
+        return false;
+    }
+    return location == LOCATIONS::PMEM;
+}
+
+/*
+ * Values are mostly removed in order they were put, keys are dropped from
+ * the front until the oldest value still in PMEM. Keys are looked up with
+ * the lock released, so tracking puts do not wait for the lookups. Only
+ * this thread takes keys from the front.
+ */
+void OffloadTiering::_prune() {
+    for (size_t cnt = 0; cnt < OFFLOAD_TIERING_PRUNE; cnt++) {
+        std::string key;
+        {
+            std::lock_guard<std::mutex> lock(_keysMutex);
+            if (_keys.empty())
+                return;
+            key = std::move(_keys.front());
+            _keys.pop_front();
+        }
+        void *val;
+        size_t size;
+        if (_inPmem(key, &val, &size)) {
+            std::lock_guard<std::mutex> lock(_keysMutex);
+            _keys.push_front(std::move(key));
+            return;
+        }
+    }
+}
+
+/*
+ * Keys of values removed or moved since they were put are skipped.
+ *
+ * @return false if the update could not be queued
+ */
+bool OffloadTiering::_move(const std::string &key, size_t &size) {
+    void *val;
+    if (!_inPmem(key, &val, &size)) {
+        size = 0;
+        return true;
+    }
+
+    size_t valSize = size;
+    OffloadRqst *rqst = OffloadRqst::updatePool.get();
+    rqst->finalizeUpdate(
+        key.data(), key.size(), static_cast<char *>(val), valSize,
+        [this, valSize](KVStoreBase *kvs, Status status, const char *key,
+                        size_t keySize, const char *value, size_t valueSize) {
+            _moved(key, keySize, valSize, status.ok());
+        },
+        LOCATIONS::PMEM);
+
+    _inFlight++;
+    _inFlightBytes += valSize;
+    OffloadPoller *poller = _pollers.at(
+        OffloadPoller::queueOf(key.data(), key.size(), _pollers.size()));
+    if (!poller->enqueue(rqst)) {
+        _inFlightBytes -= valSize;
+        _inFlight--;
+        OffloadRqst::updatePool.put(rqst);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Called by the thread completing the update. Value that failed to move
+ * stays in PMEM and is tried again after the values tracked meanwhile.
+ */
+void OffloadTiering::_moved(const char *key, size_t keySize, size_t size,
+                            bool result) {
+    if (result) {
+        _movedBytes += size;
+        _movedCount++;
+    } else {
+        track(key, keySize);
+    }
+    _inFlightBytes -= size;
+    _inFlight--;
+}
+
+} // namespace DaqDB
@@ -0,0 +1,111 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <RTreeEngine.h>
+
+namespace DaqDB {
+
+class OffloadPoller;
+
+/* PMEM usage is checked at most this often */
+const uint64_t OFFLOAD_TIERING_CHECK_NS = 1000ULL * 1000;
+/* values moved at once */
+const size_t OFFLOAD_TIERING_DEPTH = 64;
+/* keys of removed values dropped per check */
+const size_t OFFLOAD_TIERING_PRUNE = 256;
+
+/*
+ * Moves values from PMEM to the offload device once PMEM usage crosses the
+ * high watermark, until it drops below the low watermark. Values are moved
+ * in order they were put, through the same update path Update with
+ * LONG_TERM attribute takes, so readout does not stall once PMEM fills.
+ *
+ * Keys are tracked by any thread putting values, migration runs in the
+ * first OffloadPoller thread.
+ */
+class OffloadTiering {
+  public:
+    /**
+     * @param highPercent PMEM usage in percent migration starts at
+     * @param lowPercent PMEM usage in percent migration stops at
+     */
+    OffloadTiering(RTreeEngine *rtree,
+                   const std::vector<OffloadPoller *> &pollers,
+                   unsigned int highPercent, unsigned int lowPercent);
+
+    /**
+     * Records key of a value put to PMEM.
+     */
+    void track(const char *key, size_t keySize);
+
+    /**
+     * Checks PMEM usage on next process() call.
+     */
+    void wakeup() { _wakeup = true; }
+
+    /**
+     * Moves values on next process() call whatever the PMEM usage, called
+     * when an allocation failed. Usage counts value bytes only, the pool
+     * can be full well below the high watermark.
+     */
+    void allocFailed() {
+        _forced = true;
+        _wakeup = true;
+    }
+
+    void process(uint64_t now);
+
+    uint64_t getMovedBytes() const { return _movedBytes; }
+    uint64_t getMovedCount() const { return _movedCount; }
+    size_t getTrackedCount();
+    bool isDraining() const { return _draining; }
+
+  private:
+    bool _inPmem(const std::string &key, void **val, size_t *size);
+    void _prune();
+    bool _move(const std::string &key, size_t &size);
+    void _moved(const char *key, size_t keySize, size_t size, bool result);
+
+    RTreeEngine *_rtree;
+    std::vector<OffloadPoller *> _pollers;
+    unsigned int _highPercent;
+    unsigned int _lowPercent;
+
+    /* oldest first, keys of removed or moved values are skipped */
+    std::deque<std::string> _keys;
+    std::mutex _keysMutex;
+
+    std::atomic<bool> _wakeup{false};
+    std::atomic<bool> _forced{false};
+    bool _draining = false;
+    uint64_t _lastCheck = 0;
+
+    std::atomic<size_t> _inFlight{0};
+    std::atomic<size_t> _inFlightBytes{0};
+    std::atomic<uint64_t> _movedBytes{0};
+    std::atomic<uint64_t> _movedCount{0};
+};
+
+} // namespace DaqDB
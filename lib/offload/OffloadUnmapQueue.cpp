@@ -0,0 +1,76 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "OffloadUnmapQueue.h"
+
+namespace DaqDB {
+
+void OffloadUnmapQueue::push(uint64_t lba, uint64_t blocks, uint64_t now) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pending.empty())
+        _oldest = now;
+    _pending.push_back({lba, blocks});
+}
+
+bool OffloadUnmapQueue::take(uint64_t now,
+                             std::vector<OffloadExtent> &batch) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pending.empty())
+        return false;
+    if (_pending.size() < _batchSize && now - _oldest < _maxDelay)
+        return false;
+    batch.swap(_pending);
+    _pending.clear();
+    return true;
+}
+
+void OffloadUnmapQueue::drain(std::vector<OffloadExtent> &batch) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    batch.insert(batch.end(), _pending.begin(), _pending.end());
+    _pending.clear();
+}
+
+size_t OffloadUnmapQueue::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pending.size();
+}
+
+void OffloadUnmapQueue::merge(const std::vector<OffloadExtent> &batch,
+                              std::vector<OffloadExtent> &ranges) {
+    ranges = batch;
+    std::sort(ranges.begin(), ranges.end(),
+              [](const OffloadExtent &a, const OffloadExtent &b) {
+                  return a.lba < b.lba;
+              });
+
+    size_t last = 0;
+    for (size_t idx = 1; idx < ranges.size(); idx++) {
+        OffloadExtent &range = ranges[last];
+        if (ranges[idx].lba <= range.lba + range.blocks) {
+            range.blocks = std::max(range.lba + range.blocks,
+                                    ranges[idx].lba + ranges[idx].blocks) -
+                           range.lba;
+        } else {
+            ranges[++last] = ranges[idx];
+        }
+    }
+    if (!ranges.empty())
+        ranges.resize(last + 1);
+}
+
+} // namespace DaqDB
@@ -0,0 +1,78 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace DaqDB {
+
+const size_t OFFLOAD_UNMAP_BATCH = 64;
+const uint64_t OFFLOAD_UNMAP_DELAY_NS = 10ULL * 1000 * 1000;
+
+struct OffloadExtent {
+    uint64_t lba;
+    uint64_t blocks;
+};
+
+/*
+ * Collects device extents freed by removals until they are unmapped. Extents
+ * go back to the allocator only once their unmap completes, a new value is
+ * never written to a range with an unmap pending.
+ *
+ * Extents are pushed by finalizer and offload threads and taken in batches
+ * by the IO engine thread.
+ */
+class OffloadUnmapQueue {
+  public:
+    OffloadUnmapQueue(size_t batchSize = OFFLOAD_UNMAP_BATCH,
+                      uint64_t maxDelay = OFFLOAD_UNMAP_DELAY_NS)
+        : _batchSize(batchSize), _maxDelay(maxDelay) {}
+
+    void push(uint64_t lba, uint64_t blocks, uint64_t now);
+
+    /**
+     * Moves pending extents to batch once batchSize of them are queued or
+     * the oldest one waits maxDelay nanoseconds.
+     *
+     * @return false if no batch is ready
+     */
+    bool take(uint64_t now, std::vector<OffloadExtent> &batch);
+
+    /**
+     * Moves all pending extents to batch regardless of their age.
+     */
+    void drain(std::vector<OffloadExtent> &batch);
+
+    size_t size();
+
+    /**
+     * Sorts extents by LBA and joins adjacent ones into unmap ranges.
+     */
+    static void merge(const std::vector<OffloadExtent> &batch,
+                      std::vector<OffloadExtent> &ranges);
+
+  private:
+    size_t _batchSize;
+    uint64_t _maxDelay;
+    std::vector<OffloadExtent> _pending;
+    uint64_t _oldest = 0;
+    std::mutex _mutex;
+};
+
+} // namespace DaqDB
@@ -32,7 +32,11 @@ ARTree::ARTree(const string &_path, const size_t size,
 }
 
 ARTree::~ARTree() {
-    // TODO Auto-generated destructor stub
+    /* reservations not published are dropped with the pool */
+    for (auto &retired : _retired) {
+        for (auto action : retired)
+            delete action;
+    }
 }
 
 void TreeImpl::_initAllocClasses(const size_t allocUnitSize) {
@@ -103,6 +107,7 @@ TreeImpl::TreeImpl(const string &path, const size_t size,
     if (!boost::filesystem::exists(path)) {
         _pm_pool =
             pool<ARTreeRoot>::create(path, LAYOUT, size, S_IWUSR | S_IRUSR);
+        poolSize = size;
 #ifdef USE_ALLOCATION_CLASSES
         _initAllocClasses(allocUnitSize);
 #endif
@@ -143,6 +148,7 @@ TreeImpl::TreeImpl(const string &path, const size_t size,
         DAQ_DEBUG("root created");
     } else {
         _pm_pool = pool<ARTreeRoot>::open(path, LAYOUT);
+        poolSize = boost::filesystem::file_size(path);
 #ifdef USE_ALLOCATION_CLASSES
         _initAllocClasses(allocUnitSize);
 #endif
@@ -152,6 +158,9 @@ TreeImpl::TreeImpl(const string &path, const size_t size,
         else
             std::cout << "Error on load" << std::endl;
     }
+    /* objects are mapped at their pool offset from the start of the file */
+    PMEMoid rootOid = _pm_pool.get_root().raw();
+    poolAddr = static_cast<char *>(pmemobj_direct(rootOid)) - rootOid.off;
 }
 
 /*
@@ -249,13 +258,30 @@ uint64_t ARTree::GetLeafCount() {
     return tree->getTreeSize(tree->treeRoot->rootNode, true);
 }
 
+/*
+ * Pool handle is the address the pool file is mapped at.
+ */
+bool ARTree::GetPoolRange(void **addr, size_t *size) {
+    *addr = tree->poolAddr;
+    *size = tree->poolSize;
+    return *size != 0;
+}
+
+bool ARTree::GetPoolUsage(size_t *used, size_t *size) {
+    *used = _valueBytes;
+    *size = tree->poolSize;
+    return *size != 0;
+}
+
 void ARTree::Put(const char *key, // copy value from std::string
                  char *value) {
     // printKey(key);
+    persistent_ptr<Node256> parent;
     persistent_ptr<ValueWrapper> valPrstPtr =
-        tree->findValueInNode(tree->treeRoot->rootNode, key, false);
+        tree->findValueInNode(tree->treeRoot->rootNode, key, false, &parent);
     if (valPrstPtr == nullptr)
         throw OperationFailedException(Status(KEY_NOT_FOUND));
+    std::lock_guard<pmem::obj::mutex> lock(parent->nodeMutex);
     if (!tree->treeRoot->initialized) {
         tree->treeRoot->initialized = true;
     }
@@ -280,10 +306,14 @@ void ARTree::removeFromParent(persistent_ptr<ValueWrapper> valPrstPtr) {
 }
 
 void ARTree::Remove(const char *key) {
+    persistent_ptr<Node256> parent;
     persistent_ptr<ValueWrapper> valPrstPtr =
-        tree->findValueInNode(tree->treeRoot->rootNode, key, false);
+        tree->findValueInNode(tree->treeRoot->rootNode, key, false, &parent);
+    if (valPrstPtr == nullptr)
+        throw OperationFailedException(Status(KEY_NOT_FOUND));
 
-    if (valPrstPtr == nullptr || (valPrstPtr->location == EMPTY))
+    std::lock_guard<pmem::obj::mutex> lock(parent->nodeMutex);
+    if (valPrstPtr->location == EMPTY)
         throw OperationFailedException(Status(KEY_NOT_FOUND));
 
     try {
@@ -293,9 +323,10 @@ void ARTree::Remove(const char *key) {
             pmemobj_cancel(tree->_pm_pool.get_handle(), valPrstPtr->actionValue,
                            1);
             delete valPrstPtr->actionValue;
+            _valueBytes -= valPrstPtr->size;
             pmemobj_free(valPrstPtr.raw_ptr());
         } else if (valPrstPtr->location == DISK) {
-            // TODO: jradtke need to confirm if no extra action required here
+            /* device extent is released by offload FinalizePoller */
             valPrstPtr->location = EMPTY;
         } else {
             // TODO: jradtke need to confirm if no extra action or error
@@ -403,22 +434,24 @@ void TreeImpl::allocateFullLevels(persistent_ptr<Node> node,
  * @param key pointer to searched key
  * @param allocate flag to specify if subtree should be allocated when key
  * not found
+ * @param leafParent if set, stores node whose mutex guards location of value
  * @return pointer to value
  */
 persistent_ptr<ValueWrapper>
 TreeImpl::findValueInNode(persistent_ptr<Node> current, const char *_key,
-                          bool allocate) {
+                          bool allocate, persistent_ptr<Node256> *leafParent) {
     size_t keyCalc;
     unsigned char *key = (unsigned char *)_key;
     persistent_ptr<Node256> node256;
     persistent_ptr<NodeLeafCompressed> nodeLeafCompressed;
 
     while (1) {
-        DAQ_DEBUG("findValueInNode: current->depth= " +
-                  std::to_string(current->depth));
+        DAQ_DEBUGF("findValueInNode: current->depth= %d", current->depth);
         if (current->depth == ((sizeof(LEVEL_TYPE) / sizeof(int) - 1))) {
             // Node Compressed
             nodeLeafCompressed = current;
+            if (leafParent)
+                *leafParent = nodeLeafCompressed->parent;
             if (nodeLeafCompressed->child == nullptr && allocate) {
                 static thread_local struct pobj_action
                     actionsArray[ACTION_NUMBER_COMPRESSED];
@@ -460,8 +493,7 @@ TreeImpl::findValueInNode(persistent_ptr<Node> current, const char *_key,
             return nodeLeafCompressed->child;
         }
         keyCalc = key[treeRoot->keySize - current->depth - 1];
-        std::bitset<8> x(keyCalc);
-        DAQ_DEBUG("findValueInNode: keyCalc=" + x.to_string());
+        DAQ_DEBUGF("findValueInNode: keyCalc=%#04zx", keyCalc);
         if (current->type == TYPE256) { // TYPE256
             node256 = current;
             if (!allocate && node256->children[keyCalc]) {
@@ -472,9 +504,9 @@ TreeImpl::findValueInNode(persistent_ptr<Node> current, const char *_key,
                 if (node256->children[keyCalc]) {
                     current = node256->children[keyCalc];
                 } else { // not found, allocate subtree
-                    DAQ_DEBUG("findValueInNode: allocate subtree on depth=" +
-                              std::to_string(node256->depth + 1) + " type=" +
-                              std::to_string(LEVEL_TYPE[node256->depth + 1]));
+                    DAQ_DEBUGF(
+                        "findValueInNode: allocate subtree on depth=%d type=%d",
+                        node256->depth + 1, LEVEL_TYPE[node256->depth + 1]);
                     static thread_local struct pobj_action
                         actionsArray[ACTION_NUMBER_NODE256];
                     int actionsCounter = 0;
@@ -542,6 +574,7 @@ void ARTree::AllocValueForKey(const char *key, size_t size, char **value) {
             throw OperationFailedException(Status(PMEM_ALLOCATION_ERROR));
         }
         valPrstPtr->size = size;
+        _valueBytes += size;
         *value = valPrstPtr->locationPtr.value.get();
     } else {
         DAQ_DEBUG("root does not exist");
@@ -555,17 +588,56 @@ void ARTree::AllocValueForKey(const char *key, size_t size, char **value) {
  */
 void ARTree::AllocateAndUpdateValueWrapper(const char *key, size_t size,
                                            const DeviceAddr *devAddr) {
-    persistent_ptr<ValueWrapper> valPrstPtr;
-
-    valPrstPtr = tree->findValueInNode(tree->treeRoot->rootNode, key, false);
+    persistent_ptr<Node256> parent;
+    persistent_ptr<ValueWrapper> valPrstPtr =
+        tree->findValueInNode(tree->treeRoot->rootNode, key, false, &parent);
     if (valPrstPtr == nullptr)
         throw OperationFailedException(Status(PMEM_ALLOCATION_ERROR));
 
-    pmemobj_cancel(tree->_pm_pool.get_handle(), valPrstPtr->actionValue, 1);
-    delete[] valPrstPtr->actionValue;
-    valPrstPtr->actionValue = nullptr;
+    std::lock_guard<pmem::obj::mutex> lock(parent->nodeMutex);
+    _updateValueWrapper(valPrstPtr, size, devAddr);
+}
+
+/*
+ * Moves value already offloaded to devAddr if it is still at expected.
+ * Compare and update are done under the same lock as remove, so a value
+ * removed or updated in the meantime is never switched back.
+ */
+bool ARTree::RelocateValueWrapper(const char *key, size_t size,
+                                  const DeviceAddr *expected,
+                                  const DeviceAddr *devAddr) {
+    persistent_ptr<Node256> parent;
+    persistent_ptr<ValueWrapper> valPrstPtr =
+        tree->findValueInNode(tree->treeRoot->rootNode, key, false, &parent);
+    if (valPrstPtr == nullptr)
+        return false;
+
+    std::lock_guard<pmem::obj::mutex> lock(parent->nodeMutex);
+    if (valPrstPtr->location != DISK ||
+        memcmp(valPrstPtr->locationPtr.IOVptr.get(), expected,
+               sizeof(*expected)))
+        return false;
+    _updateValueWrapper(valPrstPtr, size, devAddr);
+    return true;
+}
+
+void ARTree::_updateValueWrapper(persistent_ptr<ValueWrapper> valPrstPtr,
+                                 size_t size, const DeviceAddr *devAddr) {
+    struct pobj_action actions[6];
+    struct pobj_action *valueAction = nullptr;
+    int actionsCnt = 5;
+    if (valPrstPtr->location == DISK) {
+        /* value relocated on the device, old vector goes with the update */
+        pmemobj_defer_free(tree->_pm_pool.get_handle(),
+                           valPrstPtr->locationPtr.IOVptr.raw(), &actions[5]);
+        actionsCnt++;
+    } else {
+        /* readers may still copy the value, reservation outlives them */
+        valueAction = valPrstPtr->actionValue;
+        valPrstPtr->actionValue = nullptr;
+        _valueBytes -= valPrstPtr->size;
+    }
 
-    struct pobj_action actions[4];
     valPrstPtr->actionUpdate = actions;
 #ifdef USE_ALLOCATION_CLASSES
     valPrstPtr->locationPtr.IOVptr = pmemobj_xreserve(
@@ -587,10 +659,74 @@ void ARTree::AllocateAndUpdateValueWrapper(const char *key, size_t size,
                       &val->locationPtr.IOVptr->busAddr.busAddr,
                       devAddr->busAddr.busAddr);
     pmemobj_set_value(tree->_pm_pool.get_handle(), &valPrstPtr->actionUpdate[3],
+                      &val->locationPtr.IOVptr->segAddr.segAddr,
+                      devAddr->segAddr.segAddr);
+    pmemobj_set_value(tree->_pm_pool.get_handle(), &valPrstPtr->actionUpdate[4],
                       reinterpret_cast<uint64_t *>(&(val->location).get_rw()),
                       DISK);
-    pmemobj_publish(tree->_pm_pool.get_handle(), valPrstPtr->actionUpdate, 4);
+    pmemobj_publish(tree->_pm_pool.get_handle(), valPrstPtr->actionUpdate,
+                    actionsCnt);
     valPrstPtr->actionUpdate = nullptr;
+    if (valueAction)
+        _retire(valueAction);
+}
+
+/*
+ * Readers count themselves in the slot of the current epoch. Recheck makes
+ * sure the epoch did not move on before the reader was counted.
+ */
+unsigned int ARTree::PinValues() {
+    for (;;) {
+        uint64_t epoch = _epoch;
+        unsigned int pin = epoch & 1;
+        _readers[pin]++;
+        if (_epoch == epoch)
+            return pin;
+        _readers[pin]--;
+    }
+}
+
+void ARTree::UnpinValues(unsigned int pin) {
+    if (--_readers[pin] || !_retiredCnt)
+        return;
+    std::unique_lock<std::mutex> lock(_retiredMutex, std::try_to_lock);
+    if (lock.owns_lock())
+        while (_reclaim())
+            ;
+}
+
+void ARTree::_retire(struct pobj_action *action) {
+    std::lock_guard<std::mutex> lock(_retiredMutex);
+    _retired[_epoch & 1].push_back(action);
+    _retiredCnt++;
+    while (_reclaim())
+        ;
+}
+
+/*
+ * Called with _retiredMutex held. Reservations of the previous epoch are
+ * cancelled once its readers are gone, then the epoch moves on so that
+ * reservations of the current one drain the same way. Readers of the
+ * previous epoch still active block the move, so no reader is ever counted
+ * two epochs behind.
+ *
+ * @return true if the epoch moved on
+ */
+bool ARTree::_reclaim() {
+    uint64_t epoch = _epoch;
+    std::vector<struct pobj_action *> &prev = _retired[(epoch + 1) & 1];
+    if (_readers[(epoch + 1) & 1])
+        return false;
+    for (auto action : prev) {
+        pmemobj_cancel(tree->_pm_pool.get_handle(), action, 1);
+        delete action;
+    }
+    _retiredCnt -= prev.size();
+    prev.clear();
+    if (_retired[epoch & 1].empty())
+        return false;
+    _epoch = epoch + 1;
+    return true;
 }
 
 } // namespace DaqDB
@@ -39,6 +39,7 @@
 #include <cmath>
 #include <iostream>
 #include <mutex>
+#include <vector>
 
 using namespace pmem::obj::experimental;
 using namespace pmem::obj;
@@ -139,11 +140,15 @@ class TreeImpl {
     void allocateFullLevels(persistent_ptr<Node> node, int levelsToAllocate,
                             struct pobj_action *actionsArray,
                             int &actionCounter);
-    persistent_ptr<ValueWrapper> findValueInNode(persistent_ptr<Node> current,
-                                                 const char *key,
-                                                 bool allocate);
+    persistent_ptr<ValueWrapper>
+    findValueInNode(persistent_ptr<Node> current, const char *key,
+                    bool allocate,
+                    persistent_ptr<Node256> *leafParent = nullptr);
     ARTreeRoot *treeRoot;
     pool<ARTreeRoot> _pm_pool;
+    /* start of the pool file mapping and its size */
+    void *poolAddr = nullptr;
+    size_t poolSize = 0;
     void setClassId(enum ALLOC_CLASS c, size_t unit_size);
     unsigned getClassId(enum ALLOC_CLASS c);
     uint64_t getTreeSize(persistent_ptr<Node> current, bool leavesOnly = false);
@@ -175,6 +180,13 @@ class ARTree : public DaqDB::RTreeEngine {
     void AllocValueForKey(const char *key, size_t size, char **value) final;
     void AllocateAndUpdateValueWrapper(const char *key, size_t size,
                                        const DeviceAddr *devAddr) final;
+    bool RelocateValueWrapper(const char *key, size_t size,
+                              const DeviceAddr *expected,
+                              const DeviceAddr *devAddr) final;
+    bool GetPoolRange(void **addr, size_t *size) final;
+    bool GetPoolUsage(size_t *used, size_t *size) final;
+    unsigned int PinValues() final;
+    void UnpinValues(unsigned int pin) final;
     void printKey(const char *key);
     void decrementParent(persistent_ptr<Node> node);
     void removeFromParent(persistent_ptr<ValueWrapper> valPrstPtr);
@@ -186,7 +198,26 @@ class ARTree : public DaqDB::RTreeEngine {
                 valPrstPtr->locationVolatile.get().value != EMPTY);
     }
 
+    void _updateValueWrapper(persistent_ptr<ValueWrapper> valPrstPtr,
+                             size_t size, const DeviceAddr *devAddr);
+    void _retire(struct pobj_action *action);
+    bool _reclaim();
+
     TreeImpl *tree;
+    /* values are reserved until offloaded or removed, not published */
+    std::atomic<size_t> _valueBytes{0};
+
+    /*
+     * Reservations of values moved out of PMEM are cancelled once readers
+     * pinned before the move are gone. Readers are counted in the slot of
+     * the epoch they pinned in, reservations in the slot of the epoch they
+     * were retired in.
+     */
+    std::atomic<uint64_t> _epoch{0};
+    std::atomic<size_t> _readers[2] = {{0}, {0}};
+    std::mutex _retiredMutex;
+    std::vector<struct pobj_action *> _retired[2];
+    std::atomic<size_t> _retiredCnt{0};
 };
 } // namespace DaqDB
 #endif /* LIB_STORE_ARTREE_H_ */
@@ -24,11 +24,14 @@
 
 #include "../offload/OffloadPoller.h"
 #include <Logger.h>
+#include <MemMgr.h>
 
 namespace DaqDB {
 
-PmemPoller::PmemPoller(RTreeEngine *rtree, const size_t cpuCore)
-    : isRunning(0), _thread(nullptr), rtree(rtree), _cpuCore(cpuCore) {
+PmemPoller::PmemPoller(RTreeEngine *rtree, const size_t cpuCore,
+                       PollerRingBackend ringBackend)
+    : Poller<PmemRqst>(true, SPDK_RING_TYPE_MP_SC, ringBackend), isRunning(0),
+      _thread(nullptr), rtree(rtree), _cpuCore(cpuCore) {
     startThread();
 }
 
@@ -67,15 +70,21 @@ void PmemPoller::_threadMain() {
     }
 }
 
-void PmemPoller::_processTransfer(const PmemRqst *rqst) {
-    if (!offloadPoller) {
+void PmemPoller::_processTransfer(PmemRqst *rqst) {
+    if (offloadPollers.empty()) {
         DAQ_DEBUG("Request transfer failed. Offload poller not set");
         _rqstClb(rqst, StatusCode::OFFLOAD_DISABLED_ERROR);
+        return;
     }
     try {
         OffloadRqst *getRqst = OffloadRqst::getPool.get();
         getRqst->finalizeGet(rqst->key, rqst->keySize, nullptr, 0, rqst->clb);
+        /* request is completed by offload path */
+        getRqst->trace = rqst->trace;
+        rqst->trace.ts[TRACE_SUBMIT] = 0;
 
+        OffloadPoller *offloadPoller = offloadPollers.at(OffloadPoller::queueOf(
+            rqst->key, rqst->keySize, offloadPollers.size()));
         if (!offloadPoller->enqueue(getRqst)) {
             OffloadRqst::getPool.put(getRqst);
             _rqstClb(rqst, StatusCode::UNKNOWN_ERROR);
@@ -85,15 +94,31 @@ void PmemPoller::_processTransfer(const PmemRqst *rqst) {
     }
 }
 
-void PmemPoller::_processGet(const PmemRqst *rqst) {
+void PmemPoller::_processGet(PmemRqst *rqst) {
     StatusCode rc = StatusCode::OK;
     ValCtx valCtx;
-    try {
-        rtree->Get(rqst->key, rqst->keySize, &valCtx.val, &valCtx.size,
-                   &valCtx.location);
-    } catch (...) {
-        /** @todo fix exception handling */
-        rc = StatusCode::UNKNOWN_ERROR;
+    Value value;
+    {
+        /* value is not moved out of PMEM while being copied */
+        RTreeValuePin pin(rtree);
+        try {
+            rtree->Get(rqst->key, rqst->keySize, &valCtx.val, &valCtx.size,
+                       &valCtx.location);
+        } catch (...) {
+            /** @todo fix exception handling */
+            rc = StatusCode::UNKNOWN_ERROR;
+        }
+        if (valCtx.val && !_valOffloaded(valCtx)) {
+            /* released by the caller through MemMgr::freeValue */
+            char *data = MemMgr::allocValue(valCtx.size);
+            if (data) {
+                std::memcpy(data, valCtx.val, valCtx.size);
+                value = Value(data, valCtx.size);
+            } else {
+                valCtx.val = nullptr;
+                rc = StatusCode::PMEM_ALLOCATION_ERROR;
+            }
+        }
     }
 
     if (!valCtx.val) {
@@ -106,14 +131,14 @@ void PmemPoller::_processGet(const PmemRqst *rqst) {
         return;
     }
 
-    Value value(new char[valCtx.size], valCtx.size);
-    std::memcpy(value.data(), valCtx.val, valCtx.size);
     _rqstClb(rqst, StatusCode::OK, value);
 }
 void PmemPoller::_processPut(const PmemRqst *rqst) {
     StatusCode rc = StatusCode::OK;
     try {
         rtree->Put(rqst->key, rqst->keySize, rqst->value, rqst->valueSize);
+        if (tiering)
+            tiering->track(rqst->key, rqst->keySize);
     } catch (...) {
         /** @todo fix exception handling */
         rc = StatusCode::UNKNOWN_ERROR;
@@ -125,6 +150,7 @@ void PmemPoller::process() {
     if (requestCount > 0) {
         for (unsigned short RqstIdx = 0; RqstIdx < requestCount; RqstIdx++) {
             PmemRqst *rqst = requests[RqstIdx];
+            LatencyTracer::getInstance().stamp(rqst->trace, TRACE_POLLER);
 
             switch (rqst->op) {
             case RqstOperation::PUT:
@@ -137,6 +163,7 @@ void PmemPoller::process() {
             default:
                 break;
             }
+            LatencyTracer::getInstance().finish(rqst->trace);
             delete requests[RqstIdx];
         }
         requestCount = 0;
@@ -38,13 +38,15 @@ using PmemRqst = Rqst<RqstOperation>;
 
 class PmemPoller : public Poller<PmemRqst> {
   public:
-    PmemPoller(RTreeEngine *rtree, const size_t cpuCore = 0);
+    PmemPoller(RTreeEngine *rtree, const size_t cpuCore = 0,
+               PollerRingBackend ringBackend = PollerRingBackend::SPDK_RING);
     virtual ~PmemPoller();
 
     void process() final;
     void startThread();
 
-    OffloadPoller *offloadPoller = nullptr;
+    std::vector<OffloadPoller *> offloadPollers;
+    OffloadTiering *tiering = nullptr;
 
     std::atomic<int> isRunning;
     RTreeEngine *rtree;
@@ -52,9 +54,9 @@ class PmemPoller : public Poller<PmemRqst> {
   private:
     void _threadMain(void);
 
-    void _processGet(const PmemRqst *rqst);
+    void _processGet(PmemRqst *rqst);
     void _processPut(const PmemRqst *rqst);
-    void _processTransfer(const PmemRqst *rqst);
+    void _processTransfer(PmemRqst *rqst);
 
     inline void _rqstClb(const PmemRqst *rqst, StatusCode status) {
         if (rqst->clb)
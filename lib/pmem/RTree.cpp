@@ -17,6 +17,7 @@
 #include "RTree.h"
 #include <Logger.h>
 #include <daqdb/Types.h>
+#include <cstring>
 #include <iostream>
 
 namespace DaqDB {
@@ -167,11 +168,20 @@ void RTree::AllocateAndUpdateValueWrapper(const char *key, size_t size,
     if (valPrstPtr == nullptr)
         throw OperationFailedException(Status(PMEM_ALLOCATION_ERROR));
 
-    pmemobj_cancel(tree->_pm_pool.get_handle(), valPrstPtr->actionValue, 1);
-    delete[] valPrstPtr->actionValue;
-    valPrstPtr->actionValue = nullptr;
+    struct pobj_action actions[6];
+    int actionsCnt = 5;
+    if (valPrstPtr->location == DISK) {
+        /* value relocated on the device, old vector goes with the update */
+        pmemobj_defer_free(tree->_pm_pool.get_handle(),
+                           valPrstPtr->locationPtr.IOVptr.raw(), &actions[5]);
+        actionsCnt++;
+    } else {
+        pmemobj_cancel(tree->_pm_pool.get_handle(), valPrstPtr->actionValue,
+                       1);
+        delete[] valPrstPtr->actionValue;
+        valPrstPtr->actionValue = nullptr;
+    }
 
-    struct pobj_action actions[4];
     valPrstPtr->actionUpdate = actions;
 #ifdef USE_ALLOCATION_CLASSES
     valPrstPtr->locationPtr.IOVptr = pmemobj_xreserve(
@@ -193,13 +203,31 @@ void RTree::AllocateAndUpdateValueWrapper(const char *key, size_t size,
                       &val->locationPtr.IOVptr->busAddr.busAddr,
                       devAddr->busAddr.busAddr);
     pmemobj_set_value(tree->_pm_pool.get_handle(), &valPrstPtr->actionUpdate[3],
+                      &val->locationPtr.IOVptr->segAddr.segAddr,
+                      devAddr->segAddr.segAddr);
+    pmemobj_set_value(tree->_pm_pool.get_handle(), &valPrstPtr->actionUpdate[4],
                       reinterpret_cast<uint64_t *>(&(val->location).get_rw()),
                       DISK);
-    pmemobj_publish(tree->_pm_pool.get_handle(), valPrstPtr->actionUpdate, 4);
+    pmemobj_publish(tree->_pm_pool.get_handle(), valPrstPtr->actionUpdate,
+                    actionsCnt);
     valPrstPtr->actionUpdate = nullptr;
 
 }
 
+/*
+ * RTree does not lock its values, callers serialize updates of a key.
+ */
+bool RTree::RelocateValueWrapper(const char *key, size_t size,
+                                 const DeviceAddr *expected,
+                                 const DeviceAddr *devAddr) {
+    ValueWrapper *val = tree->findValueInNode(tree->treeRoot->rootNode, key);
+    if (val->location != DISK ||
+        memcmp(val->locationPtr.IOVptr.get(), expected, sizeof(*expected)))
+        return false;
+    AllocateAndUpdateValueWrapper(key, size, devAddr);
+    return true;
+}
+
 void Tree::allocateLevel(persistent_ptr<Node> current, int depth, int *count) {
     int i;
     depth++;
@@ -121,6 +121,9 @@ class RTree : public DaqDB::RTreeEngine {
     void AllocValueForKey(const char *key, size_t size, char **value) final;
     void AllocateAndUpdateValueWrapper(const char *key, size_t size,
                                        const DeviceAddr *devAddr) final;
+    bool RelocateValueWrapper(const char *key, size_t size,
+                              const DeviceAddr *expected,
+                              const DeviceAddr *devAddr) final;
 
   private:
     Tree *tree;
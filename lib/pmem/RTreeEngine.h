@@ -47,12 +47,24 @@ inline bool operator==(const struct PciAddr &l, const struct PciAddr &r) {
            l.func == r.func;
 }
 
+/*
+ * Values packed into a log segment are addressed by segment start block
+ * (lba) and their byte offset and size within the segment. Zero size marks
+ * a value written to its own LBA.
+ */
 struct DeviceAddr {
     uint64_t lba;
     union BusAddr {
         uint64_t busAddr;
         struct PciAddr pciAddr;
     } busAddr __attribute__((packed));
+    union SegAddr {
+        uint64_t segAddr;
+        struct {
+            uint32_t offset;
+            uint32_t size;
+        } seg;
+    } segAddr;
 };
 
 class RTreeEngine {
@@ -81,5 +93,33 @@ class RTreeEngine {
                                   char **value) = 0;
     virtual void AllocateAndUpdateValueWrapper(const char *key, size_t size,
                                                const DeviceAddr *devAddr) = 0;
+    /* as above if the value is still at expected, false otherwise */
+    virtual bool RelocateValueWrapper(const char *key, size_t size,
+                                      const DeviceAddr *expected,
+                                      const DeviceAddr *devAddr) = 0;
+    /* mapping of the persistent pool values live in, false if unknown */
+    virtual bool GetPoolRange(void **addr, size_t *size) { return false; }
+    /* bytes taken by values kept in PMEM and pool size, false if unknown */
+    virtual bool GetPoolUsage(size_t *used, size_t *size) { return false; }
+    /*
+     * PMEM values returned by Get while pinned are not freed by concurrent
+     * updates until unpinned, pin has to be passed to UnpinValues.
+     */
+    virtual unsigned int PinValues() { return 0; }
+    virtual void UnpinValues(unsigned int pin) {}
+};
+
+/*
+ * Keeps PMEM values got from the engine valid during the guard lifetime.
+ */
+class RTreeValuePin {
+  public:
+    explicit RTreeValuePin(RTreeEngine *rtree)
+        : _rtree(rtree), _pin(rtree->PinValues()) {}
+    ~RTreeValuePin() { _rtree->UnpinValues(_pin); }
+
+  private:
+    RTreeEngine *_rtree;
+    unsigned int _pin;
 };
 } // namespace DaqDB
@@ -14,11 +14,6 @@
  * limitations under the License.
  */
 
-#include "spdk/bdev.h"
-#include "spdk/env.h"
-#include "spdk/queue.h"
-#include "spdk/thread.h"
-
 #include <Logger.h>
 #include <PrimaryKeyNextQueue.h>
 
@@ -28,21 +23,20 @@ PrimaryKeyNextQueue::PrimaryKeyNextQueue(const DaqDB::Options &options)
     : PrimaryKeyBase(options) {
     DAQ_INFO("Initializing NextQueue for primary keys of size " +
              std::to_string(options.runtime.maxReadyKeys));
-    _readyKeys =
-        spdk_ring_create(SPDK_RING_TYPE_MP_MC, options.runtime.maxReadyKeys,
-                         SPDK_ENV_SOCKET_ID_ANY);
-    if (!_readyKeys) {
-        DAQ_CRITICAL("Cannnot create SPDK ring for ready keys");
-        throw OperationFailedException(SPDK_ALLOCATION_ERROR);
+    try {
+        _readyKeys = new LockFreeRing<char *>(options.runtime.maxReadyKeys,
+                                              RingType::MP_MC);
+    } catch (std::bad_alloc &e) {
+        DAQ_CRITICAL("Cannnot create ring for ready keys");
+        throw OperationFailedException(ENOMEM);
     }
 }
 
 PrimaryKeyNextQueue::~PrimaryKeyNextQueue() {
     char *pKeyBuff;
-    while (
-        spdk_ring_dequeue(_readyKeys, reinterpret_cast<void **>(&pKeyBuff), 1))
+    while (_readyKeys->dequeue(pKeyBuff))
         delete[] pKeyBuff;
-    spdk_ring_free(_readyKeys);
+    delete _readyKeys;
 }
 
 char *PrimaryKeyNextQueue::_createPKeyBuff(const char *srcKeyBuff) {
@@ -53,9 +47,7 @@ char *PrimaryKeyNextQueue::_createPKeyBuff(const char *srcKeyBuff) {
 
 void PrimaryKeyNextQueue::dequeueNext(Key &key) {
     char *pKeyBuff;
-    int cnt =
-        spdk_ring_dequeue(_readyKeys, reinterpret_cast<void **>(&pKeyBuff), 1);
-    if (!cnt)
+    if (!_readyKeys->dequeue(pKeyBuff))
         throw OperationFailedException(Status(KEY_NOT_FOUND));
     std::memset(key.data(), 0, _keySize);
     std::memcpy(key.data() + _pKeyOffset, pKeyBuff, _pKeySize);
@@ -66,9 +58,7 @@ void PrimaryKeyNextQueue::enqueueNext(const Key &key) {
     if (!isLocal(key))
         return;
     char *pKeyBuff = _createPKeyBuff(key.data());
-    int cnt =
-        spdk_ring_enqueue(_readyKeys, reinterpret_cast<void **>(&pKeyBuff), 1, 0);
-    if (!cnt) {
+    if (!_readyKeys->enqueue(pKeyBuff)) {
         delete[] pKeyBuff;
         throw OperationFailedException(QUEUE_FULL_ERROR);
     }
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <LockFreeRing.h>
 #include <PrimaryKeyBase.h>
 #include <daqdb/Key.h>
 #include <daqdb/Options.h>
@@ -32,7 +33,7 @@ class PrimaryKeyNextQueue : public DaqDB::PrimaryKeyBase {
   private:
     char *_createPKeyBuff(const char *srcKeyBuff);
 
-    struct spdk_ring *_readyKeys;
+    LockFreeRing<char *> *_readyKeys;
 };
 
 } // namespace DaqDB
@@ -39,8 +39,9 @@ std::ostringstream &BdevStats::formatWriteBuf(std::ostringstream &buf,
 std::ostringstream &BdevStats::formatReadBuf(std::ostringstream &buf,
                                              const char *bdev_addr) {
     buf << "bdev_addr[" << bdev_addr << "] read_compl_cnt[" << read_compl_cnt
-        << "] read_err_cnt[" << read_err_cnt << "] outs_io_cnt["
-        << outstanding_io_cnt << "]";
+        << "] read_err_cnt[" << read_err_cnt << "] read_merged_cnt["
+        << read_merged_cnt << "] read_ahead_hit_cnt[" << read_ahead_hit_cnt
+        << "] outs_io_cnt[" << outstanding_io_cnt << "]";
     return buf;
 }
 
@@ -36,13 +36,20 @@ struct BdevStats {
     uint64_t write_err_cnt;
     uint64_t read_compl_cnt;
     uint64_t read_err_cnt;
+    uint64_t read_merged_cnt;   // reads served by an IO of another read
+    uint64_t read_ahead_hit_cnt; // reads served from readahead windows
     bool periodic = true;
     uint64_t quant_per = (1 << 18);
-    uint64_t outstanding_io_cnt;
+    /*
+     * Read by JBOD write placement from offload threads
+     */
+    std::atomic<uint64_t> outstanding_io_cnt;
+    std::atomic<uint64_t> free_blk_cnt;
 
     BdevStats()
         : write_compl_cnt(0), write_err_cnt(0), read_compl_cnt(0),
-          read_err_cnt(0), outstanding_io_cnt(0) {}
+          read_err_cnt(0), read_merged_cnt(0), read_ahead_hit_cnt(0),
+          outstanding_io_cnt(0), free_blk_cnt(0) {}
     std::ostringstream &formatWriteBuf(std::ostringstream &buf,
                                        const char *bdev_addr);
     std::ostringstream &formatReadBuf(std::ostringstream &buf,
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <time.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -34,6 +35,7 @@
 #include "spdk/stdinc.h"
 #include "spdk/thread.h"
 
+#include "OffloadSegment.h"
 #include "Rqst.h"
 #include "SpdkBdev.h"
 #include <FinalizePoller.h>
@@ -42,9 +44,9 @@
 
 namespace DaqDB {
 
-//#define TEST_RAW_IOPS
-
 const char *SpdkBdev::lbaMgmtFileprefix = "/mnt/pmem/bdev_free_lba_list_";
+const char *SpdkBdev::segMgmtFileprefix = "/mnt/pmem/bdev_segments_";
+const uint64_t SpdkBdev::victimScanLimit = 4096;
 
 const unsigned int poolFreelistSize = 1ULL * 1024 * 1024 * 1024;
 const char *poolLayout = "queue";
@@ -62,7 +64,7 @@ SpdkBdev::SpdkBdev(bool enableStats)
     : state(SpdkBdevState::SPDK_BDEV_INIT), _spdkPoller(0), confBdevNum(-1),
       cpuCore(SpdkBdev::getCoreNum()), cpuCoreFin(cpuCore + 1),
       cpuCoreIoEng(cpuCoreFin + 1), finalizer(0), finalizerThread(0),
-      ioEngine(0), ioEngineThread(0), isRunning(0), statsEnabled(enableStats),
+      isRunning(0), _ioQueuesRunning(0), statsEnabled(enableStats),
       ioEngineInitDone(0), maxIoBufs(0), ioBufsInUse(0), maxCacheIoBufs(0),
       ioPoolMgr(SpdkIoBufMgr::getSpdkIoBufMgr()) {}
 
@@ -72,10 +74,24 @@ SpdkBdev::~SpdkBdev() {
     if (finalizer)
         delete finalizer;
 
-    if (ioEngineThread != nullptr)
-        ioEngineThread->join();
-    if (ioEngine)
-        delete ioEngine;
+    for (unsigned int idx = 0; idx < ioQueueCnt; idx++) {
+        SpdkIoQueue &queue = ioQueues[idx];
+        if (queue.thread != nullptr)
+            queue.thread->join();
+        if (queue.engine)
+            delete queue.engine;
+        _dropLbaCache(queue);
+        _dropReadAhead(queue);
+    }
+
+    /* extents waiting for unmap are reused without it */
+    unmapQueue.drain(_unmapBatch);
+    for (auto &extent : _unmapBatch)
+        _reclaimExtent(extent.lba, extent.blocks);
+    if (lbaAllocator)
+        delete lbaAllocator;
+    if (segAllocator)
+        delete segAllocator;
 }
 
 size_t SpdkBdev::getCoreNum() {
@@ -98,6 +114,12 @@ bool SpdkBdev::isIOQuiescent() {
 
 void SpdkBdev::IOAbort() { _IoState = SpdkBdev::IOState::BDEV_IO_ABORTED; }
 
+static inline char *taskBuf(DeviceTask *task) {
+    if (task->segment)
+        return task->segment->buf;
+    return task->dmaBuf ? task->dmaBuf : task->buff->getSpdkDmaBuf();
+}
+
 /*
  * Callback function for a write IO completion.
  */
@@ -105,12 +127,12 @@ void SpdkBdev::writeComplete(struct spdk_bdev_io *bdev_io, bool success,
                              void *cb_arg) {
     BdevTask *task = reinterpret_cast<DeviceTask *>(cb_arg);
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
-    bdev->ioPoolMgr->putIoWriteBuf(task->buff);
+    bdev->_putWriteBuf(task);
     bdev->ioBufsInUse--;
+    bdev->_writesCompleted++;
 
-#ifndef TEST_RAW_IOPS
-    spdk_bdev_free_io(bdev_io);
-#endif
+    if (bdev_io)
+        spdk_bdev_free_io(bdev_io);
 
     if (bdev->stats.outstanding_io_cnt)
         bdev->stats.outstanding_io_cnt--;
@@ -119,6 +141,7 @@ void SpdkBdev::writeComplete(struct spdk_bdev_io *bdev_io, bool success,
     (void)bdev->stateMachine();
 
     task->result = success;
+    LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_COMPLETE);
     if (bdev->statsEnabled == true && success == true)
         bdev->stats.printWritePer(std::cout, bdev->spBdevCtx.bdev_addr);
     bdev->finalizer->enqueue(task);
@@ -132,9 +155,8 @@ void SpdkBdev::readComplete(struct spdk_bdev_io *bdev_io, bool success,
     BdevTask *task = reinterpret_cast<DeviceTask *>(cb_arg);
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
 
-#ifndef TEST_RAW_IOPS
-    spdk_bdev_free_io(bdev_io);
-#endif
+    if (bdev_io)
+        spdk_bdev_free_io(bdev_io);
 
     if (bdev->stats.outstanding_io_cnt)
         bdev->stats.outstanding_io_cnt--;
@@ -143,6 +165,7 @@ void SpdkBdev::readComplete(struct spdk_bdev_io *bdev_io, bool success,
     (void)bdev->stateMachine();
 
     task->result = success;
+    LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_COMPLETE);
     if (bdev->statsEnabled == true && success == true)
         bdev->stats.printReadPer(std::cout, bdev->spBdevCtx.bdev_addr);
     bdev->finalizer->enqueue(task);
@@ -156,16 +179,15 @@ void SpdkBdev::readQueueIoWait(void *cb_arg) {
     BdevTask *task = reinterpret_cast<DeviceTask *>(cb_arg);
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
 
-    int r_rc = spdk_bdev_read_blocks(
-        bdev->spBdevCtx.bdev_desc, bdev->spBdevCtx.io_channel,
-        task->buff->getSpdkDmaBuf(), task->blockSize * task->bdevAddr->lba,
-        task->blockSize, SpdkBdev::readComplete, task);
+    int r_rc = bdev->submitRead(bdev->_ioQueue(task), taskBuf(task),
+                                task->blockOffset, task->blockSize,
+                                SpdkBdev::readComplete, task);
 
     /* If a read IO still fails due to shortage of io buffers, queue it up for
      * later execution */
     if (r_rc) {
         r_rc = spdk_bdev_queue_io_wait(bdev->spBdevCtx.bdev,
-                                       bdev->spBdevCtx.io_channel,
+                                       bdev->_ioQueue(task).channel,
                                        &task->bdev_io_wait);
         if (r_rc) {
             DAQ_CRITICAL("Spdk queue_io_wait error [" + std::to_string(r_rc) +
@@ -186,16 +208,13 @@ void SpdkBdev::writeQueueIoWait(void *cb_arg) {
     BdevTask *task = reinterpret_cast<DeviceTask *>(cb_arg);
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
 
-    int w_rc = spdk_bdev_write_blocks(
-        bdev->spBdevCtx.bdev_desc, bdev->spBdevCtx.io_channel,
-        task->buff->getSpdkDmaBuf(), task->blockSize * task->freeLba,
-        task->blockSize, SpdkBdev::writeComplete, task);
+    int w_rc = bdev->_submitWrite(task);
 
     /* If a write IO still fails due to shortage of io buffers, queue it up for
      * later execution */
     if (w_rc) {
         w_rc = spdk_bdev_queue_io_wait(bdev->spBdevCtx.bdev,
-                                       bdev->spBdevCtx.io_channel,
+                                       bdev->_ioQueue(task).channel,
                                        &task->bdev_io_wait);
         if (w_rc) {
             DAQ_CRITICAL("Spdk queue_io_wait error [" + std::to_string(w_rc) +
@@ -209,37 +228,40 @@ void SpdkBdev::writeQueueIoWait(void *cb_arg) {
 }
 
 bool SpdkBdev::read(DeviceTask *task) {
-    if (ioEngine && task->routing == true)
-        return ioEngine->enqueue(task);
+    if (ioQueueCnt && task->routing == true)
+        return _ioQueue(task).engine->enqueue(task);
     return doRead(task);
 }
 
 bool SpdkBdev::doRead(DeviceTask *task) {
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
     if (stateMachine() == true) {
-        if (task->buff)
-            ioPoolMgr->putIoReadBuf(task->buff);
+        bdev->_putReadBuf(task);
         bdev->ioBufsInUse--;
         return false;
     }
 
-    size_t algnSize = bdev->getAlignedSize(task->rqst->valueSize);
-    auto blkSize = bdev->getSizeInBlk(algnSize);
-    task->blockSize = blkSize;
+    bdev->_setReadExtent(task);
 
     bdev->ioBufsInUse++;
-    task->buff = ioPoolMgr->getIoReadBuf(task->size, bdev->spBdevCtx.buf_align);
-
-#ifdef TEST_RAW_IOPS
-    int r_rc = 0;
-    SpdkBdev::readComplete(reinterpret_cast<struct spdk_bdev_io *>(task->buff),
-                           true, task);
-#else
-    int r_rc = spdk_bdev_read_blocks(
-        bdev->spBdevCtx.bdev_desc, bdev->spBdevCtx.io_channel,
-        task->buff->getSpdkDmaBuf(), task->blockSize * task->bdevAddr->lba,
-        task->blockSize, SpdkBdev::readComplete, task);
-#endif
+    if (task->segment) {
+        /* segment is read into its own buffer */
+    } else if (task->rqst->handOver) {
+        task->dmaBuf = reinterpret_cast<char *>(
+            spdk_dma_malloc(task->size, bdev->spBdevCtx.buf_align, NULL));
+        if (!task->dmaBuf) {
+            bdev->ioBufsInUse--;
+            return false;
+        }
+    } else {
+        task->buff =
+            ioPoolMgr->getIoReadBuf(task->size, bdev->spBdevCtx.buf_align);
+    }
+    LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_SUBMIT);
+
+    int r_rc = bdev->submitRead(bdev->_ioQueue(task), taskBuf(task),
+                                task->blockOffset, task->blockSize,
+                                SpdkBdev::readComplete, task);
     bdev->stats.outstanding_io_cnt++;
 
     if (r_rc) {
@@ -254,16 +276,14 @@ bool SpdkBdev::doRead(DeviceTask *task) {
             if (r_rc) {
                 DAQ_CRITICAL("Spdk queue_io_wait error [" +
                              std::to_string(r_rc) + "] for spdk bdev");
-                if (task->buff)
-                    ioPoolMgr->putIoReadBuf(task->buff);
+                bdev->_putReadBuf(task);
                 bdev->deinit();
                 spdk_app_stop(-1);
             }
         } else {
             DAQ_CRITICAL("Spdk read error [" + std::to_string(r_rc) +
                          "] for spdk bdev");
-            if (task->buff)
-                ioPoolMgr->putIoReadBuf(task->buff);
+            bdev->_putReadBuf(task);
             bdev->deinit();
             spdk_app_stop(-1);
         }
@@ -272,41 +292,208 @@ bool SpdkBdev::doRead(DeviceTask *task) {
     return !r_rc ? true : false;
 }
 
+/*
+ * Reads of log segments and hand over reads get their own IO. Other reads are
+ * merged by their blocks, a range read at the block following the last read
+ * of the queue is extended by the readahead window.
+ */
+size_t SpdkBdev::readBatch(std::vector<DeviceTask *> &tasks) {
+    if (tasks.empty() || stateMachine() == true)
+        return tasks.size();
+
+    SpdkIoQueue &queue = _ioQueue(tasks.front());
+    uint64_t maxBlocks = SPDK_IO_BUF_MAX_SIZE / spBdevCtx.blk_size;
+    size_t failed = 0;
+
+    queue.readTasks.clear();
+    queue.readExtents.clear();
+    for (auto task : tasks) {
+        if (task->segment || task->rqst->handOver) {
+            if (doRead(task) != true)
+                tasks[failed++] = task;
+            continue;
+        }
+        _setReadExtent(task);
+        if (_readCached(queue, task))
+            continue;
+        queue.readExtents.push_back(
+            {task->blockOffset, task->blockSize, queue.readTasks.size()});
+        queue.readTasks.push_back(task);
+    }
+
+    mergeReadExtents(queue.readExtents, maxBlocks, queue.readRanges);
+    for (auto &range : queue.readRanges) {
+        uint64_t ahead = 0;
+        if (_readAheadBlocks && range.lba == queue.readNext &&
+            range.blocks < maxBlocks) {
+            ahead = std::min(_readAheadBlocks, maxBlocks - range.blocks);
+            ahead = std::min(ahead, spBdevCtx.blk_num -
+                                        (range.lba + range.blocks));
+        }
+        queue.readNext = range.lba + range.blocks;
+
+        if ((range.cnt > 1 || ahead) && _readGroup(queue, range, ahead))
+            continue;
+        /* single read or merged IO not submitted, read one by one */
+        for (size_t idx = range.first; idx < range.first + range.cnt; idx++) {
+            DeviceTask *task = queue.readTasks[queue.readExtents[idx].idx];
+            if (doRead(task) != true)
+                tasks[failed++] = task;
+        }
+    }
+
+    tasks.resize(failed);
+    return failed;
+}
+
+/*
+ * Completes a read from the readahead window of the queue. The window is
+ * dropped once anything was written to the device after it was read.
+ */
+bool SpdkBdev::_readCached(SpdkIoQueue &queue, DeviceTask *task) {
+    SpdkReadAhead &window = queue.readAhead;
+    if (!window.buf)
+        return false;
+    if (window.writeGen != _writesSubmitted) {
+        _dropReadAhead(queue);
+        return false;
+    }
+    if (task->blockOffset < window.lba ||
+        task->blockOffset + task->blockSize > window.lba + window.blocks)
+        return false;
+
+    uint32_t blkSize = spBdevCtx.blk_size;
+    size_t size = task->blockSize * blkSize;
+    ioBufsInUse++;
+    task->buff = ioPoolMgr->getIoReadBuf(size, spBdevCtx.buf_align);
+    memcpy(task->buff->getSpdkDmaBuf(),
+           window.buf->getSpdkDmaBuf() +
+               (task->blockOffset - window.lba) * blkSize,
+           size);
+    queue.readNext = task->blockOffset + task->blockSize;
+    stats.read_ahead_hit_cnt++;
+
+    task->result = true;
+    LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_COMPLETE);
+    finalizer->enqueue(task);
+    return true;
+}
+
+/*
+ * Reads range of merged extents and given number of blocks past it with a
+ * single IO. Window is kept only if no write was in flight when the IO was
+ * submitted, otherwise it might hold blocks from before that write.
+ */
+bool SpdkBdev::_readGroup(SpdkIoQueue &queue, const OffloadReadRange &range,
+                          uint64_t ahead) {
+    SpdkReadGroup *group = new SpdkReadGroup();
+    group->bdev = this;
+    group->queue = &queue;
+    group->lba = range.lba;
+    group->blocks = range.blocks + ahead;
+    group->writeGen = _writesSubmitted;
+    group->keep = _readAheadBlocks && group->writeGen == _writesCompleted;
+    group->buf = ioPoolMgr->getIoReadBuf(group->blocks * spBdevCtx.blk_size,
+                                         spBdevCtx.buf_align);
+    for (size_t idx = range.first; idx < range.first + range.cnt; idx++) {
+        DeviceTask *task = queue.readTasks[queue.readExtents[idx].idx];
+        LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_SUBMIT);
+        group->tasks.push_back(task);
+    }
+
+    ioBufsInUse += range.cnt;
+    stats.outstanding_io_cnt++;
+    int r_rc = submitRead(queue, group->buf->getSpdkDmaBuf(), group->lba,
+                          group->blocks, SpdkBdev::readGroupComplete, group);
+    if (r_rc) {
+        ioBufsInUse -= range.cnt;
+        stats.outstanding_io_cnt--;
+        ioPoolMgr->putIoReadBuf(group->buf);
+        delete group;
+        return false;
+    }
+
+    stats.read_merged_cnt += range.cnt - 1;
+    return true;
+}
+
+/*
+ * Callback function for a merged read IO completion. Each task gets its own
+ * copy of its blocks, so buffers are released by the finalizer as for single
+ * reads.
+ */
+void SpdkBdev::readGroupComplete(struct spdk_bdev_io *bdev_io, bool success,
+                                 void *cb_arg) {
+    SpdkReadGroup *group = reinterpret_cast<SpdkReadGroup *>(cb_arg);
+    SpdkBdev *bdev = group->bdev;
+    uint32_t blkSize = bdev->spBdevCtx.blk_size;
+
+    if (bdev_io)
+        spdk_bdev_free_io(bdev_io);
+
+    if (bdev->stats.outstanding_io_cnt)
+        bdev->stats.outstanding_io_cnt--;
+
+    bdev->stats.read_compl_cnt++;
+    (void)bdev->stateMachine();
+
+    for (auto task : group->tasks) {
+        task->buff = nullptr;
+        if (success) {
+            size_t size = task->blockSize * blkSize;
+            task->buff = bdev->ioPoolMgr->getIoReadBuf(
+                size, bdev->spBdevCtx.buf_align);
+            memcpy(task->buff->getSpdkDmaBuf(),
+                   group->buf->getSpdkDmaBuf() +
+                       (task->blockOffset - group->lba) * blkSize,
+                   size);
+        }
+        task->result = success;
+        LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_COMPLETE);
+        bdev->finalizer->enqueue(task);
+    }
+    if (bdev->statsEnabled == true && success == true)
+        bdev->stats.printReadPer(std::cout, bdev->spBdevCtx.bdev_addr);
+
+    if (success && group->keep) {
+        SpdkIoQueue &queue = *group->queue;
+        bdev->_dropReadAhead(queue);
+        queue.readAhead.buf = group->buf;
+        queue.readAhead.lba = group->lba;
+        queue.readAhead.blocks = group->blocks;
+        queue.readAhead.writeGen = group->writeGen;
+    } else {
+        bdev->ioPoolMgr->putIoReadBuf(group->buf);
+    }
+    delete group;
+}
+
+void SpdkBdev::_dropReadAhead(SpdkIoQueue &queue) {
+    if (queue.readAhead.buf)
+        ioPoolMgr->putIoReadBuf(queue.readAhead.buf);
+    queue.readAhead = SpdkReadAhead();
+}
+
 bool SpdkBdev::write(DeviceTask *task) {
-    if (ioEngine && task->routing == true)
-        return ioEngine->enqueue(task);
+    if (ioQueueCnt && task->routing == true)
+        return _ioQueue(task).engine->enqueue(task);
     return doWrite(task);
 }
 
 bool SpdkBdev::doWrite(DeviceTask *task) {
     SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
     if (stateMachine() == true) {
-        if (task->buff)
-            ioPoolMgr->putIoWriteBuf(task->buff);
+        _putWriteBuf(task);
         bdev->ioBufsInUse--;
         return false;
     }
 
-    auto valSize = task->rqst->valueSize;
-    auto valSizeAlign = bdev->getAlignedSize(valSize);
-    if (task->rqst->loc == LOCATIONS::PMEM)
-        task->freeLba = getFreeLba(valSize);
-    bdev->ioBufsInUse++;
-    task->buff =
-        ioPoolMgr->getIoWriteBuf(valSizeAlign, bdev->spBdevCtx.buf_align);
-
-    memcpy(task->buff->getSpdkDmaBuf(), task->rqst->value, valSize);
+    if (bdev->_setWriteExtent(task) != true)
+        return false;
+    _writesSubmitted++;
+    LatencyTracer::getInstance().stamp(taskTrace(task), TRACE_IO_SUBMIT);
 
-#ifdef TEST_RAW_IOPS
-    int w_rc = 0;
-    SpdkBdev::writeComplete(reinterpret_cast<struct spdk_bdev_io *>(task->buff),
-                            true, task);
-#else
-    int w_rc = spdk_bdev_write_blocks(
-        bdev->spBdevCtx.bdev_desc, bdev->spBdevCtx.io_channel,
-        task->buff->getSpdkDmaBuf(), task->blockSize * task->freeLba,
-        task->blockSize, SpdkBdev::writeComplete, task);
-#endif
+    int w_rc = _submitWrite(task);
     bdev->stats.outstanding_io_cnt++;
 
     if (w_rc) {
@@ -321,27 +508,192 @@ bool SpdkBdev::doWrite(DeviceTask *task) {
             if (w_rc) {
                 DAQ_CRITICAL("Spdk queue_io_wait error [" +
                              std::to_string(w_rc) + "] for spdk bdev");
-                if (task->buff)
-                    ioPoolMgr->putIoWriteBuf(task->buff);
+                _putWriteBuf(task);
                 bdev->deinit();
                 spdk_app_stop(-1);
             }
         } else {
             DAQ_CRITICAL("Spdk write error [" + std::to_string(w_rc) +
                          "] for spdk bdev");
-            if (task->buff)
-                ioPoolMgr->putIoWriteBuf(task->buff);
+            _putWriteBuf(task);
             bdev->deinit();
             spdk_app_stop(-1);
         }
     }
+    /* segment was not written, return it before the writer drops it */
+    if (w_rc && task->segment)
+        commitSegment(task->freeLba, 0);
 
     return !w_rc ? true : false;
 }
 
+/*
+ * Values packed into a log segment are read with the blocks covering them,
+ * the value starts bufOffset bytes into the read buffer. Whole segments are
+ * read into their own buffer by the compactor.
+ */
+void SpdkBdev::_setReadExtent(DeviceTask *task) {
+    const DeviceAddr *addr = task->bdevAddr;
+    if (task->segment) {
+        task->blockOffset = task->freeLba;
+        task->bufOffset = 0;
+        task->buff = nullptr;
+    } else if (addr->segAddr.seg.size) {
+        uint32_t blkSize = spBdevCtx.blk_size;
+        uint64_t offset = addr->segAddr.seg.offset;
+        task->blockOffset = addr->lba + offset / blkSize;
+        task->bufOffset = offset % blkSize;
+        task->blockSize =
+            (task->bufOffset + addr->segAddr.seg.size + blkSize - 1) / blkSize;
+        task->size = getOptimalSize(task->blockSize * blkSize);
+    } else {
+        size_t algnSize = getAlignedSize(task->rqst->valueSize);
+        task->blockSize = getSizeInBlk(algnSize);
+        task->blockOffset = addr->lba;
+        task->bufOffset = 0;
+    }
+}
+
+/*
+ * Log segments are written from their own buffer to a free segment, other
+ * values are copied into an IO buffer and written to an LBA sized for them.
+ */
+bool SpdkBdev::_setWriteExtent(DeviceTask *task) {
+    if (task->segment) {
+        int64_t segLba = getFreeSegment();
+        if (segLba < 0) {
+            DAQ_CRITICAL(std::string("No free log segment on bdev[") +
+                         spBdevCtx.bdev_name + "]");
+            return false;
+        }
+        task->freeLba = segLba;
+        task->blockOffset = segLba;
+        task->buff = nullptr;
+        ioBufsInUse++;
+        return true;
+    }
+
+    auto valSize = task->rqst->valueSize;
+    auto valSizeAlign = getAlignedSize(valSize);
+    if (task->rqst->loc == LOCATIONS::PMEM) {
+        int64_t lba = _getCachedLba(_ioQueue(task), valSizeAlign);
+        if (lba < 0) {
+            DAQ_CRITICAL(std::string("No free extent on bdev[") +
+                         spBdevCtx.bdev_name + "]");
+            return false;
+        }
+        task->freeLba = lba;
+    }
+    task->blockOffset = task->freeLba;
+    ioBufsInUse++;
+    /*
+     * Values in the PMEM pool registered for DMA are written in place. The
+     * last partial block is staged in a pooled buffer, the padding up to the
+     * block boundary must not carry other records of the pool.
+     */
+    size_t inPlace = valSize - valSize % spBdevCtx.blk_size;
+    if (inPlace && ioPoolMgr->isDmaRegion(task->rqst->value, inPlace,
+                                          spBdevCtx.buf_align)) {
+        char *value = const_cast<char *>(task->rqst->value);
+        if (inPlace == valSizeAlign) {
+            task->buff = nullptr;
+            task->dmaBuf = value;
+            return true;
+        }
+        size_t tail = valSizeAlign - inPlace;
+        size_t tailLen = valSize - inPlace;
+        task->buff = ioPoolMgr->getIoWriteBuf(tail, spBdevCtx.buf_align);
+        char *tailBuf = task->buff->getSpdkDmaBuf();
+        memcpy(tailBuf, value + inPlace, tailLen);
+        memset(tailBuf + tailLen, 0, tail - tailLen);
+        task->ioVec = new SpdkIoVec();
+        task->ioVec->iovs.push_back({value, inPlace});
+        task->ioVec->iovs.push_back({tailBuf, tail});
+        return true;
+    }
+    /*
+     * Values above the largest pooled buffer are staged in pooled chunks and
+     * written with a single vectored IO.
+     */
+    if (valSizeAlign > SPDK_IO_BUF_MAX_SIZE) {
+        task->buff = nullptr;
+        task->ioVec =
+            ioPoolMgr->getIoWriteVec(valSizeAlign, spBdevCtx.buf_align);
+        task->ioVec->copyIn(task->rqst->value, valSize);
+        return true;
+    }
+    task->buff = ioPoolMgr->getIoWriteBuf(valSizeAlign, spBdevCtx.buf_align);
+
+    memcpy(task->buff->getSpdkDmaBuf(), task->rqst->value, valSize);
+    return true;
+}
+
+int SpdkBdev::_submitWrite(DeviceTask *task) {
+    if (task->ioVec)
+        return submitWritev(_ioQueue(task), task->ioVec->iovs.data(),
+                            task->ioVec->iovs.size(), task->blockOffset,
+                            task->blockSize, SpdkBdev::writeComplete, task);
+    return submitWrite(_ioQueue(task), taskBuf(task), task->blockOffset,
+                       task->blockSize, SpdkBdev::writeComplete, task);
+}
+
+int SpdkBdev::submitRead(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                         uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                         void *arg) {
+    return spdk_bdev_read_blocks(spBdevCtx.bdev_desc, queue.channel, buf, lba,
+                                 blocks, cb, arg);
+}
+
+int SpdkBdev::submitWrite(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                          uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                          void *arg) {
+    return spdk_bdev_write_blocks(spBdevCtx.bdev_desc, queue.channel, buf, lba,
+                                  blocks, cb, arg);
+}
+
+int SpdkBdev::submitWritev(SpdkIoQueue &queue, struct iovec *iov, int iovcnt,
+                           uint64_t lba, uint64_t blocks,
+                           spdk_bdev_io_completion_cb cb, void *arg) {
+    return spdk_bdev_writev_blocks(spBdevCtx.bdev_desc, queue.channel, iov,
+                                   iovcnt, lba, blocks, cb, arg);
+}
+
+int SpdkBdev::submitUnmap(SpdkIoQueue &queue, uint64_t lba, uint64_t blocks,
+                          spdk_bdev_io_completion_cb cb, void *arg) {
+    return spdk_bdev_unmap_blocks(spBdevCtx.bdev_desc, queue.channel, lba,
+                                  blocks, cb, arg);
+}
+
+/*
+ * Vector of an in-place write holds no chunks, its staged tail is the task
+ * buffer.
+ */
+void SpdkBdev::_putWriteBuf(DeviceTask *task) {
+    if (task->ioVec) {
+        ioPoolMgr->putIoWriteVec(task->ioVec);
+        task->ioVec = nullptr;
+    }
+    if (task->buff) {
+        ioPoolMgr->putIoWriteBuf(task->buff);
+        task->buff = nullptr;
+    }
+}
+
+/*
+ * Releases read buffer of a task that did not reach the finalizer.
+ */
+void SpdkBdev::_putReadBuf(DeviceTask *task) {
+    if (task->dmaBuf) {
+        spdk_dma_free(task->dmaBuf);
+        task->dmaBuf = nullptr;
+    } else if (task->buff) {
+        ioPoolMgr->putIoReadBuf(task->buff);
+    }
+}
+
 bool SpdkBdev::remove(DeviceTask *task) {
-    if (ioEngine && task->routing == true)
-        return ioEngine->enqueue(task);
+    if (ioQueueCnt && task->routing == true)
+        return _ioQueue(task).engine->enqueue(task);
     return doRemove(task);
 }
 
@@ -351,10 +703,7 @@ bool SpdkBdev::doRemove(DeviceTask *task) {
         return false;
     }
 
-    auto valSize = task->rqst->valueSize;
-    auto valSizeAlign = getAlignedSize(valSize);
-
-    putFreeLba(task->bdevAddr, valSizeAlign);
+    /* device space is released by the finalizer once the key is removed */
     task->result = true;
     return finalizer->enqueue(task);
 }
@@ -367,51 +716,212 @@ int SpdkBdev::reschedule(DeviceTask *task) {
     task->bdev_io_wait.cb_arg = task;
 
     return spdk_bdev_queue_io_wait(
-        bdev->spBdevCtx.bdev, bdev->spBdevCtx.io_channel, &task->bdev_io_wait);
+        bdev->spBdevCtx.bdev, bdev->_ioQueue(task).channel,
+        &task->bdev_io_wait);
 }
 
 void SpdkBdev::deinit() {
     isRunning = 4;
     while (isRunning == 4) {
     }
-    spdk_put_io_channel(spBdevCtx.io_channel);
+    for (unsigned int idx = 0; idx < ioQueueCnt; idx++) {
+        if (ioQueues[idx].channel)
+            spdk_put_io_channel(ioQueues[idx].channel);
+    }
     spdk_bdev_close(spBdevCtx.bdev_desc);
 }
 
 struct spdk_bdev *SpdkBdev::prevBdev = 0;
 
 int64_t SpdkBdev::getFreeLba(size_t ioSize) {
-    return lbaAllocator->getLba(ioSize);
+    uint32_t blocks = getSizeInBlk(ioSize);
+    int64_t lba = lbaAllocator->getLba(blocks);
+    if (lba >= 0)
+        stats.free_blk_cnt -= lbaAllocator->getExtentBlocks(blocks);
+    return lba;
 }
 
 void SpdkBdev::putFreeLba(const DeviceAddr *devAddr, size_t ioSize) {
-    lbaAllocator->putLba(devAddr->lba, ioSize);
+    if (segAllocator) {
+        if (devAddr->segAddr.seg.size &&
+            segAllocator->release(devAddr->lba, devAddr->segAddr.seg.size))
+            _releaseExtent(devAddr->lba, segmentBlocks);
+        return;
+    }
+    _releaseExtent(devAddr->lba,
+                   lbaAllocator->getExtentBlocks(getSizeInBlk(ioSize)));
+}
+
+int64_t SpdkBdev::getFreeSegment() {
+    int64_t lba = segAllocator ? segAllocator->get() : -1;
+    if (lba >= 0)
+        stats.free_blk_cnt -= segmentBlocks;
+    return lba;
+}
+
+void SpdkBdev::commitSegment(uint64_t lba, uint32_t liveBytes) {
+    if (segAllocator && segAllocator->commit(lba, liveBytes))
+        _releaseExtent(lba, segmentBlocks);
+}
+
+void SpdkBdev::_releaseExtent(uint64_t lba, uint64_t blocks) {
+    if (releaseHandler)
+        releaseHandler(spBdevCtx.pci_addr, lba, blocks);
+    if (_unmapSupported)
+        unmapQueue.push(lba, blocks, LatencyTracer::now());
+    else
+        _reclaimExtent(lba, blocks);
+}
+
+void SpdkBdev::_reclaimExtent(uint64_t lba, uint64_t blocks) {
+    if (segAllocator)
+        segAllocator->put(lba);
+    else
+        lbaAllocator->putLba(lba, blocks);
+    stats.free_blk_cnt += blocks;
+}
+
+uint64_t SpdkBdev::getQueueDepth() {
+    uint64_t depth = stats.outstanding_io_cnt;
+    for (unsigned int idx = 0; idx < ioQueueCnt; idx++)
+        depth += ioQueues[idx].engine->count();
+    return depth;
+}
+
+/*
+ * Values not packed into segments are written to extents cached per queue
+ * and extent size, each cache is refilled from the allocator in batches so
+ * that IO engine threads rarely contend on it. Sizes beyond the cached
+ * classes are allocated one at a time. Extents cached when the process dies
+ * stay allocated, like frees not yet persisted.
+ */
+int64_t SpdkBdev::_getCachedLba(SpdkIoQueue &queue, size_t ioSize) {
+    uint64_t blocks = lbaAllocator->getExtentBlocks(getSizeInBlk(ioSize));
+    auto cache = queue.lbaCache.find(blocks);
+    if (cache == queue.lbaCache.end()) {
+        if (queue.lbaCache.size() >= SPDK_LBA_CACHE_CLASSES) {
+            int64_t lba = lbaAllocator->getLba(blocks);
+            if (lba >= 0)
+                stats.free_blk_cnt -= blocks;
+            return lba;
+        }
+        cache = queue.lbaCache.emplace(blocks, std::vector<uint64_t>()).first;
+    }
+    std::vector<uint64_t> &lbas = cache->second;
+    if (lbas.empty()) {
+        size_t cnt = lbaAllocator->getLbas(blocks, SPDK_LBA_CACHE_SIZE, lbas);
+        if (!cnt)
+            return -1;
+        stats.free_blk_cnt -= cnt * blocks;
+    }
+    uint64_t lba = lbas.back();
+    lbas.pop_back();
+    return static_cast<int64_t>(lba);
+}
+
+void SpdkBdev::_dropLbaCache(SpdkIoQueue &queue) {
+    for (auto &cache : queue.lbaCache) {
+        for (auto lba : cache.second) {
+            lbaAllocator->putLba(lba, cache.first);
+            stats.free_blk_cnt += cache.first;
+        }
+    }
+    queue.lbaCache.clear();
+}
+
+/*
+ * Called in the first IO engine thread. Freed extents are unmapped in
+ * batches with adjacent ones merged, a single batch is in flight at a time.
+ * Extents of the batch are reused once all its unmaps complete, failed
+ * unmaps only delay device garbage collection.
+ */
+void SpdkBdev::processUnmaps() {
+    if (_unmapsInFlight || !unmapQueue.take(LatencyTracer::now(), _unmapBatch))
+        return;
+    OffloadUnmapQueue::merge(_unmapBatch, _unmapRanges);
+
+    /* held until all unmaps of the batch are submitted */
+    _unmapsInFlight = 1;
+    for (auto &range : _unmapRanges) {
+        _unmapsInFlight++;
+        int rc = submitUnmap(ioQueues[0], range.lba, range.blocks,
+                             SpdkBdev::unmapComplete, this);
+        if (rc) {
+            DAQ_DEBUG("Spdk unmap error [" + std::to_string(rc) +
+                      "] for lba [" + std::to_string(range.lba) + "]");
+            _unmapsInFlight--;
+        }
+    }
+    _unmapDone();
+}
+
+void SpdkBdev::unmapComplete(struct spdk_bdev_io *bdev_io, bool success,
+                             void *cb_arg) {
+    SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(cb_arg);
+    if (bdev_io)
+        spdk_bdev_free_io(bdev_io);
+    if (!success)
+        DAQ_DEBUG(std::string("Unmap failed on bdev[") +
+                  bdev->spBdevCtx.bdev_name + "]");
+    bdev->_unmapDone();
+}
+
+void SpdkBdev::_unmapDone() {
+    if (--_unmapsInFlight)
+        return;
+    for (auto &extent : _unmapBatch)
+        _reclaimExtent(extent.lba, extent.blocks);
+    _unmapBatch.clear();
+}
+
+SpdkDevice *SpdkBdev::getCompactionVictim(uint32_t maxLiveBytes,
+                                          unsigned int freePercent,
+                                          uint64_t &lba) {
+    if (!segAllocator || segAllocator->getFreeCount() * 100 >=
+                             segAllocator->getSegmentCount() * freePercent)
+        return nullptr;
+    int64_t victim = segAllocator->findVictim(maxLiveBytes, victimScanLimit);
+    if (victim < 0)
+        return nullptr;
+    lba = victim;
+    return this;
 }
 
 void SpdkBdev::initFreeList() {
+    if (segmentBlocks) {
+        std::string fileName = std::string(SpdkBdev::segMgmtFileprefix) +
+                               spBdevCtx.bdev_name + ".pm";
+        segAllocator =
+            new OffloadSegmentAlloc(fileName, spBdevCtx.blk_num, segmentBlocks);
+        stats.free_blk_cnt = segAllocator->getFreeCount() * segmentBlocks;
+        return;
+    }
     std::string fileName =
         std::string(SpdkBdev::lbaMgmtFileprefix) + spBdevCtx.bdev_name + ".pm";
     lbaAllocator =
-        new OffloadLbaAlloc(true, fileName, spBdevCtx.blk_num, blkNumForLba);
+        new OffloadLbaAlloc(fileName, spBdevCtx.blk_num, blkNumForLba);
+    stats.free_blk_cnt =
+        lbaAllocator->getFreeUnits() * lbaAllocator->getUnitBlocks();
 }
 
-bool SpdkBdev::bdevInit() {
-    if (confBdevNum == -1) { // single Bdev
-        spBdevCtx.bdev = spdk_bdev_first();
-    } else { // JBOD or RAID0
-        if (!confBdevNum) {
-            spBdevCtx.bdev = spdk_bdev_first_leaf();
-            SpdkBdev::prevBdev = spBdevCtx.bdev;
-        } else if (confBdevNum > 0) {
-            spBdevCtx.bdev = spdk_bdev_next_leaf(SpdkBdev::prevBdev);
-            SpdkBdev::prevBdev = spBdevCtx.bdev;
-        } else {
-            DAQ_CRITICAL("Get leaf BDEV failed");
-            spBdevCtx.state = SPDK_BDEV_NOT_FOUND;
-            return false;
-        }
+struct spdk_bdev *SpdkBdev::lookupBdev() {
+    if (confBdevNum == -1) // single Bdev
+        return spdk_bdev_first();
+
+    /* JBOD member */
+    if (!confBdevNum) {
+        SpdkBdev::prevBdev = spdk_bdev_first_leaf();
+    } else if (confBdevNum > 0) {
+        SpdkBdev::prevBdev = spdk_bdev_next_leaf(SpdkBdev::prevBdev);
+    } else {
+        DAQ_CRITICAL("Get leaf BDEV failed");
+        return nullptr;
     }
+    return SpdkBdev::prevBdev;
+}
 
+bool SpdkBdev::bdevInit() {
+    spBdevCtx.bdev = lookupBdev();
     if (!spBdevCtx.bdev) {
         DAQ_CRITICAL(std::string("No NVMe devices detected for name[") +
                      spBdevCtx.bdev_name + "]");
@@ -464,7 +974,13 @@ bool SpdkBdev::bdevInit() {
     DAQ_DEBUG("BDEV number of blocks[" + std::to_string(spBdevCtx.blk_num) +
               "]");
 
-    ioEngineInitDone = 1;
+    _unmapSupported =
+        spdk_bdev_io_type_supported(spBdevCtx.bdev, SPDK_BDEV_IO_TYPE_UNMAP);
+    DAQ_DEBUG("BDEV unmap supported[" + std::to_string(_unmapSupported) +
+              "]");
+
+    ioQueues[0].channel = spBdevCtx.io_channel;
+    ioEngineInitDone++;
     return true;
 }
 
@@ -498,31 +1014,53 @@ bool SpdkBdev::init(const SpdkConf &conf) {
     }
 
     /*
-     * Set up ioEngine
+     * Set up IO queues, the first one opens the device and the others get
+     * their own io_channel of it
      */
-    ioEngine = new SpdkIoEngine();
-    ioEngineThread = new std::thread(&SpdkBdev::ioEngineThreadMain, this);
-    cpu_set_t cpuset1;
-    CPU_ZERO(&cpuset1);
-    CPU_SET(cpuCoreIoEng, &cpuset1);
-
-    set_result = pthread_setaffinity_np(ioEngineThread->native_handle(),
-                                        sizeof(cpu_set_t), &cpuset1);
-    if (!set_result) {
-        DAQ_DEBUG("SpdkCore thread affinity set on CPU core [" +
-                  std::to_string(cpuCoreIoEng) + "]");
-    } else {
-        DAQ_DEBUG("Cannot set affinity on CPU core [" +
-                  std::to_string(cpuCoreIoEng) + "] for IoEngine");
+    ioQueueCnt = std::min(std::max(conf.getQueues(), 1u), SPDK_MAX_IO_QUEUES);
+    for (unsigned int idx = 0; idx < ioQueueCnt; idx++) {
+        ioQueues[idx].bdev = this;
+        ioQueues[idx].idx = idx;
+        ioQueues[idx].engine = new SpdkIoEngine();
     }
+    _ioQueuesRunning = ioQueueCnt;
 
+    _startIoQueue(ioQueues[0], cpuCoreIoEng);
     while (!ioEngineInitDone) {
     }
+    /* additional queues are not pinned, their cores are not reserved */
+    for (unsigned int idx = 1; idx < ioQueueCnt; idx++)
+        _startIoQueue(ioQueues[idx], 0);
+    while (ioEngineInitDone < ioQueueCnt) {
+    }
+    if (spBdevCtx.state == SPDK_BDEV_ERROR)
+        return false;
+    _readAheadBlocks = conf.getReadAhead() * 1024 / spBdevCtx.blk_size;
     setRunning(1);
 
     return true;
 }
 
+void SpdkBdev::_startIoQueue(SpdkIoQueue &queue, size_t cpuCore) {
+    queue.thread =
+        new std::thread(&SpdkBdev::ioEngineThreadMain, this, &queue);
+    if (!cpuCore)
+        return;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpuCore, &cpuset);
+    int set_result = pthread_setaffinity_np(queue.thread->native_handle(),
+                                            sizeof(cpu_set_t), &cpuset);
+    if (!set_result) {
+        DAQ_DEBUG("SpdkCore thread affinity set on CPU core [" +
+                  std::to_string(cpuCore) + "]");
+    } else {
+        DAQ_DEBUG("Cannot set affinity on CPU core [" +
+                  std::to_string(cpuCore) + "] for IoEngine");
+    }
+}
+
 void SpdkBdev::finilizerThreadMain() {
     std::string finThreadName = std::string(spBdevCtx.bdev_name) + "_finalizer";
     pthread_setname_np(pthread_self(), finThreadName.c_str());
@@ -535,23 +1073,27 @@ void SpdkBdev::finilizerThreadMain() {
 }
 
 int SpdkBdev::ioEngineIoFunction(void *arg) {
-    SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(arg);
+    SpdkIoQueue *queue = reinterpret_cast<SpdkIoQueue *>(arg);
+    SpdkBdev *bdev = queue->bdev;
     if (bdev->isRunning) {
         uint32_t can_queue_cnt = bdev->canQueue();
         if (can_queue_cnt) {
-            bdev->ioEngine->dequeue(can_queue_cnt);
-            bdev->ioEngine->process();
+            queue->engine->dequeue(can_queue_cnt);
+            queue->engine->process();
         }
+        if (!queue->idx)
+            bdev->processUnmaps();
     }
 
     return 0;
 }
 
-void SpdkBdev::ioEngineThreadMain() {
-    std::string finThreadName = std::string(spBdevCtx.bdev_name) + "_io";
-    pthread_setname_np(pthread_self(), finThreadName.c_str());
+void SpdkBdev::ioEngineThreadMain(SpdkIoQueue *queue) {
+    std::string ioThreadName = std::string(spBdevCtx.bdev_name) + "_io" +
+                               std::to_string(queue->idx);
+    pthread_setname_np(pthread_self(), ioThreadName.c_str());
 
-    struct spdk_thread *spdk_th = spdk_thread_create(spBdevCtx.bdev_name, 0);
+    struct spdk_thread *spdk_th = spdk_thread_create(ioThreadName.c_str(), 0);
     if (!spdk_th) {
         DAQ_CRITICAL(
             "Spdk spdk_thread_create() can't create context on pthread");
@@ -561,10 +1103,25 @@ void SpdkBdev::ioEngineThreadMain() {
     }
     spdk_set_thread(spdk_th);
 
-    bool ret = bdevInit();
-    if (ret == false) {
-        DAQ_CRITICAL("Bdev init failed");
-        return;
+    if (!queue->idx) {
+        bool ret = bdevInit();
+        if (ret == false) {
+            DAQ_CRITICAL("Bdev init failed");
+            return;
+        }
+    } else {
+        queue->channel = spdk_bdev_get_io_channel(spBdevCtx.bdev_desc);
+        if (!queue->channel) {
+            DAQ_CRITICAL(std::string("Get io_channel failed bdev[") +
+                         spBdevCtx.bdev_name + "] queue[" +
+                         std::to_string(queue->idx) + "]");
+            spBdevCtx.state = SPDK_BDEV_ERROR;
+            _ioQueuesRunning--;
+            ioEngineInitDone++;
+            spdk_thread_exit(spdk_th);
+            return;
+        }
+        ioEngineInitDone++;
     }
 
     /*
@@ -574,7 +1131,7 @@ void SpdkBdev::ioEngineThreadMain() {
     }
 
     struct spdk_poller *spdk_io_poller =
-        spdk_poller_register(SpdkBdev::ioEngineIoFunction, this, 0);
+        spdk_poller_register(SpdkBdev::ioEngineIoFunction, queue, 0);
     if (!spdk_io_poller) {
         DAQ_CRITICAL("Spdk poller can't be created");
         spdk_thread_exit(spdk_th);
@@ -594,9 +1151,44 @@ void SpdkBdev::ioEngineThreadMain() {
         if (ret < 0)
             break;
     }
-    isRunning = 5;
-
     spdk_poller_unregister(&spdk_io_poller);
+
+    /* deinit waits for all queues */
+    if (!--_ioQueuesRunning)
+        isRunning = 5;
+}
+
+/*
+ * The first queue opens the device with bdevInit before its own set up.
+ */
+void SpdkBdev::pollIoEngineThreadMain(SpdkIoQueue *queue) {
+    std::string ioThreadName = std::string(spBdevCtx.bdev_name) + "_io" +
+                               std::to_string(queue->idx);
+    pthread_setname_np(pthread_self(), ioThreadName.c_str());
+
+    if ((!queue->idx && bdevInit() != true) || initIoQueue(*queue) != true) {
+        spBdevCtx.state = SPDK_BDEV_ERROR;
+        _ioQueuesRunning--;
+        ioEngineInitDone++;
+        return;
+    }
+    ioEngineInitDone++;
+
+    /*
+     * Wait for ready on
+     */
+    while (isRunning == 3) {
+    }
+
+    while (isRunning != 4) {
+        SpdkBdev::ioEngineIoFunction(queue);
+        pollIoQueue(*queue);
+    }
+    exitIoQueue(*queue);
+
+    /* deinit waits for all queues */
+    if (!--_ioQueuesRunning)
+        isRunning = 5;
 }
 
 void SpdkBdev::setMaxQueued(uint32_t io_cache_size, uint32_t blk_size) {}
@@ -18,14 +18,17 @@
 
 #include <atomic>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <thread>
 
 #include "spdk/bdev.h"
 
 #include "BdevStats.h"
-#include "OffloadFreeList.h"
 #include "OffloadLbaAlloc.h"
+#include "OffloadReadMerge.h"
+#include "OffloadSegmentAlloc.h"
+#include "OffloadUnmapQueue.h"
 #include "Rqst.h"
 #include "SpdkConf.h"
 #include "SpdkDevice.h"
@@ -44,6 +47,61 @@ enum class SpdkBdevState : std::uint8_t {
 
 class FinalizePoller;
 class SpdkIoEngine;
+class SpdkBdev;
+
+/* extents allocated ahead for a queue when values are not packed */
+const size_t SPDK_LBA_CACHE_SIZE = 32;
+/* extent sizes cached per queue, other sizes are taken from the allocator */
+const size_t SPDK_LBA_CACHE_CLASSES = 8;
+
+/*
+ * Blocks read past the last sequential read of a queue, valid as long as
+ * nothing was written to the device since the read was submitted.
+ */
+struct SpdkReadAhead {
+    SpdkIoBuf *buf = nullptr;
+    uint64_t lba = 0;
+    uint64_t blocks = 0;
+    uint64_t writeGen = 0;
+};
+
+/*
+ * Device IO queue served by its own IO engine thread. Each thread runs its
+ * own SPDK thread with a separate io_channel so that queues are submitted
+ * to the device in parallel.
+ */
+struct SpdkIoQueue {
+    SpdkBdev *bdev = nullptr;
+    unsigned int idx = 0;
+    SpdkIoEngine *engine = nullptr;
+    std::thread *thread = nullptr;
+    spdk_io_channel *channel = nullptr;
+
+    /* extents taken from the allocator in batches, keyed by their blocks */
+    std::map<uint64_t, std::vector<uint64_t>> lbaCache;
+
+    /* reads of the batch being merged, touched by the IO engine thread only */
+    std::vector<DeviceTask *> readTasks;
+    std::vector<OffloadReadExtent> readExtents;
+    std::vector<OffloadReadRange> readRanges;
+    SpdkReadAhead readAhead;
+    uint64_t readNext = 0; // block following the last read
+};
+
+/*
+ * Reads of several tasks served by a single IO, the buffer is split among
+ * them on completion.
+ */
+struct SpdkReadGroup {
+    SpdkBdev *bdev = nullptr;
+    SpdkIoQueue *queue = nullptr;
+    SpdkIoBuf *buf = nullptr;
+    uint64_t lba = 0;
+    uint64_t blocks = 0;
+    uint64_t writeGen = 0;
+    bool keep = false; // buffer becomes the readahead window of the queue
+    std::vector<DeviceTask *> tasks;
+};
 
 class SpdkBdev : public SpdkDevice {
   public:
@@ -64,6 +122,15 @@ class SpdkBdev : public SpdkDevice {
     virtual void putFreeLba(const DeviceAddr *devAddr, size_t ioSize);
     virtual bool bdevInit();
 
+    /*
+     * Log segment management, used when values are packed into segments
+     */
+    virtual int64_t getFreeSegment();
+    virtual void commitSegment(uint64_t lba, uint32_t liveBytes);
+    virtual SpdkDevice *getCompactionVictim(uint32_t maxLiveBytes,
+                                            unsigned int freePercent,
+                                            uint64_t &lba);
+
     /*
      * Optimal size is 4k times
      */
@@ -86,6 +153,15 @@ class SpdkBdev : public SpdkDevice {
     virtual bool doRemove(DeviceTask *task);
     virtual int reschedule(DeviceTask *task);
 
+    /**
+     * Submits reads of a batch dequeued by an IO engine. Reads of adjacent
+     * or overlapping blocks are merged into a single IO and reads covered
+     * by the readahead window of the queue complete without IO.
+     *
+     * @return number of tasks that failed, they are left in tasks
+     */
+    size_t readBatch(std::vector<DeviceTask *> &tasks);
+
     virtual void enableStats(bool en);
 
     /*
@@ -95,18 +171,37 @@ class SpdkBdev : public SpdkDevice {
     virtual uint32_t getIoPoolSize() { return spBdevCtx.io_pool_size; }
     virtual uint32_t getIoCacheSize() { return spBdevCtx.io_cache_size; }
 
+    /*
+     * Load of the device used for write placement: IOs queued to its IO
+     * engine and submitted ones, and blocks left for new values.
+     */
+    uint64_t getQueueDepth();
+    uint64_t getFreeBlocks() { return stats.free_blk_cnt; }
+
     /*
      * Callback function for a read IO completion.
      */
     static void readComplete(struct spdk_bdev_io *bdev_io, bool success,
                              void *cb_arg);
 
+    /*
+     * Callback function for a merged read IO completion.
+     */
+    static void readGroupComplete(struct spdk_bdev_io *bdev_io, bool success,
+                                  void *cb_arg);
+
     /*
      * Callback function for a write IO completion.
      */
     static void writeComplete(struct spdk_bdev_io *bdev_io, bool success,
                               void *cb_arg);
 
+    /*
+     * Callback function for an unmap completion.
+     */
+    static void unmapComplete(struct spdk_bdev_io *bdev_io, bool success,
+                              void *cb_arg);
+
     /*
      * Callback function that SPDK framework will call when an io buffer becomes
      * available Called by SPDK framework when enough of IO buffers become
@@ -168,9 +263,9 @@ class SpdkBdev : public SpdkDevice {
     virtual void setRunning(int running) { isRunning = running; }
     virtual bool IsRunning(int running) { return isRunning; }
 
-    SpdkIoEngine *ioEngine;
-    std::thread *ioEngineThread;
-    void ioEngineThreadMain(void);
+    SpdkIoQueue ioQueues[SPDK_MAX_IO_QUEUES];
+    unsigned int ioQueueCnt = 0;
+    virtual void ioEngineThreadMain(SpdkIoQueue *queue);
     static int ioEngineIoFunction(void *arg);
 
     FinalizePoller *finalizer;
@@ -178,19 +273,94 @@ class SpdkBdev : public SpdkDevice {
     void finilizerThreadMain(void);
 
     OffloadLbaAlloc *lbaAllocator = nullptr;
+    OffloadSegmentAlloc *segAllocator = nullptr;
 
-    std::atomic<int> ioEngineInitDone;
+    /*
+     * Freed extents wait here for their unmap before reuse
+     */
+    OffloadUnmapQueue unmapQueue;
+    void processUnmaps();
+
+    std::atomic<unsigned int> ioEngineInitDone;
     uint32_t maxIoBufs;
     uint32_t maxCacheIoBufs;
-    uint32_t ioBufsInUse;
+    std::atomic<uint32_t> ioBufsInUse;
 
     SpdkIoBufMgr *ioPoolMgr;
 
-  private:
+  protected:
+    /*
+     * Finds SPDK bdev driven by this device, called from bdevInit
+     */
+    virtual struct spdk_bdev *lookupBdev();
+
+    /*
+     * IO submission to a queue, called from the IO engine thread of the
+     * queue. Completion callback runs on the same thread, devices not driven
+     * by SPDK bdev layer pass it null bdev_io.
+     */
+    virtual int submitRead(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                           uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                           void *arg);
+    virtual int submitWrite(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                            uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                            void *arg);
+    virtual int submitWritev(SpdkIoQueue &queue, struct iovec *iov,
+                             int iovcnt, uint64_t lba, uint64_t blocks,
+                             spdk_bdev_io_completion_cb cb, void *arg);
+    virtual int submitUnmap(SpdkIoQueue &queue, uint64_t lba, uint64_t blocks,
+                            spdk_bdev_io_completion_cb cb, void *arg);
+
+    /*
+     * IO engine thread of devices not driven by SPDK bdev layer. There is no
+     * SPDK thread, the queue is set up by initIoQueue and its completions are
+     * delivered by pollIoQueue in between IO engine runs.
+     */
+    void pollIoEngineThreadMain(SpdkIoQueue *queue);
+    virtual bool initIoQueue(SpdkIoQueue &queue) { return true; }
+    virtual void pollIoQueue(SpdkIoQueue &queue) {}
+    virtual void exitIoQueue(SpdkIoQueue &queue) {}
+
+    bool _unmapSupported = false;
     std::atomic<int> isRunning;
+    std::atomic<unsigned int> _ioQueuesRunning;
+
+  private:
+    SpdkIoQueue &_ioQueue(const DeviceTask *task) {
+        return ioQueues[task->queue % ioQueueCnt];
+    }
+    void _startIoQueue(SpdkIoQueue &queue, size_t cpuCore);
+    int64_t _getCachedLba(SpdkIoQueue &queue, size_t ioSize);
+    void _dropLbaCache(SpdkIoQueue &queue);
+
+    void _setReadExtent(DeviceTask *task);
+    bool _setWriteExtent(DeviceTask *task);
+    void _putReadBuf(DeviceTask *task);
+    bool _readCached(SpdkIoQueue &queue, DeviceTask *task);
+    bool _readGroup(SpdkIoQueue &queue, const OffloadReadRange &range,
+                    uint64_t ahead);
+    void _dropReadAhead(SpdkIoQueue &queue);
+    void _putWriteBuf(DeviceTask *task);
+    int _submitWrite(DeviceTask *task);
+    void _releaseExtent(uint64_t lba, uint64_t blocks);
+    void _reclaimExtent(uint64_t lba, uint64_t blocks);
+    void _unmapDone();
+
+    /* blocks read ahead of sequential reads, 0 if disabled */
+    uint64_t _readAheadBlocks = 0;
+    /* readahead windows are dropped once a write is submitted */
+    std::atomic<uint64_t> _writesSubmitted{0};
+    std::atomic<uint64_t> _writesCompleted{0};
+
+    uint32_t _unmapsInFlight = 0;
+    std::vector<OffloadExtent> _unmapBatch;
+    std::vector<OffloadExtent> _unmapRanges;
+
     bool statsEnabled;
 
     const static char *lbaMgmtFileprefix;
+    const static char *segMgmtFileprefix;
+    const static uint64_t victimScanLimit;
 };
 
 inline size_t SpdkBdev::getOptimalSize(size_t size) {
@@ -23,7 +23,9 @@
 #include "SpdkConf.h"
 #include "SpdkDevice.h"
 #include "SpdkJBODBdev.h"
+#include "SpdkNullBdev.h"
 #include "SpdkRAID0Bdev.h"
+#include "SpdkUringBdev.h"
 #include <RTree.h>
 
 namespace DaqDB {
@@ -39,6 +41,13 @@ SpdkDevice *SpdkBdevFactory::getBdev(SpdkDeviceClass typ) {
     case SpdkDeviceClass::RAID0:
         return new SpdkRAID0Bdev;
         break; // never reached
+    case SpdkDeviceClass::URING:
+        return new SpdkUringBdev;
+        break; // never reached
+    case SpdkDeviceClass::NULLDEV:
+    case SpdkDeviceClass::RAMDISK:
+        return new SpdkNullBdev;
+        break; // never reached
     }
     return 0;
 }
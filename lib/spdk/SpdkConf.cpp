@@ -27,7 +27,13 @@ namespace DaqDB {
 SpdkConf::SpdkConf(const OffloadOptions &_offloadOptions)
     : _devType(_offloadOptions.devType), _name(_offloadOptions.name),
       _raid0StripeSize(_offloadOptions.raid0StripeSize), _bdev(0),
-      _bdevNum(-1) {
+      _bdevNum(-1), _placement(_offloadOptions.placement),
+      _queues(_offloadOptions.queues),
+      _readAhead(_offloadOptions.readAhead),
+      _uringFileSize(_offloadOptions.uringFileSize),
+      _uringSqPoll(_offloadOptions.uringSqPoll),
+      _nullSize(_offloadOptions.nullSize),
+      _nullLatency(_offloadOptions.nullLatency) {
     copyDevs(_offloadOptions._devs);
 }
 
@@ -70,6 +76,13 @@ SpdkConf &SpdkConf::operator=(const SpdkConf &_r) {
     this->_name = _r._name;
     this->_devs = _r._devs;
     this->_bdevNum = _r._bdevNum;
+    this->_placement = _r._placement;
+    this->_queues = _r._queues;
+    this->_readAhead = _r._readAhead;
+    this->_uringFileSize = _r._uringFileSize;
+    this->_uringSqPoll = _r._uringSqPoll;
+    this->_nullSize = _r._nullSize;
+    this->_nullLatency = _r._nullLatency;
     return *this;
 }
 
@@ -51,7 +51,7 @@ class SpdkConf {
     void setSpdkConfDevType(SpdkConfDevType devType) { _devType = devType; }
     std::string getName() { return _name; }
     void setName(std::string &name) { _name = name; }
-    size_t getRaid0StripeSize() { return _raid0StripeSize; }
+    size_t getRaid0StripeSize() const { return _raid0StripeSize; }
     void setRaid0StripeSize(size_t raid0StripeSize) {
         _raid0StripeSize = raid0StripeSize;
     }
@@ -63,6 +63,16 @@ class SpdkConf {
     void addDev(SpdkBdevConf dev);
     int getBdevNum() const { return _bdevNum; }
     void setBdevNum(int bdevNum) { _bdevNum = bdevNum; }
+    OffloadPlacement getPlacement() const { return _placement; }
+    void setPlacement(OffloadPlacement placement) { _placement = placement; }
+    unsigned int getQueues() const { return _queues; }
+    void setQueues(unsigned int queues) { _queues = queues; }
+    size_t getReadAhead() const { return _readAhead; }
+    void setReadAhead(size_t readAhead) { _readAhead = readAhead; }
+    size_t getUringFileSize() const { return _uringFileSize; }
+    bool getUringSqPoll() const { return _uringSqPoll; }
+    size_t getNullSize() const { return _nullSize; }
+    size_t getNullLatency() const { return _nullLatency; }
 
   private:
     SpdkConfDevType _devType;
@@ -71,6 +81,13 @@ class SpdkConf {
     std::vector<SpdkBdevConf> _devs;
     struct spdk_bdev *_bdev;
     int _bdevNum;
+    OffloadPlacement _placement = OffloadPlacement::QUEUE_DEPTH;
+    unsigned int _queues = 1;
+    size_t _readAhead = 0;
+    size_t _uringFileSize = 0;
+    bool _uringSqPoll = true;
+    size_t _nullSize = 0;
+    size_t _nullLatency = 0;
 };
 
 } // namespace DaqDB
@@ -45,6 +45,7 @@
 #include "Rqst.h"
 #include "SpdkBdevFactory.h"
 #include "SpdkCore.h"
+#include "SpdkIoBuf.h"
 #include <Logger.h>
 #include <RTree.h>
 
@@ -53,16 +54,20 @@ namespace DaqDB {
 const char *SpdkCore::spdkHugepageDirname = "/mnt/huge_1GB";
 
 SpdkCore::SpdkCore(OffloadOptions _offloadOptions)
-    : state(SpdkState::SPDK_INIT), offloadOptions(_offloadOptions), poller(0),
+    : state(SpdkState::SPDK_INIT), offloadOptions(_offloadOptions),
       _spdkThread(0), _loopThread(0), _ready(false), _cpuCore(1),
       _spdkConf(offloadOptions) {
     removeConfFile();
-    bool conf_file_ok = createConfFile();
-
     spBdev = SpdkBdevFactory::getBdev(offloadOptions.devType);
     spBdev->enableStats(true);
 
-    if (conf_file_ok == false) {
+    if (_isAppLess()) {
+        /* SPDK provides DMA memory only */
+        if (spdkEnvInit() == false)
+            state = SpdkState::SPDK_ERROR;
+        else
+            state = SpdkState::SPDK_READY;
+    } else if (createConfFile() == false) {
         if (spdkEnvInit() == false)
             state = SpdkState::SPDK_ERROR;
         else
@@ -98,30 +103,8 @@ bool SpdkCore::createConfFile(void) {
         if (isNvmeInOptions()) {
             ofstream spdkConf(DEFAULT_SPDK_CONF_FILE, ios::out);
             if (spdkConf) {
-                switch (offloadOptions.devType) {
-                case OffloadDevType::BDEV:
-                    assert(offloadOptions._devs.size() == 1);
-                    spdkConf << "[Nvme]" << endl
-                             << "  TransportID \"trtype:PCIe traddr:"
-                             << offloadOptions._devs[0].nvmeAddr << "\" "
-                             << offloadOptions._devs[0].nvmeName << endl;
-
-                    spdkConf.close();
-                    break;
-                case OffloadDevType::JBOD:
-                    spdkConf << "[Nvme]" << endl;
-                    for (auto b : offloadOptions._devs) {
-                        spdkConf << "  TransportID \"trtype:PCIe traddr:"
-                                 << b.nvmeAddr << "\" " << b.nvmeName << endl;
-                    }
-                    spdkConf.close();
-                    break;
-                case OffloadDevType::RAID0:
-                    std::cout << "RAID0 bdev configuration not supported yet"
-                              << std::endl;
-                    break;
-                }
-
+                writeConf(spdkConf, offloadOptions);
+                spdkConf.close();
                 DAQ_DEBUG("SPDK configuration file created");
                 return true;
             } else {
@@ -139,6 +122,44 @@ bool SpdkCore::createConfFile(void) {
     }
 }
 
+void SpdkCore::writeConf(std::ostream &conf, const OffloadOptions &options) {
+    switch (options.devType) {
+    case OffloadDevType::BDEV:
+        assert(options._devs.size() == 1);
+        conf << "[Nvme]" << endl
+             << "  TransportID \"trtype:PCIe traddr:"
+             << options._devs[0].nvmeAddr << "\" " << options._devs[0].nvmeName
+             << endl;
+        break;
+    case OffloadDevType::JBOD:
+        conf << "[Nvme]" << endl;
+        for (auto b : options._devs) {
+            conf << "  TransportID \"trtype:PCIe traddr:" << b.nvmeAddr
+                 << "\" " << b.nvmeName << endl;
+        }
+        break;
+    case OffloadDevType::RAID0:
+        conf << "[Nvme]" << endl;
+        for (auto b : options._devs) {
+            conf << "  TransportID \"trtype:PCIe traddr:" << b.nvmeAddr
+                 << "\" " << b.nvmeName << endl;
+        }
+        /* striping is done by SPDK raid bdev, strip size in KB */
+        conf << "[RAID1]" << endl
+             << "  Name " << SpdkRAID0Bdev::raidBdevName << endl
+             << "  StripSize " << options.raid0StripeSize << endl
+             << "  NumDevices " << options._devs.size() << endl
+             << "  RaidLevel 0" << endl
+             << "  Devices";
+        for (auto b : options._devs)
+            conf << " " << b.nvmeName << "n1";
+        conf << endl;
+        break;
+    default:
+        break;
+    }
+}
+
 void SpdkCore::removeConfFile(void) {
     if (bf::exists(DEFAULT_SPDK_CONF_FILE)) {
         bf::remove(DEFAULT_SPDK_CONF_FILE);
@@ -184,31 +205,50 @@ void SpdkCore::spdkStart(void *arg) {
     SpdkDevice *bdev = spdkCore->spBdev;
     SpdkBdevCtx *bdev_c = bdev->getBdevCtx();
 
+    if (spdkCore->_pmemSize) {
+        if (SpdkIoBufMgr::getSpdkIoBufMgr()->registerDmaRegion(
+                spdkCore->_pmemAddr, spdkCore->_pmemSize))
+            DAQ_DEBUG("PMEM pool registered for DMA");
+        else
+            DAQ_DEBUG("Cannot register PMEM pool for DMA, values are copied");
+    }
+
     bool rc = bdev->init(spdkCore->_spdkConf);
     if (rc == false) {
         DAQ_CRITICAL("Bdev init failed");
         spdkCore->signalReady();
-        spdk_app_stop(-1);
+        spdkCore->_appStop(-1);
         return;
     }
 
     bdev->setMaxQueued(bdev->getIoCacheSize(), bdev->getBlockSize());
     auto aligned = bdev->getAlignedSize(spdkCore->offloadOptions.allocUnitSize);
     bdev->setBlockNumForLba(aligned / bdev_c->blk_size);
+    if (spdkCore->offloadOptions.segmentSize) {
+        auto segAligned =
+            bdev->getAlignedSize(spdkCore->offloadOptions.segmentSize);
+        bdev->setSegmentBlocks(segAligned / bdev_c->blk_size);
+    }
 
-    spdkCore->poller->initFreeList();
+    for (auto poller : spdkCore->pollers)
+        poller->initFreeList();
     bdev->initFreeList();
-    bool i_rc = spdkCore->poller->init();
-    if (i_rc == false) {
-        DAQ_CRITICAL("Poller init failed");
-        spdkCore->signalReady();
-        spdk_app_stop(-1);
-        return;
+
+    for (auto poller : spdkCore->pollers) {
+        if (poller->init() == false) {
+            DAQ_CRITICAL("Poller init failed");
+            spdkCore->signalReady();
+            spdkCore->_appStop(-1);
+            return;
+        }
     }
 
     bdev->setRunning(1);
-    spdkCore->poller->setRunning(1);
-
+    for (auto poller : spdkCore->pollers)
+        poller->setRunning(1);
+    /* the first poller is driven by this thread */
+    for (size_t idx = 1; idx < spdkCore->pollers.size(); idx++)
+        spdkCore->pollers[idx]->startThread();
     bdev->setReady();
     spdkCore->signalReady();
     spdkCore->restoreSignals();
@@ -221,6 +261,13 @@ void SpdkCore::spdkStart(void *arg) {
 }
 
 void SpdkCore::_spdkThreadMain(void) {
+    if (_isAppLess()) {
+        /* environment is initialized already, there is no SPDK app */
+        SpdkCore::spdkStart(this);
+        return;
+    }
+
+    _spdkApp = true;
     struct spdk_app_opts daqdb_opts = {};
     spdk_app_opts_init(&daqdb_opts);
     daqdb_opts.config_file = DEFAULT_SPDK_CONF_FILE.c_str();
@@ -236,7 +283,7 @@ void SpdkCore::_spdkThreadMain(void) {
 }
 
 int SpdkCore::spdkCoreMainLoop(SpdkCore *spdkCore) {
-    Poller<OffloadRqst> *poller = spdkCore->poller;
+    Poller<OffloadRqst> *poller = spdkCore->pollers[0];
     SpdkDevice *bdev = spdkCore->spBdev;
 
     poller->dequeue();
@@ -244,7 +291,8 @@ int SpdkCore::spdkCoreMainLoop(SpdkCore *spdkCore) {
 
     if (poller->isOffloadRunning() == false) {
         bdev->deinit();
-        spdk_app_stop(0);
+        SpdkIoBufMgr::getSpdkIoBufMgr()->unregisterDmaRegion();
+        spdkCore->_appStop(0);
         bdev->setRunning(0);
         return 1;
     }
@@ -252,6 +300,11 @@ int SpdkCore::spdkCoreMainLoop(SpdkCore *spdkCore) {
     return 0;
 }
 
+void SpdkCore::_appStop(int rc) {
+    if (_spdkApp)
+        spdk_app_stop(rc);
+}
+
 void SpdkCore::signalReady() {
     std::unique_lock<std::mutex> lk(_syncMutex);
     _ready = true;
@@ -46,6 +46,10 @@ class SpdkCore {
      */
     bool createConfFile(void);
     void removeConfFile(void);
+    /**
+     * Writes SPDK configuration of devices given in offload options.
+     */
+    static void writeConf(std::ostream &conf, const OffloadOptions &options);
     bool isOffloadEnabled() {
         if (state == SpdkState::SPDK_READY)
             return spBdev->isOffloadEnabled();
@@ -65,13 +69,19 @@ class SpdkCore {
     std::atomic<SpdkState> state;
     SpdkDevice *spBdev;
     OffloadOptions offloadOptions;
-    Poller<OffloadRqst> *poller;
+    /* offload pollers, one per device IO queue */
+    std::vector<Poller<OffloadRqst> *> pollers;
 
     const static char *spdkHugepageDirname;
 
     void signalReady();
     bool waitReady();
-    void setPoller(Poller<OffloadRqst> *pol) { poller = pol; }
+    void addPoller(Poller<OffloadRqst> *pol) { pollers.push_back(pol); }
+    /* PMEM values in this range are written to the device in place */
+    void setPmemRegion(void *addr, size_t size) {
+        _pmemAddr = addr;
+        _pmemSize = size;
+    }
     static int spdkCoreMainLoop(SpdkCore *spdkCore);
 
     /*
@@ -93,6 +103,18 @@ class SpdkCore {
     std::mutex _syncMutex;
     std::condition_variable _cv;
 
+    void *_pmemAddr = nullptr;
+    size_t _pmemSize = 0;
+
+    /* devices not driven by SPDK bdev layer run without SPDK app framework */
+    bool _spdkApp = false;
+    void _appStop(int rc);
+    inline bool _isAppLess() {
+        return offloadOptions.devType == OffloadDevType::URING ||
+               offloadOptions.devType == OffloadDevType::NULLDEV ||
+               offloadOptions.devType == OffloadDevType::RAMDISK;
+    }
+
     inline bool isNvmeInOptions() {
         return offloadOptions._devs.size() ? true : false;
     }
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include "spdk/bdev.h"
 #include "spdk/env.h"
 
@@ -30,8 +32,16 @@ using OffloadRqst = Rqst<OffloadOperation>;
 
 typedef OffloadDevType SpdkDeviceClass;
 
+typedef std::function<void(const PciAddr &dev, uint64_t lba, uint64_t blocks)>
+    SpdkReleaseHandler;
+
+/* IO queues of a single device, each with its own SPDK thread */
+const unsigned int SPDK_MAX_IO_QUEUES = 16;
+
 class SpdkDevice;
 class SpdkIoBuf;
+struct SpdkIoVec;
+struct OffloadSegment;
 
 struct DeviceTask {
   public:
@@ -52,10 +62,19 @@ struct DeviceTask {
     struct spdk_bdev_io_wait_entry bdev_io_wait;
     char key[64];
     bool result;
-    uint64_t freeLba;
     bool routing = true;
+    uint8_t queue = 0; // device IO queue of the submitting offload poller
+    uint32_t bufOffset = 0; // offset of the value in the read buffer
+    uint64_t freeLba;
+    OffloadSegment *segment = nullptr; // set for log segment writes
+    uint64_t blockOffset = 0;          // first block of the IO
+    char *dmaBuf = nullptr; // IO buffer not taken from the IO buffer pool
+    SpdkIoVec *ioVec = nullptr; // chunked buffer of values above max IO buf
 };
 
+static_assert(sizeof(DeviceTask) <= sizeof(OffloadRqst::taskBuffer),
+              "DeviceTask does not fit into request task buffer");
+
 extern "C" enum CSpdkBdevState {
     SPDK_BDEV_INIT = 0,
     SPDK_BDEV_NOT_FOUND,
@@ -119,6 +138,28 @@ class SpdkDevice {
     virtual void setBlockNumForLba(uint64_t blk_num_flba) {
         blkNumForLba = blk_num_flba;
     }
+    virtual void setSegmentBlocks(uint64_t blk_num_seg) {
+        segmentBlocks = blk_num_seg;
+    }
+    virtual void commitSegment(uint64_t lba, uint32_t liveBytes) {}
+    /**
+     * Handler is called with every extent freed on the device, before the
+     * extent can be written again. Set before the device is initialized.
+     */
+    virtual void setReleaseHandler(SpdkReleaseHandler handler) {
+        releaseHandler = handler;
+    }
+    /**
+     * Picks a log segment worth compacting once less than freePercent of
+     * segments are free.
+     *
+     * @return device holding the segment, nullptr if none
+     */
+    virtual SpdkDevice *getCompactionVictim(uint32_t maxLiveBytes,
+                                            unsigned int freePercent,
+                                            uint64_t &lba) {
+        return nullptr;
+    }
     virtual void setMaxQueued(uint32_t io_cache_size, uint32_t blk_size) = 0;
     virtual uint32_t getBlockSize() = 0;
     virtual uint32_t getIoPoolSize() = 0;
@@ -127,6 +168,8 @@ class SpdkDevice {
     virtual bool IsRunning(int running) = 0;
 
     uint64_t blkNumForLba = 0;
+    uint64_t segmentBlocks = 0; // log segment size, 0 if values not packed
+    SpdkReleaseHandler releaseHandler;
     SpdkBdevCtx spBdevCtx;
     uint64_t IoBytesQueued;
     uint64_t IoBytesMaxQueued;
@@ -14,13 +14,37 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include "spdk/env.h"
 
 #include "SpdkIoBuf.h"
 
 namespace DaqDB {
 
-SpdkIoBufMgr::~SpdkIoBufMgr() {}
+/* spdk_mem_register works on 2MB granularity */
+const uintptr_t SPDK_DMA_REGION_ALIGN = 2UL * 1024 * 1024;
+/* large buffers are page aligned to meet NVMe PRP rules in vectored IOs */
+const uint32_t SPDK_IO_BUF_LARGE_ALIGN = 4096;
+/* index of the first large size class, smaller ones are block pools */
+const int SPDK_IO_BUF_LARGE_IDX = SpdkIoBufMgr::blockSize;
+
+void SpdkIoVec::copyIn(const char *src, size_t size) {
+    for (auto &iov : iovs) {
+        size_t len = std::min(size, iov.iov_len);
+        memcpy(iov.iov_base, src, len);
+        src += len;
+        size -= len;
+    }
+}
+
+SpdkIoBufMgr::~SpdkIoBufMgr() {
+    for (auto &pool : _large) {
+        for (auto buf : pool.bufs)
+            delete buf;
+    }
+}
 
 SpdkIoBuf *SpdkIoBufMgr::getIoWriteBuf(uint32_t ioSize, uint32_t align) {
     SpdkIoBuf *buf = 0;
@@ -32,15 +56,15 @@ SpdkIoBuf *SpdkIoBufMgr::getIoWriteBuf(uint32_t ioSize, uint32_t align) {
             buf->setSpdkDmaBuf(
                 spdk_dma_zmalloc(static_cast<size_t>(ioSize), align, NULL));
     } else {
-        buf = new SpdkIoSizedBuf<1 << 16>(1 << 16, -1);
-        buf->setSpdkDmaBuf(
-            spdk_dma_zmalloc(static_cast<size_t>(ioSize), align, NULL));
+        buf = _getLargeBuf(ioSize, align);
     }
     return buf;
 }
 
 void SpdkIoBufMgr::putIoWriteBuf(SpdkIoBuf *ioBuf) {
-    if (ioBuf->getIdx() != -1)
+    if (ioBuf->getIdx() >= SPDK_IO_BUF_LARGE_IDX)
+        _putLargeBuf(ioBuf);
+    else if (ioBuf->getIdx() != -1)
         ioBuf->putWriteBuf(ioBuf);
     else {
         delete ioBuf;
@@ -57,20 +81,102 @@ SpdkIoBuf *SpdkIoBufMgr::getIoReadBuf(uint32_t ioSize, uint32_t align) {
             buf->setSpdkDmaBuf(
                 spdk_dma_zmalloc(static_cast<size_t>(ioSize), align, NULL));
     } else {
-        buf = new SpdkIoSizedBuf<1 << 16>(1 << 16, -1);
-        buf->setSpdkDmaBuf(
-            spdk_dma_zmalloc(static_cast<size_t>(ioSize), align, NULL));
+        buf = _getLargeBuf(ioSize, align);
     }
     return buf;
 }
 
 void SpdkIoBufMgr::putIoReadBuf(SpdkIoBuf *ioBuf) {
-    if (ioBuf->getIdx() != -1)
+    if (ioBuf->getIdx() >= SPDK_IO_BUF_LARGE_IDX)
+        _putLargeBuf(ioBuf);
+    else if (ioBuf->getIdx() != -1)
         ioBuf->putReadBuf(ioBuf);
     else
         delete ioBuf;
 }
 
+/*
+ * Buffers above SPDK_IO_BUF_MAX_SIZE are allocated for a single IO, only
+ * reads of such values get here as writes are split into chunks.
+ */
+SpdkIoBuf *SpdkIoBufMgr::_getLargeBuf(uint32_t ioSize, uint32_t align) {
+    SpdkIoBuf *buf;
+    unsigned int cls = 0;
+    while (cls < SPDK_IO_BUF_LARGE_CLASSES &&
+           (SPDK_IO_BUF_LARGE_MIN << cls) < ioSize)
+        cls++;
+    if (cls == SPDK_IO_BUF_LARGE_CLASSES) {
+        buf = new SpdkIoSizedBuf<1 << 16>(1 << 16, -1);
+        buf->setSpdkDmaBuf(
+            spdk_dma_zmalloc(static_cast<size_t>(ioSize), align, NULL));
+        return buf;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_large[cls].mutex);
+        if (!_large[cls].bufs.empty()) {
+            buf = _large[cls].bufs.back();
+            _large[cls].bufs.pop_back();
+            return buf;
+        }
+    }
+    uint32_t bufSize = SPDK_IO_BUF_LARGE_MIN << cls;
+    buf = new SpdkIoSizedBuf<1 << 16>(bufSize, SPDK_IO_BUF_LARGE_IDX + cls);
+    buf->setSpdkDmaBuf(spdk_dma_zmalloc(
+        bufSize, std::max(align, SPDK_IO_BUF_LARGE_ALIGN), NULL));
+    return buf;
+}
+
+void SpdkIoBufMgr::_putLargeBuf(SpdkIoBuf *ioBuf) {
+    LargePool &pool = _large[ioBuf->getIdx() - SPDK_IO_BUF_LARGE_IDX];
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (pool.bufs.size() < SPDK_IO_BUF_LARGE_DEPTH) {
+            pool.bufs.push_back(ioBuf);
+            return;
+        }
+    }
+    delete ioBuf;
+}
+
+SpdkIoVec *SpdkIoBufMgr::getIoWriteVec(size_t ioSize, uint32_t align) {
+    SpdkIoVec *ioVec = new SpdkIoVec();
+    for (size_t offset = 0; offset < ioSize; offset += SPDK_IO_BUF_MAX_SIZE) {
+        size_t len = std::min<size_t>(ioSize - offset, SPDK_IO_BUF_MAX_SIZE);
+        SpdkIoBuf *chunk = _getLargeBuf(len, align);
+        ioVec->chunks.push_back(chunk);
+        ioVec->iovs.push_back({chunk->getSpdkDmaBuf(), len});
+    }
+    return ioVec;
+}
+
+void SpdkIoBufMgr::putIoWriteVec(SpdkIoVec *ioVec) {
+    for (auto chunk : ioVec->chunks)
+        _putLargeBuf(chunk);
+    delete ioVec;
+}
+
+bool SpdkIoBufMgr::registerDmaRegion(void *addr, size_t size) {
+    const uintptr_t mask = SPDK_DMA_REGION_ALIGN - 1;
+    uintptr_t start = (reinterpret_cast<uintptr_t>(addr) + mask) & ~mask;
+    uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + size) & ~mask;
+    if (_dmaSize || end <= start)
+        return false;
+    if (spdk_mem_register(reinterpret_cast<void *>(start), end - start))
+        return false;
+    _dmaAddr = start;
+    _dmaSize = end - start;
+    return true;
+}
+
+void SpdkIoBufMgr::unregisterDmaRegion() {
+    if (!_dmaSize)
+        return;
+    spdk_mem_unregister(reinterpret_cast<void *>(_dmaAddr), _dmaSize);
+    _dmaAddr = 0;
+    _dmaSize = 0;
+}
+
 Lock SpdkIoBufMgr::instanceMutex;
 SpdkIoBufMgr *SpdkIoBufMgr::instance = 0;
 SpdkIoBufMgr *SpdkIoBufMgr::getSpdkIoBufMgr() {
@@ -18,12 +18,25 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <sys/uio.h>
 
 #include "ClassAlloc.h"
 #include "GeneralPool.h"
 
 namespace DaqDB {
 
+/* buffers of 32KB and more are pooled in power of two size classes */
+const uint32_t SPDK_IO_BUF_LARGE_MIN = 32 * 1024;
+const unsigned int SPDK_IO_BUF_LARGE_CLASSES = 8;
+/* largest pooled buffer, bigger writes are staged in chunks of this size */
+const uint32_t SPDK_IO_BUF_MAX_SIZE = SPDK_IO_BUF_LARGE_MIN
+                                      << (SPDK_IO_BUF_LARGE_CLASSES - 1);
+/* free buffers kept per large size class */
+const size_t SPDK_IO_BUF_LARGE_DEPTH = 8;
+
 class SpdkIoBuf {
   public:
     SpdkIoBuf() = default;
@@ -119,6 +132,17 @@ DaqDB::GeneralPool<SpdkIoSizedBuf<Size>,
                    DaqDB::ClassAlloc<SpdkIoSizedBuf<Size>>>
     SpdkIoSizedBuf<Size>::readPool(queueDepth, "readSpdkIoBufPool");
 
+/*
+ * Staging buffer of a write bigger than SPDK_IO_BUF_MAX_SIZE. Chunks come
+ * from the large buffer pool and are submitted as a single vectored IO.
+ */
+struct SpdkIoVec {
+    std::vector<SpdkIoBuf *> chunks;
+    std::vector<struct iovec> iovs;
+
+    void copyIn(const char *src, size_t size);
+};
+
 class SpdkIoBufMgr {
   public:
     SpdkIoBufMgr();
@@ -128,6 +152,26 @@ class SpdkIoBufMgr {
     void putIoWriteBuf(SpdkIoBuf *ioBuf);
     SpdkIoBuf *getIoReadBuf(uint32_t ioSize, uint32_t align);
     void putIoReadBuf(SpdkIoBuf *ioBuf);
+    SpdkIoVec *getIoWriteVec(size_t ioSize, uint32_t align);
+    void putIoWriteVec(SpdkIoVec *ioVec);
+
+    /*
+     * Registers memory mapped outside of SPDK, e.g. the PMEM pool, so IOs
+     * can be done from it without staging in a DMA buffer. Only the part of
+     * the range aligned to 2MB can be registered. Must be called from SPDK
+     * thread once the environment is initialized.
+     */
+    bool registerDmaRegion(void *addr, size_t size);
+    void unregisterDmaRegion();
+
+    /**
+     * @return true if the whole buffer lies in the registered region
+     */
+    bool isDmaRegion(const void *buf, size_t size, uint32_t align) const {
+        auto addr = reinterpret_cast<uintptr_t>(buf);
+        return _dmaSize && addr >= _dmaAddr &&
+               addr + size <= _dmaAddr + _dmaSize && !(addr % align);
+    }
 
     static const uint32_t blockSize = 8;
     SpdkIoBuf *block[blockSize];
@@ -136,6 +180,19 @@ class SpdkIoBufMgr {
     static SpdkIoBufMgr *instance;
     static SpdkIoBufMgr *getSpdkIoBufMgr();
     static void putSpdkIoBufMgr();
+
+  private:
+    SpdkIoBuf *_getLargeBuf(uint32_t ioSize, uint32_t align);
+    void _putLargeBuf(SpdkIoBuf *ioBuf);
+
+    struct LargePool {
+        std::mutex mutex;
+        std::vector<SpdkIoBuf *> bufs;
+    };
+    LargePool _large[SPDK_IO_BUF_LARGE_CLASSES];
+
+    uintptr_t _dmaAddr = 0;
+    size_t _dmaSize = 0;
 };
 
 } // namespace DaqDB
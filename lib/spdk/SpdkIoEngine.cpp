@@ -33,6 +33,8 @@
 #include "spdk/thread.h"
 
 #include "BdevStats.h"
+#include "OffloadCompactor.h"
+#include "OffloadSegment.h"
 #include "SpdkBdev.h"
 #include "SpdkIoEngine.h"
 #include <FinalizePoller.h>
@@ -47,18 +49,26 @@ void SpdkIoEngine::process() {
         for (unsigned short RqstIdx = 0; RqstIdx < requestCount; RqstIdx++) {
             DeviceTask *task = requests[RqstIdx];
             task->routing = false;
+            LatencyTracer::getInstance().stamp(taskTrace(task),
+                                               TRACE_IO_ENGINE);
             SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(task->bdev);
+            /* reads are not reordered with other operations */
+            if (task->op != OffloadOperation::GET)
+                _flushReads();
             switch (task->op) {
             case OffloadOperation::GET: {
-                bool ret = bdev->read(task);
-                if (ret != true) {
-                    rqstClb(task->rqst, StatusCode::UNKNOWN_ERROR);
-                    OffloadRqst::getPool.put(task->rqst);
+                if (!task->segment) {
+                    _reads.push_back(task);
+                } else if (bdev->read(task) != true) {
+                    task->segment->compactor->readComplete(false);
                 }
             } break;
             case OffloadOperation::UPDATE: {
                 bool ret = bdev->write(task);
-                if (ret != true) {
+                if (ret != true && task->segment) {
+                    task->segment->writer->fail(task->segment,
+                                                StatusCode::UNKNOWN_ERROR);
+                } else if (ret != true) {
                     rqstClb(task->rqst, StatusCode::UNKNOWN_ERROR);
                     OffloadRqst::updatePool.put(task->rqst);
                 }
@@ -74,8 +84,21 @@ void SpdkIoEngine::process() {
                 break;
             }
         }
+        _flushReads();
         requestCount = 0;
     }
 }
 
+void SpdkIoEngine::_flushReads() {
+    if (_reads.empty())
+        return;
+    SpdkBdev *bdev = reinterpret_cast<SpdkBdev *>(_reads.front()->bdev);
+    bdev->readBatch(_reads);
+    for (auto task : _reads) {
+        rqstClb(task->rqst, StatusCode::UNKNOWN_ERROR);
+        OffloadRqst::getPool.put(task->rqst);
+    }
+    _reads.clear();
+}
+
 } // namespace DaqDB
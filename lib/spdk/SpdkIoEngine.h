@@ -14,6 +14,7 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "spdk/bdev.h"
 #include "spdk/env.h"
@@ -38,6 +39,12 @@ class SpdkIoEngine : public Poller<DeviceTask> {
         if (rqst->clb)
             rqst->clb(nullptr, status, rqst->key, rqst->keySize, nullptr, 0);
     }
+
+  private:
+    void _flushReads();
+
+    /* consecutive reads of a batch, submitted together to be merged */
+    std::vector<DeviceTask *> _reads;
 };
 
 } // namespace DaqDB
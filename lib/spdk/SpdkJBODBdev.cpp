@@ -66,12 +66,57 @@ bool SpdkJBODBdev::write(DeviceTask *task) {
     if (!isRunning)
         return false;
 
-    uint32_t currDev = currDevice;
+    uint32_t currDev = _selectDevice(task);
     task->bdev = devices[currDev].bdev;
-    bool ret = devices[currDev].bdev->write(task);
-    currDevice++;
-    currDevice %= numDevices;
-    return ret;
+    return devices[currDev].bdev->write(task);
+}
+
+/*
+ * Members without room for the write are skipped unless all of them are
+ * full. Scan starts after the device picked last so that equally loaded
+ * members are still written in turn.
+ */
+uint32_t SpdkJBODBdev::_selectDevice(const DeviceTask *task) {
+    uint32_t start = currDevice;
+    currDevice = (start + 1) % numDevices;
+    if (placement == OffloadPlacement::ROUND_ROBIN)
+        return start;
+
+    size_t size = task->segment ? segmentBlocks * spBdevCtx.blk_size
+                                : task->rqst->valueSize;
+    uint64_t blocks = getOptimalSize(size) / spBdevCtx.blk_size;
+
+    uint32_t best = start;
+    bool bestFits = false;
+    uint64_t bestDepth = 0;
+    uint64_t bestFree = 0;
+    for (uint32_t i = 0; i < numDevices; i++) {
+        uint32_t idx = (start + i) % numDevices;
+        SpdkBdev *bdev = devices[idx].bdev;
+        uint64_t freeBlks = bdev->getFreeBlocks();
+        bool fits = freeBlks >= blocks;
+        uint64_t depth = bdev->getQueueDepth();
+
+        bool better;
+        if (i == 0)
+            better = true;
+        else if (fits != bestFits)
+            better = fits;
+        else if (placement == OffloadPlacement::FREE_SPACE)
+            better = freeBlks > bestFree ||
+                     (freeBlks == bestFree && depth < bestDepth);
+        else
+            better = depth < bestDepth ||
+                     (depth == bestDepth && freeBlks > bestFree);
+        if (better) {
+            best = idx;
+            bestFits = fits;
+            bestDepth = depth;
+            bestFree = freeBlks;
+        }
+    }
+    currDevice = (best + 1) % numDevices;
+    return best;
 }
 
 bool SpdkJBODBdev::remove(DeviceTask *task) {
@@ -100,6 +145,7 @@ bool SpdkJBODBdev::init(const SpdkConf &conf) {
     if (conf.getSpdkConfDevType() != SpdkConfDevType::JBOD) {
         return false;
     }
+    placement = conf.getPlacement();
 
     int bdevNum = 0;
     for (auto d : conf.getDevs()) {
@@ -107,9 +153,12 @@ bool SpdkJBODBdev::init(const SpdkConf &conf) {
         devices[numDevices].addr.busAddr.pciAddr = d.pciAddr;
         devices[numDevices].num = numDevices;
         devices[numDevices].bdev = new SpdkBdev(statsEnabled);
+        devices[numDevices].bdev->setReleaseHandler(releaseHandler);
 
         SpdkConf currConf(SpdkConfDevType::BDEV, d.devName, 0);
         currConf.setBdevNum(bdevNum++);
+        currConf.setQueues(conf.getQueues());
+        currConf.setReadAhead(conf.getReadAhead());
         currConf.addDev(d);
         bool ret = devices[numDevices].bdev->init(currConf);
         if (ret == false) {
@@ -147,6 +196,32 @@ void SpdkJBODBdev::setBlockNumForLba(uint64_t blk_num_flba) {
     }
 }
 
+void SpdkJBODBdev::setSegmentBlocks(uint64_t blk_num_seg) {
+    segmentBlocks = blk_num_seg;
+
+    for (uint32_t i = 0; i < numDevices; i++) {
+        devices[i].bdev->setSegmentBlocks(blk_num_seg);
+    }
+}
+
+SpdkDevice *SpdkJBODBdev::getCompactionVictim(uint32_t maxLiveBytes,
+                                              unsigned int freePercent,
+                                              uint64_t &lba) {
+    if (!isRunning)
+        return nullptr;
+
+    for (uint32_t i = 0; i < numDevices; i++) {
+        uint32_t idx = (gcDevice + i) % numDevices;
+        SpdkDevice *dev = devices[idx].bdev->getCompactionVictim(
+            maxLiveBytes, freePercent, lba);
+        if (dev) {
+            gcDevice = idx + 1;
+            return dev;
+        }
+    }
+    return nullptr;
+}
+
 int64_t SpdkJBODBdev::getFreeLba(size_t ioSize) { return -1; }
 
 void SpdkJBODBdev::putFreeLba(const DeviceAddr *devAddr, size_t ioSize) {
@@ -99,6 +99,10 @@ class SpdkJBODBdev : public SpdkDevice {
         return lba * blkNumForLba;
     }
     virtual void setBlockNumForLba(uint64_t blk_num_flba);
+    virtual void setSegmentBlocks(uint64_t blk_num_seg);
+    virtual SpdkDevice *getCompactionVictim(uint32_t maxLiveBytes,
+                                            unsigned int freePercent,
+                                            uint64_t &lba);
     virtual void setMaxQueued(uint32_t io_cache_size, uint32_t blk_size);
     virtual uint32_t getBlockSize() { return spBdevCtx.blk_size; }
     virtual uint32_t getIoPoolSize() { return spBdevCtx.io_pool_size; }
@@ -120,13 +124,18 @@ class SpdkJBODBdev : public SpdkDevice {
         return devHash.idx;
     }
 
-  private:
+    uint32_t _selectDevice(const DeviceTask *task);
+
     const static uint32_t maxDevices = 64;
     JBODDevice devices[maxDevices];
+    uint32_t numDevices = 0;
+    OffloadPlacement placement = OffloadPlacement::QUEUE_DEPTH;
+
+  private:
     const static uint16_t maxHash = -1;
     int32_t deviceHash[maxHash];
-    uint32_t numDevices = 0;
     uint32_t currDevice = 0;
+    uint32_t gcDevice = 0; // device searched first for compaction victims
     std::atomic<int> isRunning;
 };
 
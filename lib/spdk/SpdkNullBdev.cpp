@@ -0,0 +1,185 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include <LatencyTracer.h>
+#include <Logger.h>
+
+#include "SpdkNullBdev.h"
+
+namespace DaqDB {
+
+SpdkDeviceClass SpdkNullBdev::bdev_class = SpdkDeviceClass::NULLDEV;
+
+const char *SpdkNullBdev::nullBdevName = "null";
+const char *SpdkNullBdev::ramBdevName = "ram";
+
+SpdkNullBdev::SpdkNullBdev(bool enableStats) : SpdkBdev(enableStats) {}
+
+SpdkNullBdev::~SpdkNullBdev() { _unmapMem(); }
+
+bool SpdkNullBdev::init(const SpdkConf &conf) {
+    _ram = conf.getSpdkConfDevType() == SpdkConfDevType::RAMDISK;
+    if ((!_ram && conf.getSpdkConfDevType() != SpdkConfDevType::NULLDEV) ||
+        conf.getDevs().empty())
+        return false;
+
+    _size = conf.getNullSize() * 1024 * 1024;
+    _latency = conf.getNullLatency() * 1000;
+
+    const char *name = _ram ? ramBdevName : nullBdevName;
+    SpdkBdevConf nullDev = conf.getDevs()[0];
+    nullDev.nvmeName = name;
+    SpdkConf nullConf(conf.getSpdkConfDevType(), name, 0);
+    nullConf.setBdevNum(-1);
+    nullConf.setQueues(conf.getQueues());
+    nullConf.setReadAhead(conf.getReadAhead());
+    nullConf.addDev(nullDev);
+    DAQ_DEBUG(std::string(_ram ? "RAM" : "Null") + " device of [" +
+              std::to_string(conf.getNullSize()) + "] MB, latency [" +
+              std::to_string(conf.getNullLatency()) + "] us");
+    return SpdkBdev::init(nullConf);
+}
+
+/*
+ * Called from the first IO engine thread. Memory of RAM device is mapped
+ * without reserve, it is backed as blocks are written.
+ */
+bool SpdkNullBdev::bdevInit() {
+    if (_size < SPDK_NULL_BLK_SIZE) {
+        DAQ_CRITICAL("Size of " + std::string(spBdevCtx.bdev_name) +
+                     " device must be at least one block");
+        spBdevCtx.state = SPDK_BDEV_ERROR;
+        return false;
+    }
+    if (_ram) {
+        void *mem = mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem == MAP_FAILED) {
+            DAQ_CRITICAL("Cannot map [" + std::to_string(_size) +
+                         "] bytes for RAM device");
+            spBdevCtx.state = SPDK_BDEV_ERROR;
+            return false;
+        }
+        _mem = reinterpret_cast<char *>(mem);
+    }
+
+    spBdevCtx.io_pool_size = SPDK_NULL_IO_POOL_SIZE;
+    maxIoBufs = spBdevCtx.io_pool_size;
+    spBdevCtx.io_cache_size = SPDK_NULL_IO_CACHE_SIZE;
+    maxCacheIoBufs = spBdevCtx.io_cache_size;
+
+    spBdevCtx.blk_size = SPDK_NULL_BLK_SIZE;
+    spBdevCtx.data_blk_size = SPDK_NULL_BLK_SIZE;
+    spBdevCtx.buf_align = SPDK_NULL_BLK_SIZE;
+    spBdevCtx.blk_num = _size / SPDK_NULL_BLK_SIZE;
+    DAQ_DEBUG(std::string(spBdevCtx.bdev_name) + " device number of blocks[" +
+              std::to_string(spBdevCtx.blk_num) + "]");
+    return true;
+}
+
+void SpdkNullBdev::deinit() {
+    isRunning = 4;
+    while (isRunning == 4) {
+    }
+    _unmapMem();
+}
+
+void SpdkNullBdev::_unmapMem() {
+    if (_mem)
+        munmap(_mem, _size);
+    _mem = nullptr;
+}
+
+void SpdkNullBdev::ioEngineThreadMain(SpdkIoQueue *queue) {
+    pollIoEngineThreadMain(queue);
+}
+
+/*
+ * Latency is the same for all IOs of a queue, so they become due in the
+ * order they were submitted.
+ */
+void SpdkNullBdev::pollIoQueue(SpdkIoQueue &queue) {
+    std::deque<SpdkNullIo> &pending = _pending[queue.idx];
+    if (pending.empty())
+        return;
+    uint64_t now = _latency ? LatencyTracer::now() : 0;
+    while (!pending.empty() && pending.front().due <= now) {
+        SpdkNullIo io = pending.front();
+        pending.pop_front();
+        io.cb(nullptr, true, io.arg);
+    }
+}
+
+/*
+ * IOs never complete from within submission, callers account an IO as
+ * outstanding after it was submitted.
+ */
+int SpdkNullBdev::_complete(SpdkIoQueue &queue, spdk_bdev_io_completion_cb cb,
+                            void *arg) {
+    uint64_t due = _latency ? LatencyTracer::now() + _latency : 0;
+    _pending[queue.idx].push_back({cb, arg, due});
+    return 0;
+}
+
+int SpdkNullBdev::submitRead(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                             uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                             void *arg) {
+    if (_mem)
+        memcpy(buf, _mem + lba * SPDK_NULL_BLK_SIZE,
+               blocks * SPDK_NULL_BLK_SIZE);
+    return _complete(queue, cb, arg);
+}
+
+int SpdkNullBdev::submitWrite(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                              uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                              void *arg) {
+    if (_mem)
+        memcpy(_mem + lba * SPDK_NULL_BLK_SIZE, buf,
+               blocks * SPDK_NULL_BLK_SIZE);
+    return _complete(queue, cb, arg);
+}
+
+int SpdkNullBdev::submitWritev(SpdkIoQueue &queue, struct iovec *iov,
+                               int iovcnt, uint64_t lba, uint64_t blocks,
+                               spdk_bdev_io_completion_cb cb, void *arg) {
+    if (_mem) {
+        char *dst = _mem + lba * SPDK_NULL_BLK_SIZE;
+        size_t left = blocks * SPDK_NULL_BLK_SIZE;
+        for (int idx = 0; idx < iovcnt && left; idx++) {
+            size_t len = std::min(left, iov[idx].iov_len);
+            memcpy(dst, iov[idx].iov_base, len);
+            dst += len;
+            left -= len;
+        }
+    }
+    return _complete(queue, cb, arg);
+}
+
+/*
+ * Not used as unmap is not advertised, freed extents are reused at once.
+ */
+int SpdkNullBdev::submitUnmap(SpdkIoQueue &queue, uint64_t lba,
+                              uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                              void *arg) {
+    return _complete(queue, cb, arg);
+}
+
+} // namespace DaqDB
@@ -0,0 +1,104 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include "SpdkBdev.h"
+#include "SpdkConf.h"
+#include "SpdkDevice.h"
+
+namespace DaqDB {
+
+/* block size of null and RAM devices */
+const uint32_t SPDK_NULL_BLK_SIZE = 4096;
+/* SPDK bdev layer defaults, IOs are queued as for an SPDK bdev */
+const uint32_t SPDK_NULL_IO_POOL_SIZE = 65535;
+const uint32_t SPDK_NULL_IO_CACHE_SIZE = 256;
+
+/*
+ * IO waiting for its completion time.
+ */
+struct SpdkNullIo {
+    spdk_bdev_io_completion_cb cb;
+    void *arg;
+    uint64_t due;
+};
+
+/*
+ * In-process device to measure the offload pipeline without a drive. Null
+ * device drops writes and leaves read buffers as they are, RAM device keeps
+ * written blocks in memory until the process exits. IOs complete in the
+ * next poll of their queue or once the configured latency passes, there is
+ * no SPDK thread behind IO queues. Extents allocated on the device are kept
+ * in PMEM as for drives, so values offloaded to a RAM device do not survive
+ * a restart.
+ */
+class SpdkNullBdev : public SpdkBdev {
+  public:
+    SpdkNullBdev(bool enableStats = false);
+    virtual ~SpdkNullBdev();
+
+    /**
+     * Initialize null or RAM device of the configured size.
+     *
+     * @return true if memory of RAM device successfully mapped, false
+     * otherwise
+     */
+    virtual bool init(const SpdkConf &conf);
+    virtual void deinit();
+    virtual bool bdevInit();
+    virtual void ioEngineThreadMain(SpdkIoQueue *queue);
+
+    static SpdkDeviceClass bdev_class;
+
+    /*
+     * Names of the devices in logs and free list files
+     */
+    const static char *nullBdevName;
+    const static char *ramBdevName;
+
+  protected:
+    virtual void pollIoQueue(SpdkIoQueue &queue);
+
+    virtual int submitRead(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                           uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                           void *arg);
+    virtual int submitWrite(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                            uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                            void *arg);
+    virtual int submitWritev(SpdkIoQueue &queue, struct iovec *iov,
+                             int iovcnt, uint64_t lba, uint64_t blocks,
+                             spdk_bdev_io_completion_cb cb, void *arg);
+    virtual int submitUnmap(SpdkIoQueue &queue, uint64_t lba, uint64_t blocks,
+                            spdk_bdev_io_completion_cb cb, void *arg);
+
+    bool _ram = false;
+    size_t _size = 0;     // bytes
+    uint64_t _latency = 0; // ns
+    char *_mem = nullptr;
+
+  private:
+    int _complete(SpdkIoQueue &queue, spdk_bdev_io_completion_cb cb,
+                  void *arg);
+    void _unmapMem();
+
+    std::deque<SpdkNullIo> _pending[SPDK_MAX_IO_QUEUES];
+};
+
+} // namespace DaqDB
@@ -21,30 +21,38 @@ namespace DaqDB {
 
 SpdkDeviceClass SpdkRAID0Bdev::bdev_class = SpdkDeviceClass::RAID0;
 
-SpdkRAID0Bdev::SpdkRAID0Bdev() : isRunning(0) {}
-
-bool SpdkRAID0Bdev::read(DeviceTask *task) { return true; }
-
-bool SpdkRAID0Bdev::write(DeviceTask *task) { return true; }
-
-bool SpdkRAID0Bdev::remove(DeviceTask *task) { return true; }
-
-int SpdkRAID0Bdev::reschedule(DeviceTask *task) { return 0; }
-
-void SpdkRAID0Bdev::deinit() {}
-
-bool SpdkRAID0Bdev::init(const SpdkConf &conf) { return true; }
-
-void SpdkRAID0Bdev::initFreeList() {}
-
-int64_t SpdkRAID0Bdev::getFreeLba(size_t ioSize) { return -1; }
-
-void SpdkRAID0Bdev::putFreeLba(const DeviceAddr *devAddr, size_t ioSize) {}
-
-void SpdkRAID0Bdev::enableStats(bool en) {}
+const char *SpdkRAID0Bdev::raidBdevName = "Raid0";
+
+SpdkRAID0Bdev::SpdkRAID0Bdev(bool enableStats) : SpdkBdev(enableStats) {}
+
+bool SpdkRAID0Bdev::init(const SpdkConf &conf) {
+    if (conf.getSpdkConfDevType() != SpdkConfDevType::RAID0 ||
+        conf.getDevs().empty())
+        return false;
+
+    size_t stripeSize = conf.getRaid0StripeSize();
+    if (!stripeSize || (stripeSize & (stripeSize - 1))) {
+        DAQ_CRITICAL("RAID0 stripe size [" + std::to_string(stripeSize) +
+                     "] must be a power of 2");
+        return false;
+    }
+
+    /* the set is addressed by PCI address of its first member */
+    SpdkBdevConf raidDev = conf.getDevs()[0];
+    raidDev.nvmeName = raidBdevName;
+    SpdkConf raidConf(SpdkConfDevType::RAID0, raidBdevName, stripeSize);
+    raidConf.setBdevNum(-1);
+    raidConf.setQueues(conf.getQueues());
+    raidConf.setReadAhead(conf.getReadAhead());
+    raidConf.addDev(raidDev);
+    DAQ_DEBUG("RAID0 of [" + std::to_string(conf.getDevs().size()) +
+              "] drives, stripe size [" + std::to_string(stripeSize) +
+              "] KB");
+    return SpdkBdev::init(raidConf);
+}
 
-void SpdkRAID0Bdev::setMaxQueued(uint32_t io_cache_size, uint32_t blk_size) {
-    IoBytesMaxQueued = io_cache_size * 128;
+struct spdk_bdev *SpdkRAID0Bdev::lookupBdev() {
+    return spdk_bdev_get_by_name(raidBdevName);
 }
 
 } // namespace DaqDB
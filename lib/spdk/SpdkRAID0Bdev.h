@@ -23,6 +23,7 @@
 #include "spdk/bdev.h"
 
 #include "Rqst.h"
+#include "SpdkBdev.h"
 #include "SpdkConf.h"
 #include "SpdkDevice.h"
 #include <Logger.h>
@@ -30,10 +31,17 @@
 
 namespace DaqDB {
 
-class SpdkRAID0Bdev : public SpdkDevice {
+/*
+ * RAID0 set built by SPDK raid bdev module out of configured NVMe drives.
+ * Member drives form a single LBA space striped by raid0StripeSize, IOs are
+ * split at stripe boundaries and the chunks are submitted to all members in
+ * parallel, the IO completes once every chunk does. The set is driven like a
+ * single bdev, values and log segments are allocated from the combined space.
+ */
+class SpdkRAID0Bdev : public SpdkBdev {
   public:
-    SpdkRAID0Bdev(void);
-    ~SpdkRAID0Bdev() = default;
+    SpdkRAID0Bdev(bool enableStats = false);
+    virtual ~SpdkRAID0Bdev() = default;
 
     /**
      * Initialize RAID0 devices.
@@ -42,48 +50,16 @@ class SpdkRAID0Bdev : public SpdkDevice {
      * otherwise
      */
     virtual bool init(const SpdkConf &conf);
-    virtual void deinit();
-    virtual void initFreeList();
-    virtual int64_t getFreeLba(size_t ioSize);
-    virtual void putFreeLba(const DeviceAddr *devAddr, size_t ioSize);
+
+    static SpdkDeviceClass bdev_class;
 
     /*
-     * SpdkDevice virtual interface
+     * Name of raid bdev put into SPDK configuration file
      */
-    virtual bool read(DeviceTask *task);
-    virtual bool write(DeviceTask *task);
-    virtual bool remove(DeviceTask *task);
-    virtual int reschedule(DeviceTask *task);
-
-    virtual void enableStats(bool en);
-    virtual size_t getOptimalSize(size_t size) { return 0; }
-    virtual size_t getAlignedSize(size_t size) { return 0; }
-    virtual uint32_t getSizeInBlk(size_t &size) { return 0; }
-    virtual void setReady() {}
-    virtual bool isOffloadEnabled() { return true; }
-    virtual bool isBdevFound() { return true; }
-    virtual void IOQuiesce() {}
-    virtual bool isIOQuiescent() { return true; }
-    virtual void IOAbort() {}
-    virtual uint32_t canQueue() { return 1024; }
-    virtual SpdkBdevCtx *getBdevCtx() { return &spBdevCtx; }
-    virtual uint64_t getBlockOffsetForLba(uint64_t lba) {
-        return lba * blkNumForLba;
-    }
-    virtual void setBlockNumForLba(uint64_t blk_num_flba) {
-        blkNumForLba = blk_num_flba;
-    }
-    virtual void setMaxQueued(uint32_t io_cache_size, uint32_t blk_size);
-    virtual uint32_t getBlockSize() { return spBdevCtx.blk_size; }
-    virtual uint32_t getIoPoolSize() { return spBdevCtx.io_pool_size; }
-    virtual uint32_t getIoCacheSize() { return spBdevCtx.io_cache_size; }
-    virtual void setRunning(int running) { isRunning = running; }
-    virtual bool IsRunning(int running) { return isRunning; }
-
-    static SpdkDeviceClass bdev_class;
+    const static char *raidBdevName;
 
-  private:
-    std::atomic<int> isRunning;
+  protected:
+    virtual struct spdk_bdev *lookupBdev();
 };
 
 } // namespace DaqDB
@@ -0,0 +1,205 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "SpdkUring.h"
+
+namespace DaqDB {
+
+/* SQ polling thread goes to sleep after this many idle milliseconds */
+const unsigned int SPDK_URING_SQ_IDLE_MS = 1000;
+
+SpdkUring::~SpdkUring() { exit(); }
+
+int SpdkUring::init(unsigned int entries, int fd, bool sqPoll,
+                    unsigned int fixedBufs) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (sqPoll) {
+        params.flags = IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = SPDK_URING_SQ_IDLE_MS;
+    }
+    _fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (_fd < 0 && sqPoll && (errno == EPERM || errno == EINVAL)) {
+        /* SQ polling needs CAP_SYS_ADMIN before Linux 5.11 */
+        memset(&params, 0, sizeof(params));
+        _fd = syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (_fd < 0)
+        return -errno;
+    _sqPoll = params.flags & IORING_SETUP_SQPOLL;
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqRingSize = params.cq_off.cqes +
+                  params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+    _sqRing = mmap(0, _sqRingSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+    if (_sqRing == MAP_FAILED) {
+        _sqRing = nullptr;
+        int rc = -errno;
+        exit();
+        return rc;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _cqRing = _sqRing;
+    } else {
+        _cqRing = mmap(0, _cqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+        if (_cqRing == MAP_FAILED) {
+            _cqRing = nullptr;
+            int rc = -errno;
+            exit();
+            return rc;
+        }
+    }
+    _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(0, _sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        int rc = -errno;
+        exit();
+        return rc;
+    }
+    _sqes = reinterpret_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = reinterpret_cast<char *>(_sqRing);
+    _sqHead = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+    _sqFlags = reinterpret_cast<unsigned int *>(sq + params.sq_off.flags);
+    _sqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+    _sqMask = *reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    _sqLocalTail = *_sqTail;
+
+    char *cq = reinterpret_cast<char *>(_cqRing);
+    _cqHead = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+    _cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    _cqMask = *reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+    _cqEntries = params.cq_entries;
+
+    if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_FILES, &fd, 1)) {
+        int rc = -errno;
+        exit();
+        return rc;
+    }
+
+    /* without a buffer table IOs are done with unregistered buffers */
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    if (fixedBufs) {
+        struct io_uring_rsrc_register reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.nr = fixedBufs;
+        reg.flags = IORING_RSRC_REGISTER_SPARSE;
+        if (!syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS2,
+                     &reg, sizeof(reg)))
+            _fixedBufs = fixedBufs;
+    }
+#endif
+    return 0;
+}
+
+void SpdkUring::exit() {
+    if (_sqes)
+        munmap(_sqes, _sqesSize);
+    if (_cqRing && _cqRing != _sqRing)
+        munmap(_cqRing, _cqRingSize);
+    if (_sqRing)
+        munmap(_sqRing, _sqRingSize);
+    if (_fd >= 0)
+        close(_fd);
+    _sqes = nullptr;
+    _cqRing = nullptr;
+    _sqRing = nullptr;
+    _fd = -1;
+    _fixedBufs = 0;
+}
+
+struct io_uring_sqe *SpdkUring::getSqe() {
+    unsigned int head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if (_sqLocalTail - head >= _sqEntries)
+        return nullptr;
+    unsigned int idx = _sqLocalTail & _sqMask;
+    _sqArray[idx] = idx;
+    _sqLocalTail++;
+    struct io_uring_sqe *sqe = &_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int SpdkUring::submit() {
+    __atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+    if (_sqPoll) {
+        /* flag is set by the polling thread after it saw the tail */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(_sqFlags, __ATOMIC_RELAXED) &
+            IORING_SQ_NEED_WAKEUP)
+            return _enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+        return 0;
+    }
+    unsigned int toSubmit =
+        _sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    return toSubmit ? _enter(toSubmit, 0, 0) : 0;
+}
+
+int SpdkUring::wait() {
+    int rc = submit();
+    if (rc < 0 && rc != -EAGAIN && rc != -EBUSY)
+        return rc;
+    unsigned int flags = IORING_ENTER_GETEVENTS;
+    if (_sqPoll)
+        flags |= IORING_ENTER_SQ_WAKEUP;
+    return _enter(0, 1, flags);
+}
+
+int SpdkUring::registerBuffer(unsigned int idx, void *addr, size_t len) {
+    if (idx >= _fixedBufs)
+        return -EINVAL;
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    struct iovec iov = {addr, len};
+    struct io_uring_rsrc_update2 upd;
+    memset(&upd, 0, sizeof(upd));
+    upd.offset = idx;
+    upd.data = reinterpret_cast<uint64_t>(&iov);
+    upd.nr = 1;
+    if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS_UPDATE,
+                &upd, sizeof(upd)) < 0)
+        return -errno;
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+int SpdkUring::_enter(unsigned int toSubmit, unsigned int minComplete,
+                      unsigned int flags) {
+    int rc = syscall(__NR_io_uring_enter, _fd, toSubmit, minComplete, flags,
+                     nullptr, 0);
+    return rc < 0 ? -errno : rc;
+}
+
+} // namespace DaqDB
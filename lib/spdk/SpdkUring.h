@@ -0,0 +1,131 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+
+namespace DaqDB {
+
+/*
+ * Single io_uring instance driven by one thread, set up with raw syscalls.
+ * The device file is registered as fixed file 0. Buffers are registered
+ * into a sparse table one by one as they are first used.
+ */
+class SpdkUring {
+  public:
+    SpdkUring() = default;
+    ~SpdkUring();
+
+    SpdkUring(const SpdkUring &) = delete;
+    SpdkUring &operator=(const SpdkUring &) = delete;
+
+    /**
+     * Sets up the ring and registers fd as fixed file 0. SQ polling falls
+     * back to submission by syscall when the kernel does not permit it.
+     *
+     * @return 0 on success, negative errno otherwise
+     */
+    int init(unsigned int entries, int fd, bool sqPoll, unsigned int fixedBufs);
+    void exit();
+
+    bool isSqPoll() const { return _sqPoll; }
+    unsigned int getCqEntries() const { return _cqEntries; }
+    unsigned int getFixedBufs() const { return _fixedBufs; }
+
+    /**
+     * @return next submission entry cleared, nullptr if SQ is full
+     */
+    struct io_uring_sqe *getSqe();
+
+    /**
+     * Passes entries taken since the last call to the kernel, waking up the
+     * SQ polling thread if it went idle.
+     */
+    int submit();
+
+    /**
+     * Submits pending entries and blocks until a completion is posted, used
+     * when SQ or in flight IOs are exhausted.
+     */
+    int wait();
+
+    /**
+     * Registers buffer at given index of the fixed buffer table.
+     *
+     * @return 0 on success, negative errno otherwise
+     */
+    int registerBuffer(unsigned int idx, void *addr, size_t len);
+
+    /**
+     * Calls fn(user_data, res) for each completion.
+     *
+     * @return number of completions
+     */
+    template <typename Fn> unsigned int reap(Fn fn);
+
+  private:
+    int _enter(unsigned int toSubmit, unsigned int minComplete,
+               unsigned int flags);
+
+    int _fd = -1;
+    bool _sqPoll = false;
+    unsigned int _fixedBufs = 0;
+
+    void *_sqRing = nullptr;
+    size_t _sqRingSize = 0;
+    void *_cqRing = nullptr;
+    size_t _cqRingSize = 0;
+    struct io_uring_sqe *_sqes = nullptr;
+    size_t _sqesSize = 0;
+
+    unsigned int *_sqHead = nullptr;
+    unsigned int *_sqTail = nullptr;
+    unsigned int *_sqFlags = nullptr;
+    unsigned int *_sqArray = nullptr;
+    unsigned int _sqMask = 0;
+    unsigned int _sqEntries = 0;
+    unsigned int _sqLocalTail = 0;
+    unsigned int _sqSubmitted = 0;
+
+    unsigned int *_cqHead = nullptr;
+    unsigned int *_cqTail = nullptr;
+    struct io_uring_cqe *_cqes = nullptr;
+    unsigned int _cqMask = 0;
+    unsigned int _cqEntries = 0;
+};
+
+template <typename Fn> unsigned int SpdkUring::reap(Fn fn) {
+    unsigned int cnt = 0;
+    for (;;) {
+        unsigned int head = *_cqHead;
+        if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+            break;
+        struct io_uring_cqe *cqe = &_cqes[head & _cqMask];
+        uint64_t data = cqe->user_data;
+        int res = cqe->res;
+        /* entry is released before fn, which may reap on its own */
+        __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+        fn(data, res);
+        cnt++;
+    }
+    return cnt;
+}
+
+} // namespace DaqDB
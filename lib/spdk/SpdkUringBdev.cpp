@@ -0,0 +1,300 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SpdkUringBdev.h"
+#include <Logger.h>
+
+namespace DaqDB {
+
+#define URING_CREATE_MODE_RW (S_IWUSR | S_IRUSR)
+
+SpdkDeviceClass SpdkUringBdev::bdev_class = SpdkDeviceClass::URING;
+
+const char *SpdkUringBdev::uringBdevName = "uring";
+
+SpdkUringBdev::SpdkUringBdev(bool enableStats) : SpdkBdev(enableStats) {}
+
+SpdkUringBdev::~SpdkUringBdev() {
+    if (_devFd >= 0)
+        close(_devFd);
+}
+
+bool SpdkUringBdev::init(const SpdkConf &conf) {
+    if (conf.getSpdkConfDevType() != SpdkConfDevType::URING ||
+        conf.getDevs().empty())
+        return false;
+
+    _path = conf.getDevs()[0].devName;
+    _fileSize = conf.getUringFileSize() * 1024 * 1024;
+    _sqPoll = conf.getUringSqPoll();
+
+    SpdkBdevConf uringDev = conf.getDevs()[0];
+    uringDev.nvmeName = uringBdevName;
+    SpdkConf uringConf(SpdkConfDevType::URING, uringBdevName, 0);
+    uringConf.setBdevNum(-1);
+    uringConf.setQueues(conf.getQueues());
+    uringConf.setReadAhead(conf.getReadAhead());
+    uringConf.addDev(uringDev);
+    DAQ_DEBUG("io_uring device [" + _path + "] SQ polling [" +
+              std::to_string(_sqPoll) + "]");
+    return SpdkBdev::init(uringConf);
+}
+
+/*
+ * Called from the first IO engine thread before rings are set up. Files not
+ * supporting direct IO, e.g. on tmpfs, are accessed through page cache.
+ */
+bool SpdkUringBdev::bdevInit() {
+    _devFd = open(_path.c_str(), O_RDWR | O_CREAT | O_DIRECT,
+                  URING_CREATE_MODE_RW);
+    if (_devFd < 0 && errno == EINVAL) {
+        DAQ_DEBUG("Direct IO not supported by [" + _path + "]");
+        _devFd = open(_path.c_str(), O_RDWR | O_CREAT, URING_CREATE_MODE_RW);
+    }
+    if (_devFd < 0) {
+        DAQ_CRITICAL("Open io_uring device [" + _path +
+                     "] failed with error code[" + std::to_string(errno) +
+                     "]");
+        spBdevCtx.state = SPDK_BDEV_ERROR;
+        return false;
+    }
+
+    struct stat st;
+    uint64_t size = 0;
+    uint32_t blkSize = SPDK_URING_FILE_BLK_SIZE;
+    if (!fstat(_devFd, &st) && S_ISBLK(st.st_mode)) {
+        int sectorSize = 0;
+        if (ioctl(_devFd, BLKGETSIZE64, &size) ||
+            ioctl(_devFd, BLKSSZGET, &sectorSize))
+            size = 0;
+        blkSize = sectorSize;
+    } else if (!fstat(_devFd, &st)) {
+        size = _fileSize ? _fileSize : st.st_size;
+        if (size > static_cast<uint64_t>(st.st_size) &&
+            ftruncate(_devFd, size))
+            size = 0;
+    }
+    if (!blkSize || size < blkSize) {
+        DAQ_CRITICAL("Cannot size io_uring device [" + _path +
+                     "], offload_uring_file_size needed for a new file");
+        spBdevCtx.state = SPDK_BDEV_ERROR;
+        return false;
+    }
+
+    spBdevCtx.io_pool_size = SPDK_URING_ENTRIES * ioQueueCnt;
+    maxIoBufs = spBdevCtx.io_pool_size;
+    spBdevCtx.io_cache_size = SPDK_URING_ENTRIES;
+    maxCacheIoBufs = spBdevCtx.io_cache_size;
+
+    spBdevCtx.blk_size = blkSize;
+    spBdevCtx.data_blk_size = blkSize;
+    spBdevCtx.buf_align = blkSize;
+    spBdevCtx.blk_num = size / blkSize;
+    DAQ_DEBUG("io_uring device block size[" +
+              std::to_string(spBdevCtx.blk_size) + "] number of blocks[" +
+              std::to_string(spBdevCtx.blk_num) + "]");
+
+    /* freed extents are punched out, failures only delay device GC */
+    _unmapSupported = true;
+    return true;
+}
+
+bool SpdkUringBdev::initIoQueue(SpdkIoQueue &queue) {
+    if (_devFd < 0)
+        return false;
+    SpdkUringQueue &uq = _queues[queue.idx];
+    int rc = uq.ring.init(SPDK_URING_ENTRIES, _devFd, _sqPoll,
+                          SPDK_URING_FIXED_BUFS);
+    if (rc) {
+        DAQ_CRITICAL("io_uring setup failed with error code[" +
+                     std::to_string(rc) + "] queue[" +
+                     std::to_string(queue.idx) + "]");
+        return false;
+    }
+    if (_sqPoll && !uq.ring.isSqPoll())
+        DAQ_DEBUG("io_uring SQ polling not permitted, submitting by syscall");
+    if (!uq.ring.getFixedBufs())
+        DAQ_DEBUG("io_uring fixed buffers not supported");
+
+    /* IOs in flight are bounded by CQ size so no completion is dropped */
+    uq.ios.resize(uq.ring.getCqEntries());
+    for (auto &io : uq.ios)
+        uq.freeIos.push_back(&io);
+    return true;
+}
+
+void SpdkUringBdev::ioEngineThreadMain(SpdkIoQueue *queue) {
+    pollIoEngineThreadMain(queue);
+}
+
+/*
+ * Entries taken by the IO engine run are submitted together, then the ring
+ * is reaped.
+ */
+void SpdkUringBdev::pollIoQueue(SpdkIoQueue &queue) {
+    SpdkUringQueue &uq = _queues[queue.idx];
+    uq.ring.submit();
+    _reap(uq);
+}
+
+void SpdkUringBdev::exitIoQueue(SpdkIoQueue &queue) {
+    _queues[queue.idx].ring.exit();
+}
+
+void SpdkUringBdev::deinit() {
+    isRunning = 4;
+    while (isRunning == 4) {
+    }
+    if (_devFd >= 0) {
+        close(_devFd);
+        _devFd = -1;
+    }
+}
+
+/*
+ * Takes an SQ entry and an IO slot. Completions are reaped in place when
+ * either runs out, so submission does not fail for lack of resources.
+ */
+struct io_uring_sqe *SpdkUringBdev::_getSqe(SpdkUringQueue &uq, int64_t bytes,
+                                            spdk_bdev_io_completion_cb cb,
+                                            void *arg) {
+    while (uq.freeIos.empty()) {
+        uq.ring.wait();
+        _reap(uq);
+    }
+    struct io_uring_sqe *sqe;
+    while (!(sqe = uq.ring.getSqe())) {
+        uq.ring.wait();
+        _reap(uq);
+    }
+
+    SpdkUringIo *io = uq.freeIos.back();
+    uq.freeIos.pop_back();
+    io->cb = cb;
+    io->arg = arg;
+    io->bytes = bytes;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = 0;
+    sqe->user_data = reinterpret_cast<uint64_t>(io);
+    return sqe;
+}
+
+void SpdkUringBdev::_reap(SpdkUringQueue &uq) {
+    uq.ring.reap([&uq](uint64_t data, int res) {
+        SpdkUringIo *io = reinterpret_cast<SpdkUringIo *>(data);
+        spdk_bdev_io_completion_cb cb = io->cb;
+        void *arg = io->arg;
+        bool success = res == io->bytes;
+        uq.freeIos.push_back(io);
+        cb(nullptr, success, arg);
+    });
+}
+
+/*
+ * DMA buffers come from SPDK hugepage memory reserved at start up, mapped
+ * for the process lifetime. They are registered by the chunk holding them,
+ * buffers crossing a chunk boundary and the PMEM pool use plain IO.
+ */
+int SpdkUringBdev::_fixedBuf(SpdkUringQueue &uq, const char *buf,
+                             size_t len) {
+    if (!uq.ring.getFixedBufs() || ioPoolMgr->isDmaRegion(buf, len, 1))
+        return -1;
+    uintptr_t addr = reinterpret_cast<uintptr_t>(buf);
+    uintptr_t chunk = addr & ~(SPDK_URING_FIXED_BUF_SIZE - 1);
+    if (addr + len > chunk + SPDK_URING_FIXED_BUF_SIZE)
+        return -1;
+
+    auto it = uq.fixedBufs.find(chunk);
+    if (it != uq.fixedBufs.end())
+        return it->second;
+    int idx = -1;
+    if (uq.fixedCnt < uq.ring.getFixedBufs() &&
+        !uq.ring.registerBuffer(uq.fixedCnt, reinterpret_cast<void *>(chunk),
+                                SPDK_URING_FIXED_BUF_SIZE))
+        idx = uq.fixedCnt++;
+    uq.fixedBufs[chunk] = idx;
+    return idx;
+}
+
+int SpdkUringBdev::_submitRw(SpdkIoQueue &queue, bool write, char *buf,
+                             uint64_t lba, uint64_t blocks,
+                             spdk_bdev_io_completion_cb cb, void *arg) {
+    SpdkUringQueue &uq = _queues[queue.idx];
+    size_t len = blocks * spBdevCtx.blk_size;
+    int idx = _fixedBuf(uq, buf, len);
+    struct io_uring_sqe *sqe = _getSqe(uq, len, cb, arg);
+    if (idx < 0) {
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    } else {
+        sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = idx;
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = lba * spBdevCtx.blk_size;
+    return 0;
+}
+
+int SpdkUringBdev::submitRead(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                              uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                              void *arg) {
+    return _submitRw(queue, false, buf, lba, blocks, cb, arg);
+}
+
+int SpdkUringBdev::submitWrite(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                               uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                               void *arg) {
+    return _submitRw(queue, true, buf, lba, blocks, cb, arg);
+}
+
+int SpdkUringBdev::submitWritev(SpdkIoQueue &queue, struct iovec *iov,
+                                int iovcnt, uint64_t lba, uint64_t blocks,
+                                spdk_bdev_io_completion_cb cb, void *arg) {
+    int64_t bytes = 0;
+    for (int idx = 0; idx < iovcnt; idx++)
+        bytes += iov[idx].iov_len;
+    struct io_uring_sqe *sqe = _getSqe(_queues[queue.idx], bytes, cb, arg);
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = iovcnt;
+    sqe->off = lba * spBdevCtx.blk_size;
+    return 0;
+}
+
+/*
+ * Punching a hole deallocates file blocks, on a block device it becomes
+ * write zeroes with deallocation.
+ */
+int SpdkUringBdev::submitUnmap(SpdkIoQueue &queue, uint64_t lba,
+                               uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                               void *arg) {
+    struct io_uring_sqe *sqe = _getSqe(_queues[queue.idx], 0, cb, arg);
+    sqe->opcode = IORING_OP_FALLOCATE;
+    sqe->off = lba * spBdevCtx.blk_size;
+    sqe->addr = blocks * spBdevCtx.blk_size;
+    sqe->len = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+    return 0;
+}
+
+} // namespace DaqDB
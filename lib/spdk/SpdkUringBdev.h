@@ -0,0 +1,120 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SpdkBdev.h"
+#include "SpdkConf.h"
+#include "SpdkDevice.h"
+#include "SpdkUring.h"
+
+namespace DaqDB {
+
+/* ring entries of each IO queue */
+const unsigned int SPDK_URING_ENTRIES = 256;
+/* fixed buffers of each ring, each maps a chunk of DMA memory */
+const unsigned int SPDK_URING_FIXED_BUFS = 512;
+const uintptr_t SPDK_URING_FIXED_BUF_SIZE = 2UL * 1024 * 1024;
+/* block size of a device backed by a regular file */
+const uint32_t SPDK_URING_FILE_BLK_SIZE = 4096;
+
+/*
+ * IO in flight on a ring, completes with bytes transferred.
+ */
+struct SpdkUringIo {
+    spdk_bdev_io_completion_cb cb = nullptr;
+    void *arg = nullptr;
+    int64_t bytes = 0;
+};
+
+struct SpdkUringQueue {
+    SpdkUring ring;
+    std::vector<SpdkUringIo> ios;
+    std::vector<SpdkUringIo *> freeIos;
+    /* DMA memory chunk to its fixed buffer, -1 if it cannot be registered */
+    std::unordered_map<uintptr_t, int> fixedBufs;
+    unsigned int fixedCnt = 0;
+};
+
+/*
+ * Block device or regular file driven by the kernel through io_uring, for
+ * drives not bound to SPDK NVMe driver. Each IO queue has its own ring,
+ * polled by its IO engine thread instead of an SPDK thread, with the device
+ * registered as fixed file and DMA buffers registered as fixed buffers. SQ
+ * is polled by a kernel thread when enabled. SPDK provides DMA memory only,
+ * IO buffers, free lists and the finalizer are shared with SPDK bdevs.
+ */
+class SpdkUringBdev : public SpdkBdev {
+  public:
+    SpdkUringBdev(bool enableStats = false);
+    virtual ~SpdkUringBdev();
+
+    /**
+     * Initialize device at the configured path, a file is created or
+     * extended to the configured size.
+     *
+     * @return true if the device successfully opened, false otherwise
+     */
+    virtual bool init(const SpdkConf &conf);
+    virtual void deinit();
+    virtual bool bdevInit();
+    virtual void ioEngineThreadMain(SpdkIoQueue *queue);
+
+    static SpdkDeviceClass bdev_class;
+
+    /*
+     * Name of the device in logs and free list files
+     */
+    const static char *uringBdevName;
+
+  protected:
+    virtual bool initIoQueue(SpdkIoQueue &queue);
+    virtual void pollIoQueue(SpdkIoQueue &queue);
+    virtual void exitIoQueue(SpdkIoQueue &queue);
+
+    virtual int submitRead(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                           uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                           void *arg);
+    virtual int submitWrite(SpdkIoQueue &queue, char *buf, uint64_t lba,
+                            uint64_t blocks, spdk_bdev_io_completion_cb cb,
+                            void *arg);
+    virtual int submitWritev(SpdkIoQueue &queue, struct iovec *iov,
+                             int iovcnt, uint64_t lba, uint64_t blocks,
+                             spdk_bdev_io_completion_cb cb, void *arg);
+    virtual int submitUnmap(SpdkIoQueue &queue, uint64_t lba, uint64_t blocks,
+                            spdk_bdev_io_completion_cb cb, void *arg);
+
+  private:
+    struct io_uring_sqe *_getSqe(SpdkUringQueue &uq, int64_t bytes,
+                                 spdk_bdev_io_completion_cb cb, void *arg);
+    int _fixedBuf(SpdkUringQueue &uq, const char *buf, size_t len);
+    int _submitRw(SpdkIoQueue &queue, bool write, char *buf, uint64_t lba,
+                  uint64_t blocks, spdk_bdev_io_completion_cb cb, void *arg);
+    void _reap(SpdkUringQueue &uq);
+
+    std::string _path;
+    size_t _fileSize = 0; // bytes, 0 keeps size of an existing file
+    bool _sqPoll = true;
+    int _devFd = -1;
+    SpdkUringQueue _queues[SPDK_MAX_IO_QUEUES];
+};
+
+} // namespace DaqDB
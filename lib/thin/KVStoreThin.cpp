@@ -17,7 +17,9 @@
 #include <cerrno>
 
 #include "KVStoreThin.h"
+#include <HugePageArena.h>
 #include <Logger.h>
+#include <MemMgr.h>
 
 namespace DaqDB {
 
@@ -39,9 +41,13 @@ KVStoreThin::KVStoreThin(const DaqDB::Options &options) : _options(options) {
 KVStoreThin::~KVStoreThin() {}
 
 void KVStoreThin::init() {
+    gLog.setLevel(getOptions().runtime.logLevel);
     if (getOptions().runtime.logFunc)
         gLog.setLogFunc(getOptions().runtime.logFunc);
 
+    HugePageArena::getInstance().setPageSize(
+        getOptions().runtime.hugePageSize);
+
     _spDht.reset(new DhtCore(getOptions().dht));
     _spDht->initNexus();
     _spDht->initClient();
@@ -139,21 +145,31 @@ Value KVStoreThin::Alloc(const Key &key, size_t size,
         throw OperationFailedException(EINVAL);
     if (options.attr & KeyValAttribute::KVS_BUFFERED) {
         return dhtClient()->alloc(key, size);
+    } else if (options.attr & KeyValAttribute::HUGE_PAGE) {
+        return Value(
+            static_cast<char *>(HugePageArena::getInstance().alloc(size)),
+            size, KeyValAttribute::HUGE_PAGE);
     } else {
-        return Value(new char[size], size);
+        return Value(MemMgr::allocValue(size), size);
     }
 }
 
 void KVStoreThin::Free(const Key &key, Value &&value) {
     if (value.isKvsBuffered())
         return dhtClient()->free(key, std::move(value));
+    else if (value.isHugePageBacked())
+        HugePageArena::getInstance().free(value.data(), value.size());
     else
-        delete[] value.data();
+        MemMgr::freeValue(value.data(), value.size());
 }
 
 Key KVStoreThin::AllocKey(const AllocOptions &options) {
     if (options.attr & KeyValAttribute::KVS_BUFFERED) {
         return dhtClient()->allocKey(KeySize());
+    } else if (options.attr & KeyValAttribute::HUGE_PAGE) {
+        return Key(static_cast<char *>(
+                       HugePageArena::getInstance().alloc(KeySize())),
+                   KeySize(), KeyValAttribute::HUGE_PAGE);
     } else {
         return Key(new char[KeySize()], KeySize());
     }
@@ -171,6 +187,8 @@ void KVStoreThin::ChangeOptions(Value &value, const AllocOptions &options) {
 void KVStoreThin::Free(Key &&key) {
     if (key.isKvsBuffered()) {
         dhtClient()->free(std::move(key));
+    } else if (key.isHugePageBacked()) {
+        HugePageArena::getInstance().free(key.data(), key.size());
     } else {
         delete[] key.data();
     }
@@ -190,4 +208,29 @@ uint8_t KVStoreThin::GetTreeDepth() { throw FUNC_NOT_SUPPORTED; }
 
 std::string KVStoreThin::getProperty(const std::string &name) { return ""; }
 
+bool KVStoreThin::ReserveCredits(size_t n, const QueueOptions &queue) {
+    throw FUNC_NOT_SUPPORTED;
+}
+
+void KVStoreThin::ReleaseCredits(size_t n, const QueueOptions &queue) {
+    throw FUNC_NOT_SUPPORTED;
+}
+
+size_t KVStoreThin::GetFreeQueueDepth(const QueueOptions &queue) {
+    throw FUNC_NOT_SUPPORTED;
+}
+
+void KVStoreThin::NotifyOnSpace(size_t n, std::function<void()> cb,
+                                const QueueOptions &queue) {
+    throw FUNC_NOT_SUPPORTED;
+}
+
+void KVStoreThin::EnableCompletionQueue(size_t depth) {
+    throw FUNC_NOT_SUPPORTED;
+}
+
+void KVStoreThin::DisableCompletionQueue() { throw FUNC_NOT_SUPPORTED; }
+
+size_t KVStoreThin::PollCompletions(size_t max) { throw FUNC_NOT_SUPPORTED; }
+
 } // namespace DaqDB
@@ -67,6 +67,8 @@ class KVStoreThin : public KVStoreBase {
     virtual void ChangeOptions(Key &key, const AllocOptions &options);
 
     virtual bool IsOffloaded(Key &key);
+    /* values are read on the node owning them */
+    virtual void Prefetch(const std::vector<Key> &keys) {}
 
     virtual uint64_t GetTreeSize();
     virtual uint64_t GetLeafCount();
@@ -80,6 +82,18 @@ class KVStoreThin : public KVStoreBase {
 
     virtual bool QuiesceOffload(bool ForceAbort = false) { return true; }
 
+    virtual bool ReserveCredits(size_t n,
+                                const QueueOptions &queue = QueueOptions());
+    virtual void ReleaseCredits(size_t n,
+                                const QueueOptions &queue = QueueOptions());
+    virtual size_t GetFreeQueueDepth(const QueueOptions &queue = QueueOptions());
+    virtual void NotifyOnSpace(size_t n, std::function<void()> cb,
+                               const QueueOptions &queue = QueueOptions());
+
+    virtual void EnableCompletionQueue(size_t depth = 4096);
+    virtual void DisableCompletionQueue();
+    virtual size_t PollCompletions(size_t max);
+
   private:
     explicit KVStoreThin(const DaqDB::Options &options);
     virtual ~KVStoreThin();
@@ -117,6 +117,7 @@ int main(int argc, const char *argv[]) {
                                                   testAsyncOperations)(
             "testSyncOffloadOperations", testSyncOffloadOperations)(
             "testAsyncOffloadOperations", testAsyncOffloadOperations)(
+            "testOffloadHandOver", testOffloadHandOver)(
             "testSyncOffloadExtOperations", testSyncOffloadExtOperations)(
             "testAsyncOffloadExtOperations", testAsyncOffloadExtOperations)(
             "testDhtConnect", testDhtConnect)("testValueSizes", testValueSizes);
@@ -211,3 +211,49 @@ bool testAsyncOffloadOperations(KVStoreBase *kvs) {
 
     return result;
 }
+
+bool testOffloadHandOver(KVStoreBase *kvs) {
+    bool result = true;
+    const string val = "vwxyz";
+    const uint64_t keyId = 500;
+
+    daqdb_put(kvs, keyId, val);
+    daqdb_offload(kvs, keyId);
+
+    auto key = allocKey(kvs, keyId);
+    if (!kvs->IsOffloaded(key)) {
+        DAQDB_INFO << "Error: wrong value location";
+        result = false;
+    }
+
+    /* with hand over the value is returned in the buffer it was read to */
+    GetOptions options;
+    options.handOver(true);
+    for (int cnt = 0; cnt < 2; cnt++) {
+        auto resultVal = kvs->Get(key, options);
+        if (!resultVal.isDmaBuffer()) {
+            DAQDB_INFO << "Error: value not handed over";
+            result = false;
+        }
+        if (!checkValue(val, &resultVal))
+            result = false;
+        kvs->Free(key, std::move(resultVal));
+    }
+
+    /* otherwise it is copied */
+    auto copiedVal = daqdb_get(kvs, keyId);
+    if (copiedVal.isDmaBuffer()) {
+        DAQDB_INFO << "Error: value handed over without the option";
+        result = false;
+    }
+    if (!checkValue(val, &copiedVal))
+        result = false;
+    kvs->Free(key, std::move(copiedVal));
+
+    if (!daqdb_remove(kvs, keyId)) {
+        result = false;
+        DAQDB_INFO << format("Error: Cannot remove a key [%1%]") % keyId;
+    }
+
+    return result;
+}
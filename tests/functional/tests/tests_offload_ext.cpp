@@ -40,7 +40,7 @@ class KVSet64 {
     bool operator==(const KVSet64 &r);
     bool operator!=(const KVSet64 &r);
     void addKv(const pair<uint64_t, Value> &kv);
-    void clearAll();
+    void clearAll(KVStoreBase *kvs);
 
   protected:
     Value generateValue(default_random_engine &gen,
@@ -55,11 +55,15 @@ class KVSet64 {
 
 void KVSet64::addKv(const pair<uint64_t, Value> &kv) { kvpairs.push_back(kv); }
 
-void KVSet64::clearAll() {
+/*
+ * Values come from the store (Get or Alloc), so they go back through Free.
+ */
+void KVSet64::clearAll(KVStoreBase *kvs) {
     for (auto &kv : kvpairs) {
         if (kv.second.size() && kv.second.data()) {
-            delete[] kv.second.data();
-            kv.second.size();
+            auto key = allocKey(kvs, kv.first);
+            kvs->Free(key, move(kv.second));
+            kvs->Free(move(key));
         }
     }
     kvpairs.clear();
@@ -201,7 +205,7 @@ bool testSyncOffloadExtOperations(KVStoreBase *kvs) {
         }
     }
 
-    kvsetRes.clearAll();
+    kvsetRes.clearAll(kvs);
     for (auto &kv : kvpRef) {
         auto resultVal = daqdb_get(kvs, kv.first);
         kvsetRes.addKv(pair<uint64_t, Value>(kv.first, resultVal));
@@ -212,7 +216,7 @@ bool testSyncOffloadExtOperations(KVStoreBase *kvs) {
         result = false;
     }
 
-    kvsetRes.clearAll();
+    kvsetRes.clearAll(kvs);
     for (auto &kv : kvpRef) {
         auto removeResult = daqdb_remove(kvs, kv.first);
         if (removeResult == false) {
@@ -290,7 +294,7 @@ bool testAsyncOffloadExtOperations(KVStoreBase *kvs) {
         result = false;
     }
 
-    kvsetRes.clearAll();
+    kvsetRes.clearAll(kvs);
     for (auto &kv : kvpRef) {
         daqdb_async_get(
             kvs, kv.first,
@@ -299,12 +303,15 @@ bool testAsyncOffloadExtOperations(KVStoreBase *kvs) {
                 unique_lock<mutex> lck(mtx);
 
                 if (status.ok()) {
-                    char *resData = new char[valueSize];
-                    memcpy(resData, value, valueSize);
                     DAQDB_INFO << boost::format("GetAsync: [%1%] = %2%") %
                                       keyToStr(argKey) % valueSize;
-                    uint64_t ukey = *reinterpret_cast<const uint64_t *>(argKey);
-                    Value uval(resData, valueSize);
+                    Value uval;
+                    if (valueSize) {
+                        auto key = allocKey(kvs, kv.first);
+                        uval = kvs->Alloc(key, valueSize);
+                        memcpy(uval.data(), value, valueSize);
+                        kvs->Free(move(key));
+                    }
                     kvsetRes.addKv(pair<uint64_t, Value>(kv.first, uval));
                 } else {
                     DAQDB_INFO
@@ -365,7 +372,7 @@ bool testAsyncOffloadExtOperations(KVStoreBase *kvs) {
         }
     }
 
-    kvsetRes.clearAll();
+    kvsetRes.clearAll(kvs);
     for (auto &kv : kvpRef) {
         auto resultVal = daqdb_get(kvs, kv.first);
         kvsetRes.addKv(pair<uint64_t, Value>(kv.first, resultVal));
@@ -376,7 +383,7 @@ bool testAsyncOffloadExtOperations(KVStoreBase *kvs) {
         result = false;
     }
 
-    kvsetRes.clearAll();
+    kvsetRes.clearAll(kvs);
     for (auto &kv : kvpRef) {
         daqdb_async_get(
             kvs, kv.first,
@@ -385,12 +392,15 @@ bool testAsyncOffloadExtOperations(KVStoreBase *kvs) {
                 unique_lock<mutex> lck(mtx);
 
                 if (status.ok()) {
-                    char *resData = new char[valueSize];
-                    memcpy(resData, value, valueSize);
                     DAQDB_INFO << boost::format("GetAsync: [%1%] = %2%") %
                                       keyToStr(argKey) % valueSize;
-                    uint64_t ukey = *reinterpret_cast<const uint64_t *>(argKey);
-                    Value uval(resData, valueSize);
+                    Value uval;
+                    if (valueSize) {
+                        auto key = allocKey(kvs, kv.first);
+                        uval = kvs->Alloc(key, valueSize);
+                        memcpy(uval.data(), value, valueSize);
+                        kvs->Free(move(key));
+                    }
                     kvsetRes.addKv(pair<uint64_t, Value>(kv.first, uval));
                 } else {
                     DAQDB_INFO
@@ -416,7 +426,7 @@ bool testAsyncOffloadExtOperations(KVStoreBase *kvs) {
         result = false;
     }
 
-    kvsetRes.clearAll();
+    kvsetRes.clearAll(kvs);
     for (auto &kv : kvpRef) {
         auto removeResult = daqdb_remove(kvs, kv.first);
         if (removeResult == false) {
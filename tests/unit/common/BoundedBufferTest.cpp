@@ -0,0 +1,85 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../../../lib/common/BlockingPoller.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+BOOST_AUTO_TEST_CASE(PopEmptyTimeout) {
+    DaqDB::BoundedBuffer<uint64_t> buffer(16, 1);
+    uint64_t item;
+    unsigned short size = 1;
+    BOOST_CHECK(!buffer.popBack(&item));
+    BOOST_CHECK(!buffer.popBackVector(&item, &size));
+    BOOST_CHECK_EQUAL(size, 0);
+}
+
+BOOST_AUTO_TEST_CASE(PushFullTimeout) {
+    DaqDB::BoundedBuffer<uint64_t> buffer(4, 1);
+    for (uint64_t i = 0; i < 4; i++)
+        BOOST_CHECK(buffer.pushFront(i));
+    BOOST_CHECK(!buffer.pushFront(4));
+}
+
+BOOST_AUTO_TEST_CASE(BulkPopOrder) {
+    DaqDB::BoundedBuffer<uint64_t> buffer(DaqDB::dequeueBufferLimit, 1);
+    for (uint64_t i = 0; i < 100; i++)
+        BOOST_CHECK(buffer.pushFront(i));
+
+    std::vector<uint64_t> items(DaqDB::dequeueBufferQuant);
+    unsigned short size = 0;
+    BOOST_CHECK(buffer.popBackVector(items.data(), &size));
+    BOOST_CHECK_EQUAL(size, 100);
+    for (uint64_t i = 0; i < size; i++)
+        BOOST_CHECK_EQUAL(items[i], i);
+}
+
+BOOST_AUTO_TEST_CASE(ManyProducersOneConsumer) {
+    const unsigned int nProducers = 8;
+    const uint64_t nPerProducer = 50000;
+    DaqDB::BoundedBuffer<uint64_t> buffer(64, 10);
+
+    std::vector<std::thread> producers;
+    for (unsigned int p = 0; p < nProducers; p++) {
+        producers.emplace_back([&buffer, nPerProducer]() {
+            for (uint64_t i = 0; i < nPerProducer; i++) {
+                while (!buffer.pushFront(i))
+                    ;
+            }
+        });
+    }
+
+    std::vector<uint64_t> items(DaqDB::dequeueBufferQuant);
+    uint64_t received = 0;
+    while (received < nProducers * nPerProducer) {
+        unsigned short size = 0;
+        buffer.popBackVector(items.data(), &size);
+        received += size;
+    }
+
+    for (auto &t : producers)
+        t.join();
+    BOOST_CHECK_EQUAL(received, nProducers * nPerProducer);
+}
@@ -0,0 +1,98 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../../lib/common/CompletionQueue.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+BOOST_AUTO_TEST_CASE(DeferredToPoller) {
+    auto cq = std::make_shared<CompletionQueue>(16);
+    std::thread::id clbThread;
+    std::string result;
+
+    auto clb = CompletionQueue::wrap(
+        cq,
+        [&clbThread, &result](KVStoreBase *kvs, Status status,
+                              const char *key, size_t keySize,
+                              const char *value, size_t valueSize) {
+            clbThread = std::this_thread::get_id();
+            result = std::string(key, keySize) + "=" +
+                     std::string(value, valueSize);
+        },
+        true);
+
+    std::thread poller([&clb]() {
+        char key[] = "key";
+        char value[] = "value";
+        clb(nullptr, Status(OK), key, 3, value, 5);
+        /* buffers are not valid after callback returns */
+        std::memset(key, 0, sizeof(key));
+        std::memset(value, 0, sizeof(value));
+    });
+    poller.join();
+
+    BOOST_CHECK(result.empty());
+    BOOST_CHECK_EQUAL(cq->poll(nullptr, 10), 1);
+    BOOST_CHECK(clbThread == std::this_thread::get_id());
+    BOOST_CHECK_EQUAL(result, "key=value");
+    BOOST_CHECK_EQUAL(cq->poll(nullptr, 10), 0);
+}
+
+BOOST_AUTO_TEST_CASE(OverflowAndMax) {
+    CompletionQueue cq(4);
+    int delivered = 0;
+    auto clb = [&delivered](KVStoreBase *kvs, Status status, const char *key,
+                            size_t keySize, const char *value,
+                            size_t valueSize) { delivered++; };
+
+    for (int i = 0; i < 10; i++)
+        cq.push(clb, Status(OK), "k", 1, nullptr, 0, false);
+
+    BOOST_CHECK_EQUAL(cq.poll(nullptr, 3), 3);
+    BOOST_CHECK_EQUAL(delivered, 3);
+    BOOST_CHECK_EQUAL(cq.poll(nullptr, 100), 7);
+    BOOST_CHECK_EQUAL(delivered, 10);
+}
+
+BOOST_AUTO_TEST_CASE(LongKey) {
+    CompletionQueue cq(4);
+    std::string longKey(3 * COMPLETION_KEY_SIZE, 'k');
+    std::string result;
+    auto clb = [&result](KVStoreBase *kvs, Status status, const char *key,
+                         size_t keySize, const char *value,
+                         size_t valueSize) {
+        result = std::string(key, keySize);
+    };
+
+    cq.push(clb, Status(OK), longKey.c_str(), longKey.size(), nullptr, 0,
+            false);
+    cq.push(clb, Status(OK), "short", 5, nullptr, 0, false);
+    BOOST_CHECK_EQUAL(cq.poll(nullptr, 1), 1);
+    BOOST_CHECK_EQUAL(result, longKey);
+    BOOST_CHECK_EQUAL(cq.poll(nullptr, 1), 1);
+    BOOST_CHECK_EQUAL(result, "short");
+}
@@ -0,0 +1,263 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Built as C++20 only, see tests/unit/CMakeLists.txt.
+ */
+
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <daqdb/Coro.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+/*
+ * In-memory store completing every operation from another thread through
+ * its completion queue, as KVStore does with pollers.
+ */
+class FakeStore : public KVStoreBase {
+  public:
+    size_t KeySize() override { return 0; }
+    const Options &getOptions() override { return _options; }
+    std::string getProperty(const std::string &) override { return ""; }
+
+    void Put(Key &&, Value &&, const PutOptions &) override {}
+    void PutAsync(Key &&key, Value &&value, KVStoreBaseCallback cb,
+                  const PutOptions &) override {
+        if (!key.size()) {
+            cb(this, Status(BAD_KEY_FORMAT), nullptr, 0, nullptr, 0);
+            return;
+        }
+        std::string k(key.data(), key.size());
+        std::string v(value.data(), value.size());
+        delete[] key.data();
+        delete[] value.data();
+        _post([this, k, v, cb]() {
+            _data[k] = v;
+            cb(this, Status(OK), nullptr, 0, nullptr, 0);
+        });
+    }
+    Value Get(const Key &, const GetOptions &) override { return Value(); }
+    void GetAsync(const Key &key, KVStoreBaseCallback cb,
+                  const GetOptions &) override {
+        std::string k(key.data(), key.size());
+        _post([this, k, cb]() {
+            auto it = _data.find(k);
+            if (it == _data.end())
+                cb(this, Status(KEY_NOT_FOUND), nullptr, 0, nullptr, 0);
+            else
+                cb(this, Status(OK), nullptr, 0, it->second.data(),
+                   it->second.size());
+        });
+    }
+    Key GetAny(const AllocOptions &, const GetOptions &) override {
+        return Key();
+    }
+    void GetAnyAsync(KVStoreBaseGetAnyCallback, const AllocOptions &,
+                     const GetOptions &) override {}
+    void Update(const Key &, Value &&, const UpdateOptions &) override {}
+    void Update(const Key &, const UpdateOptions &) override {}
+    void UpdateAsync(const Key &, Value &&value, KVStoreBaseCallback cb,
+                     const UpdateOptions &) override {
+        delete[] value.data();
+        _post([this, cb]() { cb(this, Status(OK), nullptr, 0, nullptr, 0); });
+    }
+    void UpdateAsync(const Key &, const UpdateOptions &,
+                     KVStoreBaseCallback) override {
+        throw OperationFailedException(Status(NOT_IMPLEMENTED));
+    }
+    std::vector<KVPair> GetRange(const Key &, const Key &,
+                                 const GetOptions &) override {
+        return {};
+    }
+    void GetRangeAsync(const Key &, const Key &, KVStoreBaseRangeCallback,
+                       const GetOptions &) override {}
+    void Remove(const Key &) override {}
+    void RemoveRange(const Key &, const Key &) override {}
+    Value Alloc(const Key &, size_t size, const AllocOptions &) override {
+        return Value(new char[size], size);
+    }
+    void Free(const Key &, Value &&value) override { delete[] value.data(); }
+    void Realloc(const Key &, Value &, size_t, const AllocOptions &) override {}
+    void ChangeOptions(Value &, const AllocOptions &) override {}
+    Key AllocKey(const AllocOptions &) override { return Key(); }
+    void Free(Key &&) override {}
+    void ChangeOptions(Key &, const AllocOptions &) override {}
+    bool IsOffloaded(Key &) override { return false; }
+    bool QuiesceOffload(bool) override { return true; }
+    void Prefetch(const std::vector<Key> &) override {}
+    bool ReserveCredits(size_t, const QueueOptions &) override { return true; }
+    void ReleaseCredits(size_t, const QueueOptions &) override {}
+    size_t GetFreeQueueDepth(const QueueOptions &) override { return 0; }
+    void NotifyOnSpace(size_t, std::function<void()>,
+                       const QueueOptions &) override {}
+    void EnableCompletionQueue(size_t) override { cqEnabled = true; }
+    void DisableCompletionQueue() override { cqEnabled = false; }
+    size_t PollCompletions(size_t) override {
+        std::deque<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ready.swap(_completions);
+        }
+        for (auto &completion : ready)
+            completion();
+        return ready.size();
+    }
+    uint64_t GetTreeSize() override { return 0; }
+    uint64_t GetLeafCount() override { return 0; }
+    uint8_t GetTreeDepth() override { return 0; }
+
+    bool cqEnabled = false;
+
+  private:
+    void _post(std::function<void()> completion) {
+        std::thread([this, completion]() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _completions.push_back(completion);
+        }).join();
+    }
+
+    Options _options;
+    std::mutex _mutex;
+    std::deque<std::function<void()>> _completions;
+    std::map<std::string, std::string> _data;
+};
+
+static char *copyOf(const std::string &str) {
+    char *buf = new char[str.size()];
+    std::memcpy(buf, str.data(), str.size());
+    return buf;
+}
+
+static coro::Task<> putOne(coro::Store &store, int idx, int &errors) {
+    std::string key = "k" + std::to_string(idx);
+    std::string value = std::to_string(idx);
+    Status status = co_await store.Put(Key(copyOf(key), key.size()),
+                                       Value(copyOf(value), value.size()));
+    if (!status.ok())
+        errors++;
+}
+
+static coro::Task<int> getOne(coro::Store &store, int idx) {
+    std::string keyStr = "k" + std::to_string(idx);
+    Key key(&keyStr[0], keyStr.size());
+    auto res = co_await store.Get(key);
+    if (!res.status.ok())
+        co_return -1;
+    int value = std::stoi(std::string(res.value.data(), res.value.size()));
+    store.kvs().Free(key, std::move(res.value));
+    co_return value;
+}
+
+static coro::Task<> sumAll(coro::Store &store, int cnt, int &sum) {
+    for (int idx = 0; idx < cnt; idx++)
+        sum += co_await getOne(store, idx);
+}
+
+static coro::Task<> failing() {
+    throw std::runtime_error("task failed");
+    co_return;
+}
+
+BOOST_AUTO_TEST_CASE(PutThenGet) {
+    FakeStore kvs;
+    int errors = 0;
+    int sum = 0;
+    {
+        coro::Executor exec(kvs);
+        coro::Store store(kvs);
+        BOOST_CHECK(kvs.cqEnabled);
+
+        for (int idx = 0; idx < 100; idx++)
+            exec.spawn(putOne(store, idx, errors));
+        exec.run();
+        BOOST_CHECK_EQUAL(exec.active(), 0);
+
+        exec.spawn(sumAll(store, 100, sum));
+        exec.run();
+    }
+    BOOST_CHECK(!kvs.cqEnabled);
+    BOOST_CHECK_EQUAL(errors, 0);
+    BOOST_CHECK_EQUAL(sum, 4950);
+}
+
+BOOST_AUTO_TEST_CASE(ErrorStatus) {
+    FakeStore kvs;
+    coro::Executor exec(kvs);
+    coro::Store store(kvs);
+    int missing = 0;
+    int errors = 0;
+
+    exec.spawn([](coro::Store &store, int &missing,
+                  int &errors) -> coro::Task<> {
+        /* error reported synchronously by the store */
+        Status status = co_await store.Put(Key(), Value());
+        if (status() == BAD_KEY_FORMAT)
+            errors++;
+        if (co_await getOne(store, 7) < 0)
+            missing++;
+    }(store, missing, errors));
+    exec.run();
+
+    BOOST_CHECK_EQUAL(errors, 1);
+    BOOST_CHECK_EQUAL(missing, 1);
+}
+
+BOOST_AUTO_TEST_CASE(ExceptionPropagated) {
+    FakeStore kvs;
+    coro::Executor exec(kvs);
+    exec.spawn(failing());
+    BOOST_CHECK_THROW(exec.run(), std::runtime_error);
+    BOOST_CHECK_EQUAL(exec.active(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(FramePoolBounded) {
+    /* fresh thread, so the cache starts empty */
+    std::thread burst([]() {
+        const size_t frames = 2 * coro::FramePool::MAX_CACHED_FRAMES;
+        std::vector<void *> ptrs;
+        for (size_t idx = 0; idx < frames; idx++)
+            ptrs.push_back(coro::FramePool::alloc(100));
+        BOOST_CHECK_EQUAL(coro::FramePool::cached(100), 0);
+
+        for (auto ptr : ptrs)
+            coro::FramePool::free(ptr, 100);
+        BOOST_CHECK_EQUAL(coro::FramePool::cached(100),
+                          coro::FramePool::MAX_CACHED_FRAMES);
+        /* other size classes are not affected */
+        BOOST_CHECK_EQUAL(coro::FramePool::cached(64), 0);
+
+        void *ptr = coro::FramePool::alloc(128);
+        BOOST_CHECK_EQUAL(coro::FramePool::cached(100),
+                          coro::FramePool::MAX_CACHED_FRAMES - 1);
+        coro::FramePool::free(ptr, 128);
+    });
+    burst.join();
+}
@@ -0,0 +1,126 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../lib/common/GeneralPoolMagazine.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+using namespace DaqDB;
+
+class TestDepot : public MagazineDepot {
+  public:
+    ~TestDepot() { detachMagazines(); }
+
+    size_t releasedCount() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _released.size();
+    }
+
+  protected:
+    void releaseObject(void *obj) final {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _released.push_back(obj);
+    }
+
+  private:
+    std::mutex _mutex;
+    std::vector<void *> _released;
+};
+
+static inline void *obj(uintptr_t idx) {
+    return reinterpret_cast<void *>(idx + 1);
+}
+
+BOOST_AUTO_TEST_CASE(GetPutSameThread) {
+    TestDepot depot;
+    BOOST_CHECK(depot.magazineGet() == nullptr);
+
+    for (uintptr_t i = 0; i < 10; i++)
+        BOOST_CHECK(depot.magazinePut(obj(i)));
+    for (uintptr_t i = 10; i > 0; i--)
+        BOOST_CHECK_EQUAL(depot.magazineGet(), obj(i - 1));
+    BOOST_CHECK(depot.magazineGet() == nullptr);
+    BOOST_CHECK_EQUAL(depot.releasedCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(DepotExchange) {
+    TestDepot depot;
+    const uintptr_t putCnt = 2 * MAGAZINE_SIZE + 1;
+
+    /* third magazine pushes a full one to the depot */
+    std::thread producer([&depot, putCnt] {
+        for (uintptr_t i = 0; i < putCnt; i++)
+            BOOST_CHECK(depot.magazinePut(obj(i)));
+    });
+    producer.join();
+    /* the rest went back to the buckets when the thread exited */
+    BOOST_CHECK_EQUAL(depot.releasedCount(), putCnt - MAGAZINE_SIZE);
+
+    for (unsigned int i = 0; i < MAGAZINE_SIZE; i++)
+        BOOST_CHECK(depot.magazineGet() != nullptr);
+    BOOST_CHECK(depot.magazineGet() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadExitFlush) {
+    TestDepot depot;
+    std::thread worker([&depot] {
+        for (uintptr_t i = 0; i < 5; i++)
+            BOOST_CHECK(depot.magazinePut(obj(i)));
+    });
+    worker.join();
+    BOOST_CHECK_EQUAL(depot.releasedCount(), 5);
+    BOOST_CHECK(depot.magazineGet() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(SlotsRecycled) {
+    for (unsigned int i = 0; i < 2 * MAX_MAGAZINE_POOLS; i++) {
+        TestDepot depot;
+        BOOST_REQUIRE(depot.magazinePut(obj(i)));
+    }
+
+    /* magazines of a destroyed pool never reach the next slot owner */
+    std::unique_ptr<TestDepot> first(new TestDepot());
+    BOOST_CHECK(first->magazinePut(obj(0)));
+    first.reset();
+    TestDepot second;
+    BOOST_CHECK(second.magazineGet() == nullptr);
+    BOOST_CHECK_EQUAL(second.releasedCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(SlotsExhausted) {
+    std::vector<std::unique_ptr<TestDepot>> depots;
+    bool exhausted = false;
+    for (unsigned int i = 0; i <= MAX_MAGAZINE_POOLS && !exhausted; i++) {
+        depots.emplace_back(new TestDepot());
+        exhausted = !depots.back()->magazinePut(obj(i));
+    }
+    BOOST_REQUIRE(exhausted);
+
+    depots.erase(depots.begin());
+    TestDepot depot;
+    BOOST_CHECK(depot.magazinePut(obj(0)));
+}
@@ -0,0 +1,96 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+
+#include <daqdb/Types.h>
+
+#include "../../lib/common/HugePageArena.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+using namespace DaqDB;
+
+/* runs first, page size can not change once memory is mapped */
+BOOST_AUTO_TEST_CASE(MappedSize1GB) {
+    HugePageArena &arena = HugePageArena::getInstance();
+    arena.setPageSize(HUGE_PAGE_SIZE_1GB);
+    BOOST_CHECK_EQUAL(arena.getPageSize(), HUGE_PAGE_SIZE_1GB);
+
+    /* buffers smaller than a 1GB page keep using 2MB pages */
+    BOOST_CHECK_EQUAL(arena.mappedSize(HUGE_PAGE_SIZE_2MB + 1),
+                      2 * HUGE_PAGE_SIZE_2MB);
+    BOOST_CHECK_EQUAL(arena.mappedSize(HUGE_PAGE_SIZE_1GB - 1),
+                      HUGE_PAGE_SIZE_1GB);
+    BOOST_CHECK_EQUAL(arena.mappedSize(HUGE_PAGE_SIZE_1GB), HUGE_PAGE_SIZE_1GB);
+    BOOST_CHECK_EQUAL(arena.mappedSize(HUGE_PAGE_SIZE_1GB + 1),
+                      2 * HUGE_PAGE_SIZE_1GB);
+}
+
+BOOST_AUTO_TEST_CASE(SizeClassReuse) {
+    HugePageArena &arena = HugePageArena::getInstance();
+
+    char *small = static_cast<char *>(arena.alloc(65));
+    BOOST_REQUIRE(small != nullptr);
+    memset(small, 0xab, 128);
+    arena.free(small, 65);
+
+    /* 65 and 128 bytes share the 128B class */
+    BOOST_CHECK_EQUAL(arena.alloc(128), small);
+    BOOST_CHECK(arena.alloc(128) != small);
+    arena.free(small, 128);
+}
+
+BOOST_AUTO_TEST_CASE(LargeAllocFree) {
+    HugePageArena &arena = HugePageArena::getInstance();
+    const size_t size = 3 * HUGE_PAGE_SIZE_2MB + 1;
+
+    char *buf = static_cast<char *>(arena.alloc(size));
+    BOOST_REQUIRE(buf != nullptr);
+    memset(buf, 0xcd, size);
+    BOOST_CHECK_EQUAL(static_cast<unsigned char>(buf[size - 1]), 0xcd);
+    arena.free(buf, size);
+    arena.free(nullptr, size);
+}
+
+BOOST_AUTO_TEST_CASE(MappedSizeSmall) {
+    HugePageArena &arena = HugePageArena::getInstance();
+    BOOST_CHECK_EQUAL(arena.mappedSize(1), 64);
+    BOOST_CHECK_EQUAL(arena.mappedSize(100), 128);
+    BOOST_CHECK_EQUAL(arena.mappedSize(HUGE_PAGE_SIZE_2MB), HUGE_PAGE_SIZE_2MB);
+    BOOST_CHECK_EQUAL(arena.mappedSize(HUGE_PAGE_SIZE_2MB + 1),
+                      2 * HUGE_PAGE_SIZE_2MB);
+}
+
+BOOST_AUTO_TEST_CASE(PageSizeFixedAfterMapping) {
+    HugePageArena &arena = HugePageArena::getInstance();
+    BOOST_CHECK_THROW(arena.setPageSize(4096), OperationFailedException);
+
+    void *buf = arena.alloc(64);
+    BOOST_REQUIRE(buf != nullptr);
+    size_t pageSize = arena.getPageSize();
+    size_t otherSize = pageSize == HUGE_PAGE_SIZE_2MB ? HUGE_PAGE_SIZE_1GB
+                                                      : HUGE_PAGE_SIZE_2MB;
+    BOOST_CHECK_THROW(arena.setPageSize(otherSize), OperationFailedException);
+    BOOST_CHECK_NO_THROW(arena.setPageSize(pageSize));
+    BOOST_CHECK_EQUAL(arena.getPageSize(), pageSize);
+    arena.free(buf, 64);
+}
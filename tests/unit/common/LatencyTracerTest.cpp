@@ -0,0 +1,64 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include "../../../lib/common/LatencyTracer.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+BOOST_AUTO_TEST_CASE(DisabledNotTraced) {
+    auto &tracer = LatencyTracer::getInstance();
+    RqstTrace trace;
+    tracer.enable(false);
+    tracer.start(trace);
+    tracer.stamp(trace, TRACE_POLLER);
+    BOOST_CHECK_EQUAL(trace.ts[TRACE_SUBMIT], 0);
+    BOOST_CHECK_EQUAL(trace.ts[TRACE_POLLER], 0);
+}
+
+BOOST_AUTO_TEST_CASE(StagesRecorded) {
+    auto &tracer = LatencyTracer::getInstance();
+    tracer.enable(true);
+    tracer.reset();
+
+    RqstTrace trace;
+    tracer.start(trace);
+    tracer.stamp(trace, TRACE_POLLER);
+    tracer.stamp(trace, TRACE_FINALIZE);
+    tracer.finish(trace);
+    BOOST_CHECK_EQUAL(trace.ts[TRACE_SUBMIT], 0);
+
+    /* request skipped IO stages */
+    BOOST_CHECK(tracer.print("total").find("count=1 ") != std::string::npos);
+    BOOST_CHECK(tracer.print("poller_queue").find("count=1 ") !=
+                std::string::npos);
+    BOOST_CHECK(tracer.print("device").find("count=0 ") != std::string::npos);
+    BOOST_CHECK(tracer.print("callback").find("count=1 ") !=
+                std::string::npos);
+    BOOST_CHECK(tracer.print("unknown").empty());
+
+    /* finished trace is not recorded twice */
+    tracer.finish(trace);
+    BOOST_CHECK(tracer.print("total").find("count=1 ") != std::string::npos);
+    tracer.enable(false);
+}
@@ -0,0 +1,154 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../../lib/common/LockFreeRing.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+BOOST_AUTO_TEST_CASE(CapacityRoundUp) {
+    DaqDB::LockFreeRing<uint64_t> ring(1000);
+    BOOST_CHECK_EQUAL(ring.capacity(), 1024);
+    BOOST_CHECK_EQUAL(ring.count(), 0);
+    BOOST_CHECK_EQUAL(ring.freeCount(), 1024);
+    BOOST_CHECK(ring.empty());
+}
+
+BOOST_AUTO_TEST_CASE(EnqueueDequeueOrder) {
+    DaqDB::LockFreeRing<uint64_t> ring(16, DaqDB::RingType::SP_SC);
+    for (uint64_t i = 0; i < 16; i++)
+        BOOST_CHECK(ring.enqueue(i));
+    BOOST_CHECK(!ring.enqueue(16));
+    BOOST_CHECK_EQUAL(ring.count(), 16);
+
+    uint64_t val;
+    for (uint64_t i = 0; i < 16; i++) {
+        BOOST_CHECK(ring.dequeue(val));
+        BOOST_CHECK_EQUAL(val, i);
+    }
+    BOOST_CHECK(!ring.dequeue(val));
+}
+
+BOOST_AUTO_TEST_CASE(BulkAndBurst) {
+    DaqDB::LockFreeRing<uint64_t> ring(8, DaqDB::RingType::MP_MC);
+    uint64_t in[12];
+    uint64_t out[12];
+    for (uint64_t i = 0; i < 12; i++)
+        in[i] = i;
+
+    BOOST_CHECK_EQUAL(ring.enqueueBulk(in, 12), 0);
+    BOOST_CHECK_EQUAL(ring.enqueueBurst(in, 12), 8);
+    BOOST_CHECK_EQUAL(ring.dequeueBulk(out, 10), 0);
+    BOOST_CHECK_EQUAL(ring.dequeueBurst(out, 12), 8);
+    for (uint64_t i = 0; i < 8; i++)
+        BOOST_CHECK_EQUAL(out[i], i);
+}
+
+BOOST_AUTO_TEST_CASE(WrapAround) {
+    DaqDB::LockFreeRing<uint64_t> ring(4, DaqDB::RingType::SP_SC);
+    uint64_t val;
+    for (uint64_t i = 0; i < 1000; i++) {
+        BOOST_CHECK(ring.enqueue(i));
+        BOOST_CHECK(ring.enqueue(i + 1));
+        BOOST_CHECK(ring.dequeue(val));
+        BOOST_CHECK_EQUAL(val, i);
+        BOOST_CHECK(ring.dequeue(val));
+        BOOST_CHECK_EQUAL(val, i + 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MultiProducerSingleConsumer) {
+    const unsigned int nProducers = 4;
+    const uint64_t nPerProducer = 100000;
+    DaqDB::LockFreeRing<uint64_t> ring(1024, DaqDB::RingType::MP_SC);
+
+    std::vector<std::thread> producers;
+    for (unsigned int p = 0; p < nProducers; p++) {
+        producers.emplace_back([&ring, p, nPerProducer]() {
+            for (uint64_t i = 0; i < nPerProducer; i++) {
+                uint64_t val = (static_cast<uint64_t>(p) << 32) | i;
+                while (!ring.enqueue(val))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<uint64_t> next(nProducers, 0);
+    uint64_t received = 0;
+    uint64_t buf[64];
+    while (received < nProducers * nPerProducer) {
+        size_t cnt = ring.dequeueBurst(buf, 64);
+        for (size_t i = 0; i < cnt; i++) {
+            unsigned int p = buf[i] >> 32;
+            /* per-producer order must be preserved */
+            BOOST_REQUIRE_EQUAL(buf[i] & 0xffffffff, next[p]);
+            next[p]++;
+        }
+        received += cnt;
+    }
+
+    for (auto &t : producers)
+        t.join();
+    BOOST_CHECK(ring.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentCount) {
+    const uint64_t nItems = 1000000;
+    DaqDB::LockFreeRing<uint64_t> ring(64, DaqDB::RingType::MP_MC);
+    std::atomic<bool> done{false};
+
+    std::thread producer([&ring, nItems]() {
+        for (uint64_t i = 0; i < nItems; i++) {
+            while (!ring.enqueue(i))
+                std::this_thread::yield();
+        }
+    });
+    std::thread consumer([&ring, nItems]() {
+        uint64_t val;
+        for (uint64_t i = 0; i < nItems; i++) {
+            while (!ring.dequeue(val))
+                std::this_thread::yield();
+        }
+    });
+
+    /* counts seen while both sides move stay within the ring */
+    std::thread observer([&ring, &done]() {
+        size_t bad = 0;
+        while (!done) {
+            size_t cnt = ring.count();
+            size_t free = ring.freeCount();
+            if (cnt > ring.capacity() || free > ring.capacity())
+                bad++;
+        }
+        BOOST_CHECK_EQUAL(bad, 0);
+    });
+
+    producer.join();
+    consumer.join();
+    done = true;
+    observer.join();
+    BOOST_CHECK(ring.empty());
+    BOOST_CHECK_EQUAL(ring.freeCount(), ring.capacity());
+}
@@ -0,0 +1,120 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../../lib/common/Logger.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+struct LogSink {
+    LogSink() {
+        gLog.setLevel(LogLevel::LEVEL_DEBUG);
+        gLog.setLogFunc([this](std::string msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            msgs.push_back(msg);
+        });
+    }
+    ~LogSink() { gLog.setLogFunc(nullptr); }
+
+    std::mutex mutex;
+    std::vector<std::string> msgs;
+};
+
+BOOST_AUTO_TEST_CASE(DeferredFormat) {
+    LogSink sink;
+    DAQ_DEBUGF("depth=%d hash=%lu", 3, 42UL);
+    DAQ_INFO(std::string("plain"));
+    gLog.flush();
+
+    BOOST_REQUIRE_EQUAL(sink.msgs.size(), 2);
+    BOOST_CHECK_EQUAL(sink.msgs[0], "depth=3 hash=42");
+    BOOST_CHECK_EQUAL(sink.msgs[1], "plain");
+}
+
+BOOST_AUTO_TEST_CASE(LevelFilter) {
+    LogSink sink;
+    gLog.setLevel(LogLevel::LEVEL_INFO);
+    bool evaluated = false;
+    DAQ_DEBUG([&evaluated]() {
+        evaluated = true;
+        return std::string("hidden");
+    }());
+    DAQ_CRITICAL("critical");
+
+    /* critical messages are flushed synchronously */
+    BOOST_CHECK(!evaluated);
+    BOOST_REQUIRE_EQUAL(sink.msgs.size(), 1);
+    BOOST_CHECK_EQUAL(sink.msgs[0], "critical");
+}
+
+BOOST_AUTO_TEST_CASE(Truncated) {
+    LogSink sink;
+    std::string longMsg(LOG_RECORD_SIZE, 'x');
+    DAQ_INFO(longMsg);
+    DAQ_INFOF("%s", longMsg.c_str());
+    gLog.flush();
+
+    BOOST_REQUIRE_EQUAL(sink.msgs.size(), 2);
+    std::string mark(LOG_TRUNCATED_MARK);
+    BOOST_CHECK_EQUAL(sink.msgs[0].size(), LogRecord::PAYLOAD_SIZE - 1);
+    BOOST_CHECK_EQUAL(sink.msgs[0].substr(sink.msgs[0].size() - mark.size()),
+                      mark);
+    /* deferred format has a bigger buffer, the argument fits */
+    BOOST_CHECK_EQUAL(sink.msgs[1], longMsg);
+}
+
+BOOST_AUTO_TEST_CASE(NoSink) {
+    BOOST_CHECK(!gLog.isEnabled(LogLevel::LEVEL_CRITICAL));
+    DAQ_CRITICAL("dropped");
+}
+
+BOOST_AUTO_TEST_CASE(ManyThreads) {
+    const int nThreads = 4;
+    const int nPerThread = 200;
+    LogSink sink;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.emplace_back([t, nPerThread]() {
+            for (int i = 0; i < nPerThread; i++)
+                DAQ_DEBUGF("%d:%d", t, i);
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    gLog.flush();
+
+    /* per-thread order is preserved */
+    std::vector<int> next(nThreads, 0);
+    for (auto &msg : sink.msgs) {
+        int t, i;
+        BOOST_REQUIRE_EQUAL(sscanf(msg.c_str(), "%d:%d", &t, &i), 2);
+        BOOST_CHECK_EQUAL(i, next[t]);
+        next[t] = i + 1;
+    }
+    for (int t = 0; t < nThreads; t++)
+        BOOST_CHECK_EQUAL(next[t], nPerThread);
+}
@@ -0,0 +1,115 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../../../lib/common/MemMgr.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+static const size_t valueSizes[] = {1,
+                                    64,
+                                    100,
+                                    4096,
+                                    65537,
+                                    MemMgr::MAX_POOLED_SIZE - 1,
+                                    MemMgr::MAX_POOLED_SIZE,
+                                    MemMgr::MAX_POOLED_SIZE + 1,
+                                    4 * MemMgr::MAX_POOLED_SIZE};
+
+/* whole chunk is usable and keeps its content until freed */
+static void checkValue(size_t size) {
+    char *value = MemMgr::allocValue(size);
+    BOOST_REQUIRE(value != nullptr);
+    std::memset(value, 0xab, size);
+    BOOST_CHECK_EQUAL(static_cast<unsigned char>(value[0]), 0xab);
+    BOOST_CHECK_EQUAL(static_cast<unsigned char>(value[size - 1]), 0xab);
+    MemMgr::freeValue(value, size);
+}
+
+BOOST_AUTO_TEST_CASE(AllocFreeSizes) {
+    for (auto size : valueSizes) {
+        BOOST_TEST_MESSAGE("value size " << size);
+        checkValue(size);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(PooledReuse) {
+    /* pooled chunk returns to its size class and is handed out again */
+    const size_t pooledSizes[] = {64, 4096, MemMgr::MAX_POOLED_SIZE};
+    for (auto size : pooledSizes) {
+        char *value = MemMgr::allocValue(size);
+        BOOST_REQUIRE(value != nullptr);
+        MemMgr::freeValue(value, size);
+        char *again = MemMgr::allocValue(size);
+        BOOST_CHECK(again == value);
+        MemMgr::freeValue(again, size);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HeapAbovePooled) {
+    /* values above the biggest size class never land in a pool */
+    const size_t size = MemMgr::MAX_POOLED_SIZE + 1;
+    std::vector<char *> values;
+    for (int i = 0; i < 4; i++) {
+        char *value = MemMgr::allocValue(size);
+        BOOST_REQUIRE(value != nullptr);
+        std::memset(value, i, size);
+        values.push_back(value);
+    }
+    for (auto value : values)
+        MemMgr::freeValue(value, size);
+
+    char *pooled = MemMgr::allocValue(MemMgr::MAX_POOLED_SIZE);
+    BOOST_REQUIRE(pooled != nullptr);
+    for (auto value : values)
+        BOOST_CHECK(pooled != value);
+    MemMgr::freeValue(pooled, MemMgr::MAX_POOLED_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(FreeNull) {
+    BOOST_CHECK_NO_THROW(MemMgr::freeValue(nullptr, 64));
+    BOOST_CHECK_NO_THROW(
+        MemMgr::freeValue(nullptr, MemMgr::MAX_POOLED_SIZE + 1));
+}
+
+BOOST_AUTO_TEST_CASE(FreeOnOtherThread) {
+    /* values are allocated by pollers and freed by application threads */
+    std::vector<std::pair<char *, size_t>> values;
+    std::thread poller([&values]() {
+        for (auto size : valueSizes) {
+            char *value = MemMgr::allocValue(size);
+            std::memset(value, 0x5a, size);
+            values.emplace_back(value, size);
+        }
+    });
+    poller.join();
+
+    for (auto &value : values) {
+        BOOST_REQUIRE(value.first != nullptr);
+        BOOST_CHECK_EQUAL(value.first[value.second - 1], 0x5a);
+        MemMgr::freeValue(value.first, value.second);
+    }
+    checkValue(64);
+}
@@ -0,0 +1,139 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../../../lib/common/Poller.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+class TestPoller : public Poller<uint64_t> {
+  public:
+    TestPoller()
+        : Poller<uint64_t>(true, SPDK_RING_TYPE_MP_SC,
+                           PollerRingBackend::PORTABLE_RING) {}
+    void process() final { requestCount = 0; }
+};
+
+static uint64_t item = 0;
+
+BOOST_AUTO_TEST_CASE(ReserveAndSpend) {
+    TestPoller poller;
+    const size_t size = poller.freeCount();
+    BOOST_CHECK_EQUAL(size, POLLER_RING_SIZE);
+
+    BOOST_CHECK(poller.reserve(10));
+    BOOST_CHECK_EQUAL(poller.canQueue(), size - 10);
+    BOOST_CHECK(!poller.reserve(size));
+
+    BOOST_CHECK(poller.enqueueReserved(&item));
+    BOOST_CHECK_EQUAL(poller.canQueue(), size - 10);
+    poller.release(9);
+    BOOST_CHECK_EQUAL(poller.canQueue(), size - 1);
+}
+
+BOOST_AUTO_TEST_CASE(ReservedSlotsProtected) {
+    TestPoller poller;
+    const size_t size = poller.freeCount();
+
+    BOOST_CHECK(poller.reserve(2));
+    for (size_t i = 0; i < size - 2; i++)
+        BOOST_REQUIRE(poller.enqueue(&item));
+    /* unreserved producers cannot take reserved slots */
+    BOOST_CHECK(!poller.enqueue(&item));
+    BOOST_CHECK(poller.enqueueReserved(&item));
+    BOOST_CHECK(poller.enqueueReserved(&item));
+    BOOST_CHECK_EQUAL(poller.freeCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(SpaceNotification) {
+    TestPoller poller;
+    const size_t size = poller.freeCount();
+    for (size_t i = 0; i < size; i++)
+        BOOST_REQUIRE(poller.enqueue(&item));
+
+    int notified = 0;
+    poller.notifyOnSpace(8, [&notified]() { notified++; });
+    BOOST_CHECK_EQUAL(notified, 0);
+
+    poller.dequeue(4);
+    BOOST_CHECK_EQUAL(notified, 0);
+    poller.dequeue(4);
+    BOOST_CHECK_EQUAL(notified, 1);
+
+    /* one-shot */
+    poller.dequeue(4);
+    BOOST_CHECK_EQUAL(notified, 1);
+
+    /* enough room already */
+    poller.notifyOnSpace(1, [&notified]() { notified++; });
+    BOOST_CHECK_EQUAL(notified, 2);
+}
+
+BOOST_AUTO_TEST_CASE(ReservedSlotsConcurrent) {
+    TestPoller poller;
+    const size_t reserved = 64;
+    std::atomic<bool> stop{false};
+
+    /* unreserved producers keep the ring full */
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++) {
+        producers.emplace_back([&poller, &stop]() {
+            while (!stop)
+                poller.enqueue(&item);
+        });
+    }
+    size_t spent = 0;
+    while (spent < 16 * reserved) {
+        if (!poller.reserve(reserved)) {
+            poller.dequeue(reserved);
+            continue;
+        }
+        for (size_t i = 0; i < reserved; i++, spent++)
+            BOOST_REQUIRE(poller.enqueueReserved(&item));
+        poller.dequeue(2 * reserved);
+    }
+    stop = true;
+    for (auto &producer : producers)
+        producer.join();
+}
+
+BOOST_AUTO_TEST_CASE(SpaceNotificationRace) {
+    for (int round = 0; round < 1000; round++) {
+        TestPoller poller;
+        while (poller.enqueue(&item))
+            ;
+
+        std::atomic<int> notified{0};
+        std::thread consumer([&poller]() {
+            while (poller.count())
+                poller.dequeue(1);
+        });
+        poller.notifyOnSpace(1, [&notified]() { notified++; });
+        consumer.join();
+        /* drained ring must have woken a waiter registered meanwhile */
+        BOOST_REQUIRE_EQUAL(notified, 1);
+    }
+}
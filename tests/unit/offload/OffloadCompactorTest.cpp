@@ -0,0 +1,205 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "../../lib/offload/OffloadCompactor.cpp"
+#include "../../lib/offload/OffloadSegment.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <fakeit.hpp>
+#include <stdlib.h>
+
+namespace ut = boost::unit_test;
+
+using namespace fakeit;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_BLOCK_SIZE 512
+#define TEST_SEGMENT_SIZE 4096
+#define TEST_VICTIM_LBA 64
+#define TEST_GC_RATE 1 // MB/s
+#define TEST_MS (1000ULL * 1000)
+
+void *spdk_dma_zmalloc(size_t size, size_t align, uint64_t *phys_addr) {
+    return calloc(1, size);
+}
+
+void spdk_dma_free(void *buf) { free(buf); }
+
+static DaqDB::OffloadRqst *makeRqst(const char *key, const char *value) {
+    DaqDB::OffloadRqst *rqst = DaqDB::OffloadRqst::updatePool.get();
+    rqst->finalizeUpdate(key, strlen(key), value, strlen(value) + 1, nullptr,
+                         PMEM);
+    return rqst;
+}
+
+/*
+ * Builds image of a victim segment holding values of keys k1 and k2.
+ */
+static void makeVictim(char *buf, uint32_t *offsets) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, 1);
+    writer.append(makeRqst("k1", "value1"));
+    writer.append(makeRqst("k2", "value2"));
+    writer.flush();
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    memcpy(buf, seg->buf, TEST_SEGMENT_SIZE);
+    offsets[0] = seg->offsets[0];
+    offsets[1] = seg->offsets[1];
+    writer.popSealed();
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+}
+
+struct CompactorFixture {
+    CompactorFixture()
+        : writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE, TEST_BLOCK_SIZE, 2) {
+        DaqDB::SpdkDevice &dev = devMock.get();
+        memset(&dev.spBdevCtx, 0, sizeof(dev.spBdevCtx));
+        dev.spBdevCtx.blk_size = TEST_BLOCK_SIZE;
+
+        When(Method(devMock, getCompactionVictim))
+            .AlwaysDo([&](uint32_t maxLiveBytes, unsigned int freePercent,
+                          uint64_t &lba) {
+                lba = TEST_VICTIM_LBA;
+                return &devMock.get();
+            });
+        When(Method(devMock, getBdevCtx))
+            .AlwaysReturn(&devMock.get().spBdevCtx);
+        When(Method(devMock, read)).AlwaysDo([&](DaqDB::DeviceTask *task) {
+            readTask = task;
+            return true;
+        });
+        When(Method(devMock, commitSegment)).AlwaysReturn();
+        When(Method(devMock, putFreeLba)).AlwaysReturn();
+    }
+
+    Mock<DaqDB::SpdkDevice> devMock;
+    Mock<DaqDB::RTreeEngine> rtreeMock;
+    DaqDB::OffloadSegmentWriter writer;
+    DaqDB::DeviceTask *readTask = nullptr;
+};
+
+BOOST_FIXTURE_TEST_CASE(ReadsAreRateLimited, CompactorFixture) {
+    DaqDB::OffloadCompactor compactor(&rtreeMock.get(), &devMock.get(),
+                                      &writer, 50, TEST_GC_RATE);
+    uint64_t now = TEST_MS;
+
+    compactor.process(now, true);
+    compactor.process(now + TEST_MS, true);
+    VerifyNoOtherInvocations(Method(devMock, read));
+
+    /* enough tokens but foreground updates are waiting */
+    compactor.process(now + 5 * TEST_MS, false);
+    VerifyNoOtherInvocations(Method(devMock, read));
+
+    compactor.process(now + 5 * TEST_MS, true);
+    Verify(Method(devMock, read)).Exactly(1);
+    BOOST_REQUIRE(readTask != nullptr);
+    BOOST_CHECK_EQUAL(readTask->freeLba, TEST_VICTIM_LBA);
+    BOOST_CHECK_EQUAL(readTask->blockSize, TEST_SEGMENT_SIZE / TEST_BLOCK_SIZE);
+    BOOST_CHECK(readTask->op == DaqDB::OffloadOperation::GET);
+
+    /* read in flight */
+    compactor.process(now + 100 * TEST_MS, true);
+    Verify(Method(devMock, read)).Exactly(1);
+    BOOST_CHECK_EQUAL(compactor.getVictimCount(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(RelocatesLiveValues, CompactorFixture) {
+    DaqDB::OffloadCompactor compactor(&rtreeMock.get(), &devMock.get(),
+                                      &writer, 50, TEST_GC_RATE);
+    uint32_t offsets[2];
+    DaqDB::DeviceAddr liveAddr;
+    liveAddr.lba = TEST_VICTIM_LBA;
+    liveAddr.busAddr.busAddr = 0;
+    liveAddr.busAddr.pciAddr = devMock.get().spBdevCtx.pci_addr;
+    DaqDB::DeviceAddr movedAddr;
+    movedAddr.lba = TEST_VICTIM_LBA * 2;
+    movedAddr.busAddr.busAddr = 0;
+    movedAddr.segAddr.segAddr = 0;
+
+    When(OverloadedMethod(
+             rtreeMock, Get,
+             void(const char *, int32_t, void **, size_t *, uint8_t *)))
+        .AlwaysDo([&](const char *key, int32_t keySize, void **val,
+                      size_t *valSize, uint8_t *loc) {
+            *val = !strncmp(key, "k1", keySize) ? &liveAddr : &movedAddr;
+            *valSize = sizeof(DaqDB::DeviceAddr);
+            *loc = DISK;
+        });
+
+    compactor.process(TEST_MS, true);
+    compactor.process(TEST_MS + 10 * TEST_MS, true);
+    BOOST_REQUIRE(readTask != nullptr);
+
+    makeVictim(readTask->segment->buf, offsets);
+    liveAddr.segAddr.seg.offset = offsets[0];
+    liveAddr.segAddr.seg.size = strlen("value1") + 1;
+    compactor.readComplete(true);
+    compactor.process(TEST_MS + 11 * TEST_MS, true);
+
+    writer.flush();
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    BOOST_REQUIRE_EQUAL(seg->rqsts.size(), 1);
+    DaqDB::OffloadRqst *rqst = seg->rqsts[0];
+    BOOST_CHECK_EQUAL(std::string(rqst->key, rqst->keySize), "k1");
+    BOOST_CHECK_EQUAL(rqst->loc, DISK);
+    BOOST_CHECK_EQUAL(memcmp(rqst->devAddrBuf, &liveAddr, sizeof(liveAddr)),
+                      0);
+    BOOST_CHECK_EQUAL(memcmp(seg->buf + seg->offsets[0], "value1", 7), 0);
+    BOOST_CHECK_EQUAL(compactor.getRelocatedBytes(), 7);
+    VerifyNoOtherInvocations(Method(devMock, commitSegment));
+
+    /* old location is released once the new one is published */
+    rqst->clb(nullptr, DaqDB::StatusCode::OK, rqst->key, rqst->keySize,
+              nullptr, 0);
+    Verify(Method(devMock, putFreeLba)).Exactly(1);
+
+    writer.popSealed();
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+}
+
+BOOST_FIXTURE_TEST_CASE(FreesVictimWithoutLiveValues, CompactorFixture) {
+    DaqDB::OffloadCompactor compactor(&rtreeMock.get(), &devMock.get(),
+                                      &writer, 50, TEST_GC_RATE);
+    uint32_t offsets[2];
+
+    When(OverloadedMethod(
+             rtreeMock, Get,
+             void(const char *, int32_t, void **, size_t *, uint8_t *)))
+        .AlwaysThrow(DaqDB::OperationFailedException(
+            DaqDB::Status(DaqDB::KEY_NOT_FOUND)));
+
+    compactor.process(TEST_MS, true);
+    compactor.process(TEST_MS + 10 * TEST_MS, true);
+    BOOST_REQUIRE(readTask != nullptr);
+
+    makeVictim(readTask->segment->buf, offsets);
+    compactor.readComplete(true);
+    compactor.process(TEST_MS + 11 * TEST_MS, true);
+
+    Verify(Method(devMock, commitSegment).Using(TEST_VICTIM_LBA, 0))
+        .Exactly(1);
+    writer.flush();
+    BOOST_CHECK(writer.sealed() == nullptr);
+    BOOST_CHECK_EQUAL(compactor.getRelocatedBytes(), 0);
+}
@@ -0,0 +1,179 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "../../lib/offload/OffloadLbaAlloc.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_POOL_LBA_FILENAME "test_lba.pm"
+#define TEST_UNIT_BLOCKS 4
+#define TEST_UNIT_CNT 200
+/* partial unit at the end of the device is not used */
+#define TEST_BLOCK_CNT (TEST_UNIT_CNT * TEST_UNIT_BLOCKS + 3)
+
+struct OffloadLbaAllocFixture {
+    OffloadLbaAllocFixture() { removePool(); }
+    ~OffloadLbaAllocFixture() { removePool(); }
+    void removePool() {
+        if (boost::filesystem::exists(TEST_POOL_LBA_FILENAME))
+            boost::filesystem::remove(TEST_POOL_LBA_FILENAME);
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(GetLbaAllocatesSequentially, OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getUnitCount(), TEST_UNIT_CNT);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT);
+
+    BOOST_CHECK_EQUAL(alloc.getLba(1), 0);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS + 1), TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), 3 * TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT - 4);
+}
+
+BOOST_FIXTURE_TEST_CASE(PutLbaReusesExtents, OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    int64_t lbaA = alloc.getLba(2 * TEST_UNIT_BLOCKS);
+    int64_t lbaB = alloc.getLba(TEST_UNIT_BLOCKS);
+    alloc.getLba(TEST_UNIT_BLOCKS);
+
+    alloc.putLba(lbaA, 2 * TEST_UNIT_BLOCKS);
+    alloc.putLba(lbaB, TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT - 1);
+
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), lbaB);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), lbaA);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), lbaA + TEST_UNIT_BLOCKS);
+}
+
+BOOST_FIXTURE_TEST_CASE(PutLbaRejectsInvalidExtents, OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    int64_t lba = alloc.getLba(TEST_UNIT_BLOCKS);
+    alloc.putLba(lba, TEST_UNIT_BLOCKS);
+    alloc.putLba(lba, TEST_UNIT_BLOCKS);
+    alloc.putLba(lba + 1, TEST_UNIT_BLOCKS);
+    alloc.putLba(TEST_UNIT_CNT * TEST_UNIT_BLOCKS, TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT);
+}
+
+BOOST_FIXTURE_TEST_CASE(GetLbaMergesFreedExtents, OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    for (int64_t unit = 0; unit < TEST_UNIT_CNT; unit++)
+        BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS),
+                          unit * TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getLba(1), -1);
+
+    alloc.putLba(11 * TEST_UNIT_BLOCKS, TEST_UNIT_BLOCKS);
+    alloc.putLba(10 * TEST_UNIT_BLOCKS, TEST_UNIT_BLOCKS);
+    alloc.putLba(30 * TEST_UNIT_BLOCKS, TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getLba(2 * TEST_UNIT_BLOCKS),
+                      10 * TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getLba(2 * TEST_UNIT_BLOCKS), -1);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), 30 * TEST_UNIT_BLOCKS);
+    /* listed units taken by the merged extent are not handed out again */
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), -1);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(GetLbaKeepsFreePartsOfMergedExtents,
+                        OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    for (int64_t unit = 0; unit < TEST_UNIT_CNT; unit++)
+        alloc.getLba(TEST_UNIT_BLOCKS);
+
+    alloc.putLba(40 * TEST_UNIT_BLOCKS, 2 * TEST_UNIT_BLOCKS);
+    alloc.putLba(42 * TEST_UNIT_BLOCKS, 2 * TEST_UNIT_BLOCKS);
+    alloc.putLba(44 * TEST_UNIT_BLOCKS, TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getLba(3 * TEST_UNIT_BLOCKS),
+                      40 * TEST_UNIT_BLOCKS);
+    /* listed extent at 42 lost its first unit to the merged one */
+    BOOST_CHECK_EQUAL(alloc.getLba(2 * TEST_UNIT_BLOCKS),
+                      43 * TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), 0);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), -1);
+}
+
+BOOST_FIXTURE_TEST_CASE(PutLbaFreesWholeExtent, OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    int64_t lba = alloc.getLba(3 * TEST_UNIT_BLOCKS - 1);
+    BOOST_CHECK_EQUAL(alloc.getExtentBlocks(3 * TEST_UNIT_BLOCKS - 1),
+                      3 * TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT - 3);
+
+    alloc.putLba(lba, alloc.getExtentBlocks(3 * TEST_UNIT_BLOCKS - 1));
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT);
+    BOOST_CHECK_EQUAL(alloc.getLba(3 * TEST_UNIT_BLOCKS), lba);
+}
+
+BOOST_FIXTURE_TEST_CASE(GetLbasAllocatesBatch, OffloadLbaAllocFixture) {
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    std::vector<uint64_t> lbas;
+    BOOST_CHECK_EQUAL(alloc.getLbas(2 * TEST_UNIT_BLOCKS, 4, lbas), 4);
+    BOOST_REQUIRE_EQUAL(lbas.size(), 4);
+    for (size_t idx = 0; idx < lbas.size(); idx++)
+        BOOST_CHECK_EQUAL(lbas[idx], 2 * idx * TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT - 8);
+
+    /* batch is cut short once the device is full */
+    lbas.clear();
+    BOOST_CHECK_EQUAL(alloc.getLbas(TEST_UNIT_BLOCKS, TEST_UNIT_CNT, lbas),
+                      TEST_UNIT_CNT - 8);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), 0);
+    BOOST_CHECK_EQUAL(alloc.getLbas(TEST_UNIT_BLOCKS, 1, lbas), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(OpenRestoresFreeExtents, OffloadLbaAllocFixture) {
+    int64_t lbaA, lbaB;
+    {
+        DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                     TEST_UNIT_BLOCKS);
+        lbaA = alloc.getLba(3 * TEST_UNIT_BLOCKS);
+        lbaB = alloc.getLba(TEST_UNIT_BLOCKS);
+        alloc.putLba(lbaA, 3 * TEST_UNIT_BLOCKS);
+    }
+
+    DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                 TEST_UNIT_BLOCKS);
+    BOOST_CHECK_EQUAL(alloc.getFreeUnits(), TEST_UNIT_CNT - 1);
+    BOOST_CHECK_EQUAL(alloc.getLba(3 * TEST_UNIT_BLOCKS), lbaA);
+    BOOST_CHECK_EQUAL(alloc.getLba(TEST_UNIT_BLOCKS), lbaB + TEST_UNIT_BLOCKS);
+}
+
+BOOST_FIXTURE_TEST_CASE(OpenFailsOnUnitChange, OffloadLbaAllocFixture) {
+    {
+        DaqDB::OffloadLbaAlloc alloc(TEST_POOL_LBA_FILENAME, TEST_BLOCK_CNT,
+                                     TEST_UNIT_BLOCKS);
+    }
+    BOOST_CHECK_THROW(DaqDB::OffloadLbaAlloc(TEST_POOL_LBA_FILENAME,
+                                             TEST_BLOCK_CNT,
+                                             2 * TEST_UNIT_BLOCKS),
+                      DaqDB::OperationFailedException);
+}
@@ -206,7 +206,6 @@ BOOST_AUTO_TEST_CASE(ProcessUpdateRequest) {
     When(Method(bdevMock, getOptimalSize)).Return(0);
     When(Method(bdevMock, getSizeInBlk)).Return(0);
 
-    When(Method(pollerMock, getFreeLba)).Return(1);
     When(Method(bdevMock, read)).Return(0);
     When(Method(bdevMock, write)).Return(0);
     When(Method(pollerMock, getBdev)).AlwaysReturn(&spdkBdev);
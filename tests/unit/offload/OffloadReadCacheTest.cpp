@@ -0,0 +1,192 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "../../lib/offload/OffloadReadCache.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_CAPACITY 64
+#define TEST_VALUE "0123456789abcdef"
+#define TEST_VALUE_SIZE 16
+
+static DaqDB::DeviceAddr testAddr(uint64_t lba, uint32_t offset = 0,
+                                  uint32_t size = 0) {
+    DaqDB::DeviceAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.busAddr.pciAddr.bus = 0x89;
+    addr.lba = lba;
+    addr.segAddr.seg.offset = offset;
+    addr.segAddr.seg.size = size;
+    return addr;
+}
+
+BOOST_AUTO_TEST_CASE(PutAndGet) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY, 1);
+
+    BOOST_CHECK(!cache.get(testAddr(8)));
+    BOOST_REQUIRE(cache.put(testAddr(8), cache.generation(), TEST_VALUE,
+                            TEST_VALUE_SIZE));
+    auto buf = cache.get(testAddr(8));
+    BOOST_REQUIRE(buf);
+    BOOST_CHECK_EQUAL(buf->size(), TEST_VALUE_SIZE);
+    BOOST_CHECK(!memcmp(buf->data(), TEST_VALUE, TEST_VALUE_SIZE));
+
+    /* values packed into a segment differ by their offset */
+    BOOST_CHECK(!cache.get(testAddr(8, 512, TEST_VALUE_SIZE)));
+    BOOST_CHECK_EQUAL(cache.getSize(), TEST_VALUE_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(PutEvictsUnreferenced) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY, 1);
+    const size_t cnt = TEST_CAPACITY / TEST_VALUE_SIZE;
+
+    for (uint64_t lba = 0; lba < cnt; lba++)
+        BOOST_CHECK(cache.put(testAddr(lba), cache.generation(), TEST_VALUE,
+                              TEST_VALUE_SIZE));
+    /* hit value gets a second chance */
+    BOOST_CHECK(cache.get(testAddr(0)));
+    BOOST_CHECK(cache.put(testAddr(cnt), cache.generation(), TEST_VALUE,
+                          TEST_VALUE_SIZE));
+    BOOST_CHECK(cache.get(testAddr(0)));
+    BOOST_CHECK(!cache.get(testAddr(1)));
+    BOOST_CHECK(cache.get(testAddr(cnt)));
+    BOOST_CHECK_EQUAL(cache.getCount(), cnt);
+    BOOST_CHECK_EQUAL(cache.getSize(), TEST_CAPACITY);
+    BOOST_CHECK_EQUAL(cache.getEvictions(), 1);
+
+    std::vector<char> big(TEST_CAPACITY + 1);
+    BOOST_CHECK(!cache.put(testAddr(100), cache.generation(), big.data(),
+                           big.size()));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidateDropsExtent) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY * 4, 4);
+    DaqDB::DeviceAddr addr = testAddr(16, 1024, TEST_VALUE_SIZE);
+
+    cache.put(testAddr(8), cache.generation(), TEST_VALUE, TEST_VALUE_SIZE);
+    cache.put(addr, cache.generation(), TEST_VALUE, TEST_VALUE_SIZE);
+    cache.put(testAddr(24), cache.generation(), TEST_VALUE, TEST_VALUE_SIZE);
+
+    uint64_t gen = cache.generation();
+    cache.invalidate(addr.busAddr.pciAddr, 16, 8);
+    BOOST_CHECK(cache.get(testAddr(8)));
+    BOOST_CHECK(!cache.get(addr));
+    BOOST_CHECK(cache.get(testAddr(24)));
+    BOOST_CHECK_EQUAL(cache.getCount(), 2);
+
+    /* read started before the extent was freed is not cached */
+    BOOST_CHECK(!cache.put(addr, gen, TEST_VALUE, TEST_VALUE_SIZE));
+    BOOST_CHECK(!cache.get(addr));
+    /* reads of other extents are */
+    BOOST_CHECK(cache.put(testAddr(40), gen, TEST_VALUE, TEST_VALUE_SIZE));
+    BOOST_CHECK(cache.get(testAddr(40)));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidateForgetsOldExtents) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY, 1);
+    uint64_t gen = cache.generation();
+
+    for (uint64_t lba = 0; lba <= DaqDB::OFFLOAD_READ_CACHE_FREED; lba++)
+        cache.invalidate(testAddr(0).busAddr.pciAddr, 100 + lba, 1);
+    /* not known whether the extent was freed since gen */
+    BOOST_CHECK(!cache.put(testAddr(8), gen, TEST_VALUE, TEST_VALUE_SIZE));
+    BOOST_CHECK(cache.put(testAddr(8), cache.generation(), TEST_VALUE,
+                          TEST_VALUE_SIZE));
+}
+
+BOOST_AUTO_TEST_CASE(LookupCoalescesMisses) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY, 1);
+    DaqDB::OffloadReadCache::Buffer buf;
+    DaqDB::OffloadReadCache::ReadHandle read, joined;
+    size_t served = 0;
+    auto waiter = [&served](DaqDB::StatusCode status,
+                            const DaqDB::OffloadReadCache::Buffer &buf) {
+        BOOST_CHECK(status == DaqDB::StatusCode::OK);
+        BOOST_REQUIRE(buf);
+        BOOST_CHECK(!memcmp(buf->data(), TEST_VALUE, TEST_VALUE_SIZE));
+        served++;
+    };
+
+    BOOST_CHECK(cache.lookup(testAddr(8), buf, waiter, read) ==
+                DaqDB::OffloadReadCache::Lookup::MISS);
+    BOOST_REQUIRE(read);
+    BOOST_CHECK(cache.lookup(testAddr(8), buf, waiter, joined) ==
+                DaqDB::OffloadReadCache::Lookup::JOINED);
+    BOOST_CHECK(cache.lookup(testAddr(8), buf, waiter, joined) ==
+                DaqDB::OffloadReadCache::Lookup::JOINED);
+    BOOST_CHECK(!joined);
+
+    cache.complete(read, DaqDB::StatusCode::OK, TEST_VALUE, TEST_VALUE_SIZE);
+    BOOST_CHECK_EQUAL(served, 2);
+    BOOST_CHECK(cache.lookup(testAddr(8), buf, waiter, joined) ==
+                DaqDB::OffloadReadCache::Lookup::HIT);
+    BOOST_REQUIRE(buf);
+    BOOST_CHECK_EQUAL(buf->size(), TEST_VALUE_SIZE);
+
+    BOOST_CHECK_EQUAL(cache.getHits(), 1);
+    BOOST_CHECK_EQUAL(cache.getMisses(), 1);
+    BOOST_CHECK_EQUAL(cache.getCoalesced(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(FailedReadIsNotCached) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY, 1);
+    DaqDB::OffloadReadCache::Buffer buf;
+    DaqDB::OffloadReadCache::ReadHandle read, joined;
+    bool failed = false;
+    auto waiter = [&failed](DaqDB::StatusCode status,
+                            const DaqDB::OffloadReadCache::Buffer &buf) {
+        failed = (status != DaqDB::StatusCode::OK && !buf);
+    };
+
+    cache.lookup(testAddr(8), buf, waiter, read);
+    cache.lookup(testAddr(8), buf, waiter, joined);
+    cache.complete(read, DaqDB::StatusCode::UNKNOWN_ERROR, nullptr, 0);
+    BOOST_CHECK(failed);
+    BOOST_CHECK(!cache.get(testAddr(8)));
+
+    /* reads pending in a freed extent are not joined */
+    cache.lookup(testAddr(8), buf, waiter, read);
+    cache.invalidate(testAddr(8).busAddr.pciAddr, 8, 1);
+    BOOST_CHECK(cache.lookup(testAddr(8), buf, waiter, joined) ==
+                DaqDB::OffloadReadCache::Lookup::MISS);
+    cache.complete(read, DaqDB::StatusCode::OK, TEST_VALUE, TEST_VALUE_SIZE);
+    BOOST_CHECK(!cache.get(testAddr(8)));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidateKeepsOtherReads) {
+    DaqDB::OffloadReadCache cache(TEST_CAPACITY * 4, 4);
+    DaqDB::OffloadReadCache::Buffer buf;
+    DaqDB::OffloadReadCache::ReadHandle read, freedRead;
+
+    cache.lookup(testAddr(8), buf, nullptr, read);
+    cache.lookup(testAddr(40), buf, nullptr, freedRead);
+    BOOST_REQUIRE(read && freedRead);
+    cache.invalidate(testAddr(40).busAddr.pciAddr, 40, 8);
+
+    cache.complete(read, DaqDB::StatusCode::OK, TEST_VALUE, TEST_VALUE_SIZE);
+    cache.complete(freedRead, DaqDB::StatusCode::OK, TEST_VALUE,
+                   TEST_VALUE_SIZE);
+    BOOST_CHECK(cache.get(testAddr(8)));
+    BOOST_CHECK(!cache.get(testAddr(40)));
+}
@@ -0,0 +1,70 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "../../lib/offload/OffloadReadMerge.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_MAX_BLOCKS 32
+
+BOOST_AUTO_TEST_CASE(MergeJoinsAdjacentAndOverlappingReads) {
+    std::vector<DaqDB::OffloadReadExtent> extents = {
+        {16, 8, 0}, {0, 8, 1}, {8, 8, 2}, {64, 4, 3}, {18, 2, 4}, {70, 2, 5}};
+    std::vector<DaqDB::OffloadReadRange> ranges;
+
+    DaqDB::mergeReadExtents(extents, TEST_MAX_BLOCKS, ranges);
+    BOOST_REQUIRE_EQUAL(ranges.size(), 3);
+    BOOST_CHECK_EQUAL(ranges[0].lba, 0);
+    BOOST_CHECK_EQUAL(ranges[0].blocks, 24);
+    BOOST_CHECK_EQUAL(ranges[0].first, 0);
+    BOOST_CHECK_EQUAL(ranges[0].cnt, 4);
+    BOOST_CHECK_EQUAL(ranges[1].lba, 64);
+    BOOST_CHECK_EQUAL(ranges[1].blocks, 4);
+    BOOST_CHECK_EQUAL(ranges[2].lba, 70);
+    BOOST_CHECK_EQUAL(ranges[2].first, 5);
+
+    /* extents are sorted, their batch positions are kept */
+    BOOST_CHECK_EQUAL(extents[0].idx, 1);
+    BOOST_CHECK_EQUAL(extents[3].idx, 4);
+    BOOST_CHECK_EQUAL(extents[5].idx, 5);
+}
+
+BOOST_AUTO_TEST_CASE(MergeStopsAtMaxBlocks) {
+    std::vector<DaqDB::OffloadReadExtent> extents = {
+        {0, 16, 0}, {16, 16, 1}, {32, 8, 2}, {40, 64, 3}};
+    std::vector<DaqDB::OffloadReadRange> ranges;
+
+    DaqDB::mergeReadExtents(extents, TEST_MAX_BLOCKS, ranges);
+    BOOST_REQUIRE_EQUAL(ranges.size(), 3);
+    BOOST_CHECK_EQUAL(ranges[0].blocks, TEST_MAX_BLOCKS);
+    BOOST_CHECK_EQUAL(ranges[0].cnt, 2);
+    BOOST_CHECK_EQUAL(ranges[1].lba, 32);
+    BOOST_CHECK_EQUAL(ranges[1].blocks, 8);
+    BOOST_CHECK_EQUAL(ranges[2].lba, 40);
+    BOOST_CHECK_EQUAL(ranges[2].blocks, 64);
+    BOOST_CHECK_EQUAL(ranges[2].cnt, 1);
+
+    extents.clear();
+    DaqDB::mergeReadExtents(extents, TEST_MAX_BLOCKS, ranges);
+    BOOST_CHECK(ranges.empty());
+}
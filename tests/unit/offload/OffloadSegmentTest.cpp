@@ -0,0 +1,223 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "../../lib/offload/OffloadSegment.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_BLOCK_SIZE 512
+#define TEST_SEGMENT_SIZE 4096
+#define TEST_SEGMENT_CNT 2
+#define TEST_KEY "key"
+#define TEST_KEY_SIZE 3
+
+/* largest value filling a whole segment */
+static const size_t maxValSize =
+    TEST_SEGMENT_SIZE - sizeof(DaqDB::OffloadSegmentHeader) -
+    DaqDB::offloadSegmentEntrySize(TEST_KEY_SIZE, 0);
+
+void *spdk_dma_zmalloc(size_t size, size_t align, uint64_t *phys_addr) {
+    return calloc(1, size);
+}
+
+void spdk_dma_free(void *buf) { free(buf); }
+
+static DaqDB::OffloadRqst *makeRqst(const char *value, size_t valueSize,
+                                    int *clbCnt = nullptr,
+                                    DaqDB::StatusCode *clbStatus = nullptr) {
+    DaqDB::OffloadRqst *rqst = DaqDB::OffloadRqst::updatePool.get();
+    rqst->finalizeUpdate(
+        TEST_KEY, TEST_KEY_SIZE, value, valueSize,
+        [clbCnt, clbStatus](DaqDB::KVStoreBase *kvs, DaqDB::Status status,
+                            const char *key, size_t keySize,
+                            const char *val, size_t valSize) {
+            if (clbCnt)
+                (*clbCnt)++;
+            if (clbStatus)
+                *clbStatus = status.getStatusCode();
+        },
+        PMEM);
+    return rqst;
+}
+
+BOOST_AUTO_TEST_CASE(AppendPacksAlignedValues) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, TEST_SEGMENT_CNT);
+    const char valA[] = "abc";
+    const char valB[] = "0123456789";
+
+    BOOST_CHECK(writer.append(makeRqst(valA, sizeof(valA))));
+    BOOST_CHECK(writer.append(makeRqst(valB, sizeof(valB))));
+    BOOST_CHECK(writer.sealed() == nullptr);
+
+    writer.flush();
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    BOOST_CHECK_EQUAL(seg->rqsts.size(), 2);
+    BOOST_CHECK_EQUAL(seg->offsets[0],
+                      sizeof(DaqDB::OffloadSegmentHeader) +
+                          2 * DaqDB::OFFLOAD_SEGMENT_VALUE_ALIGN);
+    BOOST_CHECK_EQUAL(seg->offsets[1] % DaqDB::OFFLOAD_SEGMENT_VALUE_ALIGN, 0);
+    BOOST_CHECK_EQUAL(seg->valueBytes, sizeof(valA) + sizeof(valB));
+    BOOST_CHECK_EQUAL(memcmp(seg->buf + seg->offsets[0], valA, sizeof(valA)),
+                      0);
+    BOOST_CHECK_EQUAL(memcmp(seg->buf + seg->offsets[1], valB, sizeof(valB)),
+                      0);
+    BOOST_CHECK_EQUAL(writer.getWriteSize(seg), TEST_BLOCK_SIZE);
+    BOOST_CHECK_EQUAL(writer.getWriteBlocks(seg), 1);
+
+    writer.popSealed();
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+}
+
+BOOST_AUTO_TEST_CASE(AppendSealsFullSegment) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, TEST_SEGMENT_CNT);
+    static char val[TEST_SEGMENT_SIZE / 2];
+
+    DaqDB::OffloadRqst *rqst = makeRqst(val, maxValSize);
+    BOOST_CHECK(writer.fits(rqst));
+    rqst->valueSize = maxValSize + 1;
+    BOOST_CHECK(!writer.fits(rqst));
+    rqst->valueSize = 0;
+    BOOST_CHECK(!writer.fits(rqst));
+    DaqDB::OffloadRqst::updatePool.put(rqst);
+
+    BOOST_CHECK(writer.append(makeRqst(val, sizeof(val))));
+    BOOST_CHECK(writer.sealed() == nullptr);
+    BOOST_CHECK(writer.append(makeRqst(val, sizeof(val))));
+
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    BOOST_CHECK_EQUAL(seg->rqsts.size(), 1);
+    writer.popSealed();
+    BOOST_CHECK(writer.sealed() == nullptr);
+
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+    writer.flush();
+    seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    writer.popSealed();
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+}
+
+BOOST_AUTO_TEST_CASE(TickSealsAfterFlushInterval) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, TEST_SEGMENT_CNT);
+    const char val[] = "abc";
+
+    writer.tick(DaqDB::LatencyTracer::now());
+    BOOST_CHECK(writer.sealed() == nullptr);
+
+    BOOST_CHECK(writer.append(makeRqst(val, sizeof(val))));
+    uint64_t openedAt = DaqDB::LatencyTracer::now();
+    writer.tick(openedAt);
+    BOOST_CHECK(writer.sealed() == nullptr);
+
+    writer.tick(openedAt + DaqDB::OFFLOAD_SEGMENT_FLUSH_NS);
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    writer.popSealed();
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+}
+
+BOOST_AUTO_TEST_CASE(AppendFailsWithAllSegmentsInFlight) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, TEST_SEGMENT_CNT);
+    static char val[TEST_SEGMENT_SIZE];
+    DaqDB::OffloadSegment *segs[TEST_SEGMENT_CNT];
+
+    for (int idx = 0; idx < TEST_SEGMENT_CNT; idx++) {
+        BOOST_CHECK(writer.append(makeRqst(val, maxValSize)));
+        segs[idx] = writer.sealed();
+        BOOST_REQUIRE(segs[idx] != nullptr);
+        writer.popSealed();
+    }
+
+    DaqDB::OffloadRqst *rqst = makeRqst(val, maxValSize);
+    BOOST_CHECK(!writer.append(rqst));
+
+    writer.release(segs[0]);
+    BOOST_CHECK(writer.append(rqst));
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_CHECK(seg == segs[0]);
+    writer.popSealed();
+
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+    writer.fail(segs[1], DaqDB::StatusCode::OK, false);
+}
+
+BOOST_AUTO_TEST_CASE(FailCompletesPackedValues) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, TEST_SEGMENT_CNT);
+    const char val[] = "abc";
+    int clbCnt = 0;
+    DaqDB::StatusCode clbStatus = DaqDB::StatusCode::OK;
+
+    BOOST_CHECK(writer.append(makeRqst(val, sizeof(val), &clbCnt, &clbStatus)));
+    BOOST_CHECK(writer.append(makeRqst(val, sizeof(val), &clbCnt, &clbStatus)));
+    writer.flush();
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    writer.popSealed();
+
+    writer.fail(seg, DaqDB::StatusCode::UNKNOWN_ERROR);
+    BOOST_CHECK_EQUAL(clbCnt, 2);
+    BOOST_CHECK(clbStatus == DaqDB::StatusCode::UNKNOWN_ERROR);
+    BOOST_CHECK(seg->rqsts.empty());
+    BOOST_CHECK_EQUAL(seg->used, 0);
+}
+
+BOOST_AUTO_TEST_CASE(CursorWalksSealedSegment) {
+    DaqDB::OffloadSegmentWriter writer(TEST_SEGMENT_SIZE, TEST_BLOCK_SIZE,
+                                       TEST_BLOCK_SIZE, TEST_SEGMENT_CNT);
+    const char valA[] = "abc";
+    const char valB[] = "0123456789";
+
+    BOOST_CHECK(writer.append(makeRqst(valA, sizeof(valA))));
+    BOOST_CHECK(writer.append(makeRqst(valB, sizeof(valB))));
+    writer.flush();
+    DaqDB::OffloadSegment *seg = writer.sealed();
+    BOOST_REQUIRE(seg != nullptr);
+    writer.popSealed();
+
+    DaqDB::OffloadSegmentCursor cursor(seg->buf, TEST_SEGMENT_SIZE);
+    BOOST_REQUIRE(cursor.next());
+    BOOST_CHECK_EQUAL(cursor.keySize(), TEST_KEY_SIZE);
+    BOOST_CHECK_EQUAL(memcmp(cursor.key(), TEST_KEY, TEST_KEY_SIZE), 0);
+    BOOST_CHECK_EQUAL(cursor.valueOffset(), seg->offsets[0]);
+    BOOST_CHECK_EQUAL(cursor.valueSize(), sizeof(valA));
+    BOOST_REQUIRE(cursor.next());
+    BOOST_CHECK_EQUAL(cursor.valueOffset(), seg->offsets[1]);
+    BOOST_CHECK_EQUAL(memcmp(cursor.value(), valB, sizeof(valB)), 0);
+    BOOST_CHECK(!cursor.next());
+
+    memset(seg->buf, 0, sizeof(DaqDB::OffloadSegmentHeader));
+    DaqDB::OffloadSegmentCursor corrupted(seg->buf, TEST_SEGMENT_SIZE);
+    BOOST_CHECK(!corrupted.next());
+
+    writer.fail(seg, DaqDB::StatusCode::OK, false);
+}
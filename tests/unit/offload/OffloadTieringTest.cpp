@@ -0,0 +1,230 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../lib/offload/OffloadTiering.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <fakeit.hpp>
+
+namespace ut = boost::unit_test;
+
+using namespace fakeit;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_POOL_SIZE 1000
+#define TEST_VALUE_SIZE 200
+#define TEST_HIGH 80
+#define TEST_LOW 50
+#define TEST_MS (1000ULL * 1000)
+
+struct TieringFixture {
+    TieringFixture() {
+        When(OverloadedMethod(rtreeMock, Get,
+                              void(const char *, int32_t, void **, size_t *,
+                                   uint8_t *)))
+            .AlwaysDo([&](const char *key, int32_t keySize, void **val,
+                          size_t *valSize, uint8_t *loc) {
+                auto it = locations.find(std::string(key, keySize));
+                if (it == locations.end())
+                    throw DaqDB::OperationFailedException(
+                        DaqDB::Status(DaqDB::KEY_NOT_FOUND));
+                *val = value;
+                *valSize = TEST_VALUE_SIZE;
+                *loc = it->second;
+            });
+        When(Method(rtreeMock, GetPoolUsage))
+            .AlwaysDo([&](size_t *used, size_t *size) {
+                *used = pmemUsed;
+                *size = TEST_POOL_SIZE;
+                return true;
+            });
+        When(Method(pollerMock, enqueue))
+            .AlwaysDo([&](DaqDB::OffloadRqst *rqst) {
+                if (queueFull)
+                    return false;
+                queued.push_back(rqst);
+                return true;
+            });
+    }
+
+    ~TieringFixture() {
+        for (auto rqst : queued)
+            DaqDB::OffloadRqst::updatePool.put(rqst);
+    }
+
+    void put(const std::string &key, uint8_t location = PMEM) {
+        locations[key] = location;
+        tiering.track(key.data(), key.size());
+    }
+
+    void complete(DaqDB::StatusCode status) {
+        for (auto rqst : queued) {
+            rqst->clb(nullptr, status, rqst->key, rqst->keySize, nullptr, 0);
+            DaqDB::OffloadRqst::updatePool.put(rqst);
+        }
+        queued.clear();
+    }
+
+    Mock<DaqDB::RTreeEngine> rtreeMock;
+    Mock<DaqDB::OffloadPoller> pollerMock;
+    std::vector<DaqDB::OffloadPoller *> pollers{&pollerMock.get()};
+    DaqDB::OffloadTiering tiering{&rtreeMock.get(), pollers, TEST_HIGH,
+                                  TEST_LOW};
+
+    std::map<std::string, uint8_t> locations;
+    std::vector<DaqDB::OffloadRqst *> queued;
+    char value[TEST_VALUE_SIZE];
+    size_t pmemUsed = 0;
+    bool queueFull = false;
+};
+
+BOOST_FIXTURE_TEST_CASE(MovesOldestAboveHighWatermark, TieringFixture) {
+    put("k1");
+    put("k2");
+    put("k3");
+    put("k4");
+
+    pmemUsed = TEST_POOL_SIZE * (TEST_HIGH - 10) / 100;
+    tiering.process(TEST_MS);
+    BOOST_CHECK(queued.empty());
+    BOOST_CHECK(!tiering.isDraining());
+
+    /* enough values to get down to the low watermark */
+    pmemUsed = TEST_POOL_SIZE * (TEST_HIGH + 10) / 100;
+    tiering.process(2 * TEST_MS);
+    BOOST_CHECK(tiering.isDraining());
+    BOOST_REQUIRE_EQUAL(queued.size(), 2);
+    BOOST_CHECK_EQUAL(std::string(queued[0]->key, queued[0]->keySize), "k1");
+    BOOST_CHECK_EQUAL(std::string(queued[1]->key, queued[1]->keySize), "k2");
+    BOOST_CHECK(queued[0]->op == DaqDB::OffloadOperation::UPDATE);
+    BOOST_CHECK_EQUAL(queued[0]->loc, PMEM);
+    BOOST_CHECK_EQUAL(queued[0]->valueSize, TEST_VALUE_SIZE);
+
+    /* values in flight count as moved */
+    tiering.process(3 * TEST_MS);
+    BOOST_CHECK_EQUAL(queued.size(), 2);
+
+    complete(DaqDB::StatusCode::OK);
+    BOOST_CHECK_EQUAL(tiering.getMovedCount(), 2);
+    BOOST_CHECK_EQUAL(tiering.getMovedBytes(), 2 * TEST_VALUE_SIZE);
+    BOOST_CHECK_EQUAL(tiering.getTrackedCount(), 2);
+
+    /* still draining between watermarks */
+    pmemUsed = TEST_POOL_SIZE * (TEST_LOW + 10) / 100;
+    tiering.process(4 * TEST_MS);
+    BOOST_CHECK_EQUAL(queued.size(), 1);
+    complete(DaqDB::StatusCode::OK);
+
+    pmemUsed = TEST_POOL_SIZE * TEST_LOW / 100;
+    tiering.process(5 * TEST_MS);
+    BOOST_CHECK(!tiering.isDraining());
+    BOOST_CHECK(queued.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(ChecksUsageOncePerInterval, TieringFixture) {
+    put("k1");
+    pmemUsed = TEST_POOL_SIZE;
+
+    tiering.process(TEST_MS);
+    tiering.process(TEST_MS + 1);
+    Verify(Method(rtreeMock, GetPoolUsage)).Exactly(1);
+
+    tiering.wakeup();
+    tiering.process(TEST_MS + 2);
+    Verify(Method(rtreeMock, GetPoolUsage)).Exactly(2);
+}
+
+BOOST_FIXTURE_TEST_CASE(AllocFailureForcesDrain, TieringFixture) {
+    put("k1");
+    put("k2");
+    put("k3");
+    /* pool is full of tree nodes, values take little of it */
+    pmemUsed = TEST_POOL_SIZE * (TEST_LOW - 10) / 100;
+
+    tiering.process(TEST_MS);
+    BOOST_CHECK(queued.empty());
+
+    tiering.allocFailed();
+    tiering.process(TEST_MS + 1);
+    BOOST_CHECK(tiering.isDraining());
+    BOOST_CHECK_EQUAL(queued.size(), 3);
+    complete(DaqDB::StatusCode::OK);
+
+    put("k4");
+    tiering.process(2 * TEST_MS + 1);
+    BOOST_CHECK(!tiering.isDraining());
+    BOOST_CHECK(queued.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(SkipsValuesNotInPmem, TieringFixture) {
+    put("k1", DISK);
+    tiering.track("k2", 2);
+    put("k3");
+    pmemUsed = TEST_POOL_SIZE;
+
+    tiering.process(TEST_MS);
+    BOOST_REQUIRE_EQUAL(queued.size(), 1);
+    BOOST_CHECK_EQUAL(std::string(queued[0]->key, queued[0]->keySize), "k3");
+    BOOST_CHECK_EQUAL(tiering.getTrackedCount(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(RetriesFailedMoves, TieringFixture) {
+    put("k1");
+    put("k2");
+    pmemUsed = TEST_POOL_SIZE;
+
+    /* key stays first in line while offload queue is full */
+    queueFull = true;
+    tiering.process(TEST_MS);
+    BOOST_CHECK(queued.empty());
+    BOOST_CHECK_EQUAL(tiering.getTrackedCount(), 2);
+
+    queueFull = false;
+    tiering.process(2 * TEST_MS);
+    BOOST_REQUIRE_EQUAL(queued.size(), 2);
+    BOOST_CHECK_EQUAL(std::string(queued[0]->key, queued[0]->keySize), "k1");
+
+    /* value that failed to move goes after keys tracked meanwhile */
+    complete(DaqDB::StatusCode::UNKNOWN_ERROR);
+    BOOST_CHECK_EQUAL(tiering.getMovedCount(), 0);
+    BOOST_CHECK_EQUAL(tiering.getTrackedCount(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(DropsKeysOfRemovedValues, TieringFixture) {
+    put("k1");
+    put("k2");
+    put("k3");
+    pmemUsed = TEST_POOL_SIZE * TEST_LOW / 100;
+
+    locations.erase("k1");
+    locations["k3"] = DISK;
+    tiering.process(TEST_MS);
+    BOOST_CHECK(queued.empty());
+    BOOST_CHECK_EQUAL(tiering.getTrackedCount(), 2);
+
+    locations.erase("k2");
+    tiering.process(2 * TEST_MS);
+    BOOST_CHECK_EQUAL(tiering.getTrackedCount(), 0);
+}
@@ -0,0 +1,84 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+
+#include "../../lib/offload/OffloadUnmapQueue.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_BATCH_SIZE 4
+#define TEST_DELAY 1000
+
+BOOST_AUTO_TEST_CASE(TakeWaitsForFullBatch) {
+    DaqDB::OffloadUnmapQueue queue(TEST_BATCH_SIZE, TEST_DELAY);
+    std::vector<DaqDB::OffloadExtent> batch;
+
+    BOOST_CHECK(!queue.take(0, batch));
+    for (uint64_t idx = 0; idx < TEST_BATCH_SIZE - 1; idx++)
+        queue.push(idx * 8, 8, 10);
+    BOOST_CHECK(!queue.take(10, batch));
+    BOOST_CHECK_EQUAL(queue.size(), TEST_BATCH_SIZE - 1);
+
+    queue.push(64, 8, 20);
+    BOOST_REQUIRE(queue.take(20, batch));
+    BOOST_CHECK_EQUAL(batch.size(), TEST_BATCH_SIZE);
+    BOOST_CHECK_EQUAL(queue.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TakeFlushesAgedExtents) {
+    DaqDB::OffloadUnmapQueue queue(TEST_BATCH_SIZE, TEST_DELAY);
+    std::vector<DaqDB::OffloadExtent> batch;
+
+    queue.push(0, 8, 100);
+    queue.push(8, 8, 900);
+    BOOST_CHECK(!queue.take(100 + TEST_DELAY - 1, batch));
+    BOOST_REQUIRE(queue.take(100 + TEST_DELAY, batch));
+    BOOST_CHECK_EQUAL(batch.size(), 2);
+
+    /* age is counted from the first extent of the next batch */
+    batch.clear();
+    queue.push(16, 8, 2000);
+    BOOST_CHECK(!queue.take(2000 + TEST_DELAY - 1, batch));
+    queue.drain(batch);
+    BOOST_CHECK_EQUAL(batch.size(), 1);
+    BOOST_CHECK_EQUAL(queue.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(MergeJoinsAdjacentExtents) {
+    std::vector<DaqDB::OffloadExtent> batch = {
+        {32, 8}, {0, 8}, {8, 16}, {64, 8}, {40, 4}, {66, 2}};
+    std::vector<DaqDB::OffloadExtent> ranges;
+
+    DaqDB::OffloadUnmapQueue::merge(batch, ranges);
+    BOOST_REQUIRE_EQUAL(ranges.size(), 3);
+    BOOST_CHECK_EQUAL(ranges[0].lba, 0);
+    BOOST_CHECK_EQUAL(ranges[0].blocks, 24);
+    BOOST_CHECK_EQUAL(ranges[1].lba, 32);
+    BOOST_CHECK_EQUAL(ranges[1].blocks, 12);
+    BOOST_CHECK_EQUAL(ranges[2].lba, 64);
+    BOOST_CHECK_EQUAL(ranges[2].blocks, 8);
+    BOOST_CHECK_EQUAL(batch.size(), 6);
+
+    batch.clear();
+    DaqDB::OffloadUnmapQueue::merge(batch, ranges);
+    BOOST_CHECK(ranges.empty());
+}
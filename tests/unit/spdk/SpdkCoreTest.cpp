@@ -0,0 +1,92 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <condition_variable>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <daqdb/Options.h>
+
+#include "../../lib/common/Poller.h"
+#include "../../lib/spdk/SpdkBdevFactory.h"
+#include "../../lib/spdk/SpdkCore.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+using namespace DaqDB;
+
+static OffloadDevDescriptor nvmeDev(const std::string &addr,
+                                    const std::string &name) {
+    OffloadDevDescriptor dev;
+    dev.nvmeAddr = addr;
+    dev.nvmeName = name;
+    return dev;
+}
+
+BOOST_AUTO_TEST_CASE(ConfBdev) {
+    OffloadOptions options;
+    options.devType = OffloadDevType::BDEV;
+    options._devs.push_back(nvmeDev("0000:88:00.0", "Nvme0"));
+
+    std::ostringstream conf;
+    SpdkCore::writeConf(conf, options);
+    BOOST_CHECK_EQUAL(conf.str(),
+                      "[Nvme]\n"
+                      "  TransportID \"trtype:PCIe traddr:0000:88:00.0\" "
+                      "Nvme0\n");
+}
+
+BOOST_AUTO_TEST_CASE(ConfRaid0) {
+    OffloadOptions options;
+    options.devType = OffloadDevType::RAID0;
+    options.raid0StripeSize = 64;
+    options._devs.push_back(nvmeDev("0000:88:00.0", "Nvme0"));
+    options._devs.push_back(nvmeDev("0000:89:00.0", "Nvme1"));
+
+    std::ostringstream conf;
+    SpdkCore::writeConf(conf, options);
+    /* raid bdev is looked up by this name once SPDK created it */
+    BOOST_CHECK_EQUAL(std::string(SpdkRAID0Bdev::raidBdevName), "Raid0");
+    BOOST_CHECK_EQUAL(conf.str(),
+                      "[Nvme]\n"
+                      "  TransportID \"trtype:PCIe traddr:0000:88:00.0\" "
+                      "Nvme0\n"
+                      "  TransportID \"trtype:PCIe traddr:0000:89:00.0\" "
+                      "Nvme1\n"
+                      "[RAID1]\n"
+                      "  Name Raid0\n"
+                      "  StripSize 64\n"
+                      "  NumDevices 2\n"
+                      "  RaidLevel 0\n"
+                      "  Devices Nvme0n1 Nvme1n1\n");
+}
+
+BOOST_AUTO_TEST_CASE(ConfAppLessDevice) {
+    OffloadOptions options;
+    options.devType = OffloadDevType::NULLDEV;
+
+    std::ostringstream conf;
+    SpdkCore::writeConf(conf, options);
+    BOOST_CHECK(conf.str().empty());
+}
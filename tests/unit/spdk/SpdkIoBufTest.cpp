@@ -0,0 +1,164 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../../lib/spdk/SpdkIoBuf.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+
+namespace ut = boost::unit_test;
+
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_ALIGN 512
+
+/* DMA buffers currently allocated */
+static size_t dmaBufCnt = 0;
+
+void *spdk_dma_zmalloc(size_t size, size_t align, uint64_t *phys_addr) {
+    void *buf = nullptr;
+    if (posix_memalign(&buf, align, size))
+        return nullptr;
+    memset(buf, 0, size);
+    dmaBufCnt++;
+    return buf;
+}
+
+void spdk_dma_free(void *buf) {
+    dmaBufCnt--;
+    free(buf);
+}
+
+int spdk_mem_register(void *vaddr, size_t len) { return 0; }
+
+int spdk_mem_unregister(void *vaddr, size_t len) { return 0; }
+
+static bool isAligned(const void *buf, uintptr_t align) {
+    return !(reinterpret_cast<uintptr_t>(buf) % align);
+}
+
+BOOST_AUTO_TEST_CASE(LargeClassRounding) {
+    {
+        SpdkIoBufMgr mgr;
+
+        SpdkIoBuf *buf = mgr.getIoWriteBuf(SPDK_IO_BUF_LARGE_MIN + 1,
+                                           TEST_ALIGN);
+        BOOST_REQUIRE(buf != nullptr);
+        BOOST_CHECK_EQUAL(buf->getIdx(), SPDK_IO_BUF_LARGE_IDX + 1);
+        BOOST_CHECK(isAligned(buf->getSpdkDmaBuf(), SPDK_IO_BUF_LARGE_ALIGN));
+        mgr.putIoWriteBuf(buf);
+
+        /* reads and writes of the same class share the free buffers */
+        SpdkIoBuf *readBuf = mgr.getIoReadBuf(2 * SPDK_IO_BUF_LARGE_MIN,
+                                              TEST_ALIGN);
+        BOOST_CHECK_EQUAL(readBuf, buf);
+        mgr.putIoReadBuf(readBuf);
+
+        buf = mgr.getIoWriteBuf(SPDK_IO_BUF_MAX_SIZE, TEST_ALIGN);
+        BOOST_CHECK_EQUAL(buf->getIdx(), SPDK_IO_BUF_LARGE_IDX +
+                                             SPDK_IO_BUF_LARGE_CLASSES - 1);
+        mgr.putIoWriteBuf(buf);
+        BOOST_CHECK_EQUAL(dmaBufCnt, 2);
+    }
+    BOOST_CHECK_EQUAL(dmaBufCnt, 0);
+}
+
+BOOST_AUTO_TEST_CASE(LargeDepthBounded) {
+    {
+        SpdkIoBufMgr mgr;
+        std::vector<SpdkIoBuf *> bufs;
+        for (size_t idx = 0; idx < SPDK_IO_BUF_LARGE_DEPTH + 2; idx++)
+            bufs.push_back(
+                mgr.getIoWriteBuf(SPDK_IO_BUF_LARGE_MIN, TEST_ALIGN));
+        BOOST_CHECK_EQUAL(dmaBufCnt, SPDK_IO_BUF_LARGE_DEPTH + 2);
+
+        for (auto buf : bufs)
+            mgr.putIoWriteBuf(buf);
+        BOOST_CHECK_EQUAL(dmaBufCnt, SPDK_IO_BUF_LARGE_DEPTH);
+    }
+    BOOST_CHECK_EQUAL(dmaBufCnt, 0);
+}
+
+BOOST_AUTO_TEST_CASE(OversizedReadNotPooled) {
+    SpdkIoBufMgr mgr;
+
+    SpdkIoBuf *buf = mgr.getIoReadBuf(SPDK_IO_BUF_MAX_SIZE + 1, TEST_ALIGN);
+    BOOST_REQUIRE(buf != nullptr);
+    BOOST_CHECK_EQUAL(buf->getIdx(), -1);
+    BOOST_CHECK(buf->getSpdkDmaBuf() != nullptr);
+    mgr.putIoReadBuf(buf);
+    BOOST_CHECK_EQUAL(dmaBufCnt, 0);
+}
+
+BOOST_AUTO_TEST_CASE(WriteVecChunks) {
+    {
+        SpdkIoBufMgr mgr;
+        const size_t size = 2 * SPDK_IO_BUF_MAX_SIZE + 100;
+        std::vector<char> src(size);
+        for (size_t idx = 0; idx < size; idx++)
+            src[idx] = static_cast<char>(idx % 251);
+
+        SpdkIoVec *ioVec = mgr.getIoWriteVec(size, TEST_ALIGN);
+        BOOST_REQUIRE_EQUAL(ioVec->chunks.size(), 3);
+        BOOST_REQUIRE_EQUAL(ioVec->iovs.size(), 3);
+        BOOST_CHECK_EQUAL(ioVec->iovs[0].iov_len, SPDK_IO_BUF_MAX_SIZE);
+        BOOST_CHECK_EQUAL(ioVec->iovs[1].iov_len, SPDK_IO_BUF_MAX_SIZE);
+        BOOST_CHECK_EQUAL(ioVec->iovs[2].iov_len, 100);
+        /* tail chunk comes from the smallest large class */
+        BOOST_CHECK_EQUAL(ioVec->chunks[2]->getIdx(), SPDK_IO_BUF_LARGE_IDX);
+        for (size_t idx = 0; idx < ioVec->iovs.size(); idx++) {
+            BOOST_CHECK_EQUAL(ioVec->iovs[idx].iov_base,
+                              ioVec->chunks[idx]->getSpdkDmaBuf());
+            BOOST_CHECK(
+                isAligned(ioVec->iovs[idx].iov_base, SPDK_IO_BUF_LARGE_ALIGN));
+        }
+
+        ioVec->copyIn(src.data(), size);
+        size_t offset = 0;
+        for (auto &iov : ioVec->iovs) {
+            BOOST_CHECK(!memcmp(iov.iov_base, &src[offset], iov.iov_len));
+            offset += iov.iov_len;
+        }
+
+        mgr.putIoWriteVec(ioVec);
+        /* chunks went back to their pools */
+        BOOST_CHECK_EQUAL(dmaBufCnt, 3);
+    }
+    BOOST_CHECK_EQUAL(dmaBufCnt, 0);
+}
+
+BOOST_AUTO_TEST_CASE(CopyInShorterThanVec) {
+    char first[8];
+    char second[8];
+    memset(first, 'x', sizeof(first));
+    memset(second, 'x', sizeof(second));
+    SpdkIoVec ioVec;
+    ioVec.iovs.push_back({first, sizeof(first)});
+    ioVec.iovs.push_back({second, sizeof(second)});
+
+    /* copy ends within the second buffer, the rest is left untouched */
+    ioVec.copyIn("0123456789", 10);
+    BOOST_CHECK(!memcmp(first, "01234567", 8));
+    BOOST_CHECK(!memcmp(second, "89xxxxxx", 8));
+}
@@ -0,0 +1,159 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "../../lib/spdk/SpdkJBODBdev.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <fakeit.hpp>
+
+namespace ut = boost::unit_test;
+
+using namespace fakeit;
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_BLK_SIZE 512
+/* 4KB value takes 8 blocks */
+#define TEST_VALUE_SIZE 4096
+#define TEST_VALUE_BLOCKS 8
+
+/*
+ * JBOD over member bdevs whose queue depth and free space are set by the
+ * test. Members are owned by their mocks.
+ */
+class TestJBODBdev : public SpdkJBODBdev {
+  public:
+    explicit TestJBODBdev(OffloadPlacement devPlacement) {
+        placement = devPlacement;
+        spBdevCtx.blk_size = TEST_BLK_SIZE;
+        spBdevCtx.io_min_size = 4096;
+    }
+    ~TestJBODBdev() { numDevices = 0; }
+
+    void addDevice(SpdkBdev *bdev) {
+        devices[numDevices].bdev = bdev;
+        devices[numDevices].num = numDevices;
+        numDevices++;
+    }
+
+    uint32_t select(const DeviceTask *task) { return _selectDevice(task); }
+};
+
+struct JBODFixture {
+    explicit JBODFixture(size_t cnt) : mocks(cnt) {
+        for (auto &mock : mocks) {
+            SpdkBdev &bdev = mock.get();
+            bdev.ioQueueCnt = 0;
+            bdev.stats.outstanding_io_cnt = 0;
+            bdev.stats.free_blk_cnt = 1024;
+        }
+        rqst.valueSize = TEST_VALUE_SIZE;
+        task.rqst = &rqst;
+    }
+
+    void attach(TestJBODBdev &jbod) {
+        for (auto &mock : mocks)
+            jbod.addDevice(&mock.get());
+    }
+
+    SpdkBdev &bdev(size_t idx) { return mocks[idx].get(); }
+
+    std::vector<Mock<SpdkBdev>> mocks;
+    OffloadRqst rqst;
+    DeviceTask task;
+};
+
+BOOST_AUTO_TEST_CASE(RoundRobin) {
+    JBODFixture fixture(3);
+    TestJBODBdev jbod(OffloadPlacement::ROUND_ROBIN);
+    fixture.attach(jbod);
+    /* load is ignored */
+    fixture.bdev(1).stats.outstanding_io_cnt = 10;
+
+    for (uint32_t cnt = 0; cnt < 6; cnt++)
+        BOOST_CHECK_EQUAL(jbod.select(&fixture.task), cnt % 3);
+}
+
+BOOST_AUTO_TEST_CASE(QueueDepth) {
+    JBODFixture fixture(3);
+    TestJBODBdev jbod(OffloadPlacement::QUEUE_DEPTH);
+    fixture.attach(jbod);
+
+    /* equally loaded members are written in turn */
+    for (uint32_t cnt = 0; cnt < 3; cnt++)
+        BOOST_CHECK_EQUAL(jbod.select(&fixture.task), cnt);
+
+    fixture.bdev(0).stats.outstanding_io_cnt = 5;
+    fixture.bdev(1).stats.outstanding_io_cnt = 1;
+    fixture.bdev(2).stats.outstanding_io_cnt = 3;
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 1);
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 1);
+
+    /* same depth, more free space wins */
+    fixture.bdev(2).stats.outstanding_io_cnt = 1;
+    fixture.bdev(2).stats.free_blk_cnt = 2048;
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 2);
+}
+
+BOOST_AUTO_TEST_CASE(FreeSpace) {
+    JBODFixture fixture(3);
+    TestJBODBdev jbod(OffloadPlacement::FREE_SPACE);
+    fixture.attach(jbod);
+
+    fixture.bdev(0).stats.free_blk_cnt = 100;
+    fixture.bdev(1).stats.free_blk_cnt = 300;
+    fixture.bdev(2).stats.free_blk_cnt = 200;
+    fixture.bdev(1).stats.outstanding_io_cnt = 10;
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 1);
+
+    /* same free space, lower queue depth wins */
+    fixture.bdev(2).stats.free_blk_cnt = 300;
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 2);
+}
+
+BOOST_AUTO_TEST_CASE(FullMemberSkipped) {
+    JBODFixture fixture(3);
+    TestJBODBdev jbod(OffloadPlacement::QUEUE_DEPTH);
+    fixture.attach(jbod);
+
+    fixture.bdev(0).stats.free_blk_cnt = TEST_VALUE_BLOCKS - 1;
+    fixture.bdev(1).stats.outstanding_io_cnt = 4;
+    fixture.bdev(2).stats.outstanding_io_cnt = 2;
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 2);
+
+    fixture.bdev(0).stats.free_blk_cnt = TEST_VALUE_BLOCKS;
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 0);
+}
+
+BOOST_AUTO_TEST_CASE(AllMembersFull) {
+    JBODFixture fixture(3);
+    TestJBODBdev jbod(OffloadPlacement::QUEUE_DEPTH);
+    fixture.attach(jbod);
+
+    for (size_t idx = 0; idx < 3; idx++)
+        fixture.bdev(idx).stats.free_blk_cnt = 0;
+    fixture.bdev(0).stats.outstanding_io_cnt = 2;
+    fixture.bdev(2).stats.outstanding_io_cnt = 1;
+    fixture.bdev(1).stats.outstanding_io_cnt = 3;
+    /* write is still placed, failing on the least loaded member */
+    BOOST_CHECK_EQUAL(jbod.select(&fixture.task), 2);
+}
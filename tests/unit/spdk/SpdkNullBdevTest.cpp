@@ -0,0 +1,155 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../../lib/spdk/SpdkNullBdev.h"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_BLOCKS 16
+
+/*
+ * Null or RAM device set up as bdevInit does on the IO engine thread,
+ * without the finalizer and IO engine threads started by init. IOs are
+ * submitted and polled on a single queue by the test.
+ */
+class TestNullBdev : public SpdkNullBdev {
+  public:
+    TestNullBdev(bool ram, size_t size, uint64_t latencyUs) {
+        _ram = ram;
+        _size = size;
+        _latency = latencyUs * 1000;
+        strcpy(spBdevCtx.bdev_name, ram ? ramBdevName : nullBdevName);
+        queue.bdev = this;
+        queue.idx = 0;
+    }
+
+    int write(char *buf, uint64_t lba, uint64_t blocks) {
+        return submitWrite(queue, buf, lba, blocks, done, this);
+    }
+    int writev(struct iovec *iov, int iovcnt, uint64_t lba, uint64_t blocks) {
+        return submitWritev(queue, iov, iovcnt, lba, blocks, done, this);
+    }
+    int read(char *buf, uint64_t lba, uint64_t blocks) {
+        return submitRead(queue, buf, lba, blocks, done, this);
+    }
+    void poll() { pollIoQueue(queue); }
+
+    static void done(struct spdk_bdev_io *bdev_io, bool success, void *arg) {
+        TestNullBdev *bdev = reinterpret_cast<TestNullBdev *>(arg);
+        if (success)
+            bdev->completed++;
+    }
+
+    SpdkIoQueue queue;
+    size_t completed = 0;
+};
+
+static std::vector<char> block(char fill) {
+    return std::vector<char>(SPDK_NULL_BLK_SIZE, fill);
+}
+
+BOOST_AUTO_TEST_CASE(RamWriteRead) {
+    TestNullBdev bdev(true, TEST_BLOCKS * SPDK_NULL_BLK_SIZE, 0);
+    BOOST_REQUIRE(bdev.bdevInit());
+    BOOST_CHECK_EQUAL(bdev.spBdevCtx.blk_num, TEST_BLOCKS);
+    BOOST_CHECK_EQUAL(bdev.spBdevCtx.blk_size, SPDK_NULL_BLK_SIZE);
+
+    std::vector<char> written = block('a');
+    BOOST_CHECK_EQUAL(bdev.write(written.data(), 2, 1), 0);
+    /* completion comes with the next poll, never within submission */
+    BOOST_CHECK_EQUAL(bdev.completed, 0);
+    bdev.poll();
+    BOOST_CHECK_EQUAL(bdev.completed, 1);
+
+    std::vector<char> buf = block(0);
+    BOOST_CHECK_EQUAL(bdev.read(buf.data(), 2, 1), 0);
+    bdev.poll();
+    BOOST_CHECK_EQUAL(bdev.completed, 2);
+    BOOST_CHECK(buf == written);
+
+    /* other blocks were not written */
+    BOOST_CHECK_EQUAL(bdev.read(buf.data(), 3, 1), 0);
+    BOOST_CHECK(buf == block(0));
+    bdev.poll();
+}
+
+BOOST_AUTO_TEST_CASE(RamWritev) {
+    TestNullBdev bdev(true, TEST_BLOCKS * SPDK_NULL_BLK_SIZE, 0);
+    BOOST_REQUIRE(bdev.bdevInit());
+
+    std::vector<char> first = block('x');
+    std::vector<char> second = block('y');
+    struct iovec iov[2] = {{first.data(), first.size()},
+                           {second.data(), second.size()}};
+    BOOST_CHECK_EQUAL(bdev.writev(iov, 2, TEST_BLOCKS - 2, 2), 0);
+
+    std::vector<char> buf(2 * SPDK_NULL_BLK_SIZE);
+    BOOST_CHECK_EQUAL(bdev.read(buf.data(), TEST_BLOCKS - 2, 2), 0);
+    BOOST_CHECK(!memcmp(buf.data(), first.data(), SPDK_NULL_BLK_SIZE));
+    BOOST_CHECK(!memcmp(&buf[SPDK_NULL_BLK_SIZE], second.data(),
+                        SPDK_NULL_BLK_SIZE));
+    bdev.poll();
+    BOOST_CHECK_EQUAL(bdev.completed, 2);
+}
+
+BOOST_AUTO_TEST_CASE(NullDropsWrites) {
+    TestNullBdev bdev(false, TEST_BLOCKS * SPDK_NULL_BLK_SIZE, 0);
+    BOOST_REQUIRE(bdev.bdevInit());
+
+    std::vector<char> written = block('a');
+    BOOST_CHECK_EQUAL(bdev.write(written.data(), 0, 1), 0);
+
+    /* read buffer is left as it is */
+    std::vector<char> buf = block('z');
+    BOOST_CHECK_EQUAL(bdev.read(buf.data(), 0, 1), 0);
+    BOOST_CHECK(buf == block('z'));
+    bdev.poll();
+    BOOST_CHECK_EQUAL(bdev.completed, 2);
+}
+
+BOOST_AUTO_TEST_CASE(LatencyDelaysCompletion) {
+    TestNullBdev bdev(false, TEST_BLOCKS * SPDK_NULL_BLK_SIZE, 20000);
+    BOOST_REQUIRE(bdev.bdevInit());
+
+    std::vector<char> buf = block('a');
+    BOOST_CHECK_EQUAL(bdev.write(buf.data(), 0, 1), 0);
+    BOOST_CHECK_EQUAL(bdev.write(buf.data(), 1, 1), 0);
+    bdev.poll();
+    BOOST_CHECK_EQUAL(bdev.completed, 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    bdev.poll();
+    BOOST_CHECK_EQUAL(bdev.completed, 2);
+}
+
+BOOST_AUTO_TEST_CASE(SizeBelowBlock) {
+    TestNullBdev bdev(true, SPDK_NULL_BLK_SIZE - 1, 0);
+    BOOST_CHECK(!bdev.bdevInit());
+    BOOST_CHECK_EQUAL(bdev.spBdevCtx.state, SPDK_BDEV_ERROR);
+}
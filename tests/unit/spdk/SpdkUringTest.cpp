@@ -0,0 +1,193 @@
+/**
+ *  Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../../lib/spdk/SpdkUring.cpp"
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+namespace ut = boost::unit_test;
+
+using namespace DaqDB;
+
+#define BOOST_TEST_DETECT_MEMORY_LEAK 1
+
+#define TEST_ENTRIES 8
+#define TEST_BLK_SIZE 4096
+
+/*
+ * Ring over a temporary file, removed with the fixture. Kernels without
+ * io_uring, or sandboxes blocking it, leave the ring uninitialized.
+ */
+struct UringFixture {
+    UringFixture() {
+        char path[] = "/tmp/daqdb_uring_XXXXXX";
+        fd = mkstemp(path);
+        BOOST_REQUIRE(fd >= 0);
+        unlink(path);
+        BOOST_REQUIRE(!ftruncate(fd, 4 * TEST_BLK_SIZE));
+        BOOST_REQUIRE(!posix_memalign(&buf, TEST_BLK_SIZE, TEST_BLK_SIZE));
+    }
+    ~UringFixture() {
+        ring.exit();
+        free(buf);
+        close(fd);
+    }
+
+    bool init(bool sqPoll, unsigned int fixedBufs) {
+        rc = ring.init(TEST_ENTRIES, fd, sqPoll, fixedBufs);
+        if (rc == -ENOSYS || rc == -EPERM) {
+            BOOST_TEST_MESSAGE("io_uring not available, skipped");
+            return false;
+        }
+        BOOST_REQUIRE_EQUAL(rc, 0);
+        return true;
+    }
+
+    /* submits a single IO on fixed file 0 and returns its result */
+    int io(uint8_t opcode, uint64_t offset, int bufIdx = -1) {
+        struct io_uring_sqe *sqe = ring.getSqe();
+        BOOST_REQUIRE(sqe != nullptr);
+        sqe->opcode = opcode;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->fd = 0;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = TEST_BLK_SIZE;
+        sqe->off = offset;
+        sqe->user_data = offset + 1;
+        if (bufIdx >= 0)
+            sqe->buf_index = bufIdx;
+
+        int res = 0;
+        auto done = [&](uint64_t data, int ioRes) {
+            BOOST_CHECK_EQUAL(data, offset + 1);
+            res = ioRes;
+        };
+        unsigned int cnt = ring.reap(done);
+        while (!cnt) {
+            int waitRc = ring.wait();
+            BOOST_REQUIRE(waitRc >= 0 || waitRc == -EINTR);
+            cnt = ring.reap(done);
+        }
+        BOOST_CHECK_EQUAL(cnt, 1);
+        return res;
+    }
+
+    int fd = -1;
+    int rc = 0;
+    void *buf = nullptr;
+    SpdkUring ring;
+};
+
+BOOST_AUTO_TEST_CASE(WriteRead) {
+    UringFixture fixture;
+    if (!fixture.init(false, 0))
+        return;
+    BOOST_CHECK(!fixture.ring.isSqPoll());
+    BOOST_CHECK(fixture.ring.getCqEntries() >= TEST_ENTRIES);
+
+    memset(fixture.buf, 0x5a, TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(fixture.io(IORING_OP_WRITE, TEST_BLK_SIZE),
+                      TEST_BLK_SIZE);
+
+    memset(fixture.buf, 0, TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(fixture.io(IORING_OP_READ, TEST_BLK_SIZE),
+                      TEST_BLK_SIZE);
+    std::vector<char> expected(TEST_BLK_SIZE, 0x5a);
+    BOOST_CHECK(!memcmp(fixture.buf, expected.data(), TEST_BLK_SIZE));
+
+    /* data went to the file at the given offset */
+    std::vector<char> stored(TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(pread(fixture.fd, stored.data(), TEST_BLK_SIZE,
+                            TEST_BLK_SIZE),
+                      TEST_BLK_SIZE);
+    BOOST_CHECK(stored == expected);
+}
+
+BOOST_AUTO_TEST_CASE(SqFull) {
+    UringFixture fixture;
+    if (!fixture.init(false, 0))
+        return;
+
+    for (unsigned int idx = 0; idx < TEST_ENTRIES; idx++) {
+        struct io_uring_sqe *sqe = fixture.ring.getSqe();
+        BOOST_REQUIRE(sqe != nullptr);
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = idx;
+    }
+    BOOST_CHECK(fixture.ring.getSqe() == nullptr);
+
+    BOOST_CHECK_EQUAL(fixture.ring.submit(), TEST_ENTRIES);
+    uint64_t seen = 0;
+    unsigned int cnt = 0;
+    while (cnt < TEST_ENTRIES) {
+        cnt += fixture.ring.reap([&](uint64_t data, int res) {
+            BOOST_CHECK_EQUAL(res, 0);
+            seen |= 1UL << data;
+        });
+        if (cnt < TEST_ENTRIES)
+            BOOST_REQUIRE(fixture.ring.wait() >= 0);
+    }
+    BOOST_CHECK_EQUAL(seen, (1UL << TEST_ENTRIES) - 1);
+
+    /* reaped entries free the SQ again */
+    BOOST_CHECK(fixture.ring.getSqe() != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(FixedBuffer) {
+    UringFixture fixture;
+    if (!fixture.init(false, 2))
+        return;
+    if (!fixture.ring.getFixedBufs()) {
+        BOOST_TEST_MESSAGE("sparse buffer table not supported, skipped");
+        BOOST_CHECK_EQUAL(fixture.ring.registerBuffer(0, fixture.buf,
+                                                      TEST_BLK_SIZE),
+                          -EINVAL);
+        return;
+    }
+    BOOST_CHECK_EQUAL(fixture.ring.getFixedBufs(), 2);
+    BOOST_CHECK_EQUAL(
+        fixture.ring.registerBuffer(2, fixture.buf, TEST_BLK_SIZE), -EINVAL);
+    BOOST_REQUIRE_EQUAL(
+        fixture.ring.registerBuffer(1, fixture.buf, TEST_BLK_SIZE), 0);
+
+    memset(fixture.buf, 0xa5, TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(fixture.io(IORING_OP_WRITE_FIXED, 0, 1), TEST_BLK_SIZE);
+    memset(fixture.buf, 0, TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(fixture.io(IORING_OP_READ_FIXED, 0, 1), TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(static_cast<unsigned char *>(fixture.buf)[0], 0xa5);
+}
+
+BOOST_AUTO_TEST_CASE(SqPollFallback) {
+    UringFixture fixture;
+    /* polling thread may not be permitted, the ring works either way */
+    if (!fixture.init(true, 0))
+        return;
+
+    memset(fixture.buf, 0x3c, TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(fixture.io(IORING_OP_WRITE, 0), TEST_BLK_SIZE);
+    memset(fixture.buf, 0, TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(fixture.io(IORING_OP_READ, 0), TEST_BLK_SIZE);
+    BOOST_CHECK_EQUAL(static_cast<unsigned char *>(fixture.buf)[0], 0x3c);
+}